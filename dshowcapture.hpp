@@ -47,8 +47,12 @@ namespace DShow {
 /* internal forward */
 struct HDevice;
 struct HVideoEncoder;
+struct HVideoFrame;
+struct HSyncGroup;
 struct VideoConfig;
 struct AudioConfig;
+class VideoFrame;
+class VideoEncoder;
 
 typedef std::function<void(const VideoConfig &config, unsigned char *data,
 			   size_t size, long long startTime, long long stopTime,
@@ -59,6 +63,25 @@ typedef std::function<void(const AudioConfig &config, unsigned char *data,
 			   size_t size, long long startTime, long long stopTime)>
 	AudioProc;
 
+struct AudioBuffer {
+	unsigned char *data;
+	size_t size;
+	long long startTime;
+	long long stopTime;
+};
+
+typedef std::function<void(const AudioConfig &config,
+			   const AudioBuffer *buffers, size_t count)>
+	AudioBatchProc;
+
+typedef std::function<void(const AudioConfig &config, float *const *planes,
+			   int channels, size_t frames, long long startTime,
+			   long long stopTime)>
+	AudioPlanarProc;
+
+typedef std::function<void(const VideoConfig &config, VideoFrame &&frame)>
+	VideoFrameProc;
+
 typedef std::function<void()> ReactivateProc;
 
 enum class InitGraph {
@@ -109,6 +132,8 @@ enum class AudioFormat {
 	/* raw formats */
 	Wave16bit = 100,
 	WaveFloat,
+	Wave24bit, /* packed */
+	Wave32bit,
 
 	/* encoded formats */
 	AAC = 200,
@@ -153,8 +178,28 @@ struct VideoDevice : DeviceId {
 	bool audioAttached = false;
 	bool separateAudioFilter = false;
 	std::vector<VideoInfo> caps;
+
+	/**
+	 * Caps (and audioAttached/separateAudioFilter) haven't been read
+	 * yet, see EnumMode::Lazy and Device::EnumVideoCaps
+	 */
+	bool capsPending = false;
 };
 
+enum class EnumMode {
+	/** Bind each device and read its caps, one after another */
+	Full,
+
+	/** Only list names and paths; caps are read on first access */
+	Lazy,
+
+	/** Read the caps of several devices at once on worker threads */
+	Parallel,
+};
+
+typedef std::function<void(std::vector<VideoDevice> &devices, bool success)>
+	EnumVideoDevicesProc;
+
 struct AudioDevice : DeviceId {
 	std::vector<AudioInfo> caps;
 };
@@ -162,6 +207,12 @@ struct AudioDevice : DeviceId {
 struct Config : DeviceId {
 	/** Use the device's desired default config */
 	bool useDefaultConfig = true;
+
+	/**
+	 * Minimum number of buffers in the capture pin's allocator
+	 * (0 to use the default)
+	 */
+	int bufferCount = 0;
 };
 
 struct VideoConfig : Config {
@@ -183,12 +234,99 @@ struct VideoConfig : Config {
 	/** Desired video format. */
 	VideoFormat format = VideoFormat::Any;
 
+	/**
+	 * Alternative to callback that hands out refcounted frames which
+	 * can be kept after the callback returns (used instead of callback
+	 * when set)
+	 */
+	VideoFrameProc frameCallback;
+
+	/**
+	 * Maximum number of frames that may hold on to capture buffers at
+	 * the same time; frames received past that are backed by a copy
+	 */
+	int maxRetainedFrames = 2;
+
+	/**
+	 * Generate timestamps from the host clock for devices that deliver
+	 * frames without any, instead of dropping those frames
+	 */
+	bool synthesizeTimestamps = false;
+
+	/**
+	 * Demux the transport stream of encoded devices (HD PVR, Roxio,
+	 * etc.) in the library rather than with the MPEG-2 demultiplexer
+	 * filter, giving packets the stream's own timestamps.  Their audio
+	 * is available through an audio config with useVideoDevice set.
+	 * Timestamps start at 0 from the first PTS of either stream; the
+	 * other stream's packets from before that are clamped to 0.  Audio
+	 * packets are held until the next one gives their stop time.
+	 */
+	bool softwareDemux = false;
+
+	/**
+	 * Feed frames straight into this encoder's input sample, converting
+	 * them to YV12 if needed, instead of calling callback/frameCallback.
+	 * The encoder must be configured for the capture size and have a
+	 * packetCallback, which is where the encoded packets come out.
+	 */
+	VideoEncoder *encoder = nullptr;
+
     void *context;
 };
 
 struct AudioConfig : Config {
 	AudioProc callback;
 
+	/**
+	 * Alternative to callback that receives all the buffers delivered
+	 * by the device at once (used instead of callback when set).  A
+	 * batch is monitored and clock-mapped as a single delivery, and a
+	 * format change is only picked up from the first buffer of a batch.
+	 */
+	AudioBatchProc batchCallback;
+
+	/**
+	 * Alternative to callback that receives planar float audio
+	 * converted from the device's native sample format (used instead of
+	 * callback/batchCallback when set).  Devices with 24-bit audio keep
+	 * their native format rather than being switched to 16-bit.
+	 * Compressed audio (AAC/AC3) still goes to callback/batchCallback.
+	 */
+	AudioPlanarProc planarCallback;
+
+	/**
+	 * Number of planar output channels (0 to keep the device's).
+	 * Standard layouts are downmixed when reducing the channel count.
+	 */
+	int planarChannels = 0;
+
+	/**
+	 * Optional source channel for each planar output channel (-1 for
+	 * silence), replacing the default downmix
+	 */
+	std::vector<int> channelMap;
+
+	/**
+	 * Resample the planar output to this rate (0 to keep the device's),
+	 * so the device rate can be chosen for bandwidth alone
+	 */
+	int planarSampleRate = 0;
+
+	/**
+	 * Replace the timestamps passed to the audio callbacks with ones
+	 * derived from the samples actually delivered, mapped onto the
+	 * video stream's timeline (see GetAVSyncStats)
+	 */
+	bool correctTimestamps = false;
+
+	/**
+	 * Continuously adjust the planar resampler (see planarSampleRate)
+	 * to hold the audio to the video clock.  Overrides
+	 * Device::SetAudioRateAdjust.
+	 */
+	bool correctDrift = false;
+
 	/**
 		 * Use the audio attached to the video device
 		 *
@@ -210,6 +348,160 @@ struct AudioConfig : Config {
 
 	/** Audio playback mode */
 	AudioMode mode = AudioMode::Capture;
+
+	/**
+	 * Buffering to request from the audio capture pin (ms, 0 to leave
+	 * the device's default).  Not applied to Stream Engine devices.
+	 */
+	int bufferingMs = 10;
+
+	/**
+	 * Start with minimal buffering and raise it whenever late buffers or
+	 * gaps in the audio are detected (bufferingMs is ignored).  The
+	 * raised value is remembered for the device and takes effect on
+	 * the next connection; reactivateCallback is called to request one.
+	 */
+	bool adaptiveBuffering = false;
+	ReactivateProc reactivateCallback;
+};
+
+struct AllocatorStats {
+	/** Whether the upstream filter delivers into our own buffers */
+	bool ownAllocator = false;
+
+	long buffers = 0;
+	long bufferSize = 0;
+
+	/** Samples currently held by the capture callbacks/consumers */
+	long outstanding = 0;
+	long maxOutstanding = 0;
+
+	long long delivered = 0;
+
+	/**
+	 * Number of times upstream had to wait for a free buffer, and the
+	 * total time spent waiting (in 100-nanosecond units)
+	 */
+	long long starved = 0;
+	long long starvedTime = 0;
+};
+
+/**
+ * Refcounted handle to a captured video frame.  The frame data stays valid
+ * for as long as any handle to it exists, so frames can be handed to other
+ * threads without copying.
+ */
+class DSHOWCAPTURE_EXPORT VideoFrame {
+	HVideoFrame *context = nullptr;
+
+public:
+	inline VideoFrame() {}
+	explicit VideoFrame(HVideoFrame *context);
+	VideoFrame(const VideoFrame &frame);
+	VideoFrame(VideoFrame &&frame) noexcept;
+	~VideoFrame();
+
+	VideoFrame &operator=(const VideoFrame &frame);
+	VideoFrame &operator=(VideoFrame &&frame) noexcept;
+
+	bool Valid() const;
+	void Reset();
+
+	/** Whether the frame references the capture buffer (not a copy) */
+	bool Retained() const;
+
+	VideoFormat Format() const;
+	int Width() const;
+	int Height() const;
+	bool Flipped() const;
+
+	/**
+	 * Plane data in memory order.  Encoded formats and formats without
+	 * a known layout have a single plane covering the whole buffer.
+	 */
+	const unsigned char *Data(int plane = 0) const;
+	size_t Linesize(int plane = 0) const;
+	size_t Size() const;
+
+	long long StartTime() const;
+	long long StopTime() const;
+	long Rotation() const;
+
+	/** Whether the timestamps were generated rather than from the device */
+	bool SyntheticTime() const;
+
+	/** Whether an encoded frame can be decoded on its own (IDR/IRAP) */
+	bool Keyframe() const;
+
+	/** Host clock time (see GetHostTime) at which the frame arrived */
+	long long HostTime() const;
+
+	/**
+	 * Start time mapped to the host clock, with delivery jitter
+	 * smoothed out
+	 */
+	long long PresentationTime() const;
+};
+
+struct ClockStats {
+	/** Number of timestamps the mapping is currently based on */
+	long long samples = 0;
+
+	/** Device clock drift relative to the host clock (parts per million) */
+	double driftPPM = 0.0;
+
+	/** Average deviation of receive times from the mapping (100ns units) */
+	long long jitter = 0;
+
+	/** Host time minus device time at the mapping origin (100ns units) */
+	long long offset = 0;
+};
+
+struct AudioBufferingStats {
+	/** Buffering requested from the device (ms, 0 if left as is) */
+	int bufferingMs = 0;
+	bool adaptive = false;
+
+	/** Times adaptive buffering has been raised for this device */
+	long long backoffs = 0;
+
+	long long buffers = 0;
+
+	/**
+	 * Average, maximum and average deviation of the interval between
+	 * buffers arriving (100ns units)
+	 */
+	long long meanInterval = 0;
+	long long maxInterval = 0;
+	long long jitter = 0;
+
+	/** Late buffers and gaps in the audio */
+	long long glitches = 0;
+};
+
+struct AVSyncStats {
+	/** Number of audio buffers measured against the video clock */
+	long long buffers = 0;
+
+	/** Audio sample clock drift relative to the host clock (ppm) */
+	double audioDriftPPM = 0.0;
+
+	/** Video clock drift relative to the host clock (ppm) */
+	double videoDriftPPM = 0.0;
+
+	/** Audio drift relative to video (ppm) */
+	double driftPPM = 0.0;
+
+	/**
+	 * Audio timestamp minus its corrected timestamp for the last
+	 * buffer, and the range seen (100ns units)
+	 */
+	long long offset = 0;
+	long long minOffset = 0;
+	long long maxOffset = 0;
+
+	/** Last ratio applied to the resampler by correctDrift */
+	double ratioAdjust = 1.0;
 };
 
 class DSHOWCAPTURE_EXPORT Device {
@@ -242,6 +534,42 @@ public:
 	bool GetVideoDeviceId(DeviceId &id) const;
 	bool GetAudioDeviceId(DeviceId &id) const;
 
+	bool GetVideoAllocatorStats(AllocatorStats &stats) const;
+	bool GetAudioAllocatorStats(AllocatorStats &stats) const;
+
+	bool GetVideoClockStats(ClockStats &stats) const;
+	bool GetAudioClockStats(ClockStats &stats) const;
+
+	/**
+	 * Maps a timestamp passed to the video/audio callbacks to the host
+	 * clock (see GetHostTime), or returns 0 if no mapping exists yet
+	 */
+	long long VideoTimeToHost(long long time) const;
+	long long AudioTimeToHost(long long time) const;
+
+	/**
+	 * Whether the timestamps of the frame being passed to the video
+	 * callback were synthesized rather than coming from the device.
+	 * Only meaningful from within that callback (frameCallback users get
+	 * this from VideoFrame::SyntheticTime).
+	 */
+	bool VideoTimeSynthetic() const;
+
+	/**
+	 * Nudges the planar audio resampler (see planarSampleRate), e.g.
+	 * 1.0001 produces 100ppm more output samples, to compensate for
+	 * clock drift.  Clamped to +/-5%.
+	 */
+	void SetAudioRateAdjust(double ratio);
+
+	/**
+	 * Audio/video offset and drift, measured when both video and audio
+	 * are captured
+	 */
+	bool GetAVSyncStats(AVSyncStats &stats) const;
+
+	bool GetAudioBufferingStats(AudioBufferingStats &stats) const;
+
 	/**
 		 * Opens a DirectShow dialog associated with this device
 		 *
@@ -250,9 +578,153 @@ public:
 	void OpenDialog(void *hwnd, DialogType type) const;
 
 	static bool EnumVideoDevices(std::vector<VideoDevice> &devices);
+	static bool EnumVideoDevices(std::vector<VideoDevice> &devices,
+				     EnumMode mode);
 	static bool EnumAudioDevices(std::vector<AudioDevice> &devices);
+
+	/**
+	 * Reads the caps of a device listed with EnumMode::Lazy (does
+	 * nothing if they were already read).  Fails for devices that
+	 * turn out not to be usable capture devices.
+	 */
+	static bool EnumVideoCaps(VideoDevice &device);
+
+	/**
+	 * Enumerates on a separate thread and calls callback from that
+	 * thread when done.  With EnumMode::Lazy the list arrives almost
+	 * immediately, and caps can be read as devices are selected.
+	 */
+	static void EnumVideoDevicesAsync(EnumVideoDevicesProc callback,
+					  EnumMode mode = EnumMode::Lazy);
+
+	/**
+	 * Process-wide snapshot of the device lists, shared by all callers.
+	 * It is refreshed when devices arrive or are removed, or once it is
+	 * older than maxAgeMs (0 for no age limit).
+	 */
+	static bool EnumVideoDevicesCached(std::vector<VideoDevice> &devices,
+					   int maxAgeMs = 30000);
+	static bool EnumAudioDevicesCached(std::vector<AudioDevice> &devices,
+					   int maxAgeMs = 30000);
+
+	/** Forces the next cached enumeration to enumerate again */
+	static void InvalidateDeviceCache();
+
+	/**
+	 * Keeps enumerated caps in this file across runs (nullptr to
+	 * disable, the default).  Used by EnumMode::Lazy/Parallel and
+	 * EnumAudioDevices for devices whose driver hasn't changed; cached
+	 * caps are checked against the device in the background.
+	 */
+	static void SetCapsCacheFile(const wchar_t *path);
+
+	/**
+	 * Remembers the configuration that opened a device (by path) for a
+	 * mode, any string the caller uses to describe what it asked for,
+	 * so that a later open can try it first.  Kept in memory, and in
+	 * the caps cache file if one is set, until the device's driver
+	 * changes or it is forgotten after failing.  GetKnownConfig only
+	 * fills in the size, interval, format and useDefaultConfig fields.
+	 */
+	static bool GetKnownConfig(const std::wstring &path,
+				   const std::wstring &mode,
+				   VideoConfig &config);
+	static void SetKnownConfig(const std::wstring &path,
+				   const std::wstring &mode,
+				   const VideoConfig &config);
+	static void ForgetKnownConfig(const std::wstring &path,
+				      const std::wstring &mode);
+};
+
+typedef std::function<void(std::vector<VideoFrame> &frames)> FrameSetProc;
+
+struct SyncGroupConfig {
+	/** Maximum time difference between frames of a set (100ns units) */
+	long long tolerance = 50000;
+
+	/**
+	 * How long to wait for missing frames before a set is considered
+	 * partial (100ns units)
+	 */
+	long long maxWait = 1000000;
+
+	/**
+	 * Deliver sets with missing frames (as invalid VideoFrames) instead
+	 * of dropping them
+	 */
+	bool deliverPartialSets = false;
+
+	/** Number of frames/sets queued per stream before dropping */
+	size_t queueSize = 8;
+
+	/**
+	 * Called from the sync thread for every set.  If not set, sets are
+	 * queued for GetFrameSet instead.
+	 */
+	FrameSetProc callback;
+};
+
+struct SyncGroupStats {
+	long long completeSets = 0;
+	long long partialSets = 0;
+	long long droppedSets = 0;
+	long long droppedFrames = 0;
+};
+
+/**
+ * Groups frames from several devices into sets by their host-mapped
+ * presentation time (see VideoFrame::PresentationTime).
+ */
+class DSHOWCAPTURE_EXPORT SyncGroup {
+	HSyncGroup *context;
+
+public:
+	SyncGroup(const SyncGroupConfig &config);
+	~SyncGroup();
+
+	/**
+	 * Adds a stream fed by the device the config is used with.  Hooks
+	 * config.frameCallback (any previous frameCallback/callback is
+	 * still called), so this must be called before SetVideoConfig.
+	 * Once the group is destroyed the hook just stops feeding it.
+	 *
+	 * @return  Stream index (position in each frame set), or -1 if the
+	 *          group is full
+	 */
+	int AddDevice(VideoConfig &config);
+
+	/** Adds a stream that is fed manually through Push */
+	int AddStream();
+
+	void Push(int stream, VideoFrame &&frame);
+
+	/** Waits for the next frame set when not using a callback */
+	bool GetFrameSet(std::vector<VideoFrame> &frames,
+			 unsigned long timeoutMs);
+
+	void GetStats(SyncGroupStats &stats) const;
 };
 
+struct EncoderPacket {
+	unsigned char *data = nullptr;
+	size_t size = 0;
+	long long pts = 0;
+
+	/**
+	 * DirectShow encoders don't report a decode time, so hasDts is never
+	 * set.  Packets from Encode/SubmitInputBuffer still carry a copy of
+	 * pts in dts, as they always have; packetCallback leaves it at 0.
+	 */
+	long long dts = 0;
+	bool hasDts = false;
+
+	/** From the bitstream of the encoder's output format */
+	bool keyframe = false;
+};
+
+/* packet data is only valid for the duration of the call */
+typedef std::function<void(const EncoderPacket &packet)> EncoderPacketProc;
+
 struct VideoEncoderConfig : DeviceId {
 	int fpsNumerator;
 	int fpsDenominator;
@@ -260,13 +732,75 @@ struct VideoEncoderConfig : DeviceId {
 	int keyframeInterval;
 	int cx;
 	int cy;
+
+	/**
+	 * Format of the frames passed to Encode: YV12, I420, NV12,
+	 * XRGB/ARGB (BGRA), or YUY2/UYVY with an even width.  The encoder
+	 * takes YV12, anything else is converted directly into its input
+	 * sample.
+	 */
+	VideoFormat inputFormat = VideoFormat::YV12;
+
+	/**
+	 * Called from the encoder's thread as soon as each packet is
+	 * produced, with the encoder's own sample memory.  pts is the start
+	 * time of the frame it was matched to.  When set, packets are not
+	 * queued and Encode only submits frames (new_packet is always
+	 * false).
+	 */
+	EncoderPacketProc packetCallback;
 };
 
-struct EncoderPacket {
-	unsigned char *data;
+struct EncoderStats {
+	/** Packets received from the encoder */
+	long long packets = 0;
+
+	/** Packets discarded because they weren't read fast enough */
+	long long dropped = 0;
+
+	long queued = 0;
+	long maxQueued = 0;
+
+	/** Packets whose timestamp didn't match any submitted frame */
+	long long unmatched = 0;
+
+	/** Frames dropped before reaching the encoder (CountDroppedInput) */
+	long long inputDropped = 0;
+
+	/** Recycled packet buffers and their size (high-water mark) */
+	long pooledBuffers = 0;
+	size_t bufferSize = 0;
+};
+
+struct BitstreamInfo {
+	/** Packet contains an IDR (H.264) or IRAP (HEVC) picture */
+	bool keyframe = false;
+
+	/** Bit n is set if the packet contains a NAL unit of type n */
+	unsigned long long nalTypes = 0;
+
+	/** Values from the packet's SPS, 0 if it has none */
+	int profile = 0;
+	int level = 0;
+	int width = 0;
+	int height = 0;
+
+	/** Frame interval from the SPS VUI timing info, or 0 */
+	long long frameInterval = 0;
+};
+
+/**
+ * Encoder input sample memory, locked for writing by GetInputBuffer.  Planes
+ * are in memory order (Y, V, U for YV12), linesize is the row stride.
+ */
+struct EncoderInputBuffer {
+	unsigned char *data[DSHOW_MAX_PLANES];
+	size_t linesize[DSHOW_MAX_PLANES];
 	size_t size;
-	long long pts;
-	long long dts;
+
+	VideoFormat format;
+	int cx;
+	int cy;
 };
 
 class VideoEncoder {
@@ -284,11 +818,37 @@ public:
 	bool SetConfig(VideoEncoderConfig &config);
 	bool GetConfig(VideoEncoderConfig &config) const;
 
+	/**
+	 * Encodes a frame.  Planes are in memory order (Y, V, U for YV12),
+	 * linesize is each plane's row stride; the size of the whole plane
+	 * is also accepted for tightly packed planes.
+	 */
 	bool Encode(unsigned char *data[DSHOW_MAX_PLANES],
 		    size_t linesize[DSHOW_MAX_PLANES], long long timestampStart,
 		    long long timestampEnd, EncoderPacket &packet,
 		    bool &new_packet);
 
+	/**
+	 * Zero-copy alternative to Encode: GetInputBuffer locks the next
+	 * input sample so the frame can be written straight into it, and
+	 * SubmitInputBuffer sends it to the encoder.  DiscardInputBuffer
+	 * releases it without sending anything, for a frame that couldn't
+	 * be written.  With a packetCallback there are never packets to
+	 * return, so SubmitInputBuffer can be called without them.
+	 */
+	bool GetInputBuffer(EncoderInputBuffer &buffer);
+	bool SubmitInputBuffer(long long timestampStart,
+			       long long timestampEnd, EncoderPacket &packet,
+			       bool &new_packet);
+	bool SubmitInputBuffer(long long timestampStart,
+			       long long timestampEnd);
+	void DiscardInputBuffer();
+
+	/** Counts a frame the caller dropped, see EncoderStats */
+	void CountDroppedInput();
+
+	bool GetStats(EncoderStats &stats) const;
+
 	static bool EnumEncoders(std::vector<DeviceId> &encoders);
 };
 
@@ -302,4 +862,17 @@ enum class LogType {
 typedef void (*LogCallback)(LogType type, const wchar_t *msg, void *param);
 
 DSHOWCAPTURE_EXPORT void SetLogCallback(LogCallback callback, void *param);
+
+/** Monotonic host clock used for timestamp mapping (100ns units) */
+DSHOWCAPTURE_EXPORT long long GetHostTime();
+
+/**
+ * Scans an Annex-B H.264 or HEVC packet for its NAL units, keyframes and
+ * sequence parameters.  Only the SPS is parsed; PPS and slice headers
+ * aren't, as nothing in BitstreamInfo comes from them.  Returns false if
+ * no NAL units were found.
+ */
+DSHOWCAPTURE_EXPORT bool ParseBitstream(VideoFormat format,
+					const unsigned char *data, size_t size,
+					BitstreamInfo &info);
 };
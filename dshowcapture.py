@@ -40,13 +40,31 @@ class DShowCapture():
             lib.get_colorspace.argtypes = [c_void_p]
             lib.capturing.argtypes = [c_void_p]
             lib.get_frame.argtypes = [c_void_p, c_int, c_char_p, c_int]
+            lib.get_frame_time.argtypes = [c_void_p, POINTER(c_longlong), POINTER(c_int)]
+            lib.set_synthesize_timestamps.argtypes = [c_void_p, c_int]
             lib.get_size.argtypes = [c_void_p]
             lib.stop_capture.argtypes = [c_void_p]
             lib.destroy_capture.argtypes = [c_void_p]
+            lib.capture_audio.argtypes = [c_void_p, c_int, c_int, c_int]
+            lib.read_audio.argtypes = [c_void_p, c_char_p, c_int, POINTER(c_longlong)]
+            lib.get_audio_sample_rate.argtypes = [c_void_p]
+            lib.get_audio_channels.argtypes = [c_void_p]
+            lib.get_audio_format.argtypes = [c_void_p]
+            lib.get_audio_stats.argtypes = [c_void_p, POINTER(c_longlong)]
+            lib.set_passthrough.argtypes = [c_void_p, c_int]
+            lib.get_packet.argtypes = [c_void_p, c_int, c_char_p, c_int, POINTER(c_longlong), POINTER(c_int)]
+            lib.get_packet_stats.argtypes = [c_void_p, POINTER(c_longlong)]
+            lib.create_sync_group.restype = c_void_p
+            lib.create_sync_group.argtypes = [c_longlong, c_int]
+            lib.sync_group_add.argtypes = [c_void_p, c_void_p]
+            lib.get_frame_set.argtypes = [c_void_p, c_int, POINTER(c_char_p), POINTER(c_int), POINTER(c_longlong), c_int]
+            lib.get_sync_group_stats.argtypes = [c_void_p, POINTER(c_longlong)]
+            lib.destroy_sync_group.argtypes = [c_void_p]
         self.lib = lib
         self.cap = lib.create_capture()
         self.name_buffer = create_string_buffer(255);
         self.buffer = None
+        self.packet_buffer = None
         self.have_devices = False
         self.size = None
         self.real_size = None
@@ -149,6 +167,68 @@ class DShowCapture():
             img = cv2.flip(img, 0)
         return img
 
+    # Returns (timestamp, synthetic) for the frame last returned by get_frame,
+    # synthetic is True if the device didn't timestamp it
+    def get_frame_time(self):
+        timestamp = c_longlong(0)
+        synthetic = c_int(0)
+        self.lib.get_frame_time(self.cap, byref(timestamp), byref(synthetic))
+        return timestamp.value, synthetic.value == 1
+
+    # Must be called before capture_device, frames from devices that don't
+    # timestamp them are then delivered with host clock timestamps
+    def set_synthesize_timestamps(self, enabled=True):
+        self.lib.set_synthesize_timestamps(self.cap, 1 if enabled else 0)
+
+    # Must be called before capture_device, audio comes from the video device
+    def capture_audio(self, sample_rate=0, channels=0, buffer_ms=200):
+        return self.lib.capture_audio(self.cap, sample_rate, channels, buffer_ms) == 1
+
+    # Returns (samples, timestamp) without blocking, samples has shape (frames, channels)
+    def read_audio(self, max_frames):
+        channels = self.lib.get_audio_channels(self.cap)
+        audio_format = self.lib.get_audio_format(self.cap)
+        dtypes = {100: np.int16, 101: np.float32, 103: np.int32}
+        if channels == 0 or audio_format not in dtypes:
+            return None, None
+        dtype = dtypes[audio_format]
+        buffer = create_string_buffer(max_frames * channels * np.dtype(dtype).itemsize)
+        timestamp = c_longlong(0)
+        frames = self.lib.read_audio(self.cap, buffer, max_frames, byref(timestamp))
+        samples = np.frombuffer(buffer, dtype=dtype)[0:frames * channels].reshape((frames, channels))
+        return samples, timestamp.value
+
+    def get_audio_sample_rate(self):
+        return self.lib.get_audio_sample_rate(self.cap)
+
+    def get_audio_stats(self):
+        stats = (c_longlong * 3)()
+        self.lib.get_audio_stats(self.cap, stats)
+        return {"overruns": stats[0], "underruns": stats[1], "buffered": stats[2]}
+
+    # Must be called before capture_device, encoded frames then come from get_packet
+    def set_passthrough(self, enabled=True):
+        self.lib.set_passthrough(self.cap, 1 if enabled else 0)
+
+    # Returns (data, timestamp, keyframe) or None on timeout
+    def get_packet(self, timeout):
+        if self.packet_buffer is None:
+            self.packet_buffer = create_string_buffer(1024 * 1024)
+        timestamp = c_longlong(0)
+        keyframe = c_int(0)
+        size = self.lib.get_packet(self.cap, timeout, self.packet_buffer, len(self.packet_buffer), byref(timestamp), byref(keyframe))
+        if size < 0:
+            self.packet_buffer = create_string_buffer(-size)
+            size = self.lib.get_packet(self.cap, 0, self.packet_buffer, len(self.packet_buffer), byref(timestamp), byref(keyframe))
+        if size <= 0:
+            return None
+        return self.packet_buffer.raw[0:size], timestamp.value, keyframe.value == 1
+
+    def get_packet_stats(self):
+        stats = (c_longlong * 3)()
+        self.lib.get_packet_stats(self.cap, stats)
+        return {"queued": stats[0], "dropped": stats[1], "waiting": stats[2]}
+
     def stop_capture(self):
         self.size = None
         self.real_size = None
@@ -163,6 +243,60 @@ class DShowCapture():
         self.real_size = None
         return ret
 
+class DShowSyncGroup():
+    # Groups frames from several DShowCapture objects by timestamp.
+    # Add captures before calling capture_device on them.
+    def __init__(self, tolerance_ms=5.0, partial=False):
+        global lib
+        if lib is None:
+            raise RuntimeError("Create a DShowCapture first")
+        self.lib = lib
+        self.group = lib.create_sync_group(int(tolerance_ms * 10000), 1 if partial else 0)
+        self.caps = []
+
+    def __del__(self):
+        self.destroy()
+
+    def add(self, cap):
+        index = self.lib.sync_group_add(self.group, cap.cap)
+        if index >= 0:
+            self.caps.append(cap)
+        return index
+
+    def get_frame_set(self, timeout):
+        count = len(self.caps)
+        if count == 0:
+            return None
+        sizes = (c_int * count)()
+        timestamps = (c_longlong * count)()
+        buffers = (c_char_p * count)()
+        for i, cap in enumerate(self.caps):
+            if cap.buffer is None:
+                return None
+            sizes[i] = cap.size
+            buffers[i] = cast(cap.buffer, c_char_p)
+        if self.lib.get_frame_set(self.group, timeout, buffers, sizes, timestamps, count) == 0:
+            return None
+        frames = []
+        for i, cap in enumerate(self.caps):
+            if sizes[i] == 0:
+                frames.append(None)
+                continue
+            cap.real_size = sizes[i]
+            frames.append((np.frombuffer(cap.buffer, dtype=np.uint8)[0:sizes[i]].copy(), timestamps[i]))
+        return frames
+
+    def get_stats(self):
+        stats = (c_longlong * 4)()
+        self.lib.get_sync_group_stats(self.group, stats)
+        return {"complete": stats[0], "partial": stats[1], "dropped_sets": stats[2], "dropped_frames": stats[3]}
+
+    def destroy(self):
+        if self.group is None:
+            return
+        self.lib.destroy_sync_group(self.group)
+        self.group = None
+
 if __name__ == "__main__":
     cam = 0
     width = 1280
@@ -0,0 +1,156 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#include "audio-buffering.hpp"
+
+#include <math.h>
+#include <map>
+
+/* weight decay per buffer for the interval averages */
+#define MONITOR_DECAY (1.0 - 1.0 / 100.0)
+/* glitches within a window of buffers that trigger a back off */
+#define MONITOR_WINDOW 500
+#define MONITOR_MAX_GLITCHES 3
+/* buffers arriving later than this many buffer durations are late */
+#define MONITOR_LATE_BUFFERS 4
+/* ...as long as it's also longer than this (100ns units) */
+#define MONITOR_LATE_MIN 200000
+/* timestamp gaps smaller than this are rounding, not lost audio */
+#define MONITOR_GAP_MIN 10000
+
+namespace DShow {
+
+struct AdaptiveBuffering {
+	int bufferingMs = AUDIO_BUFFERING_MIN_MS;
+	long long backoffs = 0;
+};
+
+static std::mutex adaptiveMutex;
+static std::map<std::wstring, AdaptiveBuffering> adaptiveBuffering;
+
+void AudioBufferMonitor::Reset()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	lastReceive = 0;
+	lastStop = 0;
+	buffers = 0;
+	windowBuffers = 0;
+	windowGlitches = 0;
+	meanInterval = 0.0;
+	jitter = 0.0;
+	maxInterval = 0;
+	glitches = 0;
+}
+
+bool AudioBufferMonitor::Update(long long receiveTime, long long startTime,
+				long long stopTime, bool discontinuity)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	bool glitch = false;
+
+	if (buffers) {
+		long long interval = receiveTime - lastReceive;
+		long long duration = stopTime - startTime;
+
+		if (buffers == 1) {
+			meanInterval = (double)interval;
+		} else {
+			jitter = jitter * MONITOR_DECAY +
+				 fabs(interval - meanInterval) *
+					 (1.0 - MONITOR_DECAY);
+			meanInterval = meanInterval * MONITOR_DECAY +
+				       interval * (1.0 - MONITOR_DECAY);
+		}
+
+		if (interval > maxInterval)
+			maxInterval = interval;
+
+		if (duration > 0 && interval > duration * MONITOR_LATE_BUFFERS &&
+		    interval > MONITOR_LATE_MIN)
+			glitch = true;
+		if (discontinuity || startTime - lastStop > MONITOR_GAP_MIN)
+			glitch = true;
+	}
+
+	lastReceive = receiveTime;
+	lastStop = stopTime;
+	buffers++;
+
+	if (glitch) {
+		glitches++;
+		windowGlitches++;
+	}
+
+	if (++windowBuffers >= MONITOR_WINDOW) {
+		windowBuffers = 0;
+		windowGlitches = 0;
+	}
+
+	if (windowGlitches >= MONITOR_MAX_GLITCHES) {
+		windowBuffers = 0;
+		windowGlitches = 0;
+		return true;
+	}
+
+	return false;
+}
+
+void AudioBufferMonitor::GetStats(AudioBufferingStats &stats) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	stats.buffers = buffers;
+	stats.meanInterval = (long long)llround(meanInterval);
+	stats.maxInterval = maxInterval;
+	stats.jitter = (long long)llround(jitter);
+	stats.glitches = glitches;
+}
+
+int GetAdaptiveAudioBuffering(const std::wstring &path, long long *backoffs)
+{
+	std::lock_guard<std::mutex> lock(adaptiveMutex);
+
+	AdaptiveBuffering &entry = adaptiveBuffering[path];
+	if (backoffs)
+		*backoffs = entry.backoffs;
+	return entry.bufferingMs;
+}
+
+int RaiseAdaptiveAudioBuffering(const std::wstring &path, int current)
+{
+	std::lock_guard<std::mutex> lock(adaptiveMutex);
+
+	AdaptiveBuffering &entry = adaptiveBuffering[path];
+
+	/* another connection may already have raised it */
+	if (entry.bufferingMs > current)
+		return entry.bufferingMs;
+	if (current >= AUDIO_BUFFERING_MAX_MS)
+		return current;
+
+	entry.bufferingMs = current * 2;
+	if (entry.bufferingMs > AUDIO_BUFFERING_MAX_MS)
+		entry.bufferingMs = AUDIO_BUFFERING_MAX_MS;
+	entry.backoffs++;
+	return entry.bufferingMs;
+}
+
+}; /* namespace DShow */
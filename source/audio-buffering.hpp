@@ -0,0 +1,65 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+
+#include <mutex>
+#include <string>
+
+#define AUDIO_BUFFERING_MIN_MS 2
+#define AUDIO_BUFFERING_MAX_MS 100
+
+namespace DShow {
+
+/*
+ * Watches audio buffer delivery for late buffers and gaps in the audio,
+ * which is how too little buffering shows up.  Update returns true once
+ * enough glitches have been seen that the buffering should be raised.
+ */
+class AudioBufferMonitor {
+	mutable std::mutex mutex;
+
+	long long lastReceive = 0;
+	long long lastStop = 0;
+	long long buffers = 0;
+	long long windowBuffers = 0;
+	long long windowGlitches = 0;
+
+	double meanInterval = 0.0;
+	double jitter = 0.0;
+	long long maxInterval = 0;
+	long long glitches = 0;
+
+public:
+	void Reset();
+	bool Update(long long receiveTime, long long startTime,
+		    long long stopTime, bool discontinuity);
+	void GetStats(AudioBufferingStats &stats) const;
+};
+
+/* buffering that adaptive mode settled on for a device, kept for the
+ * lifetime of the process so reconnecting doesn't start over */
+int GetAdaptiveAudioBuffering(const std::wstring &path,
+			      long long *backoffs = nullptr);
+int RaiseAdaptiveAudioBuffering(const std::wstring &path, int current);
+
+}; /* namespace DShow */
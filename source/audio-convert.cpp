@@ -0,0 +1,314 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#include "audio-convert.hpp"
+
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define AUDIO_SSE2 1
+#endif
+
+#define CENTER_MIX 0.70710678f
+#define SURROUND_MIX 0.70710678f
+
+namespace DShow {
+
+size_t AFormatSampleBytes(AudioFormat format)
+{
+	switch (format) {
+	case AudioFormat::Wave16bit:
+		return 2;
+	case AudioFormat::Wave24bit:
+		return 3;
+	case AudioFormat::Wave32bit:
+	case AudioFormat::WaveFloat:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+static void S16ToFloat(const int16_t *in, size_t samples, float *out)
+{
+	const float scale = 1.0f / 32768.0f;
+	size_t i = 0;
+
+#ifdef AUDIO_SSE2
+	const __m128 scaleVec = _mm_set1_ps(scale);
+	for (; i + 8 <= samples; i += 8) {
+		__m128i s16 = _mm_loadu_si128((const __m128i *)(in + i));
+
+		/* sign extend by unpacking into the high half and shifting */
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s16, s16), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s16, s16), 16);
+
+		_mm_storeu_ps(out + i,
+			      _mm_mul_ps(_mm_cvtepi32_ps(lo), scaleVec));
+		_mm_storeu_ps(out + i + 4,
+			      _mm_mul_ps(_mm_cvtepi32_ps(hi), scaleVec));
+	}
+#endif
+
+	for (; i < samples; i++)
+		out[i] = (float)in[i] * scale;
+}
+
+static inline int32_t LoadS24(const uint8_t *p)
+{
+	/* shift into the top of the int32 so the sign comes along */
+	return (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) |
+			 ((uint32_t)p[2] << 24));
+}
+
+static void S24ToFloat(const uint8_t *in, size_t samples, float *out)
+{
+	const float scale = 1.0f / 2147483648.0f;
+	size_t i = 0;
+
+#ifdef AUDIO_SSE2
+	/* packed 24-bit has no SSE2 friendly layout, so gather the samples
+	 * with scalar loads and do the conversion four at a time */
+	const __m128 scaleVec = _mm_set1_ps(scale);
+	for (; i + 4 <= samples; i += 4) {
+		const uint8_t *p = in + i * 3;
+		__m128i s32 = _mm_setr_epi32(LoadS24(p), LoadS24(p + 3),
+					     LoadS24(p + 6), LoadS24(p + 9));
+		_mm_storeu_ps(out + i,
+			      _mm_mul_ps(_mm_cvtepi32_ps(s32), scaleVec));
+	}
+#endif
+
+	for (; i < samples; i++)
+		out[i] = (float)LoadS24(in + i * 3) * scale;
+}
+
+static void S32ToFloat(const int32_t *in, size_t samples, float *out)
+{
+	const float scale = 1.0f / 2147483648.0f;
+	size_t i = 0;
+
+#ifdef AUDIO_SSE2
+	const __m128 scaleVec = _mm_set1_ps(scale);
+	for (; i + 4 <= samples; i += 4) {
+		__m128i s32 = _mm_loadu_si128((const __m128i *)(in + i));
+		_mm_storeu_ps(out + i,
+			      _mm_mul_ps(_mm_cvtepi32_ps(s32), scaleVec));
+	}
+#endif
+
+	for (; i < samples; i++)
+		out[i] = (float)in[i] * scale;
+}
+
+void AudioToFloat(AudioFormat format, const uint8_t *in, size_t samples,
+		  float *out)
+{
+	switch (format) {
+	case AudioFormat::Wave16bit:
+		S16ToFloat((const int16_t *)in, samples, out);
+		break;
+	case AudioFormat::Wave24bit:
+		S24ToFloat(in, samples, out);
+		break;
+	case AudioFormat::Wave32bit:
+		S32ToFloat((const int32_t *)in, samples, out);
+		break;
+	case AudioFormat::WaveFloat:
+		memcpy(out, in, samples * sizeof(float));
+		break;
+	default:
+		memset(out, 0, samples * sizeof(float));
+	}
+}
+
+void AudioDeinterleave(const float *in, size_t frames, int channels,
+		       float *const *out)
+{
+	size_t i = 0;
+
+	if (channels == 1) {
+		memcpy(out[0], in, frames * sizeof(float));
+		return;
+	}
+
+#ifdef AUDIO_SSE2
+	if (channels == 2) {
+		for (; i + 4 <= frames; i += 4) {
+			__m128 a = _mm_loadu_ps(in + i * 2);
+			__m128 b = _mm_loadu_ps(in + i * 2 + 4);
+			_mm_storeu_ps(out[0] + i,
+				      _mm_shuffle_ps(a, b,
+						     _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(out[1] + i,
+				      _mm_shuffle_ps(a, b,
+						     _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+	}
+#endif
+
+	for (; i < frames; i++) {
+		const float *frame = in + i * channels;
+		for (int c = 0; c < channels; c++)
+			out[c][i] = frame[c];
+	}
+}
+
+/* WAVEFORMATEXTENSIBLE default channel orders */
+enum Speaker {
+	FL,
+	FR,
+	FC,
+	LFE,
+	BL,
+	BR,
+	SL,
+	SR,
+};
+
+static void StereoDownmix(int inChannels, float *left, float *right)
+{
+	switch (inChannels) {
+	case 1:
+		left[0] = right[0] = 1.0f;
+		break;
+	case 3: /* 2.1 */
+		left[FL] = right[FR] = 1.0f;
+		break;
+	case 4: /* quad */
+		left[0] = right[1] = 1.0f;
+		left[2] = right[3] = SURROUND_MIX;
+		break;
+	case 6: /* 5.1 */
+		left[FL] = right[FR] = 1.0f;
+		left[FC] = right[FC] = CENTER_MIX;
+		left[BL] = right[BR] = SURROUND_MIX;
+		break;
+	case 8: /* 7.1 */
+		left[FL] = right[FR] = 1.0f;
+		left[FC] = right[FC] = CENTER_MIX;
+		left[BL] = right[BR] = SURROUND_MIX;
+		left[SL] = right[SR] = SURROUND_MIX;
+		break;
+	default:
+		left[0] = 1.0f;
+		if (inChannels > 1)
+			right[1] = 1.0f;
+	}
+}
+
+void AudioMixMatrix(int inChannels, int outChannels,
+		    const std::vector<int> &channelMap,
+		    std::vector<float> &matrix)
+{
+	matrix.assign((size_t)inChannels * outChannels, 0.0f);
+
+	if (!channelMap.empty()) {
+		for (int out = 0; out < outChannels; out++) {
+			int in = out < (int)channelMap.size() ? channelMap[out]
+							      : -1;
+			if (in >= 0 && in < inChannels)
+				matrix[out * inChannels + in] = 1.0f;
+		}
+		return;
+	}
+
+	if (inChannels == outChannels || outChannels > 2 ||
+	    (inChannels < outChannels && inChannels != 1)) {
+		for (int c = 0; c < inChannels && c < outChannels; c++)
+			matrix[c * inChannels + c] = 1.0f;
+		return;
+	}
+
+	std::vector<float> left(inChannels, 0.0f);
+	std::vector<float> right(inChannels, 0.0f);
+	StereoDownmix(inChannels, left.data(), right.data());
+
+	/* keep the mix from clipping once converted back to integer */
+	float sum = 0.0f;
+	for (int c = 0; c < inChannels; c++)
+		sum += left[c];
+
+	float scale = sum > 1.0f ? 1.0f / sum : 1.0f;
+	if (outChannels == 1)
+		scale *= 0.5f;
+
+	for (int c = 0; c < inChannels; c++) {
+		if (outChannels == 1) {
+			matrix[c] = (left[c] + right[c]) * scale;
+		} else {
+			matrix[c] = left[c] * scale;
+			matrix[inChannels + c] = right[c] * scale;
+		}
+	}
+}
+
+bool AudioMixIsIdentity(int inChannels, int outChannels,
+			const std::vector<float> &matrix)
+{
+	if (inChannels != outChannels)
+		return false;
+
+	for (int out = 0; out < outChannels; out++) {
+		for (int in = 0; in < inChannels; in++) {
+			float expected = in == out ? 1.0f : 0.0f;
+			if (matrix[out * inChannels + in] != expected)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+void AudioMixPlanar(const float *const *in, int inChannels, float *const *out,
+		    int outChannels, size_t frames, const float *matrix)
+{
+	for (int o = 0; o < outChannels; o++) {
+		const float *row = matrix + o * inChannels;
+		float *dst = out[o];
+
+		memset(dst, 0, frames * sizeof(float));
+
+		for (int c = 0; c < inChannels; c++) {
+			const float gain = row[c];
+			const float *src = in[c];
+			size_t i = 0;
+
+			if (gain == 0.0f)
+				continue;
+
+#ifdef AUDIO_SSE2
+			const __m128 gainVec = _mm_set1_ps(gain);
+			for (; i + 4 <= frames; i += 4) {
+				__m128 acc = _mm_loadu_ps(dst + i);
+				__m128 val = _mm_loadu_ps(src + i);
+				acc = _mm_add_ps(acc, _mm_mul_ps(val, gainVec));
+				_mm_storeu_ps(dst + i, acc);
+			}
+#endif
+
+			for (; i < frames; i++)
+				dst[i] += src[i] * gain;
+		}
+	}
+}
+
+}; /* namespace DShow */
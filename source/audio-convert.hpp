@@ -0,0 +1,56 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+
+#include <stdint.h>
+
+namespace DShow {
+
+/* bytes per sample of a raw audio format, or 0 for encoded/unknown */
+size_t AFormatSampleBytes(AudioFormat format);
+
+/* converts interleaved samples of any raw format to float in [-1, 1] */
+void AudioToFloat(AudioFormat format, const uint8_t *in, size_t samples,
+		  float *out);
+
+void AudioDeinterleave(const float *in, size_t frames, int channels,
+		       float *const *out);
+
+/*
+ * Builds an outChannels x inChannels mix matrix.  channelMap, if not empty,
+ * gives the source channel for each output channel (-1 for silence);
+ * otherwise standard layouts (mono, stereo, 2.1, quad, 5.1, 7.1) are
+ * downmixed and missing channels are left silent.
+ */
+void AudioMixMatrix(int inChannels, int outChannels,
+		    const std::vector<int> &channelMap,
+		    std::vector<float> &matrix);
+
+/* returns true if the matrix just passes the channels through */
+bool AudioMixIsIdentity(int inChannels, int outChannels,
+			const std::vector<float> &matrix);
+
+void AudioMixPlanar(const float *const *in, int inChannels, float *const *out,
+		    int outChannels, size_t frames, const float *matrix);
+
+}; /* namespace DShow */
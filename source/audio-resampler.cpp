@@ -0,0 +1,207 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#include "audio-resampler.hpp"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RESAMPLER_SSE2 1
+#endif
+
+/* taps must be a multiple of 4 for the SIMD path */
+#define RESAMPLER_TAPS 32
+#define RESAMPLER_PHASES 128
+#define RESAMPLER_HALF (RESAMPLER_TAPS / 2 - 1)
+#define RESAMPLER_CUTOFF 0.92
+#define RESAMPLER_MAX_ADJUST 0.05
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace DShow {
+
+static inline double Sinc(double x)
+{
+	return fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+}
+
+static inline double Blackman(double x, double width)
+{
+	/* x in [-width, width] */
+	double n = (x + width) / (2.0 * width);
+	if (n < 0.0 || n > 1.0)
+		return 0.0;
+	return 0.42 - 0.5 * cos(2.0 * M_PI * n) + 0.08 * cos(4.0 * M_PI * n);
+}
+
+void AudioResampler::Reset(int inRate_, int outRate_, int channels_)
+{
+	inRate = inRate_;
+	outRate = outRate_;
+	channels = channels_;
+
+	/* lower the cutoff when downsampling to avoid aliasing */
+	double cutoff = RESAMPLER_CUTOFF;
+	if (outRate < inRate)
+		cutoff *= (double)outRate / (double)inRate;
+
+	/* one extra row so phase interpolation never runs off the end */
+	filter.resize((RESAMPLER_PHASES + 1) * RESAMPLER_TAPS);
+
+	for (int phase = 0; phase <= RESAMPLER_PHASES; phase++) {
+		float *row = filter.data() + phase * RESAMPLER_TAPS;
+		double frac = (double)phase / RESAMPLER_PHASES;
+		double sum = 0.0;
+
+		for (int tap = 0; tap < RESAMPLER_TAPS; tap++) {
+			double t = (double)(tap - RESAMPLER_HALF) - frac;
+			double val = cutoff * Sinc(cutoff * t) *
+				     Blackman(t, RESAMPLER_TAPS / 2.0);
+			row[tap] = (float)val;
+			sum += val;
+		}
+
+		/* unity gain at DC for every phase */
+		for (int tap = 0; tap < RESAMPLER_TAPS; tap++)
+			row[tap] = (float)(row[tap] / sum);
+	}
+
+	/* start with silence in front of the first sample, so it lines up
+	 * with the center of the filter */
+	history.assign(channels, std::vector<float>(RESAMPLER_HALF, 0.0f));
+	position = RESAMPLER_HALF;
+}
+
+void AudioResampler::SetRatioAdjust(double ratio)
+{
+	if (ratio < 1.0 - RESAMPLER_MAX_ADJUST)
+		ratio = 1.0 - RESAMPLER_MAX_ADJUST;
+	else if (ratio > 1.0 + RESAMPLER_MAX_ADJUST)
+		ratio = 1.0 + RESAMPLER_MAX_ADJUST;
+
+	adjust = ratio;
+}
+
+double AudioResampler::GetRatioAdjust() const
+{
+	return adjust;
+}
+
+size_t AudioResampler::MaxOutputFrames(size_t frames) const
+{
+	double ratio = (double)outRate / (double)inRate *
+		       (1.0 + RESAMPLER_MAX_ADJUST);
+	return (size_t)ceil((double)(frames + RESAMPLER_TAPS) * ratio) + 1;
+}
+
+double AudioResampler::NextOutputOffset() const
+{
+	if (history.empty())
+		return 0.0;
+	return position - (double)history[0].size();
+}
+
+static inline float FilterSample(const float *x, const float *row0,
+				 const float *row1, float frac)
+{
+	int tap = 0;
+	float result = 0.0f;
+
+#ifdef RESAMPLER_SSE2
+	__m128 acc = _mm_setzero_ps();
+	__m128 fracVec = _mm_set1_ps(frac);
+
+	for (; tap + 4 <= RESAMPLER_TAPS; tap += 4) {
+		__m128 c0 = _mm_loadu_ps(row0 + tap);
+		__m128 c1 = _mm_loadu_ps(row1 + tap);
+		__m128 c = _mm_add_ps(
+			c0, _mm_mul_ps(_mm_sub_ps(c1, c0), fracVec));
+		acc = _mm_add_ps(acc,
+				 _mm_mul_ps(c, _mm_loadu_ps(x + tap)));
+	}
+
+	float sums[4];
+	_mm_storeu_ps(sums, acc);
+	result = sums[0] + sums[1] + sums[2] + sums[3];
+#endif
+
+	for (; tap < RESAMPLER_TAPS; tap++) {
+		float c = row0[tap] + (row1[tap] - row0[tap]) * frac;
+		result += c * x[tap];
+	}
+
+	return result;
+}
+
+size_t AudioResampler::Process(const float *const *in, size_t frames,
+			       float *const *out, size_t maxOut)
+{
+	if (!channels || !inRate || !outRate)
+		return 0;
+
+	double step = (double)inRate / ((double)outRate * adjust);
+
+	for (int c = 0; c < channels; c++)
+		history[c].insert(history[c].end(), in[c], in[c] + frames);
+
+	size_t available = history[0].size();
+	size_t produced = 0;
+	double pos = position;
+
+	while (produced < maxOut) {
+		size_t index = (size_t)pos;
+		if (index + RESAMPLER_TAPS / 2 + 1 > available)
+			break;
+
+		double phasePos = (pos - (double)index) * RESAMPLER_PHASES;
+		int phase = (int)phasePos;
+		float frac = (float)(phasePos - phase);
+
+		const float *row0 = filter.data() + phase * RESAMPLER_TAPS;
+		const float *row1 = row0 + RESAMPLER_TAPS;
+		size_t base = index - RESAMPLER_HALF;
+
+		for (int c = 0; c < channels; c++)
+			out[c][produced] = FilterSample(
+				history[c].data() + base, row0, row1, frac);
+
+		produced++;
+		pos += step;
+	}
+
+	/* drop everything the next output frame no longer needs */
+	size_t keepFrom = (size_t)pos;
+	keepFrom = keepFrom > RESAMPLER_HALF ? keepFrom - RESAMPLER_HALF : 0;
+	if (keepFrom > available)
+		keepFrom = available;
+
+	for (int c = 0; c < channels; c++)
+		history[c].erase(history[c].begin(),
+				 history[c].begin() + keepFrom);
+
+	position = pos - (double)keepFrom;
+	return produced;
+}
+
+}; /* namespace DShow */
@@ -0,0 +1,74 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#pragma once
+
+#include <stddef.h>
+
+#include <atomic>
+#include <vector>
+
+namespace DShow {
+
+/*
+ * Streaming polyphase windowed-sinc resampler for planar float audio.
+ * Keeps filter history across calls, so buffers of any size can be fed
+ * in as they arrive.  The conversion ratio can be nudged by a small
+ * factor at any time to compensate for clock drift.
+ */
+class AudioResampler {
+	int inRate = 0;
+	int outRate = 0;
+	int channels = 0;
+
+	std::vector<float> filter;
+	std::vector<std::vector<float>> history;
+	double position = 0.0;
+
+	std::atomic<double> adjust{1.0};
+
+public:
+	inline int InputRate() const { return inRate; }
+	inline int OutputRate() const { return outRate; }
+	inline int Channels() const { return channels; }
+
+	void Reset(int inRate, int outRate, int channels);
+
+	/*
+	 * Scales the output rate, e.g. 1.0001 produces 100ppm more samples.
+	 * Clamped to +/-5%.  Safe to call from any thread.
+	 */
+	void SetRatioAdjust(double ratio);
+	double GetRatioAdjust() const;
+
+	/* upper bound of the output frames produced for a given input */
+	size_t MaxOutputFrames(size_t frames) const;
+
+	/*
+	 * Offset (in input frames, relative to the next input buffer) of the
+	 * next output frame, for deriving output timestamps
+	 */
+	double NextOutputOffset() const;
+
+	size_t Process(const float *const *in, size_t frames, float *const *out,
+		       size_t maxOut);
+};
+
+}; /* namespace DShow */
@@ -0,0 +1,113 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#include "av-sync.hpp"
+
+/* never correct more than this, anything beyond is a measurement error */
+#define AV_SYNC_MAX_CORRECTION 0.001
+
+namespace DShow {
+
+void AVSync::Reset()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	sampleClock.Reset();
+	frames = 0;
+	sampleRate = 0;
+	buffers = 0;
+	offset = minOffset = maxOffset = 0;
+	ratioAdjust = 1.0;
+}
+
+long long AVSync::AddAudio(long long startTime, size_t frameCount, int rate,
+			   long long hostTime, const ClockMapper &videoClock)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (rate <= 0)
+		return startTime;
+
+	if (rate != sampleRate) {
+		sampleClock.Reset();
+		frames = 0;
+		sampleRate = rate;
+	}
+
+	/* the buffer arrives once its last sample has been captured, so the
+	 * host time measures the end of the buffer, not its start */
+	long long bufferStart = frames * 10000000LL / rate;
+	frames += (long long)frameCount;
+	long long bufferEnd = frames * 10000000LL / rate;
+
+	if (hostTime)
+		sampleClock.Update(bufferEnd, hostTime);
+
+	long long corrected = videoClock.Unmap(sampleClock.Map(bufferStart));
+	if (!corrected)
+		return startTime;
+
+	offset = startTime - corrected;
+	if (!buffers++) {
+		minOffset = maxOffset = offset;
+	} else {
+		if (offset < minOffset)
+			minOffset = offset;
+		if (offset > maxOffset)
+			maxOffset = offset;
+	}
+
+	return corrected;
+}
+
+double AVSync::CorrectionRatio(const ClockMapper &videoClock)
+{
+	/* a fast audio clock (slope below 1: less host time per sample)
+	 * needs fewer output samples to stay with the video */
+	double ratio = sampleClock.Slope() / videoClock.Slope();
+
+	if (ratio < 1.0 - AV_SYNC_MAX_CORRECTION)
+		ratio = 1.0 - AV_SYNC_MAX_CORRECTION;
+	else if (ratio > 1.0 + AV_SYNC_MAX_CORRECTION)
+		ratio = 1.0 + AV_SYNC_MAX_CORRECTION;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	ratioAdjust = ratio;
+	return ratio;
+}
+
+void AVSync::GetStats(AVSyncStats &stats, const ClockMapper &videoClock) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	double audioSlope = sampleClock.Slope();
+	double videoSlope = videoClock.Slope();
+
+	stats.buffers = buffers;
+	stats.audioDriftPPM = (audioSlope - 1.0) * 1000000.0;
+	stats.videoDriftPPM = (videoSlope - 1.0) * 1000000.0;
+	stats.driftPPM = (audioSlope / videoSlope - 1.0) * 1000000.0;
+	stats.offset = offset;
+	stats.minOffset = minOffset;
+	stats.maxOffset = maxOffset;
+	stats.ratioAdjust = ratioAdjust;
+}
+
+}; /* namespace DShow */
@@ -0,0 +1,62 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#pragma once
+
+#include "dshow-clock.hpp"
+
+#include <mutex>
+
+namespace DShow {
+
+/*
+ * Measures audio against video.  Audio time is derived from the number of
+ * samples actually delivered (mapped to the host clock), which exposes the
+ * audio device's real sample rate, and is then mapped onto the video
+ * stream's timeline to give a corrected timestamp for every buffer.
+ */
+class AVSync {
+	mutable std::mutex mutex;
+
+	ClockMapper sampleClock;
+	long long frames = 0;
+	int sampleRate = 0;
+
+	long long buffers = 0;
+	long long offset = 0;
+	long long minOffset = 0;
+	long long maxOffset = 0;
+	double ratioAdjust = 1.0;
+
+public:
+	void Reset();
+
+	/* returns the corrected timestamp (startTime if none is known yet).
+	 * hostTime is when the buffer arrived, or 0 if it wasn't measured */
+	long long AddAudio(long long startTime, size_t frameCount, int rate,
+			   long long hostTime, const ClockMapper &videoClock);
+
+	/* resampler ratio that holds audio to the video clock */
+	double CorrectionRatio(const ClockMapper &videoClock);
+
+	void GetStats(AVSyncStats &stats, const ClockMapper &videoClock) const;
+};
+
+}; /* namespace DShow */
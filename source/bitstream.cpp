@@ -0,0 +1,556 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#include "bitstream.hpp"
+
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BITSTREAM_SSE2 1
+#endif
+
+#define H264_NAL_IDR 5
+#define H264_NAL_SPS 7
+#define HEVC_NAL_IRAP_FIRST 16
+#define HEVC_NAL_IRAP_LAST 23
+#define HEVC_NAL_SPS 33
+#define HEVC_MAX_REF_SETS 64
+#define HEVC_MAX_DELTA_POCS 16
+
+/* SPS fields past this are of no interest, don't copy more */
+#define SPS_MAX_SIZE 256
+
+namespace DShow {
+
+/* ------------------------------------------------------------------------- */
+
+const unsigned char *FindStartCode(const unsigned char *data,
+				   const unsigned char *end)
+{
+	const unsigned char *p = data;
+
+#ifdef BITSTREAM_SSE2
+	/* look for pairs of zero bytes 16 at a time, only checking for the
+	 * 01 that completes a start code where one is found */
+	const __m128i zero = _mm_setzero_si128();
+
+	while (end - p >= 18) {
+		__m128i v = _mm_loadu_si128((const __m128i *)p);
+		unsigned mask = (unsigned)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(v, zero));
+		unsigned pairs = mask & (mask >> 1);
+
+		/* a pair may also straddle into the next block */
+		if (mask & 0x8000 && !p[16])
+			pairs |= 0x8000;
+
+		while (pairs) {
+			unsigned long i;
+#ifdef _MSC_VER
+			_BitScanForward(&i, pairs);
+#else
+			i = (unsigned long)__builtin_ctz(pairs);
+#endif
+			if (p[i + 2] == 1)
+				return p + i;
+			pairs &= pairs - 1;
+		}
+
+		p += 16;
+	}
+#endif
+
+	for (; end - p >= 3; p++) {
+		if (!p[0] && !p[1] && p[2] == 1)
+			return p;
+	}
+
+	return end;
+}
+
+/* ------------------------------------------------------------------------- */
+
+class BitReader {
+	const unsigned char *data;
+	size_t size;
+	size_t bit = 0;
+
+public:
+	bool overrun = false;
+
+	inline BitReader(const unsigned char *data_, size_t size_)
+		: data(data_), size(size_)
+	{
+	}
+
+	inline unsigned Bit()
+	{
+		if (bit >= size * 8) {
+			overrun = true;
+			return 0;
+		}
+
+		unsigned val = (data[bit >> 3] >> (7 - (bit & 7))) & 1;
+		bit++;
+		return val;
+	}
+
+	inline unsigned Bits(int count)
+	{
+		unsigned val = 0;
+		while (count--)
+			val = (val << 1) | Bit();
+		return val;
+	}
+
+	inline void Skip(size_t count)
+	{
+		bit += count;
+		if (bit > size * 8)
+			overrun = true;
+	}
+
+	/* exp-golomb */
+	inline unsigned UE()
+	{
+		int zeros = 0;
+		while (!Bit()) {
+			if (overrun || ++zeros > 31) {
+				overrun = true;
+				return 0;
+			}
+		}
+
+		return ((1U << zeros) - 1) + Bits(zeros);
+	}
+
+	inline int SE()
+	{
+		unsigned val = UE();
+		return (val & 1) ? (int)((val + 1) / 2) : -(int)(val / 2);
+	}
+};
+
+/* strips emulation prevention bytes (00 00 03) from the payload */
+static size_t Unescape(const unsigned char *src, size_t size,
+		       unsigned char *dst, size_t maxSize)
+{
+	size_t out = 0;
+	int zeros = 0;
+
+	for (size_t i = 0; i < size && out < maxSize; i++) {
+		if (zeros >= 2 && src[i] == 3) {
+			zeros = 0;
+			continue;
+		}
+
+		zeros = src[i] ? 0 : zeros + 1;
+		dst[out++] = src[i];
+	}
+
+	return out;
+}
+
+static void SkipScalingList(BitReader &br, int count)
+{
+	int last = 8, next = 8;
+
+	for (int i = 0; i < count; i++) {
+		if (next)
+			next = (last + br.SE() + 256) % 256;
+		last = next ? next : last;
+	}
+}
+
+static inline bool H264HighProfile(int profile)
+{
+	return profile == 100 || profile == 110 || profile == 122 ||
+	       profile == 244 || profile == 44 || profile == 83 ||
+	       profile == 86 || profile == 118 || profile == 128 ||
+	       profile == 138 || profile == 139 || profile == 134 ||
+	       profile == 135;
+}
+
+bool ParseH264SPS(const unsigned char *nal, size_t size, BitstreamInfo &info)
+{
+	unsigned char rbsp[SPS_MAX_SIZE];
+
+	/* skip the NAL header */
+	if (size < 2)
+		return false;
+
+	size = Unescape(nal + 1, size - 1, rbsp, sizeof(rbsp));
+	BitReader br(rbsp, size);
+
+	int profile = (int)br.Bits(8);
+	br.Skip(8); /* constraint flags */
+	int level = (int)br.Bits(8);
+	br.UE(); /* seq_parameter_set_id */
+
+	unsigned chroma = 1;
+	bool separatePlanes = false;
+
+	if (H264HighProfile(profile)) {
+		chroma = br.UE();
+		if (chroma == 3)
+			separatePlanes = br.Bit() != 0;
+		br.UE(); /* bit_depth_luma_minus8 */
+		br.UE(); /* bit_depth_chroma_minus8 */
+		br.Bit(); /* qpprime_y_zero_transform_bypass_flag */
+
+		if (br.Bit()) {
+			int lists = chroma != 3 ? 8 : 12;
+			for (int i = 0; i < lists; i++) {
+				if (br.Bit())
+					SkipScalingList(br, i < 6 ? 16 : 64);
+			}
+		}
+	}
+
+	br.UE(); /* log2_max_frame_num_minus4 */
+
+	unsigned pocType = br.UE();
+	if (pocType == 0) {
+		br.UE(); /* log2_max_pic_order_cnt_lsb_minus4 */
+	} else if (pocType == 1) {
+		br.Bit();
+		br.SE();
+		br.SE();
+		unsigned cycle = br.UE();
+		for (unsigned i = 0; i < cycle && !br.overrun; i++)
+			br.SE();
+	}
+
+	br.UE(); /* max_num_ref_frames */
+	br.Bit(); /* gaps_in_frame_num_value_allowed_flag */
+
+	unsigned widthMbs = br.UE() + 1;
+	unsigned heightMapUnits = br.UE() + 1;
+	unsigned frameMbsOnly = br.Bit();
+	if (!frameMbsOnly)
+		br.Bit(); /* mb_adaptive_frame_field_flag */
+	br.Bit(); /* direct_8x8_inference_flag */
+
+	unsigned cropLeft = 0, cropRight = 0, cropTop = 0, cropBottom = 0;
+	if (br.Bit()) {
+		cropLeft = br.UE();
+		cropRight = br.UE();
+		cropTop = br.UE();
+		cropBottom = br.UE();
+	}
+
+	if (br.overrun)
+		return false;
+
+	unsigned cropUnitX = 1;
+	unsigned cropUnitY = 2 - frameMbsOnly;
+	if (chroma && !separatePlanes) {
+		cropUnitX = chroma == 3 ? 1 : 2;
+		cropUnitY *= chroma == 1 ? 2 : 1;
+	}
+
+	info.profile = profile;
+	info.level = level;
+	info.width = (int)(widthMbs * 16 - cropUnitX * (cropLeft + cropRight));
+	info.height = (int)((2 - frameMbsOnly) * heightMapUnits * 16 -
+			    cropUnitY * (cropTop + cropBottom));
+
+	/* VUI, only as far as the timing info */
+	if (!br.Bit())
+		return true;
+
+	if (br.Bit()) {
+		if (br.Bits(8) == 255) /* aspect_ratio_idc, Extended_SAR */
+			br.Skip(32);
+	}
+	if (br.Bit())
+		br.Bit(); /* overscan_appropriate_flag */
+	if (br.Bit()) {
+		br.Skip(4); /* video_format, video_full_range_flag */
+		if (br.Bit())
+			br.Skip(24); /* colour description */
+	}
+	if (br.Bit()) {
+		br.UE();
+		br.UE();
+	}
+	if (br.Bit()) {
+		unsigned numUnitsInTick = br.Bits(32);
+		unsigned timeScale = br.Bits(32);
+
+		/* two ticks per frame, one per field */
+		if (!br.overrun && numUnitsInTick && timeScale)
+			info.frameInterval = 2LL * numUnitsInTick *
+					     10000000LL / timeScale;
+	}
+
+	return true;
+}
+
+static void SkipHEVCScalingLists(BitReader &br)
+{
+	for (int sizeId = 0; sizeId < 4; sizeId++) {
+		int coefs = sizeId ? 64 : 16;
+
+		for (int matrix = 0; matrix < 6; matrix += sizeId == 3 ? 3 : 1) {
+			if (!br.Bit()) {
+				br.UE(); /* scaling_list_pred_matrix_id_delta */
+				continue;
+			}
+
+			if (sizeId > 1)
+				br.SE(); /* scaling_list_dc_coef_minus8 */
+			for (int i = 0; i < coefs; i++)
+				br.SE();
+		}
+	}
+}
+
+/* returns the number of delta POCs in the set, which later sets that
+ * predict from it need */
+static unsigned SkipHEVCRefSet(BitReader &br, unsigned index,
+			       const unsigned *deltaPocs)
+{
+	if (index && br.Bit()) {
+		/* inter_ref_pic_set_prediction_flag, predicted from the set
+		 * before it (delta_idx is only coded in slice headers) */
+		unsigned count = 0;
+
+		br.Bit(); /* delta_rps_sign */
+		br.UE(); /* abs_delta_rps_minus1 */
+
+		for (unsigned j = 0; j <= deltaPocs[index - 1]; j++) {
+			/* use_delta_flag is implied by used_by_curr_pic_flag */
+			if (br.Bit() || br.Bit())
+				count++;
+		}
+
+		return count;
+	}
+
+	unsigned negative = br.UE();
+	unsigned positive = br.UE();
+	if (negative > HEVC_MAX_DELTA_POCS || positive > HEVC_MAX_DELTA_POCS) {
+		br.overrun = true;
+		return 0;
+	}
+
+	for (unsigned i = 0; i < negative + positive; i++) {
+		br.UE(); /* delta_poc_minus1 */
+		br.Bit(); /* used_by_curr_pic_flag */
+	}
+
+	return negative + positive;
+}
+
+bool ParseHEVCSPS(const unsigned char *nal, size_t size, BitstreamInfo &info)
+{
+	unsigned char rbsp[SPS_MAX_SIZE];
+
+	/* skip the two byte NAL header */
+	if (size < 3)
+		return false;
+
+	size = Unescape(nal + 2, size - 2, rbsp, sizeof(rbsp));
+	BitReader br(rbsp, size);
+
+	br.Skip(4); /* sps_video_parameter_set_id */
+	unsigned subLayers = br.Bits(3);
+	br.Bit(); /* sps_temporal_id_nesting_flag */
+
+	/* profile_tier_level */
+	br.Skip(2); /* general_profile_space */
+	br.Bit(); /* general_tier_flag */
+	int profile = (int)br.Bits(5);
+	br.Skip(32 + 4 + 43 + 1);
+	int level = (int)br.Bits(8);
+
+	bool profilePresent[8] = {};
+	bool levelPresent[8] = {};
+	for (unsigned i = 0; i < subLayers; i++) {
+		profilePresent[i] = br.Bit() != 0;
+		levelPresent[i] = br.Bit() != 0;
+	}
+	if (subLayers)
+		br.Skip((8 - subLayers) * 2);
+	for (unsigned i = 0; i < subLayers; i++) {
+		if (profilePresent[i])
+			br.Skip(88);
+		if (levelPresent[i])
+			br.Skip(8);
+	}
+
+	br.UE(); /* sps_seq_parameter_set_id */
+	unsigned chroma = br.UE();
+	if (chroma == 3)
+		br.Bit(); /* separate_colour_plane_flag */
+
+	unsigned width = br.UE();
+	unsigned height = br.UE();
+
+	if (br.Bit()) {
+		unsigned subWidth = (chroma == 1 || chroma == 2) ? 2 : 1;
+		unsigned subHeight = chroma == 1 ? 2 : 1;
+
+		width -= subWidth * (br.UE() + br.UE());
+		height -= subHeight * (br.UE() + br.UE());
+	}
+
+	if (br.overrun)
+		return false;
+
+	info.profile = profile;
+	info.level = level;
+	info.width = (int)width;
+	info.height = (int)height;
+
+	/* everything up to the VUI has to be walked to get to its timing
+	 * info, bail out quietly if anything there looks wrong */
+	br.UE(); /* bit_depth_luma_minus8 */
+	br.UE(); /* bit_depth_chroma_minus8 */
+	unsigned pocBits = br.UE() + 4;
+
+	bool orderingInfo = br.Bit() != 0;
+	for (unsigned i = orderingInfo ? 0 : subLayers; i <= subLayers; i++) {
+		br.UE(); /* sps_max_dec_pic_buffering_minus1 */
+		br.UE(); /* sps_max_num_reorder_pics */
+		br.UE(); /* sps_max_latency_increase_plus1 */
+	}
+
+	for (int i = 0; i < 6; i++)
+		br.UE(); /* coding/transform block sizes and depths */
+
+	if (br.Bit() && br.Bit())
+		SkipHEVCScalingLists(br);
+
+	br.Skip(2); /* amp_enabled_flag, sample_adaptive_offset_enabled_flag */
+	if (br.Bit()) {
+		br.Skip(8); /* pcm sample bit depths */
+		br.UE();
+		br.UE();
+		br.Bit(); /* pcm_loop_filter_disabled_flag */
+	}
+
+	unsigned refSets = br.UE();
+	if (refSets > HEVC_MAX_REF_SETS)
+		return true;
+
+	unsigned deltaPocs[HEVC_MAX_REF_SETS];
+	for (unsigned i = 0; i < refSets && !br.overrun; i++)
+		deltaPocs[i] = SkipHEVCRefSet(br, i, deltaPocs);
+
+	if (br.Bit()) {
+		unsigned longTermRefs = br.UE();
+		for (unsigned i = 0; i < longTermRefs && !br.overrun; i++)
+			br.Skip(pocBits + 1);
+	}
+
+	br.Skip(2); /* temporal_mvp, strong_intra_smoothing */
+
+	if (br.overrun || !br.Bit())
+		return true;
+
+	/* VUI, only as far as the timing info */
+	if (br.Bit()) {
+		if (br.Bits(8) == 255) /* aspect_ratio_idc, Extended_SAR */
+			br.Skip(32);
+	}
+	if (br.Bit())
+		br.Bit(); /* overscan_appropriate_flag */
+	if (br.Bit()) {
+		br.Skip(4); /* video_format, video_full_range_flag */
+		if (br.Bit())
+			br.Skip(24); /* colour description */
+	}
+	if (br.Bit()) {
+		br.UE();
+		br.UE();
+	}
+	br.Skip(3); /* neutral_chroma, field_seq, frame_field_info */
+	if (br.Bit()) {
+		br.UE(); /* default display window */
+		br.UE();
+		br.UE();
+		br.UE();
+	}
+	if (br.Bit()) {
+		unsigned numUnitsInTick = br.Bits(32);
+		unsigned timeScale = br.Bits(32);
+
+		/* unlike H.264, one tick per picture */
+		if (!br.overrun && numUnitsInTick && timeScale)
+			info.frameInterval = (long long)numUnitsInTick *
+					     10000000LL / timeScale;
+	}
+
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+bool ParseBitstream(VideoFormat format, const unsigned char *data,
+		    size_t size, BitstreamInfo &info)
+{
+	const unsigned char *end = data + size;
+	const unsigned char *nal = FindStartCode(data, end);
+	bool hevc = format == VideoFormat::HEVC;
+
+	info = BitstreamInfo();
+
+	if (format != VideoFormat::H264 && !hevc)
+		return false;
+	if (nal == end)
+		return false;
+
+	while (nal != end) {
+		nal += 3;
+
+		const unsigned char *next = FindStartCode(nal, end);
+		size_t nalSize = next - nal;
+
+		/* the zero of a four byte start code belongs to the next */
+		if (next != end && nalSize && !nal[nalSize - 1])
+			nalSize--;
+
+		if (nalSize) {
+			int type = hevc ? (nal[0] >> 1) & 0x3F : nal[0] & 0x1F;
+			info.nalTypes |= 1ULL << type;
+
+			if (hevc) {
+				if (type >= HEVC_NAL_IRAP_FIRST &&
+				    type <= HEVC_NAL_IRAP_LAST)
+					info.keyframe = true;
+				else if (type == HEVC_NAL_SPS)
+					ParseHEVCSPS(nal, nalSize, info);
+			} else {
+				if (type == H264_NAL_IDR)
+					info.keyframe = true;
+				else if (type == H264_NAL_SPS)
+					ParseH264SPS(nal, nalSize, info);
+			}
+		}
+
+		nal = next;
+	}
+
+	return true;
+}
+
+}; /* namespace DShow */
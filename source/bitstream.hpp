@@ -0,0 +1,34 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+
+namespace DShow {
+
+/* returns the position of the next 00 00 01 start code, or end */
+const unsigned char *FindStartCode(const unsigned char *data,
+				   const unsigned char *end);
+
+bool ParseH264SPS(const unsigned char *nal, size_t size, BitstreamInfo &info);
+bool ParseHEVCSPS(const unsigned char *nal, size_t size, BitstreamInfo &info);
+
+}; /* namespace DShow */
@@ -0,0 +1,512 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#include "caps-cache.hpp"
+
+#include <string.h>
+
+#define CAPS_CACHE_MAGIC 0x43435344 /* "DSCC" */
+#define CAPS_CACHE_MAX_CAPS 4096
+#define CAPS_CACHE_MAX_PATH 4096
+
+#define ENTRY_VIDEO 0
+#define ENTRY_AUDIO 1
+#define ENTRY_CONFIG 2
+
+#define FLAG_AUDIO_ATTACHED 1
+#define FLAG_SEPARATE_AUDIO 2
+
+#define FLAG_CY_FLIP 1
+#define FLAG_DEFAULT_CONFIG 2
+
+namespace DShow {
+
+struct CacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count;
+	uint32_t reserved;
+};
+
+struct CacheEntryHeader {
+	uint32_t size;
+	uint32_t kind;
+	uint64_t fingerprint;
+	uint32_t flags;
+	uint32_t pathLength;
+	uint32_t recordCount;
+	uint32_t modeLength;
+};
+
+struct CachedVideoInfo {
+	int32_t minCX, minCY;
+	int32_t maxCX, maxCY;
+	int32_t granularityCX, granularityCY;
+	int64_t minInterval, maxInterval;
+	int32_t format;
+	int32_t reserved;
+};
+
+struct CachedAudioInfo {
+	int32_t minChannels, maxChannels;
+	int32_t channelsGranularity;
+	int32_t minSampleRate, maxSampleRate;
+	int32_t sampleRateGranularity;
+	int32_t format;
+};
+
+struct CachedConfig {
+	int32_t cx, cy_abs;
+	int64_t frameInterval;
+	int32_t internalFormat;
+	int32_t format;
+};
+
+static_assert(sizeof(CacheHeader) == 16, "cache layout");
+static_assert(sizeof(CacheEntryHeader) == 32, "cache layout");
+static_assert(sizeof(CachedVideoInfo) == 48, "cache layout");
+static_assert(sizeof(CachedAudioInfo) == 28, "cache layout");
+static_assert(sizeof(CachedConfig) == 24, "cache layout");
+
+static inline size_t Align4(size_t size)
+{
+	return (size + 3) & ~(size_t)3;
+}
+
+static inline bool operator==(const VideoInfo &a, const VideoInfo &b)
+{
+	return a.minCX == b.minCX && a.minCY == b.minCY &&
+	       a.maxCX == b.maxCX && a.maxCY == b.maxCY &&
+	       a.granularityCX == b.granularityCX &&
+	       a.granularityCY == b.granularityCY &&
+	       a.minInterval == b.minInterval &&
+	       a.maxInterval == b.maxInterval && a.format == b.format;
+}
+
+static inline bool operator==(const AudioInfo &a, const AudioInfo &b)
+{
+	return a.minChannels == b.minChannels &&
+	       a.maxChannels == b.maxChannels &&
+	       a.channelsGranularity == b.channelsGranularity &&
+	       a.minSampleRate == b.minSampleRate &&
+	       a.maxSampleRate == b.maxSampleRate &&
+	       a.sampleRateGranularity == b.sampleRateGranularity &&
+	       a.format == b.format;
+}
+
+static inline bool operator==(const CapsCacheEntry &a, const CapsCacheEntry &b)
+{
+	return a.fingerprint == b.fingerprint &&
+	       a.audioAttached == b.audioAttached &&
+	       a.separateAudioFilter == b.separateAudioFilter &&
+	       a.videoCaps == b.videoCaps && a.audioCaps == b.audioCaps;
+}
+
+static inline bool operator==(const KnownConfigEntry &a,
+			      const KnownConfigEntry &b)
+{
+	return a.fingerprint == b.fingerprint && a.cx == b.cx &&
+	       a.cy_abs == b.cy_abs && a.cy_flip == b.cy_flip &&
+	       a.frameInterval == b.frameInterval &&
+	       a.internalFormat == b.internalFormat && a.format == b.format &&
+	       a.useDefaultConfig == b.useDefaultConfig;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void ReadString(const uint8_t *data, size_t length, std::wstring &str)
+{
+	str.resize(length);
+	for (size_t c = 0; c < length; c++)
+		str[c] = (wchar_t)(data[c * 2] | (data[c * 2 + 1] << 8));
+}
+
+static void ReadVideoCaps(const uint8_t *data, size_t count,
+			  std::vector<VideoInfo> &caps)
+{
+	caps.resize(count);
+
+	for (size_t i = 0; i < count; i++) {
+		CachedVideoInfo in;
+		memcpy(&in, data + i * sizeof(in), sizeof(in));
+
+		VideoInfo &out = caps[i];
+		out.minCX = in.minCX;
+		out.minCY = in.minCY;
+		out.maxCX = in.maxCX;
+		out.maxCY = in.maxCY;
+		out.granularityCX = in.granularityCX;
+		out.granularityCY = in.granularityCY;
+		out.minInterval = in.minInterval;
+		out.maxInterval = in.maxInterval;
+		out.format = (VideoFormat)in.format;
+	}
+}
+
+static void ReadAudioCaps(const uint8_t *data, size_t count,
+			  std::vector<AudioInfo> &caps)
+{
+	caps.resize(count);
+
+	for (size_t i = 0; i < count; i++) {
+		CachedAudioInfo in;
+		memcpy(&in, data + i * sizeof(in), sizeof(in));
+
+		AudioInfo &out = caps[i];
+		out.minChannels = in.minChannels;
+		out.maxChannels = in.maxChannels;
+		out.channelsGranularity = in.channelsGranularity;
+		out.minSampleRate = in.minSampleRate;
+		out.maxSampleRate = in.maxSampleRate;
+		out.sampleRateGranularity = in.sampleRateGranularity;
+		out.format = (AudioFormat)in.format;
+	}
+}
+
+static void ReadConfig(const uint8_t *data, uint32_t flags,
+		       KnownConfigEntry &entry)
+{
+	CachedConfig in;
+	memcpy(&in, data, sizeof(in));
+
+	entry.cx = in.cx;
+	entry.cy_abs = in.cy_abs;
+	entry.cy_flip = !!(flags & FLAG_CY_FLIP);
+	entry.frameInterval = in.frameInterval;
+	entry.internalFormat = (VideoFormat)in.internalFormat;
+	entry.format = (VideoFormat)in.format;
+	entry.useDefaultConfig = !!(flags & FLAG_DEFAULT_CONFIG);
+}
+
+static inline size_t RecordSize(uint32_t kind)
+{
+	switch (kind) {
+	case ENTRY_VIDEO:
+		return sizeof(CachedVideoInfo);
+	case ENTRY_AUDIO:
+		return sizeof(CachedAudioInfo);
+	default:
+		return sizeof(CachedConfig);
+	}
+}
+
+bool CapsCache::Load(const uint8_t *data, size_t size)
+{
+	CacheHeader header;
+	size_t offset = sizeof(header);
+
+	Clear();
+
+	if (!data || size < sizeof(header))
+		return false;
+
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != CAPS_CACHE_MAGIC ||
+	    header.version != CAPS_CACHE_VERSION)
+		return false;
+
+	for (uint32_t i = 0; i < header.count; i++) {
+		CacheEntryHeader entryHeader;
+		CapsCacheEntry entry;
+
+		if (size - offset < sizeof(entryHeader))
+			goto fail;
+
+		memcpy(&entryHeader, data + offset, sizeof(entryHeader));
+
+		bool config = entryHeader.kind == ENTRY_CONFIG;
+
+		if (entryHeader.kind != ENTRY_VIDEO &&
+		    entryHeader.kind != ENTRY_AUDIO && !config)
+			goto fail;
+		if (entryHeader.pathLength > CAPS_CACHE_MAX_PATH ||
+		    entryHeader.recordCount > CAPS_CACHE_MAX_CAPS ||
+		    entryHeader.modeLength > CAPS_CACHE_MAX_PATH)
+			goto fail;
+		if (config ? entryHeader.recordCount != 1
+			   : entryHeader.modeLength != 0)
+			goto fail;
+
+		size_t pathSize = Align4(entryHeader.pathLength * 2);
+		size_t modeSize = Align4(entryHeader.modeLength * 2);
+		size_t entrySize = sizeof(entryHeader) + pathSize + modeSize +
+				   Align4(entryHeader.recordCount *
+					  RecordSize(entryHeader.kind));
+
+		/* the limits above keep this from overflowing */
+		if (entryHeader.size != entrySize || size - offset < entrySize)
+			goto fail;
+
+		const uint8_t *pathData = data + offset + sizeof(entryHeader);
+		std::wstring path;
+		ReadString(pathData, entryHeader.pathLength, path);
+
+		const uint8_t *capsData = pathData + pathSize + modeSize;
+
+		if (config) {
+			KnownConfigEntry configEntry;
+			std::wstring mode;
+
+			ReadString(pathData + pathSize, entryHeader.modeLength,
+				   mode);
+			configEntry.fingerprint = entryHeader.fingerprint;
+			ReadConfig(capsData, entryHeader.flags, configEntry);
+			configs[std::make_pair(path, mode)] = configEntry;
+
+			offset += entrySize;
+			continue;
+		}
+
+		entry.fingerprint = entryHeader.fingerprint;
+		entry.audioAttached = !!(entryHeader.flags &
+					 FLAG_AUDIO_ATTACHED);
+		entry.separateAudioFilter = !!(entryHeader.flags &
+					       FLAG_SEPARATE_AUDIO);
+
+		if (entryHeader.kind == ENTRY_VIDEO) {
+			ReadVideoCaps(capsData, entryHeader.recordCount,
+				      entry.videoCaps);
+			video[path] = std::move(entry);
+		} else {
+			ReadAudioCaps(capsData, entryHeader.recordCount,
+				      entry.audioCaps);
+			audio[path] = std::move(entry);
+		}
+
+		offset += entrySize;
+	}
+
+	return true;
+
+fail:
+	Clear();
+	return false;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void Append(std::vector<uint8_t> &data, const void *src, size_t size)
+{
+	const uint8_t *bytes = (const uint8_t *)src;
+	data.insert(data.end(), bytes, bytes + size);
+}
+
+static void Pad4(std::vector<uint8_t> &data)
+{
+	data.resize(Align4(data.size()), 0);
+}
+
+static void AppendString(std::vector<uint8_t> &data, const std::wstring &str)
+{
+	for (wchar_t c : str) {
+		uint8_t unit[2] = {(uint8_t)(c & 0xFF),
+				   (uint8_t)((c >> 8) & 0xFF)};
+		Append(data, unit, 2);
+	}
+	Pad4(data);
+}
+
+static void SaveEntry(std::vector<uint8_t> &data, uint32_t kind,
+		      const std::wstring &path, const CapsCacheEntry &entry)
+{
+	CacheEntryHeader header = {};
+	size_t count = kind == ENTRY_VIDEO ? entry.videoCaps.size()
+					   : entry.audioCaps.size();
+	size_t capSize = kind == ENTRY_VIDEO ? sizeof(CachedVideoInfo)
+					     : sizeof(CachedAudioInfo);
+
+	header.kind = kind;
+	header.fingerprint = entry.fingerprint;
+	header.flags = (entry.audioAttached ? FLAG_AUDIO_ATTACHED : 0) |
+		       (entry.separateAudioFilter ? FLAG_SEPARATE_AUDIO : 0);
+	header.pathLength = (uint32_t)path.size();
+	header.recordCount = (uint32_t)count;
+	header.size = (uint32_t)(sizeof(header) + Align4(path.size() * 2) +
+				 Align4(count * capSize));
+	Append(data, &header, sizeof(header));
+	AppendString(data, path);
+
+	for (size_t i = 0; kind == ENTRY_VIDEO && i < count; i++) {
+		const VideoInfo &in = entry.videoCaps[i];
+		CachedVideoInfo out = {};
+		out.minCX = in.minCX;
+		out.minCY = in.minCY;
+		out.maxCX = in.maxCX;
+		out.maxCY = in.maxCY;
+		out.granularityCX = in.granularityCX;
+		out.granularityCY = in.granularityCY;
+		out.minInterval = in.minInterval;
+		out.maxInterval = in.maxInterval;
+		out.format = (int32_t)in.format;
+		Append(data, &out, sizeof(out));
+	}
+
+	for (size_t i = 0; kind == ENTRY_AUDIO && i < count; i++) {
+		const AudioInfo &in = entry.audioCaps[i];
+		CachedAudioInfo out = {};
+		out.minChannels = in.minChannels;
+		out.maxChannels = in.maxChannels;
+		out.channelsGranularity = in.channelsGranularity;
+		out.minSampleRate = in.minSampleRate;
+		out.maxSampleRate = in.maxSampleRate;
+		out.sampleRateGranularity = in.sampleRateGranularity;
+		out.format = (int32_t)in.format;
+		Append(data, &out, sizeof(out));
+	}
+	Pad4(data);
+}
+
+static void SaveConfig(std::vector<uint8_t> &data, const std::wstring &path,
+		       const std::wstring &mode, const KnownConfigEntry &entry)
+{
+	CacheEntryHeader header = {};
+	CachedConfig out = {};
+
+	header.kind = ENTRY_CONFIG;
+	header.fingerprint = entry.fingerprint;
+	header.flags = (entry.cy_flip ? FLAG_CY_FLIP : 0) |
+		       (entry.useDefaultConfig ? FLAG_DEFAULT_CONFIG : 0);
+	header.pathLength = (uint32_t)path.size();
+	header.recordCount = 1;
+	header.modeLength = (uint32_t)mode.size();
+	header.size = (uint32_t)(sizeof(header) + Align4(path.size() * 2) +
+				 Align4(mode.size() * 2) + sizeof(out));
+	Append(data, &header, sizeof(header));
+	AppendString(data, path);
+	AppendString(data, mode);
+
+	out.cx = entry.cx;
+	out.cy_abs = entry.cy_abs;
+	out.frameInterval = entry.frameInterval;
+	out.internalFormat = (int32_t)entry.internalFormat;
+	out.format = (int32_t)entry.format;
+	Append(data, &out, sizeof(out));
+}
+
+void CapsCache::Save(std::vector<uint8_t> &data) const
+{
+	CacheHeader header = {};
+	size_t count = 0;
+
+	data.clear();
+	data.resize(sizeof(header));
+
+	/* entries that couldn't be loaded back aren't written */
+	for (auto &pair : video) {
+		if (pair.first.size() > CAPS_CACHE_MAX_PATH ||
+		    pair.second.videoCaps.size() > CAPS_CACHE_MAX_CAPS)
+			continue;
+		SaveEntry(data, ENTRY_VIDEO, pair.first, pair.second);
+		count++;
+	}
+	for (auto &pair : audio) {
+		if (pair.first.size() > CAPS_CACHE_MAX_PATH ||
+		    pair.second.audioCaps.size() > CAPS_CACHE_MAX_CAPS)
+			continue;
+		SaveEntry(data, ENTRY_AUDIO, pair.first, pair.second);
+		count++;
+	}
+	for (auto &pair : configs) {
+		const std::wstring &path = pair.first.first;
+		const std::wstring &mode = pair.first.second;
+		if (path.size() > CAPS_CACHE_MAX_PATH ||
+		    mode.size() > CAPS_CACHE_MAX_PATH)
+			continue;
+		SaveConfig(data, path, mode, pair.second);
+		count++;
+	}
+
+	header.magic = CAPS_CACHE_MAGIC;
+	header.version = CAPS_CACHE_VERSION;
+	header.count = (uint32_t)count;
+	memcpy(data.data(), &header, sizeof(header));
+}
+
+void CapsCache::Clear()
+{
+	video.clear();
+	audio.clear();
+	configs.clear();
+}
+
+/* ------------------------------------------------------------------------- */
+
+template<typename K, typename T>
+static const T *Find(const std::map<K, T> &entries, const K &key,
+		     uint64_t fingerprint)
+{
+	auto it = entries.find(key);
+	if (it == entries.end() || it->second.fingerprint != fingerprint)
+		return nullptr;
+	return &it->second;
+}
+
+template<typename K, typename T>
+static bool Set(std::map<K, T> &entries, const K &key, const T &entry)
+{
+	auto it = entries.find(key);
+	if (it != entries.end() && it->second == entry)
+		return false;
+
+	entries[key] = entry;
+	return true;
+}
+
+const CapsCacheEntry *CapsCache::FindVideo(const std::wstring &path,
+					   uint64_t fingerprint) const
+{
+	return Find(video, path, fingerprint);
+}
+
+const CapsCacheEntry *CapsCache::FindAudio(const std::wstring &path,
+					   uint64_t fingerprint) const
+{
+	return Find(audio, path, fingerprint);
+}
+
+bool CapsCache::SetVideo(const std::wstring &path, const CapsCacheEntry &entry)
+{
+	return Set(video, path, entry);
+}
+
+bool CapsCache::SetAudio(const std::wstring &path, const CapsCacheEntry &entry)
+{
+	return Set(audio, path, entry);
+}
+
+const KnownConfigEntry *CapsCache::FindConfig(const std::wstring &path,
+					      const std::wstring &mode,
+					      uint64_t fingerprint) const
+{
+	return Find(configs, std::make_pair(path, mode), fingerprint);
+}
+
+bool CapsCache::SetConfig(const std::wstring &path, const std::wstring &mode,
+			  const KnownConfigEntry &entry)
+{
+	return Set(configs, std::make_pair(path, mode), entry);
+}
+
+bool CapsCache::RemoveConfig(const std::wstring &path, const std::wstring &mode)
+{
+	return configs.erase(std::make_pair(path, mode)) != 0;
+}
+
+}; /* namespace DShow */
@@ -0,0 +1,102 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define CAPS_CACHE_VERSION 2
+
+namespace DShow {
+
+struct CapsCacheEntry {
+	/* hash of the driver's identity, entries for another driver
+	 * version don't match */
+	uint64_t fingerprint = 0;
+
+	bool audioAttached = false;
+	bool separateAudioFilter = false;
+	std::vector<VideoInfo> videoCaps;
+	std::vector<AudioInfo> audioCaps;
+};
+
+/* a configuration that opened the device, see Device::SetKnownConfig */
+struct KnownConfigEntry {
+	uint64_t fingerprint = 0;
+
+	int cx = 0, cy_abs = 0;
+	bool cy_flip = false;
+	long long frameInterval = 0;
+	VideoFormat internalFormat = VideoFormat::Any;
+	VideoFormat format = VideoFormat::Any;
+	bool useDefaultConfig = false;
+};
+
+/*
+ * Enumerated caps keyed by device path, and known-good configurations
+ * keyed by device path and mode, with a compact binary form:
+ *
+ *   header:  "DSCC", version, entry count, reserved     (4 x 32-bit)
+ *   entry:   size, kind, fingerprint (64-bit), flags,
+ *            path length, record count, mode length,
+ *            path (UTF-16, padded to 4 bytes),
+ *            mode (UTF-16, padded to 4 bytes, configs only),
+ *            caps records or a single config record
+ *
+ * Everything is little-endian, fixed width and 4-byte aligned, so the
+ * file can be read straight out of a mapped view.  Load checks every
+ * size against the buffer and rejects anything malformed as a whole.
+ */
+class CapsCache {
+	std::map<std::wstring, CapsCacheEntry> video;
+	std::map<std::wstring, CapsCacheEntry> audio;
+	std::map<std::pair<std::wstring, std::wstring>, KnownConfigEntry>
+		configs;
+
+public:
+	bool Load(const uint8_t *data, size_t size);
+	void Save(std::vector<uint8_t> &data) const;
+	void Clear();
+
+	const CapsCacheEntry *FindVideo(const std::wstring &path,
+					uint64_t fingerprint) const;
+	const CapsCacheEntry *FindAudio(const std::wstring &path,
+					uint64_t fingerprint) const;
+
+	/* returns false if the entry was already there unchanged */
+	bool SetVideo(const std::wstring &path, const CapsCacheEntry &entry);
+	bool SetAudio(const std::wstring &path, const CapsCacheEntry &entry);
+
+	const KnownConfigEntry *FindConfig(const std::wstring &path,
+					   const std::wstring &mode,
+					   uint64_t fingerprint) const;
+	bool SetConfig(const std::wstring &path, const std::wstring &mode,
+		       const KnownConfigEntry &entry);
+	bool RemoveConfig(const std::wstring &path, const std::wstring &mode);
+};
+
+}; /* namespace DShow */
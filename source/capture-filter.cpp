@@ -18,6 +18,7 @@
  */
 
 #include "capture-filter.hpp"
+#include "dshow-clock.hpp"
 #include "log.hpp"
 
 namespace DShow {
@@ -36,6 +37,10 @@ CapturePin::CapturePin(CaptureFilter *filter_, const PinCaptureInfo &info)
 	: refCount(0), captureInfo(info), filter(filter_)
 {
 	connectedMediaType->majortype = info.expectedMajorType;
+
+	long bufferCount = info.bufferCount > 0 ? info.bufferCount
+						: CAPTURE_DEFAULT_BUFFERS;
+	allocator = new CaptureAllocator(bufferCount);
 }
 
 CapturePin::~CapturePin() {}
@@ -129,6 +134,7 @@ STDMETHODIMP CapturePin::Disconnect()
 		return S_FALSE;
 
 	connectedPin = nullptr;
+	ownAllocator = false;
 	return S_OK;
 }
 
@@ -265,8 +271,18 @@ STDMETHODIMP CapturePin::GetAllocator(IMemAllocator **ppAllocator)
 {
 	PrintFunc(L"CapturePin::GetAllocator");
 
-	DSHOW_UNUSED(ppAllocator);
-	return VFW_E_NO_ALLOCATOR;
+	if (!ppAllocator)
+		return E_POINTER;
+
+	/* raw video is the only case where we know the exact frame size
+	 * upfront; for everything else let upstream pick the buffer size
+	 * (audio buffering is negotiated separately) */
+	if (captureInfo.expectedMajorType == MEDIATYPE_Video)
+		allocator->SetMinimumBufferSize(GetMediaTypeBufferSize());
+
+	*ppAllocator = allocator;
+	(*ppAllocator)->AddRef();
+	return S_OK;
 }
 
 STDMETHODIMP CapturePin::NotifyAllocator(IMemAllocator *pAllocator,
@@ -274,7 +290,15 @@ STDMETHODIMP CapturePin::NotifyAllocator(IMemAllocator *pAllocator,
 {
 	PrintFunc(L"CapturePin::NotifyAllocator");
 
-	DSHOW_UNUSED(pAllocator);
+	if (!pAllocator)
+		return E_POINTER;
+
+	ownAllocator = pAllocator == (IMemAllocator *)allocator.Get();
+
+	if (!ownAllocator)
+		Debug(L"CapturePin::NotifyAllocator: upstream filter is using "
+		      L"its own allocator");
+
 	DSHOW_UNUSED(bReadOnly);
 	return S_OK;
 }
@@ -283,8 +307,16 @@ STDMETHODIMP CapturePin::GetAllocatorRequirements(ALLOCATOR_PROPERTIES *pProps)
 {
 	PrintFunc(L"CapturePin::GetAllocatorRequirements");
 
-	DSHOW_UNUSED(pProps);
-	return E_NOTIMPL;
+	if (!pProps)
+		return E_POINTER;
+
+	pProps->cBuffers = captureInfo.bufferCount > 0
+				   ? captureInfo.bufferCount
+				   : CAPTURE_DEFAULT_BUFFERS;
+	pProps->cbBuffer = GetMediaTypeBufferSize();
+	pProps->cbAlign = CAPTURE_BUFFER_ALIGN;
+	pProps->cbPrefix = 0;
+	return S_OK;
 }
 
 STDMETHODIMP CapturePin::Receive(IMediaSample *pSample)
@@ -294,8 +326,10 @@ STDMETHODIMP CapturePin::Receive(IMediaSample *pSample)
 	if (flushing)
 		return S_FALSE;
 
-	if (pSample)
+	if (pSample) {
+		InterlockedIncrement64(&delivered);
 		captureInfo.callback(pSample);
+	}
 
 	return S_OK;
 }
@@ -308,9 +342,18 @@ STDMETHODIMP CapturePin::ReceiveMultiple(IMediaSample **pSamples, long nSamples,
 	if (flushing)
 		return S_FALSE;
 
-	for (long i = 0; i < nSamples; i++)
-		if (pSamples[i])
-			captureInfo.callback(pSamples[i]);
+	if (captureInfo.batchCallback) {
+		InterlockedAdd64(&delivered, nSamples);
+		captureInfo.batchCallback(pSamples, nSamples);
+
+	} else {
+		for (long i = 0; i < nSamples; i++) {
+			if (pSamples[i]) {
+				InterlockedIncrement64(&delivered);
+				captureInfo.callback(pSamples[i]);
+			}
+		}
+	}
 
 	*nSamplesProcessed = nSamples;
 
@@ -322,6 +365,47 @@ STDMETHODIMP CapturePin::ReceiveCanBlock()
 	return S_FALSE;
 }
 
+void CapturePin::GetAllocatorStats(AllocatorStats &stats)
+{
+	allocator->GetStats(stats);
+	stats.ownAllocator = ownAllocator;
+	stats.delivered = delivered;
+}
+
+long CapturePin::GetMediaTypeBufferSize() const
+{
+	const AM_MEDIA_TYPE &mt = connectedMediaType;
+
+	if (mt.bFixedSizeSamples && mt.lSampleSize)
+		return (long)mt.lSampleSize;
+	if (!mt.pbFormat)
+		return 0;
+
+	if (mt.majortype == MEDIATYPE_Video) {
+		const BITMAPINFOHEADER *bih = GetBitmapInfoHeader(mt);
+		if (!bih)
+			return 0;
+		if (bih->biSizeImage)
+			return (long)bih->biSizeImage;
+
+		long cx = bih->biWidth;
+		long cy = labs(bih->biHeight);
+		return (cx * cy * bih->biBitCount + 7) / 8;
+
+	} else if (mt.formattype == FORMAT_WaveFormatEx) {
+		const WAVEFORMATEX *wfex =
+			reinterpret_cast<const WAVEFORMATEX *>(mt.pbFormat);
+
+		/* 10 milliseconds worth of audio, rounded to whole frames */
+		long size = (long)wfex->nAvgBytesPerSec / 100;
+		if (wfex->nBlockAlign)
+			size -= size % wfex->nBlockAlign;
+		return size;
+	}
+
+	return 0;
+}
+
 bool CapturePin::IsValidMediaType(const AM_MEDIA_TYPE *pmt) const
 {
 	if (pmt->pbFormat) {
@@ -341,6 +425,458 @@ bool CapturePin::IsValidMediaType(const AM_MEDIA_TYPE *pmt) const
 
 // ============================================================================
 
+CaptureSample::CaptureSample(CaptureAllocator *allocator_)
+	: allocator(allocator_)
+{
+}
+
+CaptureSample::~CaptureSample()
+{
+	if (memory)
+		_aligned_free(memory);
+}
+
+void CaptureSample::Reset()
+{
+	actualSize = 0;
+	hasStartTime = false;
+	hasStopTime = false;
+	hasMediaTime = false;
+	syncPoint = false;
+	preroll = false;
+	discontinuity = false;
+
+	if (hasMediaType) {
+		mediaType = MediaType();
+		hasMediaType = false;
+	}
+}
+
+STDMETHODIMP CaptureSample::QueryInterface(REFIID riid, void **ppv)
+{
+	if (riid == IID_IUnknown || riid == IID_IMediaSample) {
+		AddRef();
+		*ppv = (IMediaSample *)this;
+		return NOERROR;
+	} else {
+		*ppv = nullptr;
+		return E_NOINTERFACE;
+	}
+}
+
+STDMETHODIMP_(ULONG) CaptureSample::AddRef()
+{
+	return (ULONG)InterlockedIncrement(&refCount);
+}
+
+STDMETHODIMP_(ULONG) CaptureSample::Release()
+{
+	long newRefs = InterlockedDecrement(&refCount);
+
+	/* samples are owned by the allocator; the last release just puts
+	 * the buffer back in the free list */
+	if (!newRefs) {
+		CaptureAllocator *owner = allocator;
+		owner->ReturnSample(this);
+		owner->Release();
+		return 0;
+	}
+
+	return (ULONG)newRefs;
+}
+
+STDMETHODIMP CaptureSample::GetPointer(BYTE **ppBuffer)
+{
+	if (!ppBuffer)
+		return E_POINTER;
+
+	*ppBuffer = buffer;
+	return S_OK;
+}
+
+STDMETHODIMP_(long) CaptureSample::GetSize()
+{
+	return size;
+}
+
+STDMETHODIMP CaptureSample::GetTime(REFERENCE_TIME *pTimeStart,
+				    REFERENCE_TIME *pTimeEnd)
+{
+	if (!hasStartTime)
+		return VFW_E_SAMPLE_TIME_NOT_SET;
+
+	if (pTimeStart)
+		*pTimeStart = startTime;
+
+	if (!hasStopTime) {
+		if (pTimeEnd)
+			*pTimeEnd = startTime + 1;
+		return VFW_S_NO_STOP_TIME;
+	}
+
+	if (pTimeEnd)
+		*pTimeEnd = stopTime;
+	return S_OK;
+}
+
+STDMETHODIMP CaptureSample::SetTime(REFERENCE_TIME *pTimeStart,
+				    REFERENCE_TIME *pTimeEnd)
+{
+	hasStartTime = pTimeStart != nullptr;
+	hasStopTime = hasStartTime && pTimeEnd != nullptr;
+
+	if (hasStartTime)
+		startTime = *pTimeStart;
+	if (hasStopTime)
+		stopTime = *pTimeEnd;
+	return S_OK;
+}
+
+STDMETHODIMP CaptureSample::IsSyncPoint()
+{
+	return syncPoint ? S_OK : S_FALSE;
+}
+
+STDMETHODIMP CaptureSample::SetSyncPoint(BOOL bIsSyncPoint)
+{
+	syncPoint = !!bIsSyncPoint;
+	return S_OK;
+}
+
+STDMETHODIMP CaptureSample::IsPreroll()
+{
+	return preroll ? S_OK : S_FALSE;
+}
+
+STDMETHODIMP CaptureSample::SetPreroll(BOOL bIsPreroll)
+{
+	preroll = !!bIsPreroll;
+	return S_OK;
+}
+
+STDMETHODIMP_(long) CaptureSample::GetActualDataLength()
+{
+	return actualSize;
+}
+
+STDMETHODIMP CaptureSample::SetActualDataLength(long length)
+{
+	if (length < 0 || length > size)
+		return VFW_E_BUFFER_OVERFLOW;
+
+	actualSize = length;
+	return S_OK;
+}
+
+STDMETHODIMP CaptureSample::GetMediaType(AM_MEDIA_TYPE **ppMediaType)
+{
+	if (!ppMediaType)
+		return E_POINTER;
+
+	if (!hasMediaType) {
+		*ppMediaType = nullptr;
+		return S_FALSE;
+	}
+
+	*ppMediaType = mediaType.Duplicate();
+	return *ppMediaType ? S_OK : E_OUTOFMEMORY;
+}
+
+STDMETHODIMP CaptureSample::SetMediaType(AM_MEDIA_TYPE *pMediaType)
+{
+	if (!pMediaType) {
+		mediaType = MediaType();
+		hasMediaType = false;
+		return S_OK;
+	}
+
+	mediaType = pMediaType;
+	hasMediaType = true;
+	return S_OK;
+}
+
+STDMETHODIMP CaptureSample::IsDiscontinuity()
+{
+	return discontinuity ? S_OK : S_FALSE;
+}
+
+STDMETHODIMP CaptureSample::SetDiscontinuity(BOOL bDiscontinuity)
+{
+	discontinuity = !!bDiscontinuity;
+	return S_OK;
+}
+
+STDMETHODIMP CaptureSample::GetMediaTime(LONGLONG *pTimeStart,
+					 LONGLONG *pTimeEnd)
+{
+	if (!hasMediaTime)
+		return VFW_E_MEDIA_TIME_NOT_SET;
+
+	if (pTimeStart)
+		*pTimeStart = mediaStart;
+	if (pTimeEnd)
+		*pTimeEnd = mediaStop;
+	return S_OK;
+}
+
+STDMETHODIMP CaptureSample::SetMediaTime(LONGLONG *pTimeStart,
+					 LONGLONG *pTimeEnd)
+{
+	hasMediaTime = pTimeStart != nullptr && pTimeEnd != nullptr;
+
+	if (hasMediaTime) {
+		mediaStart = *pTimeStart;
+		mediaStop = *pTimeEnd;
+	}
+	return S_OK;
+}
+
+// ============================================================================
+
+CaptureAllocator::CaptureAllocator(long bufferCount) : minBuffers(bufferCount)
+{
+}
+
+CaptureAllocator::~CaptureAllocator()
+{
+	Free();
+}
+
+void CaptureAllocator::SetMinimumBufferSize(long size)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	minBufferSize = size;
+}
+
+void CaptureAllocator::GetStats(AllocatorStats &stats)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	stats.buffers = props.cBuffers;
+	stats.bufferSize = props.cbBuffer;
+	stats.outstanding = outstanding;
+	stats.maxOutstanding = maxOutstanding;
+	stats.starved = starved;
+	stats.starvedTime = starvedTime;
+}
+
+bool CaptureAllocator::Allocate()
+{
+	long align = props.cbAlign;
+	long prefix = (props.cbPrefix + align - 1) & ~(align - 1);
+
+	for (long i = 0; i < props.cBuffers; i++) {
+		CaptureSample *sample = new CaptureSample(this);
+		sample->memory = (BYTE *)_aligned_malloc(
+			(size_t)(prefix + props.cbBuffer), (size_t)align);
+		if (!sample->memory) {
+			delete sample;
+			Free();
+			return false;
+		}
+
+		sample->buffer = sample->memory + prefix;
+		sample->size = props.cbBuffer;
+
+		samples.push_back(sample);
+		freeSamples.push_back(sample);
+	}
+
+	allocated = true;
+	return true;
+}
+
+void CaptureAllocator::Free()
+{
+	for (CaptureSample *sample : samples)
+		delete sample;
+
+	samples.clear();
+	freeSamples.clear();
+	allocated = false;
+}
+
+void CaptureAllocator::ReturnSample(CaptureSample *sample)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	sample->Reset();
+	freeSamples.push_back(sample);
+	outstanding--;
+
+	/* a decommit while buffers were still held by consumers frees the
+	 * memory once the last one comes back */
+	if (!committed && freeSamples.size() == samples.size())
+		Free();
+
+	bufferAvailable.notify_one();
+}
+
+STDMETHODIMP CaptureAllocator::QueryInterface(REFIID riid, void **ppv)
+{
+	if (riid == IID_IUnknown || riid == IID_IMemAllocator) {
+		AddRef();
+		*ppv = (IMemAllocator *)this;
+		return NOERROR;
+	} else {
+		*ppv = nullptr;
+		return E_NOINTERFACE;
+	}
+}
+
+STDMETHODIMP_(ULONG) CaptureAllocator::AddRef()
+{
+	return (ULONG)InterlockedIncrement(&refCount);
+}
+
+STDMETHODIMP_(ULONG) CaptureAllocator::Release()
+{
+	long newRefs = InterlockedDecrement(&refCount);
+	if (!newRefs) {
+		delete this;
+		return 0;
+	}
+
+	return (ULONG)newRefs;
+}
+
+STDMETHODIMP CaptureAllocator::SetProperties(ALLOCATOR_PROPERTIES *pRequest,
+					     ALLOCATOR_PROPERTIES *pActual)
+{
+	PrintFunc(L"CaptureAllocator::SetProperties");
+
+	if (!pRequest || !pActual)
+		return E_POINTER;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (committed)
+		return VFW_E_ALREADY_COMMITTED;
+	if (outstanding)
+		return VFW_E_BUFFERS_OUTSTANDING;
+
+	long align = max(pRequest->cbAlign, (long)CAPTURE_BUFFER_ALIGN);
+	if (align & (align - 1))
+		return VFW_E_BADALIGN;
+
+	if (allocated)
+		Free();
+
+	props.cBuffers = max(pRequest->cBuffers, minBuffers);
+	props.cbBuffer = max(pRequest->cbBuffer, minBufferSize);
+	props.cbAlign = align;
+	props.cbPrefix = max(pRequest->cbPrefix, 0L);
+
+	if (props.cbBuffer <= 0)
+		return E_INVALIDARG;
+
+	*pActual = props;
+	return S_OK;
+}
+
+STDMETHODIMP CaptureAllocator::GetProperties(ALLOCATOR_PROPERTIES *pProps)
+{
+	if (!pProps)
+		return E_POINTER;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	*pProps = props;
+	return S_OK;
+}
+
+STDMETHODIMP CaptureAllocator::Commit()
+{
+	PrintFunc(L"CaptureAllocator::Commit");
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (committed)
+		return S_OK;
+	if (props.cbBuffer <= 0)
+		return VFW_E_SIZENOTSET;
+
+	/* buffers from a previous commit may still be held downstream, in
+	 * which case they simply get reused */
+	if (!allocated && !Allocate())
+		return E_OUTOFMEMORY;
+
+	committed = true;
+	return S_OK;
+}
+
+STDMETHODIMP CaptureAllocator::Decommit()
+{
+	PrintFunc(L"CaptureAllocator::Decommit");
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!committed)
+		return S_OK;
+
+	committed = false;
+	if (freeSamples.size() == samples.size())
+		Free();
+
+	bufferAvailable.notify_all();
+	return S_OK;
+}
+
+STDMETHODIMP CaptureAllocator::GetBuffer(IMediaSample **ppBuffer,
+					 REFERENCE_TIME *pStartTime,
+					 REFERENCE_TIME *pEndTime,
+					 DWORD dwFlags)
+{
+	if (!ppBuffer)
+		return E_POINTER;
+
+	*ppBuffer = nullptr;
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	if (!committed)
+		return VFW_E_NOT_COMMITTED;
+
+	if (freeSamples.empty()) {
+		/* every buffer is still held by a consumer */
+		starved++;
+
+		if ((dwFlags & AM_GBF_NOWAIT) != 0)
+			return VFW_E_TIMEOUT;
+
+		long long waitStart = GetHostTime();
+		bufferAvailable.wait(lock, [this]() {
+			return !committed || !freeSamples.empty();
+		});
+		starvedTime += GetHostTime() - waitStart;
+
+		if (!committed)
+			return VFW_E_NOT_COMMITTED;
+	}
+
+	CaptureSample *sample = freeSamples.back();
+	freeSamples.pop_back();
+
+	if (++outstanding > maxOutstanding)
+		maxOutstanding = outstanding;
+
+	sample->refCount = 1;
+	sample->SetTime(pStartTime, pEndTime);
+	AddRef();
+
+	*ppBuffer = sample;
+	return S_OK;
+}
+
+STDMETHODIMP CaptureAllocator::ReleaseBuffer(IMediaSample *pBuffer)
+{
+	if (!pBuffer)
+		return E_POINTER;
+
+	/* buffers come back through CaptureSample::Release */
+	return S_OK;
+}
+
+// ============================================================================
+
 class MiscFlagsHandler : public IAMFilterMiscFlags {
 	volatile long refCount = 0;
 
@@ -23,17 +23,139 @@
 #include "dshow-media-type.hpp"
 #include "../dshowcapture.hpp"
 
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
 namespace DShow {
 
+#define CAPTURE_DEFAULT_BUFFERS 4
+#define CAPTURE_BUFFER_ALIGN 64
+
 class CaptureFilter;
 class CaptureSource;
+class CaptureAllocator;
 
 typedef void (*CaptureCallback)(void *param, IMediaSample *sample);
 
 struct PinCaptureInfo {
 	std::function<void(IMediaSample *sample)> callback;
+
+	/* optional, receives everything passed to ReceiveMultiple at once */
+	std::function<void(IMediaSample **samples, long count)> batchCallback;
+
 	GUID expectedMajorType{};
 	GUID expectedSubType{};
+	long bufferCount = 0;
+};
+
+class CaptureSample : public IMediaSample {
+	friend class CaptureAllocator;
+
+	volatile long refCount = 0;
+	CaptureAllocator *allocator;
+
+	BYTE *memory = nullptr;
+	BYTE *buffer = nullptr;
+	long size = 0;
+	long actualSize = 0;
+
+	REFERENCE_TIME startTime = 0;
+	REFERENCE_TIME stopTime = 0;
+	LONGLONG mediaStart = 0;
+	LONGLONG mediaStop = 0;
+	bool hasStartTime = false;
+	bool hasStopTime = false;
+	bool hasMediaTime = false;
+	bool syncPoint = false;
+	bool preroll = false;
+	bool discontinuity = false;
+
+	MediaType mediaType;
+	bool hasMediaType = false;
+
+	void Reset();
+
+public:
+	CaptureSample(CaptureAllocator *allocator);
+	virtual ~CaptureSample();
+
+	STDMETHODIMP QueryInterface(REFIID riid, void **ppv);
+	STDMETHODIMP_(ULONG) AddRef();
+	STDMETHODIMP_(ULONG) Release();
+
+	// IMediaSample methods
+	STDMETHODIMP GetPointer(BYTE **ppBuffer);
+	STDMETHODIMP_(long) GetSize();
+	STDMETHODIMP GetTime(REFERENCE_TIME *pTimeStart,
+			     REFERENCE_TIME *pTimeEnd);
+	STDMETHODIMP SetTime(REFERENCE_TIME *pTimeStart,
+			     REFERENCE_TIME *pTimeEnd);
+	STDMETHODIMP IsSyncPoint();
+	STDMETHODIMP SetSyncPoint(BOOL bIsSyncPoint);
+	STDMETHODIMP IsPreroll();
+	STDMETHODIMP SetPreroll(BOOL bIsPreroll);
+	STDMETHODIMP_(long) GetActualDataLength();
+	STDMETHODIMP SetActualDataLength(long length);
+	STDMETHODIMP GetMediaType(AM_MEDIA_TYPE **ppMediaType);
+	STDMETHODIMP SetMediaType(AM_MEDIA_TYPE *pMediaType);
+	STDMETHODIMP IsDiscontinuity();
+	STDMETHODIMP SetDiscontinuity(BOOL bDiscontinuity);
+	STDMETHODIMP GetMediaTime(LONGLONG *pTimeStart, LONGLONG *pTimeEnd);
+	STDMETHODIMP SetMediaTime(LONGLONG *pTimeStart, LONGLONG *pTimeEnd);
+};
+
+/*
+ * Allocator handed out by the capture pin.  Upstream filters that accept it
+ * write straight into our aligned buffers, and those buffers are what the
+ * capture callbacks end up reading.
+ */
+class CaptureAllocator : public IMemAllocator {
+	friend class CaptureSample;
+
+	volatile long refCount = 0;
+
+	std::mutex mutex;
+	std::condition_variable bufferAvailable;
+
+	std::vector<CaptureSample *> samples;
+	std::vector<CaptureSample *> freeSamples;
+	ALLOCATOR_PROPERTIES props = {};
+	long minBuffers;
+	long minBufferSize = 0;
+	bool allocated = false;
+	bool committed = false;
+
+	long outstanding = 0;
+	long maxOutstanding = 0;
+	long long starved = 0;
+	long long starvedTime = 0;
+
+	bool Allocate();
+	void Free();
+	void ReturnSample(CaptureSample *sample);
+
+public:
+	CaptureAllocator(long bufferCount);
+	virtual ~CaptureAllocator();
+
+	void SetMinimumBufferSize(long size);
+	void GetStats(AllocatorStats &stats);
+
+	STDMETHODIMP QueryInterface(REFIID riid, void **ppv);
+	STDMETHODIMP_(ULONG) AddRef();
+	STDMETHODIMP_(ULONG) Release();
+
+	// IMemAllocator methods
+	STDMETHODIMP SetProperties(ALLOCATOR_PROPERTIES *pRequest,
+				   ALLOCATOR_PROPERTIES *pActual);
+	STDMETHODIMP GetProperties(ALLOCATOR_PROPERTIES *pProps);
+	STDMETHODIMP Commit();
+	STDMETHODIMP Decommit();
+	STDMETHODIMP GetBuffer(IMediaSample **ppBuffer,
+			       REFERENCE_TIME *pStartTime,
+			       REFERENCE_TIME *pEndTime, DWORD dwFlags);
+	STDMETHODIMP ReleaseBuffer(IMediaSample *pBuffer);
 };
 
 class CapturePin : public IPin, public IMemInputPin {
@@ -47,7 +169,12 @@ class CapturePin : public IPin, public IMemInputPin {
 	MediaType connectedMediaType;
 	volatile bool flushing = false;
 
+	ComPtr<CaptureAllocator> allocator;
+	bool ownAllocator = false;
+	volatile long long delivered = 0;
+
 	bool IsValidMediaType(const AM_MEDIA_TYPE *pmt) const;
+	long GetMediaTypeBufferSize() const;
 
 public:
 	CapturePin(CaptureFilter *filter, const PinCaptureInfo &info);
@@ -85,6 +212,8 @@ public:
 	STDMETHODIMP ReceiveMultiple(IMediaSample **pSamples, long nSamples,
 				     long *nSamplesProcessed);
 	STDMETHODIMP ReceiveCanBlock();
+
+	void GetAllocatorStats(AllocatorStats &stats);
 };
 
 class CaptureFilter : public IBaseFilter {
@@ -1,13 +1,59 @@
 #include <windows.h>
 #include "../dshowcapture.hpp"
 #include "cexport.hpp"
+#include "ring-buffer.hpp"
+#include "audio-convert.hpp"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <memory>
+#include <deque>
 
 using namespace std;
 using namespace DShow;
 
+struct AudioAnchor {
+    long long frame;
+    long long time;
+};
+
+// Written by the DirectShow audio thread, read by read_audio, no locks
+struct AudioStream {
+    RingBuffer<unsigned char> data;
+    RingBuffer<AudioAnchor> anchors;
+    size_t frameSize;
+    int sampleRate;
+    int channels;
+    AudioFormat format;
+
+    // producer only
+    long long written = 0;
+
+    // consumer only
+    long long read = 0;
+    AudioAnchor anchor = {0, 0};
+    AudioAnchor nextAnchor = {0, 0};
+    bool haveNextAnchor = false;
+
+    atomic<long long> overruns{0};
+    atomic<long long> underruns{0};
+
+    AudioStream(size_t bytes, size_t frameSize_, const AudioConfig &config)
+        : data(bytes), anchors(256), frameSize(frameSize_),
+          sampleRate(config.sampleRate), channels(config.channels),
+          format(config.format) {}
+};
+
+// Encoded frames are queued rather than overwritten in passthrough mode,
+// since dropping one breaks decoding until the next keyframe
+#define MAX_QUEUED_PACKETS 64
+
+struct Packet {
+    vector<unsigned char> data;
+    long long timestamp;
+    int keyframe;
+};
+
 struct Context {
     Device device;
     vector<VideoDevice> devices;
@@ -18,7 +64,21 @@ struct Context {
     int debug;
     unsigned char *buffer;
     size_t size;
+    // timestamp of the frame in buffer, and of the one get_frame returned
+    long long frameTime;
+    int frameSynthetic;
+    long long readTime;
+    int readSynthetic;
     string json;
+    AudioConfig audioConfig;
+    int audioEnabled;
+    int audioBufferMs;
+    unique_ptr<AudioStream> audio;
+    int passthrough;
+    deque<Packet> packets;
+    bool waitKeyframe;
+    long long packetsQueued;
+    long long packetsDropped;
 };
 
 static int initialized = 0;
@@ -35,11 +95,22 @@ void DSHOWCAPTURE_EXPORT *create_capture() {
     context->debug = 0;
     context->buffer = 0;
     context->size = 0;
+    context->frameTime = 0;
+    context->frameSynthetic = 0;
+    context->readTime = 0;
+    context->readSynthetic = 0;
+    context->audioEnabled = 0;
+    context->audioBufferMs = 0;
+    context->passthrough = 0;
+    context->waitKeyframe = true;
+    context->packetsQueued = 0;
+    context->packetsDropped = 0;
     return context;
 }
 int DSHOWCAPTURE_EXPORT get_devices(void *cap) {
     Context *context = (Context*)cap;
-    Device::EnumVideoDevices(context->devices);
+    // shared between contexts, only enumerates again after hot-plug
+    Device::EnumVideoDevicesCached(context->devices);
     return (int)context->devices.size();
 }
 
@@ -80,8 +151,14 @@ string WidestringToString(wstring wstr)
     return ret;
 }
 
-static inline int GetFormatRating(VideoFormat format)
+static inline int GetFormatRating(VideoFormat format, bool passthrough = false)
 {
+    // recording/forwarding consumers want the compressed formats
+    if (passthrough && (format == VideoFormat::H264 || format == VideoFormat::HEVC))
+        return 0;
+    else if (passthrough && format == VideoFormat::MJPEG)
+        return 1;
+
     if (format == VideoFormat::XRGB)
         return 0;
     else if (format == VideoFormat::ARGB)
@@ -104,7 +181,7 @@ static inline int GetFormatRating(VideoFormat format)
 
 int DSHOWCAPTURE_EXPORT get_json_length(void *cap) {
     Context *context = (Context*)cap;
-    Device::EnumVideoDevices(context->devices);
+    Device::EnumVideoDevicesCached(context->devices);
 
     ostringstream ss;
     ss << "[";
@@ -117,7 +194,7 @@ int DSHOWCAPTURE_EXPORT get_json_length(void *cap) {
         ss << "\"caps\": [";
         bool found = false;
         for (size_t dcap = 0; dcap < context->devices[dev].caps.size(); dcap++) {
-            int rating = GetFormatRating(context->devices[dev].caps[dcap].format);
+            int rating = GetFormatRating(context->devices[dev].caps[dcap].format, context->passthrough != 0);
             if (rating >= 15)
                 continue;
             if (found)
@@ -157,10 +234,47 @@ void DSHOWCAPTURE_EXPORT get_device(void *cap, int n, char *name, int len) {
     Context *context = (Context*)cap;
 }*/
 
+static void packet_callback(Context *context, const VideoConfig &config,
+    unsigned char *data, size_t size, long long startTime) {
+    int keyframe = 1;
+    if (config.format != VideoFormat::MJPEG) {
+        BitstreamInfo info;
+        ParseBitstream(config.format, data, size, info);
+        keyframe = info.keyframe ? 1 : 0;
+    }
+
+    EnterCriticalSection(&context->busy);
+    // after an overflow nothing decodes until the next keyframe anyway
+    if (context->waitKeyframe && !keyframe) {
+        context->packetsDropped++;
+        LeaveCriticalSection(&context->busy);
+        return;
+    }
+    context->waitKeyframe = false;
+    if (context->packets.size() >= MAX_QUEUED_PACKETS) {
+        context->packetsDropped += context->packets.size();
+        context->packets.clear();
+        if (!keyframe) {
+            context->waitKeyframe = true;
+            context->packetsDropped++;
+            LeaveCriticalSection(&context->busy);
+            return;
+        }
+    }
+    context->packets.push_back({vector<unsigned char>(data, data + size), startTime, keyframe});
+    context->packetsQueued++;
+    LeaveCriticalSection(&context->busy);
+    SetEvent(context->readReady);
+}
+
 void capture_callback(const VideoConfig &config, unsigned char *data,
     size_t size, long long startTime, long long stopTime,
     long rotation) {
     Context *context = (Context*)config.context;
+    if (context->passthrough && config.format >= VideoFormat::MJPEG) {
+        packet_callback(context, config, data, size, startTime);
+        return;
+    }
     float start = (float)startTime / 10000000.f;
     float stop = (float)stopTime / 10000000.f;
     if (context->debug == 2)
@@ -177,10 +291,77 @@ void capture_callback(const VideoConfig &config, unsigned char *data,
         context->size = size;
     }
     memcpy(context->buffer, data, size);
+    context->frameTime = startTime;
+    context->frameSynthetic = context->device.VideoTimeSynthetic() ? 1 : 0;
     LeaveCriticalSection(&context->busy);
     SetEvent(context->readReady);
 }
 
+static size_t audio_frame_size(const AudioConfig &config) {
+    return AFormatSampleBytes(config.format) * config.channels;
+}
+
+static void audio_callback(Context *context, const AudioConfig &config,
+    unsigned char *data, size_t size, long long startTime) {
+    AudioStream *audio = context->audio.get();
+    if (!audio)
+        return;
+    if (config.channels != audio->channels || config.format != audio->format) {
+        audio->overruns += size / audio->frameSize;
+        return;
+    }
+
+    size_t frames = size / audio->frameSize;
+    size_t space = (audio->data.Capacity() - audio->data.Size()) / audio->frameSize;
+    if (frames > space) {
+        audio->overruns += frames - space;
+        frames = space;
+    }
+    if (!frames)
+        return;
+
+    // If the anchor ring is full read_audio just extrapolates from the last one
+    audio->anchors.Push({audio->written, startTime});
+    audio->data.Write(data, frames * audio->frameSize);
+    audio->written += frames;
+}
+
+// Called between SetVideoConfig and ConnectFilters, audio failing is not fatal
+static void setup_audio(Context *context) {
+    context->audio.reset();
+    if (!context->audioEnabled)
+        return;
+
+    AudioConfig config = context->audioConfig;
+    config.useVideoDevice = true;
+    config.callback = [context](const AudioConfig &deviceConfig, unsigned char *data,
+        size_t size, long long startTime, long long) {
+        audio_callback(context, deviceConfig, data, size, startTime);
+    };
+
+    if (!context->device.SetAudioConfig(&config)) {
+        cout << "Device has no usable audio, capturing video only\n";
+        context->device.SetAudioConfig(nullptr);
+        return;
+    }
+
+    size_t frameSize = audio_frame_size(config);
+    if (!frameSize || config.sampleRate <= 0) {
+        cout << "Unsupported audio format " << (int)config.format << ", capturing video only\n";
+        context->device.SetAudioConfig(nullptr);
+        return;
+    }
+
+    size_t bytes = (size_t)config.sampleRate * context->audioBufferMs / 1000 * frameSize;
+    context->audio.reset(new AudioStream(bytes, frameSize, config));
+    cout << "Audio configuration: " << config.sampleRate << "Hz " << config.channels << " channels Format: " << (int)config.format << "\n";
+}
+
+static bool connect_filters(Context *context) {
+    setup_audio(context);
+    return context->device.ConnectFilters();
+}
+
 int DSHOWCAPTURE_EXPORT capture_device_default(void *cap, int n) {
     Context *context = (Context*)cap;
     if (context->devices.size() < 1)
@@ -208,7 +389,7 @@ int DSHOWCAPTURE_EXPORT capture_device_default(void *cap, int n) {
     if (!context->device.SetVideoConfig(&context->config)) {
         return 0;
     }
-    if (context->config.internalFormat > VideoFormat::MJPEG) {
+    if (!context->passthrough && context->config.internalFormat > VideoFormat::MJPEG) {
         cout << "Detected unsupported encoded format " << (int)context->config.internalFormat << ", trying to downgrade to MJPEG\n\n";
         context->config = config;
         context->config.internalFormat = VideoFormat::MJPEG;
@@ -218,7 +399,7 @@ int DSHOWCAPTURE_EXPORT capture_device_default(void *cap, int n) {
     }
     if (!context->device.Valid())
         return 0;
-    if (!context->device.ConnectFilters())
+    if (!connect_filters(context))
         return 0;
     if (!context->device.Valid())
         return 0;
@@ -298,7 +479,7 @@ int DSHOWCAPTURE_EXPORT capture_device_by_dcap(void *cap, int n, int dcap, int c
     if (!context->device.SetVideoConfig(&context->config)) {
         return 0;
     }
-    if (context->config.internalFormat > VideoFormat::MJPEG) {
+    if (!context->passthrough && context->config.internalFormat > VideoFormat::MJPEG) {
         cout << "Detected unsupported encoded format " << (int)context->config.internalFormat << ", trying to downgrade to MJPEG\n\n";
         context->config = config;
         context->config.internalFormat = VideoFormat::MJPEG;
@@ -308,7 +489,7 @@ int DSHOWCAPTURE_EXPORT capture_device_by_dcap(void *cap, int n, int dcap, int c
     }
     if (!context->device.Valid())
         return 0;
-    if (!context->device.ConnectFilters())
+    if (!connect_filters(context))
         return 0;
     if (!context->device.Valid())
         return 0;
@@ -324,6 +505,73 @@ int DSHOWCAPTURE_EXPORT capture_device_by_dcap(void *cap, int n, int dcap, int c
     return context->capturing;
 }
 
+// Key under which capture_device remembers what worked for a request
+static wstring known_config_mode(int width, int height, int fps, int passthrough) {
+    wstringstream mode;
+    mode << width << L"x" << height << L"@" << fps;
+    if (passthrough)
+        mode << L" passthrough";
+    return mode.str();
+}
+
+// Whether the device opened with the size and interval that were asked
+// for, rather than something it substituted
+static bool config_matches(const VideoConfig &config, int cx, int cy, long long interval) {
+    return config.cx == cx && config.cy_abs == cy && config.frameInterval == interval;
+}
+
+// Tries the configuration that last opened this device for the same
+// request.  It is only forgotten when the device rejects it; a failure to
+// start (e.g. the device being in use elsewhere) or to build the graph
+// says nothing about the config, so it is kept for next time
+static int capture_known_config(void *cap, int n, const wstring &mode) {
+    Context *context = (Context*)cap;
+    const wstring &path = context->devices[n].path;
+    if (!Device::GetKnownConfig(path, mode, context->config))
+        return 0;
+
+    // Earlier versions also stored the device's default config when it was
+    // the fallback, which isn't what the mode asks for
+    if (context->config.useDefaultConfig) {
+        Device::ForgetKnownConfig(path, mode);
+        return 0;
+    }
+
+    int cx = context->config.cx;
+    int cy = context->config.cy_abs;
+    long long interval = context->config.frameInterval;
+    bool rejected = false;
+
+    context->config.context = cap;
+    context->config.callback = capture_callback;
+    context->capturing = 0;
+    cout << "Trying known configuration: " << context->config.cx << "x" << context->config.cy_abs << " " << context->config.frameInterval << " " << (int)context->config.internalFormat << "\n";
+
+    if (context->device.ResetGraph() && context->device.Valid()) {
+        if (!context->device.SetVideoConfig(&context->config) ||
+            !config_matches(context->config, cx, cy, interval) ||
+            context->config.frameInterval == 0)
+            rejected = true;
+        else if (context->device.Valid() && connect_filters(context) && context->device.Valid())
+            context->capturing = context->device.Start() == Result::Success;
+    }
+
+    if (!context->capturing) {
+        context->device.Stop();
+        if (rejected) {
+            cout << "Known configuration rejected\n";
+            Device::ForgetKnownConfig(path, mode);
+        } else {
+            cout << "Known configuration failed\n";
+        }
+        return 0;
+    }
+    long long unit = 10000000;
+    cout << "Final camera configuration: " << context->config.cx << "x" << context->config.cy_abs << " " << unit / context->config.frameInterval << "\n";
+    cout << "Format: " << (int)context->config.format << " Internal format: " << (int)context->config.internalFormat << "\n";
+    return context->capturing;
+}
+
 int DSHOWCAPTURE_EXPORT capture_device(void *cap, int n, int width, int height, int fps) {
     Context *context = (Context*)cap;
     int ret = 1;
@@ -333,6 +581,12 @@ int DSHOWCAPTURE_EXPORT capture_device(void *cap, int n, int width, int height,
     context->config.name = context->devices[n].name.c_str();
     context->config.path = context->devices[n].path.c_str();
 
+    // A single attempt with what worked last time, before scoring caps
+    // and falling back through several full graph resets
+    wstring mode = known_config_mode(width, height, fps, context->passthrough);
+    if (capture_known_config(cap, n, mode))
+        return context->capturing;
+
     VideoDevice dev = context->devices[n];
     int best_match = -1;
     int best_width = width;
@@ -389,7 +643,7 @@ int DSHOWCAPTURE_EXPORT capture_device(void *cap, int n, int width, int height,
         unsigned int mismatch = (width * height) - (this_width * this_height);
         mismatch = mismatch * mismatch;
 
-        int format_rating = GetFormatRating(dev.caps[i].format);
+        int format_rating = GetFormatRating(dev.caps[i].format, context->passthrough != 0);
         if (mismatch < score && format_rating < 15) {
             score = mismatch;
             best_match = (int)i;
@@ -420,10 +674,10 @@ int DSHOWCAPTURE_EXPORT capture_device(void *cap, int n, int width, int height,
         ret = 0;
     if (ret && !context->device.Valid())
         ret = 0;
-    if (ret && (!context->device.SetVideoConfig(&context->config) || !context->device.Valid() || !context->device.ConnectFilters())) {
+    if (ret && (!context->device.SetVideoConfig(&context->config) || !context->device.Valid() || !connect_filters(context))) {
         cout << "Retrying with any format\n";
         context->config.internalFormat = VideoFormat::Any;
-        if (!context->device.SetVideoConfig(&context->config) || !context->device.Valid() || !context->device.ConnectFilters())
+        if (!context->device.SetVideoConfig(&context->config) || !context->device.Valid() || !connect_filters(context))
             ret = 0;
     }
     if (ret && !context->device.Valid())
@@ -432,12 +686,17 @@ int DSHOWCAPTURE_EXPORT capture_device(void *cap, int n, int width, int height,
         context->capturing = context->device.Start() == Result::Success;
         cout << "Final camera configuration: " << context->config.cx << "x" << context->config.cy_abs << " " << unit / context->config.frameInterval << "\n";
         cout << "Format: " << (int)context->config.format << " Internal format: " << (int)context->config.internalFormat << "\n";
+        if (context->capturing &&
+            config_matches(context->config, best_width, best_height, best_interval))
+            Device::SetKnownConfig(context->devices[n].path, mode, context->config);
         if (ret)
             return context->capturing;
     }
     cout << "Failed\n";
     context->capturing = 0;
     context->device.Stop();
+    // The device's default config isn't what was asked for, so it isn't
+    // remembered for this request
     return capture_device_default(cap, n);
 }
 int DSHOWCAPTURE_EXPORT get_width(void *cap) {
@@ -478,9 +737,20 @@ int DSHOWCAPTURE_EXPORT get_frame(void *cap, int timeout, unsigned char *buffer,
         return 0;
     }
     memcpy(buffer, context->buffer, context->size);
+    context->readTime = context->frameTime;
+    context->readSynthetic = context->frameSynthetic;
     LeaveCriticalSection(&context->busy);
     return context->size;
 }
+// Timestamp of the frame last returned by get_frame, synthetic is set if the
+// device didn't timestamp it and it was generated from the host clock
+void DSHOWCAPTURE_EXPORT get_frame_time(void *cap, long long *timestamp, int *synthetic) {
+    Context *context = (Context*)cap;
+    EnterCriticalSection(&context->busy);
+    *timestamp = context->readTime;
+    *synthetic = context->readSynthetic;
+    LeaveCriticalSection(&context->busy);
+}
 int DSHOWCAPTURE_EXPORT get_size(void *cap) {
     Context *context = (Context*)cap;
     return (int)context->size;
@@ -489,6 +759,10 @@ void DSHOWCAPTURE_EXPORT stop_capture(void *cap) {
     Context *context = (Context*)cap;
     context->device.Stop();
     context->capturing = 0;
+    EnterCriticalSection(&context->busy);
+    context->packets.clear();
+    context->waitKeyframe = true;
+    LeaveCriticalSection(&context->busy);
 }
 void DSHOWCAPTURE_EXPORT destroy_capture(void *cap) {
     Context *context = (Context*)cap;
@@ -501,6 +775,117 @@ void DSHOWCAPTURE_EXPORT destroy_capture(void *cap) {
     context->devices.clear();
     delete context;
 }
+// Delivers H264/HEVC/MJPEG frames through get_packet instead of downgrading
+// or decoding them, for the next capture_device* call
+void DSHOWCAPTURE_EXPORT set_passthrough(void *cap, int enabled) {
+    Context *context = (Context*)cap;
+    context->passthrough = enabled ? 1 : 0;
+}
+// Returns the packet size, 0 on timeout, or minus the size needed if buffer is too small
+int DSHOWCAPTURE_EXPORT get_packet(void *cap, int timeout, unsigned char *buffer, int size, long long *timestamp, int *keyframe) {
+    Context *context = (Context*)cap;
+    if (!context->capturing)
+        return 0;
+    EnterCriticalSection(&context->busy);
+    if (context->packets.empty()) {
+        LeaveCriticalSection(&context->busy);
+        if (WaitForSingleObject(context->readReady, timeout) != WAIT_OBJECT_0)
+            return 0;
+        EnterCriticalSection(&context->busy);
+        if (context->packets.empty()) {
+            LeaveCriticalSection(&context->busy);
+            return 0;
+        }
+    }
+    Packet &packet = context->packets.front();
+    int packetSize = (int)packet.data.size();
+    if (packetSize > size) {
+        LeaveCriticalSection(&context->busy);
+        return -packetSize;
+    }
+    memcpy(buffer, packet.data.data(), packet.data.size());
+    if (timestamp)
+        *timestamp = packet.timestamp;
+    if (keyframe)
+        *keyframe = packet.keyframe;
+    context->packets.pop_front();
+    LeaveCriticalSection(&context->busy);
+    return packetSize;
+}
+// stats: packets queued, packets dropped, packets waiting
+void DSHOWCAPTURE_EXPORT get_packet_stats(void *cap, long long *stats) {
+    Context *context = (Context*)cap;
+    EnterCriticalSection(&context->busy);
+    stats[0] = context->packetsQueued;
+    stats[1] = context->packetsDropped;
+    stats[2] = (long long)context->packets.size();
+    LeaveCriticalSection(&context->busy);
+}
+// Delivers frames from devices that don't timestamp them, with timestamps
+// generated from the host clock, for the next capture_device* call
+void DSHOWCAPTURE_EXPORT set_synthesize_timestamps(void *cap, int enabled) {
+    Context *context = (Context*)cap;
+    context->config.synthesizeTimestamps = enabled != 0;
+}
+
+// Enables audio from the video device for the next capture_device* call
+int DSHOWCAPTURE_EXPORT capture_audio(void *cap, int sample_rate, int channels, int buffer_ms) {
+    Context *context = (Context*)cap;
+    context->audioConfig = AudioConfig();
+    context->audioConfig.sampleRate = sample_rate;
+    context->audioConfig.channels = channels;
+    context->audioConfig.useDefaultConfig = sample_rate <= 0 && channels <= 0;
+    context->audioBufferMs = buffer_ms > 0 ? buffer_ms : 200;
+    context->audioEnabled = 1;
+    return 1;
+}
+// Never blocks, returns the number of frames read and the timestamp of the first one
+int DSHOWCAPTURE_EXPORT read_audio(void *cap, unsigned char *dst, int max_frames, long long *timestamp) {
+    Context *context = (Context*)cap;
+    AudioStream *audio = context->audio.get();
+    if (!audio || max_frames <= 0)
+        return 0;
+
+    while (audio->haveNextAnchor || audio->anchors.Pop(audio->nextAnchor)) {
+        audio->haveNextAnchor = true;
+        if (audio->nextAnchor.frame > audio->read)
+            break;
+        audio->anchor = audio->nextAnchor;
+        audio->haveNextAnchor = false;
+    }
+    if (timestamp)
+        *timestamp = audio->anchor.time + (audio->read - audio->anchor.frame) * 10000000LL / audio->sampleRate;
+
+    size_t frames = audio->data.Size() / audio->frameSize;
+    if (frames < (size_t)max_frames)
+        audio->underruns++;
+    else
+        frames = (size_t)max_frames;
+
+    audio->data.Read(dst, frames * audio->frameSize);
+    audio->read += frames;
+    return (int)frames;
+}
+int DSHOWCAPTURE_EXPORT get_audio_sample_rate(void *cap) {
+    Context *context = (Context*)cap;
+    return context->audio ? context->audio->sampleRate : 0;
+}
+int DSHOWCAPTURE_EXPORT get_audio_channels(void *cap) {
+    Context *context = (Context*)cap;
+    return context->audio ? context->audio->channels : 0;
+}
+int DSHOWCAPTURE_EXPORT get_audio_format(void *cap) {
+    Context *context = (Context*)cap;
+    return context->audio ? (int)context->audio->format : 0;
+}
+// stats: overrun frames, underruns, buffered frames
+void DSHOWCAPTURE_EXPORT get_audio_stats(void *cap, long long *stats) {
+    Context *context = (Context*)cap;
+    AudioStream *audio = context->audio.get();
+    stats[0] = audio ? audio->overruns.load() : 0;
+    stats[1] = audio ? audio->underruns.load() : 0;
+    stats[2] = audio ? (long long)(audio->data.Size() / audio->frameSize) : 0;
+}
 int DSHOWCAPTURE_EXPORT capturing(void *cap) {
     Context *context = (Context*)cap;
     return context->capturing;
@@ -540,4 +925,50 @@ void DSHOWCAPTURE_EXPORT lib_test(int n, int width, int height, int fps) {
             cout << "Lost frame\n";
     }
     destroy_capture(cap);
-}
\ No newline at end of file
+}
+void DSHOWCAPTURE_EXPORT *create_sync_group(long long tolerance, int partial) {
+    SyncGroupConfig config;
+    if (tolerance > 0)
+        config.tolerance = tolerance;
+    config.deliverPartialSets = partial != 0;
+    return new SyncGroup(config);
+}
+// Must be called before capture_device, returns the stream's index in a frame set
+int DSHOWCAPTURE_EXPORT sync_group_add(void *group, void *cap) {
+    SyncGroup *syncGroup = (SyncGroup*)group;
+    Context *context = (Context*)cap;
+    return syncGroup->AddDevice(context->config);
+}
+int DSHOWCAPTURE_EXPORT get_frame_set(void *group, int timeout, unsigned char **buffers, int *sizes, long long *timestamps, int count) {
+    SyncGroup *syncGroup = (SyncGroup*)group;
+    vector<VideoFrame> frames;
+    if (!syncGroup->GetFrameSet(frames, timeout))
+        return 0;
+    int found = 0;
+    for (int i = 0; i < count; i++) {
+        timestamps[i] = 0;
+        if (i >= (int)frames.size() || !frames[i].Valid() || frames[i].Size() > (size_t)sizes[i]) {
+            sizes[i] = 0;
+            continue;
+        }
+        memcpy(buffers[i], frames[i].Data(), frames[i].Size());
+        sizes[i] = (int)frames[i].Size();
+        timestamps[i] = frames[i].PresentationTime();
+        found++;
+    }
+    return found;
+}
+// stats: complete sets, partial sets, dropped sets, dropped frames
+void DSHOWCAPTURE_EXPORT get_sync_group_stats(void *group, long long *stats) {
+    SyncGroup *syncGroup = (SyncGroup*)group;
+    SyncGroupStats syncStats;
+    syncGroup->GetStats(syncStats);
+    stats[0] = syncStats.completeSets;
+    stats[1] = syncStats.partialSets;
+    stats[2] = syncStats.droppedSets;
+    stats[3] = syncStats.droppedFrames;
+}
+// Captures in the group keep running, they just stop feeding it
+void DSHOWCAPTURE_EXPORT destroy_sync_group(void *group) {
+    delete (SyncGroup*)group;
+}
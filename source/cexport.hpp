@@ -16,10 +16,26 @@ extern "C" {
     int DSHOWCAPTURE_EXPORT capture_device_by_dcap(void *cap, int n, int dcap, int cx, int cy, long long interval);
     int DSHOWCAPTURE_EXPORT capture_device_default(void *cap, int n);
     int DSHOWCAPTURE_EXPORT get_frame(void *cap, int timeout, unsigned char *buffer, int size);
+    void DSHOWCAPTURE_EXPORT get_frame_time(void *cap, long long *timestamp, int *synthetic);
+    void DSHOWCAPTURE_EXPORT set_synthesize_timestamps(void *cap, int enabled);
     void DSHOWCAPTURE_EXPORT stop_capture(void *cap);
     void DSHOWCAPTURE_EXPORT destroy_capture(void *cap);
     int DSHOWCAPTURE_EXPORT capturing(void *cap);
     int DSHOWCAPTURE_EXPORT get_json_length(void *cap);
     void DSHOWCAPTURE_EXPORT get_json(void *cap, char *buffer, int len);
     void DSHOWCAPTURE_EXPORT lib_test(int n, int width, int height, int fps);
+    int DSHOWCAPTURE_EXPORT capture_audio(void *cap, int sample_rate, int channels, int buffer_ms);
+    int DSHOWCAPTURE_EXPORT read_audio(void *cap, unsigned char *dst, int max_frames, long long *timestamp);
+    int DSHOWCAPTURE_EXPORT get_audio_sample_rate(void *cap);
+    int DSHOWCAPTURE_EXPORT get_audio_channels(void *cap);
+    int DSHOWCAPTURE_EXPORT get_audio_format(void *cap);
+    void DSHOWCAPTURE_EXPORT get_audio_stats(void *cap, long long *stats);
+    void DSHOWCAPTURE_EXPORT set_passthrough(void *cap, int enabled);
+    int DSHOWCAPTURE_EXPORT get_packet(void *cap, int timeout, unsigned char *buffer, int size, long long *timestamp, int *keyframe);
+    void DSHOWCAPTURE_EXPORT get_packet_stats(void *cap, long long *stats);
+    void DSHOWCAPTURE_EXPORT *create_sync_group(long long tolerance, int partial);
+    int DSHOWCAPTURE_EXPORT sync_group_add(void *group, void *cap);
+    int DSHOWCAPTURE_EXPORT get_frame_set(void *group, int timeout, unsigned char **buffers, int *sizes, long long *timestamps, int count);
+    void DSHOWCAPTURE_EXPORT get_sync_group_stats(void *group, long long *stats);
+    void DSHOWCAPTURE_EXPORT destroy_sync_group(void *group);
 }
\ No newline at end of file
@@ -0,0 +1,482 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#include "device-cache.hpp"
+#include "caps-cache.hpp"
+#include "dshow-base.hpp"
+#include "log.hpp"
+
+#include <mutex>
+#include <set>
+#include <SetupAPI.h>
+#include <cfgmgr32.h>
+
+namespace DShow {
+
+typedef CONFIGRET(WINAPI *CM_REGISTER_NOTIFICATION)(
+	PCM_NOTIFY_FILTER filter, PVOID context,
+	PCM_NOTIFY_CALLBACK callback, PHCMNOTIFICATION notifyContext);
+typedef CONFIGRET(WINAPI *CM_UNREGISTER_NOTIFICATION)(
+	HCMNOTIFICATION notifyContext);
+
+/* ------------------------------------------------------------------------- */
+
+static DWORD CALLBACK DeviceChanged(HCMNOTIFICATION notify, PVOID context,
+				    CM_NOTIFY_ACTION action,
+				    PCM_NOTIFY_EVENT_DATA data, DWORD size)
+{
+	auto changed = (const std::function<void()> *)context;
+
+	if (action == CM_NOTIFY_ACTION_DEVICEINTERFACEARRIVAL ||
+	    action == CM_NOTIFY_ACTION_DEVICEINTERFACEREMOVAL)
+		(*changed)();
+
+	DSHOW_UNUSED(notify);
+	DSHOW_UNUSED(data);
+	DSHOW_UNUSED(size);
+	return ERROR_SUCCESS;
+}
+
+/* CM_Register_Notification is Windows 8+, load it dynamically and just
+ * rely on the maximum age where it isn't available */
+class SystemDeviceNotifier : public DeviceNotifier {
+	HCMNOTIFICATION notify = nullptr;
+	CM_UNREGISTER_NOTIFICATION unregisterNotification = nullptr;
+	std::function<void()> changed;
+
+public:
+	bool Start(std::function<void()> changed_) override
+	{
+		changed = std::move(changed_);
+
+		HMODULE cfgmgr = LoadLibraryW(L"cfgmgr32.dll");
+		if (!cfgmgr)
+			return false;
+
+		auto registerNotification = (CM_REGISTER_NOTIFICATION)
+			GetProcAddress(cfgmgr, "CM_Register_Notification");
+		unregisterNotification = (CM_UNREGISTER_NOTIFICATION)
+			GetProcAddress(cfgmgr, "CM_Unregister_Notification");
+		if (!registerNotification || !unregisterNotification)
+			return false;
+
+		/* any interface class: capture devices register under
+		 * several, and a spurious refresh is cheap */
+		CM_NOTIFY_FILTER filter = {};
+		filter.cbSize = sizeof(filter);
+		filter.Flags = CM_NOTIFY_FILTER_FLAG_ALL_INTERFACE_CLASSES;
+		filter.FilterType = CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE;
+
+		CONFIGRET ret = registerNotification(&filter, &changed,
+						     DeviceChanged, &notify);
+		if (ret != CR_SUCCESS) {
+			Warning(L"Failed to register for device notifications: "
+				L"%lu",
+				ret);
+			notify = nullptr;
+			return false;
+		}
+
+		return true;
+	}
+
+	~SystemDeviceNotifier()
+	{
+		if (notify)
+			unregisterNotification(notify);
+	}
+};
+
+static DeviceGeneration cacheGeneration(new SystemDeviceNotifier);
+static CachedDeviceList<VideoDevice> videoDevices;
+static CachedDeviceList<AudioDevice> audioDevices;
+
+bool GetCachedVideoDevices(std::vector<VideoDevice> &devices, int maxAgeMs)
+{
+	return videoDevices.Get(devices, (long long)maxAgeMs * 10000,
+				cacheGeneration,
+				[](std::vector<VideoDevice> &list) {
+					return Device::EnumVideoDevices(
+						list, EnumMode::Parallel);
+				});
+}
+
+bool GetCachedAudioDevices(std::vector<AudioDevice> &devices, int maxAgeMs)
+{
+	return audioDevices.Get(devices, (long long)maxAgeMs * 10000,
+				cacheGeneration,
+				[](std::vector<AudioDevice> &list) {
+					return Device::EnumAudioDevices(list);
+				});
+}
+
+void InvalidateDeviceCache()
+{
+	cacheGeneration.Invalidate();
+}
+
+/* ------------------------------------------------------------------------- */
+
+static std::mutex capsMutex;
+static std::mutex flushMutex;
+static std::wstring capsFile;
+static CapsCache capsCache;
+static bool capsLoaded = false;
+static bool capsDirty = false;
+static std::map<std::wstring, uint64_t> fingerprints;
+static unsigned long long fingerprintGeneration = 0;
+static std::set<std::wstring> revalidated;
+
+static inline void HashBytes(uint64_t &hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = (const uint8_t *)data;
+
+	/* FNV-1a */
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ULL;
+	}
+}
+
+static bool HashRegValue(uint64_t &hash, HKEY key, const wchar_t *name)
+{
+	wchar_t value[512];
+	DWORD size = sizeof(value) - sizeof(wchar_t);
+	DWORD type;
+
+	LSTATUS status = RegQueryValueExW(key, name, nullptr, &type,
+					  (LPBYTE)value, &size);
+	if (status != ERROR_SUCCESS || type != REG_SZ)
+		return false;
+
+	HashBytes(hash, value, size);
+	return true;
+}
+
+/* identifies the installed driver, so that caps cached for one driver
+ * version aren't used with another (0 if it can't be determined) */
+static uint64_t DriverFingerprint(const wchar_t *devicePath)
+{
+	SP_DEVICE_INTERFACE_DATA iface = {};
+	SP_DEVINFO_DATA did = {};
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	bool success = false;
+
+	HDEVINFO devInfo = SetupDiCreateDeviceInfoList(nullptr, NULL);
+	if (devInfo == INVALID_HANDLE_VALUE)
+		return 0;
+
+	iface.cbSize = sizeof(iface);
+	did.cbSize = sizeof(did);
+
+	if (SetupDiOpenDeviceInterfaceW(devInfo, devicePath, 0, &iface) &&
+	    SetupDiEnumDeviceInfo(devInfo, 0, &did)) {
+		HKEY key = SetupDiOpenDevRegKey(devInfo, &did,
+						DICS_FLAG_GLOBAL, 0, DIREG_DRV,
+						KEY_READ);
+		if (key != INVALID_HANDLE_VALUE) {
+			success = HashRegValue(hash, key, L"DriverVersion");
+			HashRegValue(hash, key, L"DriverDate");
+			HashRegValue(hash, key, L"ProviderName");
+			HashRegValue(hash, key, L"InfPath");
+			RegCloseKey(key);
+		}
+	}
+
+	SetupDiDestroyDeviceInfoList(devInfo);
+	return success && hash ? hash : 0;
+}
+
+static uint64_t GetFingerprint(const std::wstring &path)
+{
+	/* a driver can be updated or replaced while its device is unplugged,
+	 * so fingerprints are read again once devices have changed */
+	unsigned long long generation = cacheGeneration.Current();
+	if (generation != fingerprintGeneration) {
+		fingerprints.clear();
+		fingerprintGeneration = generation;
+	}
+
+	auto it = fingerprints.find(path);
+	if (it != fingerprints.end())
+		return it->second;
+
+	uint64_t fingerprint = DriverFingerprint(path.c_str());
+	fingerprints[path] = fingerprint;
+	return fingerprint;
+}
+
+static void LoadCapsCache()
+{
+	capsLoaded = true;
+
+	HANDLE file = CreateFileW(capsFile.c_str(), GENERIC_READ,
+				  FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0,
+				  nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0 &&
+	    size.QuadPart < 64 * 1024 * 1024) {
+		HANDLE mapping = CreateFileMappingW(file, nullptr,
+						    PAGE_READONLY, 0, 0,
+						    nullptr);
+		if (mapping) {
+			void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0,
+						   0, 0);
+			if (view) {
+				if (!capsCache.Load((const uint8_t *)view,
+						    (size_t)size.QuadPart))
+					Info(L"Discarding invalid caps cache "
+					     L"'%s'",
+					     capsFile.c_str());
+				UnmapViewOfFile(view);
+			}
+			CloseHandle(mapping);
+		}
+	}
+
+	CloseHandle(file);
+}
+
+/* called with capsMutex held; false if there's no usable cache/key */
+static bool PrepareCaps(const std::wstring &path, uint64_t &fingerprint)
+{
+	if (capsFile.empty() || path.empty())
+		return false;
+	if (!capsLoaded)
+		LoadCapsCache();
+
+	fingerprint = GetFingerprint(path);
+	return fingerprint != 0;
+}
+
+void SetCapsCacheFile(const wchar_t *path)
+{
+	std::lock_guard<std::mutex> lock(capsMutex);
+
+	capsFile = path ? path : L"";
+	capsCache.Clear();
+	capsLoaded = false;
+	capsDirty = false;
+}
+
+bool LookupVideoCaps(VideoDevice &device)
+{
+	std::lock_guard<std::mutex> lock(capsMutex);
+	uint64_t fingerprint;
+
+	if (!PrepareCaps(device.path, fingerprint))
+		return false;
+
+	const CapsCacheEntry *entry =
+		capsCache.FindVideo(device.path, fingerprint);
+	if (!entry)
+		return false;
+
+	device.caps = entry->videoCaps;
+	device.audioAttached = entry->audioAttached;
+	device.separateAudioFilter = entry->separateAudioFilter;
+	device.capsPending = false;
+	return true;
+}
+
+bool LookupAudioCaps(AudioDevice &device)
+{
+	std::lock_guard<std::mutex> lock(capsMutex);
+	uint64_t fingerprint;
+
+	if (!PrepareCaps(device.path, fingerprint))
+		return false;
+
+	const CapsCacheEntry *entry =
+		capsCache.FindAudio(device.path, fingerprint);
+	if (!entry)
+		return false;
+
+	device.caps = entry->audioCaps;
+	return true;
+}
+
+bool StoreVideoCaps(const VideoDevice &device)
+{
+	std::lock_guard<std::mutex> lock(capsMutex);
+	CapsCacheEntry entry;
+
+	if (!PrepareCaps(device.path, entry.fingerprint))
+		return false;
+
+	entry.audioAttached = device.audioAttached;
+	entry.separateAudioFilter = device.separateAudioFilter;
+	entry.videoCaps = device.caps;
+
+	if (!capsCache.SetVideo(device.path, entry))
+		return false;
+
+	capsDirty = true;
+	return true;
+}
+
+bool StoreAudioCaps(const AudioDevice &device)
+{
+	std::lock_guard<std::mutex> lock(capsMutex);
+	CapsCacheEntry entry;
+
+	if (!PrepareCaps(device.path, entry.fingerprint))
+		return false;
+
+	entry.audioCaps = device.caps;
+
+	if (!capsCache.SetAudio(device.path, entry))
+		return false;
+
+	capsDirty = true;
+	return true;
+}
+
+bool TakeCapsRevalidation(const std::wstring &path)
+{
+	std::lock_guard<std::mutex> lock(capsMutex);
+	return revalidated.insert(path).second;
+}
+
+/* unlike caps, known configs are kept in memory without a file too */
+static uint64_t PrepareConfig(const std::wstring &path)
+{
+	if (!capsFile.empty() && !capsLoaded)
+		LoadCapsCache();
+
+	return GetFingerprint(path);
+}
+
+bool LookupKnownConfig(const std::wstring &path, const std::wstring &mode,
+		       VideoConfig &config)
+{
+	std::lock_guard<std::mutex> lock(capsMutex);
+
+	if (path.empty())
+		return false;
+
+	const KnownConfigEntry *entry =
+		capsCache.FindConfig(path, mode, PrepareConfig(path));
+	if (!entry)
+		return false;
+
+	config.cx = entry->cx;
+	config.cy_abs = entry->cy_abs;
+	config.cy_flip = entry->cy_flip;
+	config.frameInterval = entry->frameInterval;
+	config.internalFormat = entry->internalFormat;
+	config.format = entry->format;
+	config.useDefaultConfig = entry->useDefaultConfig;
+	return true;
+}
+
+bool StoreKnownConfig(const std::wstring &path, const std::wstring &mode,
+		      const VideoConfig &config)
+{
+	std::lock_guard<std::mutex> lock(capsMutex);
+	KnownConfigEntry entry;
+
+	if (path.empty())
+		return false;
+
+	entry.fingerprint = PrepareConfig(path);
+	entry.cx = config.cx;
+	entry.cy_abs = config.cy_abs;
+	entry.cy_flip = config.cy_flip;
+	entry.frameInterval = config.frameInterval;
+	entry.internalFormat = config.internalFormat;
+	entry.format = config.format;
+	entry.useDefaultConfig = config.useDefaultConfig;
+
+	if (!capsCache.SetConfig(path, mode, entry))
+		return false;
+
+	capsDirty = true;
+	return true;
+}
+
+bool ForgetKnownConfig(const std::wstring &path, const std::wstring &mode)
+{
+	std::lock_guard<std::mutex> lock(capsMutex);
+
+	if (!capsFile.empty() && !capsLoaded)
+		LoadCapsCache();
+	if (!capsCache.RemoveConfig(path, mode))
+		return false;
+
+	capsDirty = true;
+	return true;
+}
+
+/* the cache is serialized under capsMutex, but written without it so that
+ * lookups don't wait on the disk.  flushMutex keeps flushes in order, so
+ * the file always ends up with the latest contents */
+void FlushCapsCache()
+{
+	std::lock_guard<std::mutex> flushLock(flushMutex);
+	std::vector<uint8_t> data;
+	std::wstring path;
+	DWORD written = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(capsMutex);
+
+		if (!capsDirty || capsFile.empty())
+			return;
+
+		capsCache.Save(data);
+		path = capsFile;
+		capsDirty = false;
+	}
+
+	/* written aside and moved over the old file, so that a process
+	 * reading it never sees it half written */
+	std::wstring temp = path + L".tmp";
+	HANDLE file = CreateFileW(temp.c_str(), GENERIC_WRITE, 0, nullptr,
+				  CREATE_ALWAYS, 0, nullptr);
+	BOOL success = file != INVALID_HANDLE_VALUE;
+
+	if (success) {
+		success = WriteFile(file, data.data(), (DWORD)data.size(),
+				    &written, nullptr) &&
+			  written == data.size();
+		CloseHandle(file);
+
+		success = success &&
+			  MoveFileExW(temp.c_str(), path.c_str(),
+				      MOVEFILE_REPLACE_EXISTING);
+		if (!success)
+			DeleteFileW(temp.c_str());
+	}
+
+	if (!success) {
+		Warning(L"Could not write caps cache '%s'", path.c_str());
+
+		/* try again on the next flush, unless the file changed */
+		std::lock_guard<std::mutex> lock(capsMutex);
+		if (capsFile == path)
+			capsDirty = true;
+	}
+}
+
+}; /* namespace DShow */
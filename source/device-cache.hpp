@@ -0,0 +1,62 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+#include "device-snapshot.hpp"
+
+#include <string>
+#include <vector>
+
+namespace DShow {
+
+/* process-wide device lists, shared by every caller */
+bool GetCachedVideoDevices(std::vector<VideoDevice> &devices, int maxAgeMs);
+bool GetCachedAudioDevices(std::vector<AudioDevice> &devices, int maxAgeMs);
+void InvalidateDeviceCache();
+
+/*
+ * On-disk caps cache (see CapsCache), keyed by device path and a
+ * fingerprint of the device's driver.  Does nothing until a file is set.
+ * Lookups fill in caps from the cache; each device is also handed out
+ * once per process by TakeCapsRevalidation, to check cached caps against
+ * the driver in the background.  Store returns whether the entry changed.
+ */
+void SetCapsCacheFile(const wchar_t *path);
+bool LookupVideoCaps(VideoDevice &device);
+bool LookupAudioCaps(AudioDevice &device);
+bool StoreVideoCaps(const VideoDevice &device);
+bool StoreAudioCaps(const AudioDevice &device);
+bool TakeCapsRevalidation(const std::wstring &path);
+void FlushCapsCache();
+
+/*
+ * Known-good configurations, keyed by device path and mode.  Kept in the
+ * same cache (and file, if set), but also work without a file.  Store
+ * and Forget return whether anything changed, FlushCapsCache writes it.
+ */
+bool LookupKnownConfig(const std::wstring &path, const std::wstring &mode,
+		       VideoConfig &config);
+bool StoreKnownConfig(const std::wstring &path, const std::wstring &mode,
+		      const VideoConfig &config);
+bool ForgetKnownConfig(const std::wstring &path, const std::wstring &mode);
+
+}; /* namespace DShow */
@@ -0,0 +1,170 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace DShow {
+
+/*
+ * The rules the device lookups in dshow-base.cpp use to pick an entry out
+ * of an enumerated category (MonikerIndex::Entry), kept apart from the
+ * monikers so they can be checked with stand-in entries.  Entries need
+ * name, path and hasPath, plus mediumsRead and mediums for the medium
+ * lookup; binding and anything else touching the system goes through the
+ * callables passed in.
+ */
+
+static inline bool IsDecklinkName(const std::wstring &name)
+{
+	return name.find(L"Decklink") != std::wstring::npos;
+}
+
+template<typename Entry>
+bool HasDecklinkEntry(const std::vector<Entry> &entries)
+{
+	for (const Entry &entry : entries) {
+		if (IsDecklinkName(entry.name))
+			return true;
+	}
+
+	return false;
+}
+
+/* the last device with the name (any name if null or empty), unless one
+ * has the path too, in which case exact is set */
+template<typename Entry>
+Entry *MatchDeviceEntry(std::vector<Entry> &entries, const wchar_t *name,
+			const wchar_t *path, bool skipDecklink, bool &exact)
+{
+	Entry *match = nullptr;
+	exact = false;
+
+	for (Entry &entry : entries) {
+		if (name && *name && entry.name != name)
+			continue;
+		if (skipDecklink && IsDecklinkName(entry.name))
+			continue;
+
+		match = &entry;
+
+		if (path && entry.hasPath && entry.path == path) {
+			exact = true;
+			break;
+		}
+	}
+
+	return match;
+}
+
+/* GetDeviceFilter: an exception filter (the Elgato one, for video) takes
+ * the place of anything but an exact match */
+template<typename Entry, typename Exception, typename Bind>
+bool SelectDeviceEntry(std::vector<Entry> &entries, const wchar_t *name,
+		       const wchar_t *path, bool skipDecklink,
+		       Exception createException, Bind bind)
+{
+	bool exact;
+	Entry *match =
+		MatchDeviceEntry(entries, name, path, skipDecklink, exact);
+
+	if (!exact && createException())
+		return true;
+	if (!match)
+		return false;
+
+	return bind(*match);
+}
+
+template<typename Medium>
+inline bool HasMediumEntry(const std::vector<Medium> &mediums,
+			   const Medium &medium)
+{
+	for (const Medium &curMedium : mediums) {
+		if (memcmp(&medium, &curMedium, sizeof(medium)) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * GetFilterByMedium: each entry is bound once to read its mediums, and
+ * after that only one that has the medium gets bound again.  One that
+ * fails to bind counts as read, so it isn't tried again.  bind(entry,
+ * filter) binds into a local filter, readMediums(filter, mediums) reads
+ * its pins, take(filter) hands the match to the caller.
+ */
+template<typename Filter, typename Entry, typename Medium, typename Bind,
+	 typename ReadMediums, typename Take>
+bool FindMediumEntry(std::vector<Entry> &entries, const Medium &medium,
+		     Bind bind, ReadMediums readMediums, Take take)
+{
+	for (Entry &entry : entries) {
+		Filter filter;
+
+		if (entry.mediumsRead && !HasMediumEntry(entry.mediums, medium))
+			continue;
+
+		if (!bind(entry, filter)) {
+			entry.mediumsRead = true;
+			continue;
+		}
+
+		if (!entry.mediumsRead) {
+			readMediums(filter, entry.mediums);
+			entry.mediumsRead = true;
+		}
+
+		if (HasMediumEntry(entry.mediums, medium)) {
+			take(filter);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * GetDeviceAudioFilterInternal: the first entry of the same device as the
+ * video device that binds, skipping the video device's own entry.
+ * sameDevice(entry) compares instance paths or parents, nameMatches(entry)
+ * checks friendly names when that is asked for.
+ */
+template<typename Entry, typename SameDevice, typename NameMatches,
+	 typename Bind>
+bool FindAudioEntry(std::vector<Entry> &entries, const std::wstring &videoPath,
+		    SameDevice sameDevice, NameMatches nameMatches, Bind bind)
+{
+	for (Entry &entry : entries) {
+		if (entry.hasPath && entry.path == videoPath)
+			continue;
+		if (!sameDevice(entry) || !nameMatches(entry))
+			continue;
+		if (bind(entry))
+			return true;
+	}
+
+	return false;
+}
+
+}; /* namespace DShow */
@@ -0,0 +1,208 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace DShow {
+
+/*
+ * Tracks whether a cached device list is still current.  Notifications of
+ * devices arriving or leaving bump a generation counter; a snapshot is
+ * good while it was taken at the current generation and hasn't outlived
+ * its maximum age.
+ */
+class DeviceSnapshot {
+	bool filled = false;
+	unsigned long long generation = 0;
+	long long time = 0;
+
+public:
+	inline bool Valid(unsigned long long currentGeneration, long long now,
+			  long long maxAge) const
+	{
+		if (!filled || generation != currentGeneration)
+			return false;
+		return maxAge <= 0 || now - time < maxAge;
+	}
+
+	/* takes the generation read before enumerating, so a change that
+	 * arrives during enumeration still invalidates the result */
+	inline void Filled(unsigned long long generation_, long long now)
+	{
+		filled = true;
+		generation = generation_;
+		time = now;
+	}
+
+	inline void Clear() { filled = false; }
+};
+
+/*
+ * Where device arrival/removal notifications come from: the system's in
+ * device-cache.cpp, or simulated ones.  Start is called once, and returns
+ * false if notifications aren't available, in which case only the
+ * maximum age expires snapshots.
+ */
+class DeviceNotifier {
+public:
+	virtual ~DeviceNotifier() {}
+	virtual bool Start(std::function<void()> changed) = 0;
+};
+
+/* the generation shared by a set of device lists.  It owns the notifier
+ * (if any), starts it on first use, and destroys it before the counter
+ * it bumps */
+class DeviceGeneration {
+	std::atomic<unsigned long long> generation;
+	std::once_flag started;
+	std::unique_ptr<DeviceNotifier> notifier;
+
+public:
+	inline explicit DeviceGeneration(DeviceNotifier *notifier_)
+		: generation(0), notifier(notifier_)
+	{
+	}
+
+	inline void Invalidate() { generation++; }
+
+	inline unsigned long long Current()
+	{
+		std::call_once(started, [this]() {
+			if (notifier)
+				notifier->Start([this]() { Invalidate(); });
+		});
+		return generation;
+	}
+};
+
+/*
+ * Reader-writer lock, as std::shared_mutex needs C++17.  Named like the
+ * standard one so that std::lock_guard works for the exclusive side.
+ * Writers that are waiting hold back new readers, so a steady stream of
+ * readers can't starve them.
+ */
+class SharedMutex {
+	std::mutex mutex;
+	std::condition_variable changed;
+	int readers = 0;
+	int writersWaiting = 0;
+	bool writing = false;
+
+public:
+	inline void lock_shared()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [this]() {
+			return !writing && !writersWaiting;
+		});
+		readers++;
+	}
+
+	inline void unlock_shared()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--readers == 0)
+			changed.notify_all();
+	}
+
+	inline void lock()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		writersWaiting++;
+		changed.wait(lock, [this]() { return !writing && !readers; });
+		writersWaiting--;
+		writing = true;
+	}
+
+	inline void unlock()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		writing = false;
+		changed.notify_all();
+	}
+};
+
+class SharedLockGuard {
+	SharedMutex &mutex;
+
+public:
+	inline explicit SharedLockGuard(SharedMutex &mutex_) : mutex(mutex_)
+	{
+		mutex.lock_shared();
+	}
+	inline ~SharedLockGuard() { mutex.unlock_shared(); }
+
+	SharedLockGuard(const SharedLockGuard &) = delete;
+	SharedLockGuard &operator=(const SharedLockGuard &) = delete;
+};
+
+/*
+ * A device list shared by every caller.  While it is fresh, callers copy
+ * it out under a shared lock.  A caller that finds it stale takes the lock
+ * exclusively and checks again before enumerating, so callers that queued
+ * up behind that enumeration use its result rather than start their own.
+ */
+template<typename T> class CachedDeviceList {
+	SharedMutex mutex;
+	DeviceSnapshot snapshot;
+	std::vector<T> cached;
+
+public:
+	/* maxAge is in 100ns units, 0 for no limit */
+	template<typename Enum>
+	bool Get(std::vector<T> &devices, long long maxAge,
+		 DeviceGeneration &generation, Enum enumDevices)
+	{
+		{
+			SharedLockGuard lock(mutex);
+			unsigned long long current = generation.Current();
+
+			if (snapshot.Valid(current, GetHostTime(), maxAge)) {
+				devices = cached;
+				return true;
+			}
+		}
+
+		std::lock_guard<SharedMutex> lock(mutex);
+		unsigned long long current = generation.Current();
+		bool success = true;
+
+		if (!snapshot.Valid(current, GetHostTime(), maxAge)) {
+			success = enumDevices(cached);
+			if (success)
+				snapshot.Filled(current, GetHostTime());
+			else
+				snapshot.Clear();
+		}
+
+		devices = cached;
+		return success;
+	}
+};
+
+}; /* namespace DShow */
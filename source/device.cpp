@@ -21,6 +21,8 @@
 #include "dshow-device-defs.hpp"
 #include "dshow-media-type.hpp"
 #include "dshow-formats.hpp"
+#include "video-convert.hpp"
+#include "encoder-feed.hpp"
 #include "dshow-enum.hpp"
 #include "log.hpp"
 
@@ -36,7 +38,12 @@ extern void SetVendorTonemapperUsage(IBaseFilter *filter, bool enable);
 
 bool SetRocketEnabled(IBaseFilter *encoder, bool enable);
 
-HDevice::HDevice() : initialized(false), active(false) {}
+HDevice::HDevice()
+	: initialized(false),
+	  active(false),
+	  retainedFrames(std::make_shared<FrameRetainCount>())
+{
+}
 
 HDevice::~HDevice()
 {
@@ -89,19 +96,284 @@ bool HDevice::EnsureInactive(const wchar_t *func)
 	return true;
 }
 
+/* encoded devices only have nominal dimensions until the stream's own
+ * parameters are seen */
+void HDevice::UpdateFromBitstream(const BitstreamInfo &info)
+{
+	if (info.width > 0 && info.height > 0 &&
+	    (info.width != videoConfig.cx || info.height != videoConfig.cy_abs)) {
+		Info(L"Encoded video is %dx%d, not %dx%d", info.width,
+		     info.height, videoConfig.cx, videoConfig.cy_abs);
+		videoConfig.cx = info.width;
+		videoConfig.cy_abs = info.height;
+	}
+
+	if (info.frameInterval > 0)
+		videoConfig.frameInterval = info.frameInterval;
+}
+
+class VideoEncoderInput : public EncoderInput {
+	VideoEncoder *encoder;
+
+public:
+	inline VideoEncoderInput(VideoEncoder *encoder_) : encoder(encoder_) {}
+
+	bool GetInputBuffer(EncoderInputBuffer &buffer) override
+	{
+		return encoder->GetInputBuffer(buffer);
+	}
+
+	bool SubmitInputBuffer(long long startTime, long long stopTime) override
+	{
+		return encoder->SubmitInputBuffer(startTime, stopTime);
+	}
+
+	void DiscardInputBuffer() override { encoder->DiscardInputBuffer(); }
+	void CountDroppedInput() override { encoder->CountDroppedInput(); }
+};
+
+/* converts/copies the frame straight into the encoder's input sample, the
+ * only copy the frame goes through */
+void HDevice::SendToEncoder(unsigned char *data, size_t size,
+			    long long startTime, long long stopTime)
+{
+	VideoEncoderInput input(videoConfig.encoder);
+	EncoderFeedFrame frame;
+
+	frame.format = videoConfig.format;
+	frame.cx = videoConfig.cx;
+	frame.cy = videoConfig.cy_abs;
+	frame.bottomUp = (frame.format == VideoFormat::XRGB ||
+			  frame.format == VideoFormat::ARGB) &&
+			 !videoConfig.cy_flip;
+	frame.data = data;
+	frame.size = size;
+	frame.frameSize = VFormatPlaneLayout(frame.format, frame.cx, frame.cy,
+					     frame.offsets, frame.linesize);
+	frame.startTime = startTime;
+	frame.stopTime = stopTime;
+
+	EncoderFeedResult result = FeedEncoder(input, frame);
+	if (result == encoderFeedResult)
+		return;
+
+	if (result == EncoderFeedResult::Sent) {
+		Info(L"Sending frames to the encoder again");
+	} else {
+		EncoderStats stats;
+		videoConfig.encoder->GetStats(stats);
+		Warning(L"Dropping frames for the encoder: %s (%lld dropped "
+			L"so far)",
+			EncoderFeedResultName(result), stats.inputDropped);
+	}
+
+	encoderFeedResult = result;
+}
+
 inline void HDevice::SendToCallback(bool video, unsigned char *data,
 				    size_t size, long long startTime,
-				    long long stopTime, long rotation)
+				    long long stopTime, long rotation,
+				    IMediaSample *sample, bool syntheticTime)
 {
 	if (!size)
 		return;
 
-	if (video)
+	if (video && videoConfig.encoder) {
+		SendToEncoder(data, size, startTime, stopTime);
+		return;
+	}
+
+	bool keyframe = false;
+	if (video && (videoConfig.format == VideoFormat::H264 ||
+		      videoConfig.format == VideoFormat::HEVC)) {
+		BitstreamInfo info;
+		ParseBitstream(videoConfig.format, data, size, info);
+		UpdateFromBitstream(info);
+		keyframe = info.keyframe;
+	}
+
+	if (video && videoConfig.frameCallback) {
+		HVideoFrame *frame = CreateVideoFrame(videoConfig, sample, data,
+						      size, startTime, stopTime,
+						      rotation, syntheticTime,
+						      retainedFrames);
+		frame->keyframe = keyframe;
+		frame->hostTime = videoReceiveTime;
+		frame->presentationTime = videoClock.Map(startTime);
+		videoConfig.frameCallback(videoConfig, VideoFrame(frame));
+	} else if (video) {
+		videoTimeSynthetic = syntheticTime;
 		videoConfig.callback(videoConfig, data, size, startTime,
 				     stopTime, rotation);
-	else
+	} else if (audioConfig.planarCallback &&
+		   AFormatSampleBytes(audioConfig.format)) {
+		SendPlanarAudio(data, size, startTime, stopTime);
+	} else if (audioConfig.batchCallback) {
+		AudioBuffer buffer = {data, size, startTime, stopTime};
+		audioConfig.batchCallback(audioConfig, &buffer, 1);
+	} else if (audioConfig.callback) {
 		audioConfig.callback(audioConfig, data, size, startTime,
 				     stopTime);
+	}
+}
+
+void HDevice::SendPlanarAudio(unsigned char *data, size_t size,
+			      long long startTime, long long stopTime)
+{
+	size_t sampleBytes = AFormatSampleBytes(audioConfig.format);
+	int channels = audioConfig.channels;
+	int outChannels = audioConfig.planarChannels > 0
+				  ? audioConfig.planarChannels
+				  : channels;
+
+	if (!sampleBytes || channels <= 0)
+		return;
+
+	size_t frames = size / (sampleBytes * channels);
+	if (!frames)
+		return;
+
+	if (channels != mixInChannels || outChannels != mixOutChannels) {
+		AudioMixMatrix(channels, outChannels, audioConfig.channelMap,
+			       audioMix);
+		mixIdentity = AudioMixIsIdentity(channels, outChannels,
+						 audioMix);
+		mixInChannels = channels;
+		mixOutChannels = outChannels;
+	}
+
+	audioFloat.resize(frames * channels);
+	audioPlanar.resize(frames * channels);
+	audioPlanes.resize(channels);
+
+	AudioToFloat(audioConfig.format, data, frames * channels,
+		     audioFloat.data());
+
+	for (int c = 0; c < channels; c++)
+		audioPlanes[c] = audioPlanar.data() + frames * c;
+	AudioDeinterleave(audioFloat.data(), frames, channels,
+			  audioPlanes.data());
+
+	if (mixIdentity) {
+		SendPlanarAudio(audioPlanes.data(), channels, frames, startTime,
+				stopTime);
+		return;
+	}
+
+	/* the interleaved buffer is free again, mix into it */
+	audioFloat.resize(frames * outChannels);
+	audioMixPlanes.resize(outChannels);
+	for (int c = 0; c < outChannels; c++)
+		audioMixPlanes[c] = audioFloat.data() + frames * c;
+
+	AudioMixPlanar(audioPlanes.data(), channels, audioMixPlanes.data(),
+		       outChannels, frames, audioMix.data());
+	SendPlanarAudio(audioMixPlanes.data(), outChannels, frames, startTime,
+			stopTime);
+}
+
+void HDevice::SendPlanarAudio(float *const *planes, int channels,
+			      size_t frames, long long startTime,
+			      long long stopTime)
+{
+	int inRate = audioConfig.sampleRate;
+	int outRate = audioConfig.planarSampleRate;
+
+	if (outRate <= 0 || outRate == inRate || inRate <= 0) {
+		audioConfig.planarCallback(audioConfig, planes, channels,
+					   frames, startTime, stopTime);
+		return;
+	}
+
+	if (audioResampler.InputRate() != inRate ||
+	    audioResampler.OutputRate() != outRate ||
+	    audioResampler.Channels() != channels)
+		audioResampler.Reset(inRate, outRate, channels);
+	if (audioConfig.correctDrift && !!videoCapture)
+		audioResampler.SetRatioAdjust(
+			avSync.CorrectionRatio(videoClock));
+
+	/* the filter is centered on the output frame, so the first output
+	 * frame's time follows from its position in the input */
+	long long outStart =
+		startTime + (long long)(audioResampler.NextOutputOffset() *
+					10000000.0 / inRate);
+
+	size_t maxOut = audioResampler.MaxOutputFrames(frames);
+	audioResampled.resize(maxOut * channels);
+	audioResampledPlanes.resize(channels);
+	for (int c = 0; c < channels; c++)
+		audioResampledPlanes[c] = audioResampled.data() + maxOut * c;
+
+	size_t outFrames = audioResampler.Process(
+		planes, frames, audioResampledPlanes.data(), maxOut);
+	if (!outFrames)
+		return;
+
+	long long outStop = outStart + (long long)outFrames * 10000000LL /
+					       outRate;
+	audioConfig.planarCallback(audioConfig, audioResampledPlanes.data(),
+				   channels, outFrames, outStart, outStop);
+
+	DSHOW_UNUSED(stopTime);
+}
+
+inline void HDevice::SendAudioBatch()
+{
+	if (!audioBatch.empty())
+		audioConfig.batchCallback(audioConfig, audioBatch.data(),
+					  audioBatch.size());
+	audioBatch.clear();
+}
+
+void HDevice::SyncAudio(size_t size, long long receiveTime,
+			long long &startTime, long long &stopTime)
+{
+	size_t sampleBytes = AFormatSampleBytes(audioConfig.format);
+	int channels = audioConfig.channels;
+
+	if (!videoCapture || !sampleBytes || channels <= 0)
+		return;
+
+	size_t frames = size / (sampleBytes * channels);
+	long long corrected = avSync.AddAudio(startTime, frames,
+					      audioConfig.sampleRate,
+					      receiveTime, videoClock);
+
+	if (audioConfig.correctTimestamps) {
+		stopTime += corrected - startTime;
+		startTime = corrected;
+	}
+}
+
+const std::wstring &HDevice::AudioDevicePath() const
+{
+	return audioConfig.useVideoDevice ? videoConfig.path
+					  : audioConfig.path;
+}
+
+void HDevice::MonitorAudio(long long receiveTime, long long startTime,
+			   long long stopTime, bool discontinuity)
+{
+	if (!audioMonitor.Update(receiveTime, startTime, stopTime,
+				 discontinuity))
+		return;
+	if (!audioConfig.adaptiveBuffering || !audioBufferingMs)
+		return;
+
+	int bufferingMs = RaiseAdaptiveAudioBuffering(AudioDevicePath(),
+						      audioBufferingMs);
+	if (bufferingMs == audioBufferingMs)
+		return;
+
+	Info(L"Audio glitches detected, raising buffering from %d ms to "
+	     L"%d ms",
+	     audioBufferingMs, bufferingMs);
+
+	if (audioConfig.reactivateCallback) {
+		audioConfig.reactivateCallback();
+		reactivatePending = true;
+	}
 }
 
 void HDevice::Receive(bool isVideo, IMediaSample *sample)
@@ -115,7 +387,10 @@ void HDevice::Receive(bool isVideo, IMediaSample *sample)
 	if (!sample)
 		return;
 
-	if (isVideo ? !videoConfig.callback : !audioConfig.callback)
+	if (isVideo ? !videoConfig.callback && !videoConfig.frameCallback &&
+			      !videoConfig.encoder
+		    : !audioConfig.callback && !audioConfig.batchCallback &&
+			      !audioConfig.planarCallback)
 		return;
 
 	if (reactivatePending)
@@ -163,9 +438,15 @@ void HDevice::Receive(bool isVideo, IMediaSample *sample)
 	if (FAILED(sample->GetPointer(&ptr)))
 		return;
 
+	long long receiveTime = GetHostTime();
 	long long startTime, stopTime;
 	bool hasTime = SUCCEEDED(sample->GetTime(&startTime, &stopTime));
 
+	if (hasTime)
+		(isVideo ? videoClock : audioClock).Update(startTime, receiveTime);
+	if (isVideo)
+		videoReceiveTime = receiveTime;
+
 	if (encoded) {
 		EncodedData &data = isVideo ? encodedVideo : encodedAudio;
 
@@ -185,8 +466,190 @@ void HDevice::Receive(bool isVideo, IMediaSample *sample)
 				  (unsigned char *)ptr + size);
 
 	} else if (hasTime) {
-		SendToCallback(isVideo, ptr, size, startTime, stopTime, roll);
+		if (!isVideo) {
+			MonitorAudio(receiveTime, startTime, stopTime,
+				     sample->IsDiscontinuity() == S_OK);
+			SyncAudio(size, receiveTime, startTime, stopTime);
+		}
+		SendToCallback(isVideo, ptr, size, startTime, stopTime, roll,
+			       sample);
+
+	} else if (isVideo && videoConfig.synthesizeTimestamps) {
+		videoTimestamps.Next(videoConfig.frameInterval, startTime,
+				     stopTime);
+		videoClock.Update(startTime, receiveTime);
+		SendToCallback(isVideo, ptr, size, startTime, stopTime, roll,
+			       sample, true);
+	}
+}
+
+void HDevice::ReceiveTransport(IMediaSample *sample)
+{
+	BYTE *ptr;
+
+	if (reactivatePending)
+		return;
+
+	long size = sample->GetActualDataLength();
+	if (!size)
+		return;
+
+	if (FAILED(sample->GetPointer(&ptr)))
+		return;
+
+	transportReceiveTime = GetHostTime();
+	transportDemuxer.Write(ptr, size);
+}
+
+void HDevice::ReceiveTransportPacket(const TSPacket &packet)
+{
+	bool isVideo = packet.pid == (int)encodedInfo.videoPacketID;
+
+	if (isVideo ? !videoConfig.callback && !videoConfig.frameCallback
+		    : !audioConfig.useVideoDevice ||
+			      (!audioConfig.callback &&
+			       !audioConfig.batchCallback))
+		return;
+
+	/* PES packets without a PTS belong to the previous one's unit */
+	EncodedData &data = isVideo ? encodedVideo : encodedAudio;
+	long long startTime = data.lastStartTime;
+
+	if (packet.hasPts) {
+		/* the origin is the first PTS of either stream, so the other
+		 * stream's first packets can land before it.  those start at
+		 * 0 rather than going negative */
+		if (transportOrigin < 0)
+			transportOrigin = packet.pts;
+		startTime = packet.pts - transportOrigin;
+		if (startTime < 0)
+			startTime = 0;
+
+		(isVideo ? videoClock : audioClock)
+			.Update(startTime, transportReceiveTime);
+	}
+
+	if (isVideo) {
+		videoReceiveTime = transportReceiveTime;
+		data.lastStartTime = startTime;
+		SendToCallback(true, (unsigned char *)packet.data, packet.size,
+			       startTime, startTime + videoConfig.frameInterval,
+			       0);
+		return;
+	}
+
+	/* an audio packet's duration isn't known until the next timestamp
+	 * arrives, so like the segments in Receive it's held until then */
+	if (packet.hasPts) {
+		long long stopTime = startTime > data.lastStartTime
+					     ? startTime
+					     : data.lastStartTime;
+
+		if (!data.bytes.empty())
+			SendToCallback(false, data.bytes.data(),
+				       data.bytes.size(), data.lastStartTime,
+				       stopTime, 0);
+
+		data.bytes.resize(0);
+		data.lastStartTime = startTime;
+	}
+
+	data.bytes.insert(data.bytes.end(), packet.data,
+			  packet.data + packet.size);
+}
+
+void HDevice::ReceiveMultiple(bool isVideo, IMediaSample **samples,
+			      long count)
+{
+	bool encoded = isVideo ? ((int)videoConfig.format >= 400)
+			       : ((int)audioConfig.format >= 200);
+
+	/* only raw audio benefits from batching, everything else is
+	 * handled one sample at a time */
+	if (isVideo || encoded || !audioConfig.batchCallback ||
+	    audioConfig.planarCallback) {
+		for (long i = 0; i < count; i++)
+			Receive(isVideo, samples[i]);
+		return;
+	}
+
+	if (reactivatePending || count <= 0)
+		return;
+
+	/* the whole batch arrived at once, so it gets one host time, which
+	 * measures the end of the last buffer delivered.  that buffer is
+	 * only known once the loop is done, so each buffer's sync is held
+	 * back until the next one is accepted */
+	long long receiveTime = GetHostTime();
+	long long batchStart = 0;
+	long long batchStop = 0;
+	long long lastStart = 0;
+	bool discontinuity = false;
+	bool delivered = false;
+	bool tailPending = false;
+
+	auto syncTail = [&](long long time) {
+		if (!tailPending)
+			return;
+		AudioBuffer &buffer = audioBatch.back();
+		SyncAudio(buffer.size, time, buffer.startTime, buffer.stopTime);
+		tailPending = false;
+	};
+
+	audioBatch.clear();
+
+	for (long i = 0; i < count; i++) {
+		IMediaSample *sample = samples[i];
+		MediaTypePtr mt;
+		BYTE *ptr;
+
+		if (!sample)
+			continue;
+
+		/* a format change can land anywhere in the batch, so the
+		 * buffers ahead of it go out under the old format */
+		if (sample->GetMediaType(&mt) == S_OK) {
+			syncTail(0);
+			SendAudioBatch();
+			audioMediaType = mt;
+			ConvertAudioSettings();
+		}
+
+		long size = sample->GetActualDataLength();
+		if (!size)
+			continue;
+
+		if (FAILED(sample->GetPointer(&ptr)))
+			continue;
+
+		long long startTime, stopTime;
+		if (FAILED(sample->GetTime(&startTime, &stopTime)))
+			continue;
+
+		if (!delivered)
+			batchStart = startTime;
+		batchStop = stopTime;
+		lastStart = startTime;
+		delivered = true;
+
+		if (sample->IsDiscontinuity() == S_OK)
+			discontinuity = true;
+
+		syncTail(0);
+		audioBatch.push_back({(unsigned char *)ptr, (size_t)size,
+				      startTime, stopTime});
+		tailPending = true;
 	}
+
+	syncTail(receiveTime);
+
+	if (delivered) {
+		audioClock.Update(lastStart, receiveTime);
+		MonitorAudio(receiveTime, batchStart, batchStop,
+			     discontinuity);
+	}
+
+	SendAudioBatch();
 }
 
 void HDevice::ConvertVideoSettings()
@@ -226,12 +689,8 @@ void HDevice::ConvertAudioSettings()
 		audioConfig.format = AudioFormat::AC3;
 	else if (wfex->wFormatTag == WAVE_FORMAT_MPEG)
 		audioConfig.format = AudioFormat::MPGA;
-	else if (wfex->wBitsPerSample == 16)
-		audioConfig.format = AudioFormat::Wave16bit;
-	else if (wfex->wBitsPerSample == 32)
-		audioConfig.format = AudioFormat::WaveFloat;
 	else
-		audioConfig.format = AudioFormat::Unknown;
+		audioConfig.format = GetWaveFormatAFormat(wfex);
 }
 
 #define HD_PVR1_NAME L"Hauppauge HD PVR Capture"
@@ -345,6 +804,7 @@ bool HDevice::SetupVideoCapture(IBaseFilter *filter, VideoConfig &config)
 	PinCaptureInfo info;
 	info.callback = [this](IMediaSample *s) { Receive(true, s); };
 	info.expectedMajorType = videoMediaType->majortype;
+	info.bufferCount = videoConfig.bufferCount;
 
 	/* attempt to force intermediary filters for these types */
 	if (videoConfig.format == VideoFormat::XRGB)
@@ -383,6 +843,7 @@ bool HDevice::SetVideoConfig(VideoConfig *config)
 	graph->RemoveFilter(videoCapture);
 	videoFilter.Release();
 	videoCapture.Release();
+	softwareDemux = false;
 
 	if (!config)
 		return true;
@@ -392,9 +853,13 @@ bool HDevice::SetVideoConfig(VideoConfig *config)
 		return false;
 	}
 
+	/* starts a new graph build, devices may have changed since */
+	monikers.Clear();
+
 	bool success = GetDeviceFilter(CLSID_VideoInputDeviceCategory,
 				       config->name.c_str(),
-				       config->path.c_str(), &filter);
+				       config->path.c_str(), &filter,
+				       &monikers);
 	if (!success) {
 		Error(L"Video device '%s': %s not found", config->name.c_str(),
 		      config->path.c_str());
@@ -418,15 +883,66 @@ bool HDevice::SetVideoConfig(VideoConfig *config)
 		deviceHdrSignal = hdr;
 	}
 
+	if (config->encoder) {
+		VideoEncoderConfig encoderConfig;
+
+		if (!config->encoder->GetConfig(encoderConfig) ||
+		    !encoderConfig.packetCallback) {
+			Error(L"Video encoder is not configured or has no "
+			      L"packet callback");
+			return false;
+		}
+		if (config->format != VideoFormat::Any &&
+		    !VFormatConvertsToYV12(config->format)) {
+			Error(L"Video format %d can't be sent to the encoder",
+			      (int)config->format);
+			return false;
+		}
+
+		encoderFeedResult = EncoderFeedResult::Sent;
+	}
+
 	videoConfig = *config;
 
 	if (!SetupVideoCapture(filter, videoConfig))
 		return false;
 
+	/* Any (or a size left to the device) is only resolved now, and may
+	 * have picked something the encoder can't take, such as MJPEG */
+	if (config->encoder && !CheckEncoderInput(videoConfig)) {
+		graph->RemoveFilter(videoFilter);
+		graph->RemoveFilter(videoCapture);
+		videoFilter.Release();
+		videoCapture.Release();
+		return false;
+	}
+
 	*config = videoConfig;
 	return true;
 }
 
+bool HDevice::CheckEncoderInput(const VideoConfig &config)
+{
+	VideoEncoderConfig encoderConfig;
+	config.encoder->GetConfig(encoderConfig);
+
+	if (!VFormatConvertsToYV12(config.format, config.cx, config.cy_abs)) {
+		Error(L"Device chose video format %d at %dx%d, which can't be "
+		      L"sent to the encoder",
+		      (int)config.format, config.cx, config.cy_abs);
+		return false;
+	}
+	if (config.cx != encoderConfig.cx || config.cy_abs != encoderConfig.cy) {
+		Error(L"Device chose %dx%d, but the encoder is set up for "
+		      L"%dx%d",
+		      config.cx, config.cy_abs, encoderConfig.cx,
+		      encoderConfig.cy);
+		return false;
+	}
+
+	return true;
+}
+
 bool HDevice::SetupExceptionAudioCapture(IPin *pin)
 {
 	ComPtr<IEnumMediaTypes> enumMediaTypes;
@@ -483,7 +999,8 @@ bool HDevice::SetupAudioCapture(IBaseFilter *filter, AudioConfig &config)
 		MediaTypePtr defaultMT;
 
 		if (pinConfig && SUCCEEDED(pinConfig->GetFormat(&defaultMT))) {
-			if (is24BitAudio(defaultMT)) {
+			/* 24-bit is only kept if we convert it ourselves */
+			if (is24BitAudio(defaultMT) && !config.planarCallback) {
 				WAVEFORMATEX *wfex =
 					(WAVEFORMATEX *)defaultMT->pbFormat;
 				config.sampleRate = wfex->nSamplesPerSec;
@@ -522,10 +1039,16 @@ bool HDevice::SetupAudioCapture(IBaseFilter *filter, AudioConfig &config)
 
 	PinCaptureInfo info;
 	info.callback = [this](IMediaSample *s) { Receive(false, s); };
+	info.batchCallback = [this](IMediaSample **s, long n) {
+		ReceiveMultiple(false, s, n);
+	};
 	info.expectedMajorType = audioMediaType->majortype;
 	info.expectedSubType = audioMediaType->subtype;
+	info.bufferCount = audioConfig.bufferCount;
 
 	audioCapture = new CaptureFilter(info);
+	mixInChannels = -1;
+	audioResampler.Reset(0, 0, 0);
 	audioFilter = filter;
 	audioConfig = config;
 
@@ -563,6 +1086,20 @@ bool HDevice::SetupAudioOutput(IBaseFilter *filter, AudioConfig &config)
 	return true;
 }
 
+/* only PCM converts to planar float, compressed audio (AAC/AC3 from encoded
+ * devices) goes to callback/batchCallback instead */
+static bool CheckPlanarAudio(const AudioConfig &config)
+{
+	if (!config.planarCallback || AFormatSampleBytes(config.format) ||
+	    config.callback || config.batchCallback)
+		return true;
+
+	Error(L"Audio format %d is compressed and can't be delivered as "
+	      L"planar float without a callback or batchCallback",
+	      (int)config.format);
+	return false;
+}
+
 bool HDevice::SetAudioConfig(AudioConfig *config)
 {
 	ComPtr<IBaseFilter> filter;
@@ -596,10 +1133,20 @@ bool HDevice::SetAudioConfig(AudioConfig *config)
 			return false;
 		}
 
+		/* the audio comes out of our own demuxer */
+		if (softwareDemux) {
+			audioConfig = *config;
+			audioConfig.sampleRate = encodedInfo.samplesPerSec;
+			audioConfig.channels = 2;
+			audioConfig.format = encodedInfo.audioFormat;
+			*config = audioConfig;
+			return CheckPlanarAudio(audioConfig);
+		}
+
 		filter = videoFilter;
 	} else if (config->useSeparateAudioFilter) {
-		bool success =
-			GetDeviceAudioFilter(videoConfig.path.c_str(), &filter);
+		bool success = GetDeviceAudioFilter(videoConfig.path.c_str(),
+						    &filter, &monikers);
 		if (!success) {
 			Error(L"Corresponding audio device for '%s' not found",
 			      videoConfig.path.c_str());
@@ -609,7 +1156,8 @@ bool HDevice::SetAudioConfig(AudioConfig *config)
 	} else {
 		bool success = GetDeviceFilter(CLSID_AudioInputDeviceCategory,
 					       config->name.c_str(),
-					       config->path.c_str(), &filter);
+					       config->path.c_str(), &filter,
+					       &monikers);
 		if (!success) {
 			Error(L"Audio device '%s': %s not found",
 			      config->name.c_str(), config->path.c_str());
@@ -627,7 +1175,7 @@ bool HDevice::SetAudioConfig(AudioConfig *config)
 			return false;
 
 		*config = audioConfig;
-		return true;
+		return CheckPlanarAudio(audioConfig);
 	}
 
 	return SetupAudioOutput(filter, audioConfig);
@@ -662,7 +1210,8 @@ bool HDevice::FindCrossbar(IBaseFilter *filter, IBaseFilter **crossbar)
 		return false;
 	if (!GetPinMedium(pin, medium))
 		return false;
-	if (!GetFilterByMedium(AM_KSCATEGORY_CROSSBAR, medium, crossbar))
+	if (!GetFilterByMedium(AM_KSCATEGORY_CROSSBAR, medium, crossbar,
+			       &monikers))
 		return false;
 
 	graph->AddFilter(*crossbar, L"Crossbar Filter");
@@ -774,7 +1323,8 @@ bool HDevice::ConnectFilters()
 	    !EnsureInactive(L"ConnectFilters"))
 		return false;
 
-	if (videoCapture != NULL) {
+	/* transport capture is connected when it's set up */
+	if (videoCapture != NULL && !softwareDemux) {
 		/* use hardware tonemapper for narrow format (SDR), not wide (HDR) */
 		const bool enable_tonemapper = videoConfig.format !=
 					       VideoFormat::P010;
@@ -801,8 +1351,18 @@ bool HDevice::ConnectFilters()
 				    (videoConfig.name.find(L"Stream Engine") !=
 				     std::string::npos);
 
-		if (!streamEngine && audioCapture != nullptr)
-			SetAudioBuffering(10);
+		audioBufferingMs = 0;
+		if (!streamEngine && audioCapture != nullptr) {
+			int bufferingMs =
+				audioConfig.adaptiveBuffering
+					? GetAdaptiveAudioBuffering(
+						  AudioDevicePath())
+					: audioConfig.bufferingMs;
+			if (bufferingMs > 0) {
+				SetAudioBuffering(bufferingMs);
+				audioBufferingMs = bufferingMs;
+			}
+		}
 
 		success = ConnectPins(PIN_CATEGORY_CAPTURE, MEDIATYPE_Audio,
 				      audioFilter, filter);
@@ -816,6 +1376,8 @@ bool HDevice::ConnectFilters()
 	if (success)
 		LogFilters(graph);
 
+	/* the graph is built, don't hang on to the device list */
+	monikers.Clear();
 	return success;
 }
 
@@ -848,6 +1410,15 @@ Result HDevice::Start()
 	if (!!rocketEncoder)
 		Sleep(ROCKET_WAIT_TIME_MS);
 
+	videoTimestamps.Reset();
+	videoClock.Reset();
+	audioClock.Reset();
+	avSync.Reset();
+	audioMonitor.Reset();
+	transportDemuxer.Reset();
+	transportOrigin = -1;
+	encodedVideo = EncodedData();
+	encodedAudio = EncodedData();
 	hr = control->Run();
 
 	if (FAILED(hr)) {
@@ -21,6 +21,15 @@
 
 #include "../dshowcapture.hpp"
 #include "capture-filter.hpp"
+#include "video-frame.hpp"
+#include "dshow-clock.hpp"
+#include "audio-convert.hpp"
+#include "audio-resampler.hpp"
+#include "av-sync.hpp"
+#include "audio-buffering.hpp"
+#include "ts-demux.hpp"
+#include "bitstream.hpp"
+#include "encoder-feed.hpp"
 
 #include <string>
 #include <vector>
@@ -63,6 +72,13 @@ struct HDevice {
 	AudioConfig audioConfig;
 
 	bool encodedDevice = false;
+	bool softwareDemux = false;
+
+	/* device monikers, shared by the lookups of a graph build */
+	MonikerIndex monikers;
+
+	/* last SendToEncoder result, so each kind of drop is logged once */
+	EncoderFeedResult encoderFeedResult = EncoderFeedResult::Sent;
 	bool rotatableDevice = false;
 	bool deviceHdrSignal = false;
 	bool reactivatePending = false;
@@ -72,6 +88,35 @@ struct HDevice {
 	EncodedData encodedVideo;
 	EncodedData encodedAudio;
 
+	std::shared_ptr<FrameRetainCount> retainedFrames;
+	vector<AudioBuffer> audioBatch;
+
+	vector<float> audioFloat;
+	vector<float> audioPlanar;
+	vector<float *> audioPlanes;
+	vector<float *> audioMixPlanes;
+	vector<float> audioMix;
+	int mixInChannels = -1;
+	int mixOutChannels = -1;
+	bool mixIdentity = true;
+
+	AudioResampler audioResampler;
+	vector<float> audioResampled;
+	vector<float *> audioResampledPlanes;
+	TimestampSynthesizer videoTimestamps;
+	ClockMapper videoClock;
+	ClockMapper audioClock;
+	AVSync avSync;
+	AudioBufferMonitor audioMonitor;
+	int audioBufferingMs = 0;
+	long long videoReceiveTime = 0;
+	bool videoTimeSynthetic = false;
+
+	EncodedDevice encodedInfo = {};
+	TSDemuxer transportDemuxer;
+	long long transportOrigin = -1;
+	long long transportReceiveTime = 0;
+
 	HDevice();
 	~HDevice();
 
@@ -84,12 +129,32 @@ struct HDevice {
 
 	inline void SendToCallback(bool video, unsigned char *data, size_t size,
 				   long long startTime, long long stopTime,
-				   long rotation);
+				   long rotation, IMediaSample *sample = nullptr,
+				   bool syntheticTime = false);
 
+	void UpdateFromBitstream(const BitstreamInfo &info);
+	void SendToEncoder(unsigned char *data, size_t size,
+			   long long startTime, long long stopTime);
+	bool CheckEncoderInput(const VideoConfig &config);
 	void Receive(bool video, IMediaSample *sample);
+	void ReceiveMultiple(bool video, IMediaSample **samples, long count);
+	void SendAudioBatch();
+	void ReceiveTransport(IMediaSample *sample);
+	void ReceiveTransportPacket(const TSPacket &packet);
+	void SyncAudio(size_t size, long long receiveTime, long long &startTime,
+		       long long &stopTime);
+	void MonitorAudio(long long receiveTime, long long startTime,
+			  long long stopTime, bool discontinuity);
+	const std::wstring &AudioDevicePath() const;
+	void SendPlanarAudio(unsigned char *data, size_t size,
+			     long long startTime, long long stopTime);
+	void SendPlanarAudio(float *const *planes, int channels, size_t frames,
+			     long long startTime, long long stopTime);
 
 	bool SetupEncodedVideoCapture(IBaseFilter *filter, VideoConfig &config,
 				      const EncodedDevice &info);
+	bool SetupTransportCapture(IBaseFilter *filter, VideoConfig &config,
+				   const EncodedDevice &info);
 
 	bool SetupExceptionVideoCapture(IBaseFilter *filter,
 					VideoConfig &config);
@@ -19,6 +19,7 @@
 
 #include "dshow-base.hpp"
 #include "dshow-enum.hpp"
+#include "device-match.hpp"
 #include "log.hpp"
 
 #include <bdaiface.h>
@@ -101,44 +102,37 @@ void LogFilters(IGraphBuilder *graph)
 	}
 }
 
-struct DeviceFilterCallbackInfo {
-	ComPtr<IBaseFilter> filter;
-	const wchar_t *name;
-	const wchar_t *path;
-};
-
-static bool GetDeviceCallback(DeviceFilterCallbackInfo &info,
-			      IBaseFilter *filter, const wchar_t *name,
-			      const wchar_t *path)
+static bool BindEntry(MonikerIndex::Entry &entry, IBaseFilter **filter)
 {
-	if (info.name && *info.name && wcscmp(name, info.name) != 0)
-		return true;
-
-	info.filter = filter;
-
-	/* continue if path does not match */
-	if (!path || !info.path || wcscmp(path, info.path) != 0)
-		return true;
-
-	return false;
+	HRESULT hr = entry.moniker->BindToObject(nullptr, nullptr,
+						 IID_IBaseFilter,
+						 (void **)filter);
+	return SUCCEEDED(hr);
 }
 
 bool GetDeviceFilter(const IID &type, const wchar_t *name, const wchar_t *path,
-		     IBaseFilter **out)
+		     IBaseFilter **out, MonikerIndex *index)
 {
-	DeviceFilterCallbackInfo info;
-	info.name = name;
-	info.path = path;
+	MonikerIndex localIndex;
 
-	if (!EnumDevices(type, EnumDeviceCallback(GetDeviceCallback), &info))
-		return false;
+	if (!index)
+		index = &localIndex;
 
-	if (info.filter != NULL) {
-		*out = info.filter.Detach();
-		return true;
-	}
+	/* see the decklink workaround in EnumDevice */
+	bool skipDecklink = type == CLSID_AudioInputDeviceCategory &&
+			    !HasDecklinkEntry(index->Entries(
+				    CLSID_VideoInputDeviceCategory));
+	bool video = type == CLSID_VideoInputDeviceCategory;
 
-	return false;
+	auto createException = [&]() {
+		return video && CreateExceptionVideoFilter(name, out);
+	};
+
+	return SelectDeviceEntry(index->Entries(type), name, path, skipDecklink,
+				 createException,
+				 [out](MonikerIndex::Entry &entry) {
+					 return BindEntry(entry, out);
+				 });
 }
 
 /* checks to see if a pin's config caps have a specific media type */
@@ -332,62 +326,46 @@ bool GetPinByMedium(IBaseFilter *filter, REGPINMEDIUM &medium, IPin **pin)
 	return false;
 }
 
-static bool GetFilterByMediumFromMoniker(IMoniker *moniker,
-					 REGPINMEDIUM &medium,
-					 IBaseFilter **filter)
+static void ReadPinMediums(IBaseFilter *filter, vector<REGPINMEDIUM> &mediums)
 {
-	ComPtr<IBaseFilter> curFilter;
-	HRESULT hr;
+	ComPtr<IPin> curPin;
+	ComPtr<IEnumPins> pinsEnum;
+	ULONG num;
 
-	hr = moniker->BindToObject(nullptr, nullptr, IID_IBaseFilter,
-				   (void **)&curFilter);
-	if (SUCCEEDED(hr)) {
-		ComPtr<IPin> pin;
-		if (GetPinByMedium(curFilter, medium, &pin)) {
-			*filter = curFilter.Detach();
-			return true;
-		}
-	} else {
-		WarningHR(L"GetFilterByMediumFromMoniker: BindToObject failed",
-			  hr);
-	}
+	if (FAILED(filter->EnumPins(&pinsEnum)))
+		return;
 
-	return false;
+	while (pinsEnum->Next(1, &curPin, &num) == S_OK) {
+		REGPINMEDIUM curMedium;
+		if (GetPinMedium(curPin, curMedium))
+			mediums.push_back(curMedium);
+	}
 }
 
 bool GetFilterByMedium(const CLSID &id, REGPINMEDIUM &medium,
-		       IBaseFilter **filter)
+		       IBaseFilter **filter, MonikerIndex *index)
 {
-	ComPtr<ICreateDevEnum> deviceEnum;
-	ComPtr<IEnumMoniker> enumMoniker;
-	ComPtr<IMoniker> moniker;
-	DWORD count = 0;
-	HRESULT hr;
+	MonikerIndex localIndex;
 
-	hr = CoCreateInstance(CLSID_SystemDeviceEnum, nullptr,
-			      CLSCTX_INPROC_SERVER, IID_ICreateDevEnum,
-			      (void **)&deviceEnum);
-	if (FAILED(hr)) {
-		WarningHR(L"GetFilterByMedium: Failed to create device enum",
-			  hr);
-		return false;
-	}
+	if (!index)
+		index = &localIndex;
 
-	hr = deviceEnum->CreateClassEnumerator(id, &enumMoniker, 0);
-	if (hr != S_OK) {
-		WarningHR(L"GetFilterByMedium: Failed to create enum moniker",
-			  hr);
-		return false;
-	}
-
-	enumMoniker->Reset();
-
-	while (enumMoniker->Next(1, &moniker, &count) == S_OK) {
-		if (GetFilterByMediumFromMoniker(moniker, medium, filter))
-			return true;
-	}
+	auto bind = [](MonikerIndex::Entry &entry,
+		       ComPtr<IBaseFilter> &curFilter) {
+		HRESULT hr = entry.moniker->BindToObject(nullptr, nullptr,
+							 IID_IBaseFilter,
+							 (void **)&curFilter);
+		if (FAILED(hr))
+			WarningHR(L"GetFilterByMedium: BindToObject failed",
+				  hr);
+		return SUCCEEDED(hr);
+	};
 
-	return false;
+	return FindMediumEntry<ComPtr<IBaseFilter>>(
+		index->Entries(id), medium, bind,
+		ReadPinMediums, [filter](ComPtr<IBaseFilter> &curFilter) {
+			*filter = curFilter.Detach();
+		});
 }
 
 bool GetPinMedium(IPin *pin, REGPINMEDIUM &medium)
@@ -645,31 +623,6 @@ GetAudioCaptureParentDeviceInstancePath(IMoniker *audioCapture,
 	return hr;
 }
 
-static bool IsMonikerSameParentInstPath(IMoniker *moniker,
-					const wchar_t *vidDevInstPath)
-{
-	/* Get video parent device instance path */
-	wchar_t vidParentDevInstPath[512];
-	HRESULT hr = GetParentDeviceInstancePath(
-		vidDevInstPath, vidParentDevInstPath,
-		_ARRAYSIZE(vidParentDevInstPath));
-
-	if (FAILED(hr))
-		return false;
-
-	/* Get audio parent device instance path */
-	wchar_t audParentDevInstPath[512];
-	hr = GetAudioCaptureParentDeviceInstancePath(
-		moniker, audParentDevInstPath,
-		_ARRAYSIZE(audParentDevInstPath));
-
-	if (FAILED(hr))
-		return false;
-
-	/* Compare audio and video parent device instance path */
-	return wcscmp(audParentDevInstPath, vidParentDevInstPath) == 0;
-}
-
 #define VEN_ID_SIZE 4
 
 static inline bool MatchingStartToken(const wstring &path,
@@ -800,60 +753,6 @@ static HRESULT ReadProperty(IMoniker *moniker, const wchar_t *property,
 	return hr;
 }
 
-static HRESULT GetFriendlyName(REFCLSID deviceClass, const wchar_t *devPath,
-			       wchar_t *name, int nameSize)
-{
-	/* Sanity checks */
-	if (!devPath)
-		return E_POINTER;
-	if (!name)
-		return E_POINTER;
-
-	/* Create device enumerator */
-	ComPtr<ICreateDevEnum> createDevEnum;
-	HRESULT hr = CoCreateInstance(CLSID_SystemDeviceEnum, NULL,
-				      CLSCTX_INPROC_SERVER, IID_ICreateDevEnum,
-				      (void **)&createDevEnum);
-
-	/* Enumerate filters */
-	ComPtr<IEnumMoniker> enumMoniker;
-	if (SUCCEEDED(hr)) {
-		/* returns S_FALSE if no devices are installed */
-		hr = createDevEnum->CreateClassEnumerator(deviceClass,
-							  &enumMoniker, 0);
-		if (!enumMoniker)
-			hr = E_FAIL;
-	}
-
-	/* Cycle through the enumeration */
-	if (SUCCEEDED(hr)) {
-		ULONG fetched = 0;
-		ComPtr<IMoniker> moniker;
-
-		enumMoniker->Reset();
-
-		while (enumMoniker->Next(1, &moniker, &fetched) == S_OK) {
-
-			/* Get device path from moniker */
-			wchar_t monikerDevPath[512];
-			hr = ReadProperty(moniker, L"DevicePath",
-					  monikerDevPath,
-					  _ARRAYSIZE(monikerDevPath));
-
-			/* Find desired filter */
-			if (wcscmp(devPath, monikerDevPath) == 0) {
-
-				/* Get friendly name */
-				hr = ReadProperty(moniker, L"FriendlyName",
-						  name, nameSize);
-				return hr;
-			}
-		}
-	}
-
-	return E_FAIL;
-}
-
 static bool MatchFriendlyNames(const wchar_t *vidName, const wchar_t *audName)
 {
 	/* Sanity checks */
@@ -897,9 +796,112 @@ static bool MatchFriendlyNames(const wchar_t *vidName, const wchar_t *audName)
 	return strVidName == strAudName;
 }
 
+/* ------------------------------------------------------------------------- */
+
+static bool ReadProperty(IMoniker *moniker, const wchar_t *property,
+			 wstring &value)
+{
+	wchar_t buffer[512];
+
+	if (FAILED(ReadProperty(moniker, property, buffer, _ARRAYSIZE(buffer))))
+		return false;
+
+	value = buffer;
+	return true;
+}
+
+MonikerIndex::Category &MonikerIndex::GetCategory(const GUID &type)
+{
+	for (Category &category : categories) {
+		if (category.type == type)
+			return category;
+	}
+
+	categories.emplace_back();
+	Category &category = categories.back();
+	category.type = type;
+
+	ComPtr<ICreateDevEnum> deviceEnum;
+	ComPtr<IEnumMoniker> enumMoniker;
+	ComPtr<IMoniker> moniker;
+	DWORD count = 0;
+
+	HRESULT hr = CoCreateInstance(CLSID_SystemDeviceEnum, nullptr,
+				      CLSCTX_INPROC_SERVER, IID_ICreateDevEnum,
+				      (void **)&deviceEnum);
+	if (FAILED(hr)) {
+		WarningHR(L"MonikerIndex: Failed to create device enum", hr);
+		return category;
+	}
+
+	/* returns S_FALSE if no devices are installed */
+	hr = deviceEnum->CreateClassEnumerator(type, &enumMoniker, 0);
+	if (hr != S_OK)
+		return category;
+
+	while (enumMoniker->Next(1, &moniker, &count) == S_OK) {
+		Entry entry;
+		entry.moniker = moniker;
+		ReadProperty(moniker, L"FriendlyName", entry.name);
+		entry.hasPath = ReadProperty(moniker, L"DevicePath", entry.path);
+		category.entries.push_back(std::move(entry));
+	}
+
+	return category;
+}
+
+vector<MonikerIndex::Entry> &MonikerIndex::Entries(const GUID &type)
+{
+	return GetCategory(type).entries;
+}
+
+const wstring *MonikerIndex::ParentInstancePath(const wchar_t *instancePath)
+{
+	for (auto &parent : parents) {
+		if (parent.instance == instancePath)
+			return parent.ok ? &parent.parent : nullptr;
+	}
+
+	wchar_t parentPath[512];
+	parents.emplace_back();
+	Parent &parent = parents.back();
+	parent.instance = instancePath;
+	parent.ok = SUCCEEDED(GetParentDeviceInstancePath(
+		instancePath, parentPath, _ARRAYSIZE(parentPath)));
+	if (parent.ok)
+		parent.parent = parentPath;
+
+	return parent.ok ? &parent.parent : nullptr;
+}
+
+const wstring *MonikerIndex::AudioParentInstancePath(Entry &entry)
+{
+	if (!entry.audioParentRead) {
+		wchar_t parentPath[512];
+		entry.audioParentRead = true;
+		entry.hasAudioParent =
+			SUCCEEDED(GetAudioCaptureParentDeviceInstancePath(
+				entry.moniker, parentPath,
+				_ARRAYSIZE(parentPath)));
+		if (entry.hasAudioParent)
+			entry.audioParent = parentPath;
+	}
+
+	return entry.hasAudioParent ? &entry.audioParent : nullptr;
+}
+
+void MonikerIndex::Clear()
+{
+	categories.clear();
+	parents.clear();
+}
+
+/* ------------------------------------------------------------------------- */
+
 static bool GetDeviceAudioFilterInternal(REFCLSID deviceClass,
 					 const wchar_t *vidDevPath,
 					 IBaseFilter **audioCaptureFilter,
+					 MonikerIndex &index,
 					 bool matchFilterName = false)
 {
 	/* Get video device instance path */
@@ -916,114 +918,78 @@ static bool GetDeviceAudioFilterInternal(REFCLSID deviceClass,
 #endif
 
 	/* Get friendly name */
-	wchar_t vidName[512];
+	const wstring *vidName = nullptr;
 	if (matchFilterName) {
-		hr = GetFriendlyName(CLSID_VideoInputDeviceCategory, vidDevPath,
-				     vidName, _ARRAYSIZE(vidName));
-		if (FAILED(hr))
-			return false;
-	}
-
-	/* Create device enumerator */
-	ComPtr<ICreateDevEnum> createDevEnum;
-	if (SUCCEEDED(hr))
-		hr = CoCreateInstance(CLSID_SystemDeviceEnum, NULL,
-				      CLSCTX_INPROC_SERVER, IID_ICreateDevEnum,
-				      (void **)&createDevEnum);
+		for (auto &entry : index.Entries(CLSID_VideoInputDeviceCategory)) {
+			if (entry.hasPath && entry.path == vidDevPath) {
+				vidName = &entry.name;
+				break;
+			}
+		}
 
-	/* Enumerate filters */
-	ComPtr<IEnumMoniker> enumMoniker;
-	if (SUCCEEDED(hr)) {
-		/* returns S_FALSE if no devices are installed */
-		hr = createDevEnum->CreateClassEnumerator(deviceClass,
-							  &enumMoniker, 0);
-		if (!enumMoniker)
-			hr = E_FAIL;
+		if (!vidName)
+			return false;
 	}
 
-	/* Cycle through the enumeration */
-	if (SUCCEEDED(hr)) {
-		ULONG fetched = 0;
-		ComPtr<IMoniker> moniker;
-
-		enumMoniker->Reset();
+	auto sameDevice = [&](MonikerIndex::Entry &entry) {
+		if (entry.hasPath)
+			return IsSameInstPath(entry.path.c_str(),
+					      vidDevInstPath);
 
-		while (enumMoniker->Next(1, &moniker, &fetched) == S_OK) {
-			bool samePath = false;
+		const wstring *vidParent =
+			index.ParentInstancePath(vidDevInstPath);
+		const wstring *audParent = index.AudioParentInstancePath(entry);
 
-			/* Get device path */
-			wchar_t audDevPath[512];
-			hr = ReadProperty(moniker, L"DevicePath", audDevPath,
-					  _ARRAYSIZE(audDevPath));
-			if (SUCCEEDED(hr)) {
-				/* Skip if it is the video device */
-				if (wcscmp(audDevPath, vidDevPath) == 0)
-					continue;
-
-				samePath = IsSameInstPath(audDevPath,
-							  vidDevInstPath);
-			} else {
-				samePath = IsMonikerSameParentInstPath(
-					moniker, vidDevInstPath);
-			}
-
-			/* Get audio capture filter */
-			if (samePath) {
-				/* Match video and audio filter names */
-				bool isSameFilterName = false;
-				if (matchFilterName) {
-					wchar_t audName[512];
-					hr = ReadProperty(moniker,
-							  L"FriendlyName",
-							  audName,
-							  _ARRAYSIZE(audName));
-					if (SUCCEEDED(hr)) {
-						isSameFilterName =
-							MatchFriendlyNames(
-								vidName,
-								audName);
-					}
-				}
+		return vidParent && audParent && *vidParent == *audParent;
+	};
 
-				if (!matchFilterName || isSameFilterName) {
-					hr = moniker->BindToObject(
-						0, 0, IID_IBaseFilter,
-						(void **)audioCaptureFilter);
-					if (SUCCEEDED(hr))
-						return true;
-				}
-			}
-		}
-	}
+	/* Match video and audio filter names */
+	auto nameMatches = [&](MonikerIndex::Entry &entry) {
+		return !matchFilterName ||
+		       (!entry.name.empty() &&
+			MatchFriendlyNames(vidName->c_str(),
+					   entry.name.c_str()));
+	};
 
-	return false;
+	return FindAudioEntry(index.Entries(deviceClass), vidDevPath,
+			      sameDevice, nameMatches,
+			      [audioCaptureFilter](MonikerIndex::Entry &entry) {
+				      return BindEntry(entry,
+						       audioCaptureFilter);
+			      });
 }
 
 bool GetDeviceAudioFilter(const wchar_t *vidDevPath,
-			  IBaseFilter **audioCaptureFilter)
+			  IBaseFilter **audioCaptureFilter, MonikerIndex *index)
 {
+	MonikerIndex localIndex;
+
+	if (!index)
+		index = &localIndex;
+
 	/* Search in "Audio capture sources" and match filter name */
 	bool success = GetDeviceAudioFilterInternal(
 		CLSID_AudioInputDeviceCategory, vidDevPath, audioCaptureFilter,
-		true);
+		*index, true);
 
 	/* Search in "WDM Streaming Capture Devices" and match filter name */
 	if (!success)
 		success = GetDeviceAudioFilterInternal(KSCATEGORY_CAPTURE,
 						       vidDevPath,
 						       audioCaptureFilter,
-						       true);
+						       *index, true);
 
 	/* Search in "Audio capture sources" */
 	if (!success)
 		success = GetDeviceAudioFilterInternal(
 			CLSID_AudioInputDeviceCategory, vidDevPath,
-			audioCaptureFilter);
+			audioCaptureFilter, *index);
 
 	/* Search in "WDM Streaming Capture Devices" */
 	if (!success)
 		success = GetDeviceAudioFilterInternal(
-			KSCATEGORY_CAPTURE, vidDevPath, audioCaptureFilter);
+			KSCATEGORY_CAPTURE, vidDevPath, audioCaptureFilter,
+			*index);
 
 	return success;
 }
@@ -33,6 +33,8 @@
 #include "CoTaskMemPtr.hpp"
 
 #include <string>
+#include <vector>
+#include <deque>
 using namespace std;
 
 #define DSHOW_UNUSED(param) (void)param;
@@ -44,8 +46,55 @@ bool CreateFilterGraph(IGraphBuilder **graph, ICaptureGraphBuilder2 **builder,
 
 void LogFilters(IGraphBuilder *graph);
 
+/*
+ * Device monikers and their properties, read once per category and shared
+ * by the lookups of one graph build, so that opening a device doesn't
+ * enumerate the hardware again for every filter it needs.  The lookups
+ * below take one optionally; without it each call enumerates on its own.
+ */
+struct MonikerIndex {
+	struct Entry {
+		ComPtr<IMoniker> moniker;
+		wstring name;
+		wstring path;
+		bool hasPath = false;
+
+		/* pin mediums, read the first time the filter is bound */
+		bool mediumsRead = false;
+		vector<REGPINMEDIUM> mediums;
+
+		bool audioParentRead = false;
+		bool hasAudioParent = false;
+		wstring audioParent;
+	};
+
+	struct Category {
+		GUID type;
+		vector<Entry> entries;
+	};
+
+	struct Parent {
+		wstring instance;
+		wstring parent;
+		bool ok;
+	};
+
+	/* deques, references stay valid as categories are added */
+	deque<Category> categories;
+	deque<Parent> parents;
+
+	Category &GetCategory(const GUID &type);
+	vector<Entry> &Entries(const GUID &type);
+
+	/* SetupAPI lookups, remembered along with the monikers */
+	const wstring *ParentInstancePath(const wchar_t *instancePath);
+	const wstring *AudioParentInstancePath(Entry &entry);
+
+	void Clear();
+};
+
 bool GetDeviceFilter(const IID &type, const wchar_t *name, const wchar_t *path,
-		     IBaseFilter **filter);
+		     IBaseFilter **filter, MonikerIndex *index = nullptr);
 
 bool GetFilterPin(IBaseFilter *filter, const GUID &type, const GUID &category,
 		  PIN_DIRECTION dir, IPin **pin);
@@ -55,7 +104,7 @@ bool GetPinByName(IBaseFilter *filter, PIN_DIRECTION dir, const wchar_t *name,
 
 bool GetPinByMedium(IBaseFilter *filter, REGPINMEDIUM &medium, IPin **pin);
 bool GetFilterByMedium(const CLSID &id, REGPINMEDIUM &medium,
-		       IBaseFilter **filter);
+		       IBaseFilter **filter, MonikerIndex *index = nullptr);
 
 bool GetPinMedium(IPin *pin, REGPINMEDIUM &medium);
 
@@ -75,6 +124,7 @@ wstring ConvertHRToEnglish(HRESULT hr);
  * Get audio filter for the same device as the given video device path
  */
 bool GetDeviceAudioFilter(const wchar_t *videoDevicePath,
-			  IBaseFilter **audioCaptureFilter);
+			  IBaseFilter **audioCaptureFilter,
+			  MonikerIndex *index = nullptr);
 
 }; /* namespace DShow */
@@ -0,0 +1,210 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#include "dshow-clock.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include <math.h>
+
+/* fraction of the measured error corrected per frame */
+#define TIMESTAMP_SMOOTHING 16
+
+/* weight decay per sample, roughly a 10 second window at 30 samples/s */
+#define CLOCK_DECAY (1.0 - 1.0 / 300.0)
+/* samples needed before trusting the regression slope */
+#define CLOCK_MIN_SAMPLES 30
+/* slopes beyond this are bogus timestamps rather than drift */
+#define CLOCK_MAX_DRIFT 0.01
+/* resync after a jump of more than a second off the mapping */
+#define CLOCK_MAX_ERROR 10000000.0
+
+namespace DShow {
+
+#ifdef _WIN32
+long long GetHostTime()
+{
+	static LARGE_INTEGER freq = {};
+	LARGE_INTEGER count;
+
+	if (!freq.QuadPart)
+		QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+
+	/* split to avoid overflowing on systems with a high QPC frequency */
+	long long sec = count.QuadPart / freq.QuadPart;
+	long long rem = count.QuadPart % freq.QuadPart;
+	return sec * 10000000LL + rem * 10000000LL / freq.QuadPart;
+}
+#else
+long long GetHostTime()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 10000000LL + ts.tv_nsec / 100;
+}
+#endif
+
+void TimestampSynthesizer::Reset()
+{
+	origin = GetHostTime();
+	started = false;
+}
+
+void TimestampSynthesizer::Next(long long frameInterval, long long &startTime,
+				long long &stopTime)
+{
+	long long now = GetHostTime() - origin;
+
+	if (!started || frameInterval <= 0) {
+		startTime = now;
+	} else {
+		long long error = now - next;
+
+		/* within half a frame it's just delivery jitter, so stay on
+		 * the frame grid and nudge it towards the host clock.
+		 * anything beyond that means frames were dropped or the
+		 * device stalled, so resync */
+		if (error > -frameInterval / 2 && error < frameInterval / 2)
+			startTime = next + error / TIMESTAMP_SMOOTHING;
+		else
+			startTime = now;
+	}
+
+	stopTime = startTime + (frameInterval > 0 ? frameInterval : 1);
+	next = startTime + frameInterval;
+	started = true;
+}
+
+// ============================================================================
+
+void ClockMapper::ResetInternal()
+{
+	samples = 0;
+	weight = 0.0;
+	meanX = meanY = 0.0;
+	covXX = covXY = 0.0;
+	slope = 1.0;
+	intercept = 0.0;
+	jitter = 0.0;
+}
+
+void ClockMapper::Reset()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	ResetInternal();
+}
+
+void ClockMapper::Update(long long deviceTime, long long hostTime)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	/* work relative to the first sample to keep precision */
+	if (!samples) {
+		deviceOrigin = deviceTime;
+		hostOrigin = hostTime;
+	}
+
+	double x = (double)(deviceTime - deviceOrigin);
+	double y = (double)(hostTime - hostOrigin);
+
+	if (samples) {
+		double error = y - Predict(x);
+		if (fabs(error) > CLOCK_MAX_ERROR) {
+			ResetInternal();
+			deviceOrigin = deviceTime;
+			hostOrigin = hostTime;
+			x = y = 0.0;
+		} else if (deviceTime < lastDeviceTime) {
+			/* reordered timestamps (e.g. B-frame PTS) only go back
+			 * a few frames, and the newer sample already said more
+			 * about the host clock than this one can */
+			return;
+		} else {
+			jitter = jitter * CLOCK_DECAY +
+				 fabs(error) * (1.0 - CLOCK_DECAY);
+		}
+	}
+
+	/* weighted running means/covariances (West's algorithm) */
+	weight = weight * CLOCK_DECAY + 1.0;
+
+	double dx = x - meanX;
+	double dy = y - meanY;
+	meanX += dx / weight;
+	meanY += dy / weight;
+	covXX = covXX * CLOCK_DECAY + dx * (x - meanX);
+	covXY = covXY * CLOCK_DECAY + dx * (y - meanY);
+
+	slope = 1.0;
+	if (++samples >= CLOCK_MIN_SAMPLES && covXX > 0.0) {
+		double fit = covXY / covXX;
+		if (fabs(fit - 1.0) < CLOCK_MAX_DRIFT)
+			slope = fit;
+	}
+
+	intercept = meanY - slope * meanX;
+	lastDeviceTime = deviceTime;
+}
+
+long long ClockMapper::Map(long long deviceTime) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!samples)
+		return 0;
+
+	double x = (double)(deviceTime - deviceOrigin);
+	return hostOrigin + (long long)llround(Predict(x));
+}
+
+long long ClockMapper::Unmap(long long hostTime) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!samples)
+		return 0;
+
+	double y = (double)(hostTime - hostOrigin);
+	return deviceOrigin + (long long)llround((y - intercept) / slope);
+}
+
+double ClockMapper::Slope() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return slope;
+}
+
+void ClockMapper::GetStats(ClockStats &stats) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	stats.samples = samples;
+	stats.driftPPM = (slope - 1.0) * 1000000.0;
+	stats.jitter = (long long)llround(jitter);
+	stats.offset = samples ? hostOrigin - deviceOrigin +
+					 (long long)llround(intercept)
+			       : 0;
+}
+
+}; /* namespace DShow */
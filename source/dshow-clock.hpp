@@ -0,0 +1,82 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+
+#include <mutex>
+
+namespace DShow {
+
+/*
+ * Generates timestamps for devices that deliver samples without any.
+ * Frames are spaced by the frame interval, with the host clock used to
+ * slowly correct for drift and to resync after stalls or dropped frames.
+ */
+class TimestampSynthesizer {
+	long long origin = 0;
+	long long next = 0;
+	bool started = false;
+
+public:
+	void Reset();
+	void Next(long long frameInterval, long long &startTime,
+		  long long &stopTime);
+};
+
+/*
+ * Maps device timestamps to the host clock.  Keeps an exponentially
+ * weighted linear regression of host receive time against device time,
+ * which gives both the drift between the two clocks and a mapping that
+ * averages out delivery jitter.  Timestamps older than the newest one are
+ * ignored unless they're far enough off the mapping to be a discontinuity.
+ */
+class ClockMapper {
+	mutable std::mutex mutex;
+
+	long long deviceOrigin = 0;
+	long long hostOrigin = 0;
+	long long lastDeviceTime = 0;
+	long long samples = 0;
+
+	double weight = 0.0;
+	double meanX = 0.0;
+	double meanY = 0.0;
+	double covXX = 0.0;
+	double covXY = 0.0;
+
+	double slope = 1.0;
+	double intercept = 0.0;
+	double jitter = 0.0;
+
+	inline double Predict(double x) const { return intercept + slope * x; }
+	void ResetInternal();
+
+public:
+	void Reset();
+	void Update(long long deviceTime, long long hostTime);
+	long long Map(long long deviceTime) const;
+	long long Unmap(long long hostTime) const;
+	double Slope() const;
+	void GetStats(ClockStats &stats) const;
+};
+
+}; /* namespace DShow */
@@ -28,7 +28,8 @@
 namespace DShow {
 
 static inline bool CreateFilters(IBaseFilter *filter, IBaseFilter **crossbar,
-				 IBaseFilter **encoder, IBaseFilter **demuxer)
+				 IBaseFilter **encoder, IBaseFilter **demuxer,
+				 MonikerIndex *monikers)
 {
 	ComPtr<IPin> inputPin;
 	ComPtr<IPin> outputPin;
@@ -54,14 +55,20 @@ static inline bool CreateFilters(IBaseFilter *filter, IBaseFilter **crossbar,
 
 	hasOutMedium = GetPinMedium(outputPin, outMedium);
 
-	if (!GetFilterByMedium(AM_KSCATEGORY_CROSSBAR, inMedium, crossbar)) {
+	if (!GetFilterByMedium(AM_KSCATEGORY_CROSSBAR, inMedium, crossbar,
+			       monikers)) {
 		Warning(L"Encoded Device: Failed to get crossbar filter");
 		return false;
 	}
 
 	/* perfectly okay if there's no encoder filter, some don't have them */
 	if (hasOutMedium)
-		GetFilterByMedium(KSCATEGORY_ENCODER, outMedium, encoder);
+		GetFilterByMedium(KSCATEGORY_ENCODER, outMedium, encoder,
+				  monikers);
+
+	/* not needed when demuxing ourselves */
+	if (!demuxer)
+		return true;
 
 	hr = CoCreateInstance(CLSID_MPEG2Demultiplexer, nullptr,
 			      CLSCTX_INPROC_SERVER, IID_IBaseFilter,
@@ -206,7 +213,10 @@ bool HDevice::SetupEncodedVideoCapture(IBaseFilter *filter, VideoConfig &config,
 	MediaType mtVideo;
 	MediaType mtAudio;
 
-	if (!CreateFilters(filter, &crossbar, &encoder, &demuxer))
+	if (config.softwareDemux)
+		return SetupTransportCapture(filter, config, info);
+
+	if (!CreateFilters(filter, &crossbar, &encoder, &demuxer, &monikers))
 		return false;
 
 	if (!CreateDemuxVideoPin(demuxer, mtVideo, info.width, info.height,
@@ -228,6 +238,7 @@ bool HDevice::SetupEncodedVideoCapture(IBaseFilter *filter, VideoConfig &config,
 	pci.callback = [this](IMediaSample *s) { Receive(true, s); };
 	pci.expectedMajorType = mtVideo->majortype;
 	pci.expectedSubType = mtVideo->subtype;
+	pci.bufferCount = config.bufferCount;
 
 	videoCapture = new CaptureFilter(pci);
 	videoFilter = demuxer;
@@ -257,4 +268,61 @@ bool HDevice::SetupEncodedVideoCapture(IBaseFilter *filter, VideoConfig &config,
 	return success;
 }
 
+bool HDevice::SetupTransportCapture(IBaseFilter *filter, VideoConfig &config,
+				    const EncodedDevice &info)
+{
+	ComPtr<IBaseFilter> crossbar;
+	ComPtr<IBaseFilter> encoder;
+
+	if (!CreateFilters(filter, &crossbar, &encoder, nullptr, &monikers))
+		return false;
+
+	config.cx = info.width;
+	config.cy_abs = labs(info.height);
+	config.cy_flip = info.height < 0;
+	config.frameInterval = info.frameInterval;
+	config.format = info.videoFormat;
+	config.internalFormat = info.videoFormat;
+
+	PinCaptureInfo pci;
+	pci.callback = [this](IMediaSample *s) { ReceiveTransport(s); };
+	pci.expectedMajorType = MEDIATYPE_Stream;
+	pci.expectedSubType = MEDIASUBTYPE_MPEG2_TRANSPORT;
+	pci.bufferCount = config.bufferCount;
+
+	videoCapture = new CaptureFilter(pci);
+	videoFilter = filter;
+
+	if (!!encoder && config.name.find(L"IT9910") != std::string::npos) {
+		rocketEncoder = encoder;
+
+		if (!SetRocketEnabled(rocketEncoder, true))
+			return false;
+	}
+
+	graph->AddFilter(crossbar, L"Crossbar");
+	graph->AddFilter(filter, L"Device");
+	graph->AddFilter(videoCapture, L"Capture Filter");
+
+	if (!!encoder)
+		graph->AddFilter(encoder, L"Encoder");
+
+	/* the capture filter takes the demuxer's place */
+	bool success = ConnectEncodedFilters(graph, filter, crossbar, encoder,
+					     videoCapture);
+	if (success) {
+		transportDemuxer.Clear();
+		transportDemuxer.AddStream((int)info.videoPacketID);
+		transportDemuxer.AddStream((int)info.audioPacketID);
+		transportDemuxer.callback = [this](const TSPacket &packet) {
+			ReceiveTransportPacket(packet);
+		};
+		encodedInfo = info;
+	}
+
+	encodedDevice = success;
+	softwareDemux = success;
+	return success;
+}
+
 }; /* namespace DShow */
@@ -138,14 +138,7 @@ static bool Get_FORMAT_WaveFormatEx_Data(AudioInfo &info,
 		return false;
 	}
 
-	switch (wfex->wBitsPerSample) {
-	case 16:
-		info.format = AudioFormat::Wave16bit;
-		break;
-	case 32:
-		info.format = AudioFormat::WaveFloat;
-		break;
-	}
+	info.format = GetWaveFormatAFormat(wfex);
 
 	info.minChannels = ascc->MinimumChannels;
 	info.maxChannels = ascc->MaximumChannels;
@@ -495,6 +488,9 @@ static bool EnumDevice(const GUID &type, IMoniker *deviceInfo,
 	return true;
 }
 
+#define ELGATO_NAME L"Elgato Game Capture HD"
+#define ELGATO_PATH L"__elgato"
+
 static bool EnumExceptionVideoDevices(EnumDeviceCallback callback, void *param)
 {
 	ComPtr<IBaseFilter> filter;
@@ -504,8 +500,7 @@ static bool EnumExceptionVideoDevices(EnumDeviceCallback callback, void *param)
 			      CLSCTX_INPROC_SERVER, IID_IBaseFilter,
 			      (void **)&filter);
 	if (SUCCEEDED(hr)) {
-		if (!callback(param, filter, L"Elgato Game Capture HD",
-			      L"__elgato"))
+		if (!callback(param, filter, ELGATO_NAME, ELGATO_PATH))
 			return false;
 	}
 
@@ -580,4 +575,145 @@ bool EnumDevices(const GUID &type, EnumDeviceCallback callback, void *param)
 	return true;
 }
 
+/* ------------------------------------------------------------------------- */
+
+bool CreateExceptionVideoFilter(const wchar_t *name, IBaseFilter **filter)
+{
+	if (name && *name && wcscmp(name, ELGATO_NAME) != 0)
+		return false;
+
+	HRESULT hr = CoCreateInstance(CLSID_ElgatoVideoCaptureFilter, nullptr,
+				      CLSCTX_INPROC_SERVER, IID_IBaseFilter,
+				      (void **)filter);
+	return SUCCEEDED(hr);
+}
+
+bool EnumDeviceMonikers(const GUID &type, EnumMonikerCallback callback,
+			void *param)
+{
+	lock_guard<recursive_mutex> lock(enumMutex);
+	ComPtr<ICreateDevEnum> deviceEnum;
+	ComPtr<IEnumMoniker> enumMoniker;
+	ComPtr<IMoniker> deviceInfo;
+	HRESULT hr;
+	DWORD count = 0;
+
+	hr = CoCreateInstance(CLSID_SystemDeviceEnum, NULL,
+			      CLSCTX_INPROC_SERVER, IID_ICreateDevEnum,
+			      (void **)&deviceEnum);
+	if (FAILED(hr)) {
+		WarningHR(L"EnumDeviceMonikers: Could not create "
+			  L"ICreateDeviceEnum",
+			  hr);
+		return false;
+	}
+
+	hr = deviceEnum->CreateClassEnumerator(type, &enumMoniker, 0);
+	if (FAILED(hr)) {
+		WarningHR(L"EnumDeviceMonikers: CreateClassEnumerator failed",
+			  hr);
+		return false;
+	}
+
+	/* S_FALSE (and no enumerator) if the category is empty */
+	while (hr == S_OK && enumMoniker->Next(1, &deviceInfo, &count) == S_OK) {
+		ComPtr<IPropertyBag> propertyData;
+		VARIANT deviceName, devicePath;
+		bool next = true;
+
+		if (FAILED(deviceInfo->BindToStorage(0, 0, IID_IPropertyBag,
+						     (void **)&propertyData)))
+			continue;
+
+		VariantInit(&deviceName);
+		VariantInit(&devicePath);
+
+		if (SUCCEEDED(propertyData->Read(L"FriendlyName", &deviceName,
+						 NULL)) &&
+		    deviceName.vt == VT_BSTR) {
+			propertyData->Read(L"DevicePath", &devicePath, NULL);
+			next = callback(param, deviceInfo, deviceName.bstrVal,
+					devicePath.vt == VT_BSTR
+						? devicePath.bstrVal
+						: nullptr);
+		}
+
+		VariantClear(&deviceName);
+		VariantClear(&devicePath);
+
+		if (!next)
+			return true;
+	}
+
+	/* the elgato filter isn't registered as a device, so there's no
+	 * moniker for it */
+	if (type == CLSID_VideoInputDeviceCategory) {
+		ComPtr<IBaseFilter> filter;
+		hr = CoCreateInstance(CLSID_ElgatoVideoCaptureFilter, nullptr,
+				      CLSCTX_INPROC_SERVER, IID_IBaseFilter,
+				      (void **)&filter);
+		if (SUCCEEDED(hr))
+			callback(param, nullptr, ELGATO_NAME, ELGATO_PATH);
+	}
+
+	return true;
+}
+
+struct BindDeviceInfo {
+	const wchar_t *name;
+	const wchar_t *path;
+	ComPtr<IMoniker> byName;
+	ComPtr<IMoniker> byPath;
+};
+
+static bool FindDeviceMoniker(BindDeviceInfo &info, IMoniker *moniker,
+			      const wchar_t *name, const wchar_t *path)
+{
+	if (!moniker)
+		return true;
+
+	if (info.path && *info.path && path && wcscmp(path, info.path) == 0) {
+		info.byPath = moniker;
+		return false;
+	}
+
+	if (!info.byName && info.name && *info.name &&
+	    wcscmp(name, info.name) == 0)
+		info.byName = moniker;
+
+	return true;
+}
+
+bool BindDeviceFilter(const GUID &type, const wchar_t *name,
+		      const wchar_t *path, IBaseFilter **filter)
+{
+	BindDeviceInfo info;
+	HRESULT hr;
+
+	if (type == CLSID_VideoInputDeviceCategory && path &&
+	    wcscmp(path, ELGATO_PATH) == 0) {
+		hr = CoCreateInstance(CLSID_ElgatoVideoCaptureFilter, nullptr,
+				      CLSCTX_INPROC_SERVER, IID_IBaseFilter,
+				      (void **)filter);
+		return SUCCEEDED(hr);
+	}
+
+	info.name = name;
+	info.path = path;
+
+	if (!EnumDeviceMonikers(type, EnumMonikerCallback(FindDeviceMoniker),
+				&info))
+		return false;
+
+	/* bound outside of the enumeration lock, so that devices can be
+	 * bound on several threads at once */
+	IMoniker *moniker = info.byPath ? info.byPath.Get()
+					: info.byName.Get();
+	if (!moniker)
+		return false;
+
+	hr = moniker->BindToObject(NULL, 0, IID_IBaseFilter, (void **)filter);
+	return SUCCEEDED(hr);
+}
+
 }; /* namespace DShow */
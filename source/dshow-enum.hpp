@@ -43,4 +43,21 @@ typedef bool (*EnumDeviceCallback)(void *param, IBaseFilter *filter,
 
 bool EnumDevices(const GUID &type, EnumDeviceCallback callback, void *param);
 
+typedef bool (*EnumMonikerCallback)(void *param, IMoniker *moniker,
+				    const wchar_t *deviceName,
+				    const wchar_t *devicePath);
+
+/* like EnumDevices, but only reads the names, nothing gets bound */
+bool EnumDeviceMonikers(const GUID &type, EnumMonikerCallback callback,
+			void *param);
+
+/* devices outside of the video category (see EnumDevices), if name is
+ * empty or theirs */
+bool CreateExceptionVideoFilter(const wchar_t *name, IBaseFilter **filter);
+
+/* binds only the matching device rather than every device in the
+ * category (matches on path first, then on name) */
+bool BindDeviceFilter(const GUID &type, const wchar_t *name,
+		      const wchar_t *path, IBaseFilter **filter);
+
 }; /* namespace DShow */
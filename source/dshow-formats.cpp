@@ -203,6 +203,68 @@ WORD VFormatPlanes(VideoFormat format)
 	}
 }
 
+size_t VFormatPlaneLayout(VideoFormat format, int cx, int cy,
+			  size_t offsets[DSHOW_MAX_PLANES],
+			  size_t linesize[DSHOW_MAX_PLANES])
+{
+	size_t width = (size_t)cx;
+	size_t height = (size_t)cy;
+	size_t chromaCX = (width + 1) / 2;
+	size_t chromaCY = (height + 1) / 2;
+
+	memset(offsets, 0, sizeof(size_t) * DSHOW_MAX_PLANES);
+	memset(linesize, 0, sizeof(size_t) * DSHOW_MAX_PLANES);
+
+	if (cx <= 0 || cy <= 0)
+		return 0;
+
+	switch (format) {
+	/* raw formats */
+	case VideoFormat::ARGB:
+	case VideoFormat::XRGB:
+		linesize[0] = width * 4;
+		return linesize[0] * height;
+	case VideoFormat::RGB24:
+		/* DIB rows are DWORD aligned */
+		linesize[0] = (width * 3 + 3) & ~(size_t)3;
+		return linesize[0] * height;
+
+	/* planar YUV formats */
+	case VideoFormat::I420:
+	case VideoFormat::YV12:
+		linesize[0] = width;
+		linesize[1] = chromaCX;
+		linesize[2] = chromaCX;
+		offsets[1] = width * height;
+		offsets[2] = offsets[1] + chromaCX * chromaCY;
+		return offsets[2] + chromaCX * chromaCY;
+	case VideoFormat::NV12:
+		linesize[0] = width;
+		linesize[1] = chromaCX * 2;
+		offsets[1] = width * height;
+		return offsets[1] + linesize[1] * chromaCY;
+	case VideoFormat::P010:
+		linesize[0] = width * 2;
+		linesize[1] = chromaCX * 4;
+		offsets[1] = linesize[0] * height;
+		return offsets[1] + linesize[1] * chromaCY;
+	case VideoFormat::Y800:
+		linesize[0] = width;
+		return linesize[0] * height;
+
+	/* packed YUV formats */
+	case VideoFormat::YVYU:
+	case VideoFormat::YUY2:
+	case VideoFormat::UYVY:
+	case VideoFormat::HDYC:
+		linesize[0] = width * 2;
+		return linesize[0] * height;
+
+	default:
+		return 0;
+	}
+}
+
 static bool GetFourCCVFormat(DWORD fourCC, VideoFormat &format)
 {
 	switch (fourCC) {
@@ -332,4 +394,28 @@ bool GetMediaTypeVFormat(const AM_MEDIA_TYPE &mt, VideoFormat &format)
 	return true;
 }
 
+AudioFormat GetWaveFormatAFormat(const WAVEFORMATEX *wfex)
+{
+	bool isFloat = wfex->wFormatTag == WAVE_FORMAT_IEEE_FLOAT;
+
+	if (wfex->wFormatTag == WAVE_FORMAT_EXTENSIBLE &&
+	    wfex->cbSize >= sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX)) {
+		const WAVEFORMATEXTENSIBLE *wfext =
+			reinterpret_cast<const WAVEFORMATEXTENSIBLE *>(wfex);
+		isFloat = wfext->SubFormat == MEDIASUBTYPE_IEEE_FLOAT;
+	}
+
+	switch (wfex->wBitsPerSample) {
+	case 16:
+		return AudioFormat::Wave16bit;
+	case 24:
+		return AudioFormat::Wave24bit;
+	case 32:
+		return isFloat ? AudioFormat::WaveFloat
+			       : AudioFormat::Wave32bit;
+	default:
+		return AudioFormat::Unknown;
+	}
+}
+
 }; /* namespace DShow */
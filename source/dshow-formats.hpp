@@ -32,6 +32,14 @@ WORD VFormatBits(VideoFormat format);
 WORD VFormatPlanes(VideoFormat format);
 GUID VFormatToSubType(VideoFormat format);
 
+/* plane offsets/line sizes of a tightly packed frame; returns the total
+ * frame size, or 0 if the format has no known layout */
+size_t VFormatPlaneLayout(VideoFormat format, int cx, int cy,
+			  size_t offsets[DSHOW_MAX_PLANES],
+			  size_t linesize[DSHOW_MAX_PLANES]);
+
 bool GetMediaTypeVFormat(const AM_MEDIA_TYPE &mt, VideoFormat &format);
 
+AudioFormat GetWaveFormatAFormat(const WAVEFORMATEX *wfex);
+
 }; /*namespace DShow */
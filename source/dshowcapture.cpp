@@ -21,10 +21,15 @@
 #include "dshow-base.hpp"
 #include "dshow-enum.hpp"
 #include "device.hpp"
+#include "device-cache.hpp"
 #include "dshow-device-defs.hpp"
 #include "log.hpp"
 
 #include <vector>
+#include <thread>
+#include <atomic>
+
+#define ENUM_MAX_THREADS 8
 
 namespace DShow {
 
@@ -120,6 +125,85 @@ bool Device::GetAudioDeviceId(DeviceId &id) const
 	return true;
 }
 
+bool Device::GetVideoAllocatorStats(AllocatorStats &stats) const
+{
+	if (context->videoCapture == NULL)
+		return false;
+
+	context->videoCapture->GetPin()->GetAllocatorStats(stats);
+	return true;
+}
+
+bool Device::GetAudioAllocatorStats(AllocatorStats &stats) const
+{
+	if (context->audioCapture == NULL)
+		return false;
+
+	context->audioCapture->GetPin()->GetAllocatorStats(stats);
+	return true;
+}
+
+bool Device::GetVideoClockStats(ClockStats &stats) const
+{
+	if (context->videoCapture == NULL)
+		return false;
+
+	context->videoClock.GetStats(stats);
+	return true;
+}
+
+bool Device::GetAudioClockStats(ClockStats &stats) const
+{
+	if (context->audioCapture == NULL)
+		return false;
+
+	context->audioClock.GetStats(stats);
+	return true;
+}
+
+long long Device::VideoTimeToHost(long long time) const
+{
+	return context->videoClock.Map(time);
+}
+
+long long Device::AudioTimeToHost(long long time) const
+{
+	return context->audioClock.Map(time);
+}
+
+bool Device::VideoTimeSynthetic() const
+{
+	return context->videoTimeSynthetic;
+}
+
+void Device::SetAudioRateAdjust(double ratio)
+{
+	context->audioResampler.SetRatioAdjust(ratio);
+}
+
+bool Device::GetAVSyncStats(AVSyncStats &stats) const
+{
+	if (context->videoCapture == NULL || context->audioCapture == NULL)
+		return false;
+
+	context->avSync.GetStats(stats, context->videoClock);
+	return true;
+}
+
+bool Device::GetAudioBufferingStats(AudioBufferingStats &stats) const
+{
+	if (context->audioCapture == NULL)
+		return false;
+
+	context->audioMonitor.GetStats(stats);
+	stats.bufferingMs = context->audioBufferingMs;
+	stats.adaptive = context->audioConfig.adaptiveBuffering;
+	if (stats.adaptive)
+		GetAdaptiveAudioBuffering(context->AudioDevicePath(),
+					  &stats.backoffs);
+	return true;
+}
+
 static void OpenPropertyPages(HWND hwnd, IUnknown *propertyObject)
 {
 	if (!propertyObject)
@@ -280,6 +364,265 @@ bool Device::EnumVideoDevices(std::vector<VideoDevice> &devices)
 			   EnumDeviceCallback(EnumVideoDevice), &devices);
 }
 
+static bool ListVideoDevice(std::vector<VideoDevice> &devices,
+			    IMoniker *moniker, const wchar_t *deviceName,
+			    const wchar_t *devicePath)
+{
+	VideoDevice info;
+	info.name = deviceName;
+	if (devicePath)
+		info.path = devicePath;
+	info.capsPending = true;
+
+	devices.push_back(info);
+
+	DSHOW_UNUSED(moniker);
+	return true;
+}
+
+/* monikers listed for the parallel enumeration, marshaled so that the
+ * thread that reads a device's caps can bind it without enumerating the
+ * whole category again */
+struct ListedVideoDevices {
+	std::vector<VideoDevice> &devices;
+	std::vector<ComPtr<IStream>> monikers;
+
+	inline ListedVideoDevices(std::vector<VideoDevice> &devices_)
+		: devices(devices_)
+	{
+	}
+};
+
+static bool ListParallelVideoDevice(ListedVideoDevices &list,
+				    IMoniker *moniker,
+				    const wchar_t *deviceName,
+				    const wchar_t *devicePath)
+{
+	ComPtr<IStream> stream;
+
+	/* no moniker for the elgato filter, and if marshaling fails the
+	 * device is just looked up by name and path */
+	if (moniker)
+		CoMarshalInterThreadInterfaceInStream(IID_IMoniker, moniker,
+						      &stream);
+
+	list.monikers.push_back(stream);
+	return ListVideoDevice(list.devices, moniker, deviceName, devicePath);
+}
+
+/* always asks the driver, binding the given moniker if there is one */
+static bool ReadVideoCaps(VideoDevice &device, IMoniker *moniker)
+{
+	ComPtr<IBaseFilter> filter;
+	std::vector<VideoDevice> found;
+
+	if (moniker) {
+		HRESULT hr = moniker->BindToObject(NULL, 0, IID_IBaseFilter,
+						   (void **)&filter);
+		if (FAILED(hr))
+			return false;
+
+	} else if (!BindDeviceFilter(CLSID_VideoInputDeviceCategory,
+				     device.name.c_str(), device.path.c_str(),
+				     &filter)) {
+		return false;
+	}
+
+	EnumVideoDevice(found, filter, device.name.c_str(),
+			device.path.empty() ? nullptr : device.path.c_str());
+	if (found.empty())
+		return false;
+
+	device = std::move(found[0]);
+	return true;
+}
+
+static bool ReadVideoCaps(VideoDevice &device)
+{
+	return ReadVideoCaps(device, nullptr);
+}
+
+static bool ReadAudioCaps(AudioDevice &device)
+{
+	ComPtr<IBaseFilter> filter;
+	ComPtr<IPin> pin;
+
+	if (!BindDeviceFilter(CLSID_AudioInputDeviceCategory,
+			      device.name.c_str(), device.path.c_str(),
+			      &filter))
+		return false;
+	if (!GetFilterPin(filter, MEDIATYPE_Audio, PIN_CATEGORY_CAPTURE,
+			  PINDIR_OUTPUT, &pin))
+		return false;
+
+	device.caps.clear();
+	return EnumAudioCaps(pin, device.caps);
+}
+
+static bool EnumCachedVideoCaps(VideoDevice &device,
+				IMoniker *moniker = nullptr)
+{
+	if (!device.capsPending)
+		return true;
+	if (LookupVideoCaps(device))
+		return true;
+	if (!ReadVideoCaps(device, moniker))
+		return false;
+
+	/* just read from the driver, nothing to revalidate */
+	TakeCapsRevalidation(device.path);
+	StoreVideoCaps(device);
+	return true;
+}
+
+/* caps that came from the on-disk cache are read again from the driver
+ * in the background (once per process), so changes that the driver
+ * fingerprint doesn't catch are picked up by the next enumeration */
+template<typename T>
+static void RevalidateCaps(const std::vector<T> &devices,
+			   bool (*read)(T &device), bool (*store)(const T &))
+{
+	std::vector<T> stale;
+
+	for (const T &device : devices) {
+		if (!device.path.empty() && TakeCapsRevalidation(device.path))
+			stale.push_back(device);
+	}
+
+	if (stale.empty())
+		return;
+
+	std::thread thread([stale, read, store]() mutable {
+		HRESULT hr = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
+		bool changed = false;
+
+		for (T &device : stale) {
+			if (read(device) && store(device))
+				changed = true;
+		}
+
+		FlushCapsCache();
+		if (changed)
+			InvalidateDeviceCache();
+
+		if (SUCCEEDED(hr))
+			CoUninitialize();
+	});
+
+	thread.detach();
+}
+
+bool Device::EnumVideoCaps(VideoDevice &device)
+{
+	if (!device.capsPending)
+		return true;
+	if (!EnumCachedVideoCaps(device))
+		return false;
+
+	FlushCapsCache();
+	RevalidateCaps(std::vector<VideoDevice>(1, device), ReadVideoCaps,
+		       StoreVideoCaps);
+	return true;
+}
+
+static void EnumVideoCapsThread(ListedVideoDevices &list,
+				std::vector<char> &valid,
+				std::atomic<size_t> &next)
+{
+	HRESULT hr = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
+
+	for (;;) {
+		size_t i = next++;
+		if (i >= list.devices.size())
+			break;
+
+		/* unmarshaled even on a cache hit, which releases the
+		 * stream's marshal data */
+		ComPtr<IMoniker> moniker;
+		if (list.monikers[i])
+			CoGetInterfaceAndReleaseStream(
+				list.monikers[i].Detach(), IID_IMoniker,
+				(void **)&moniker);
+
+		valid[i] = EnumCachedVideoCaps(list.devices[i], moniker);
+	}
+
+	if (SUCCEEDED(hr))
+		CoUninitialize();
+}
+
+/* binding and querying the caps is what's slow, and drivers mostly spend
+ * that time waiting on their hardware, so do several devices at once */
+static bool EnumVideoDevicesParallel(std::vector<VideoDevice> &devices)
+{
+	ListedVideoDevices list(devices);
+	std::vector<std::thread> threads;
+	std::vector<char> valid;
+	std::atomic<size_t> next(0);
+
+	if (!EnumDeviceMonikers(CLSID_VideoInputDeviceCategory,
+				EnumMonikerCallback(ListParallelVideoDevice),
+				&list))
+		return false;
+
+	size_t count = devices.size();
+	if (count > ENUM_MAX_THREADS)
+		count = ENUM_MAX_THREADS;
+	valid.resize(devices.size(), 0);
+
+	for (size_t i = 0; i < count; i++)
+		threads.emplace_back(EnumVideoCapsThread, std::ref(list),
+				     std::ref(valid), std::ref(next));
+	for (std::thread &thread : threads)
+		thread.join();
+
+	size_t out = 0;
+	for (size_t i = 0; i < devices.size(); i++) {
+		if (valid[i])
+			devices[out++] = std::move(devices[i]);
+	}
+
+	devices.resize(out);
+
+	FlushCapsCache();
+	RevalidateCaps(devices, ReadVideoCaps, StoreVideoCaps);
+	return true;
+}
+
+bool Device::EnumVideoDevices(std::vector<VideoDevice> &devices,
+			      EnumMode mode)
+{
+	devices.clear();
+
+	switch (mode) {
+	case EnumMode::Lazy:
+		return EnumDeviceMonikers(CLSID_VideoInputDeviceCategory,
+					  EnumMonikerCallback(ListVideoDevice),
+					  &devices);
+	case EnumMode::Parallel:
+		return EnumVideoDevicesParallel(devices);
+	default:
+		return EnumVideoDevices(devices);
+	}
+}
+
+void Device::EnumVideoDevicesAsync(EnumVideoDevicesProc callback,
+				   EnumMode mode)
+{
+	std::thread thread([callback, mode]() {
+		HRESULT hr = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
+		std::vector<VideoDevice> devices;
+
+		bool success = EnumVideoDevices(devices, mode);
+		callback(devices, success);
+
+		if (SUCCEEDED(hr))
+			CoUninitialize();
+	});
+
+	thread.detach();
+}
+
 static bool EnumAudioDevice(vector<AudioDevice> &devices, IBaseFilter *filter,
 			    const wchar_t *deviceName,
 			    const wchar_t *devicePath)
@@ -292,13 +635,18 @@ static bool EnumAudioDevice(vector<AudioDevice> &devices, IBaseFilter *filter,
 	if (!success)
 		return true;
 
-	if (!EnumAudioCaps(pin, info.caps))
-		return true;
-
 	info.name = deviceName;
 	if (devicePath)
 		info.path = devicePath;
 
+	if (!LookupAudioCaps(info)) {
+		if (!EnumAudioCaps(pin, info.caps))
+			return true;
+
+		TakeCapsRevalidation(info.path);
+		StoreAudioCaps(info);
+	}
+
 	devices.push_back(info);
 	return true;
 }
@@ -306,8 +654,54 @@ static bool EnumAudioDevice(vector<AudioDevice> &devices, IBaseFilter *filter,
 bool Device::EnumAudioDevices(vector<AudioDevice> &devices)
 {
 	devices.clear();
-	return EnumDevices(CLSID_AudioInputDeviceCategory,
-			   EnumDeviceCallback(EnumAudioDevice), &devices);
+	bool success = EnumDevices(CLSID_AudioInputDeviceCategory,
+				   EnumDeviceCallback(EnumAudioDevice),
+				   &devices);
+
+	FlushCapsCache();
+	RevalidateCaps(devices, ReadAudioCaps, StoreAudioCaps);
+	return success;
+}
+
+bool Device::EnumVideoDevicesCached(vector<VideoDevice> &devices,
+				    int maxAgeMs)
+{
+	return GetCachedVideoDevices(devices, maxAgeMs);
+}
+
+bool Device::EnumAudioDevicesCached(vector<AudioDevice> &devices,
+				    int maxAgeMs)
+{
+	return GetCachedAudioDevices(devices, maxAgeMs);
+}
+
+void Device::InvalidateDeviceCache()
+{
+	DShow::InvalidateDeviceCache();
+}
+
+void Device::SetCapsCacheFile(const wchar_t *path)
+{
+	DShow::SetCapsCacheFile(path);
+}
+
+bool Device::GetKnownConfig(const wstring &path, const wstring &mode,
+			    VideoConfig &config)
+{
+	return LookupKnownConfig(path, mode, config);
+}
+
+void Device::SetKnownConfig(const wstring &path, const wstring &mode,
+			    const VideoConfig &config)
+{
+	if (StoreKnownConfig(path, mode, config))
+		FlushCapsCache();
+}
+
+void Device::ForgetKnownConfig(const wstring &path, const wstring &mode)
+{
+	if (DShow::ForgetKnownConfig(path, mode))
+		FlushCapsCache();
 }
 
 }; /* namespace DShow */
@@ -81,6 +81,54 @@ bool VideoEncoder::Encode(unsigned char *data[DSHOW_MAX_PLANES],
 			       packet, new_packet);
 }
 
+bool VideoEncoder::GetInputBuffer(EncoderInputBuffer &buffer)
+{
+	if (context->encoder == nullptr)
+		return false;
+
+	return context->GetInputBuffer(buffer);
+}
+
+bool VideoEncoder::SubmitInputBuffer(long long timestampStart,
+				     long long timestampEnd,
+				     EncoderPacket &packet, bool &new_packet)
+{
+	if (context->encoder == nullptr)
+		return false;
+
+	return context->SubmitInputBuffer(timestampStart, timestampEnd, packet,
+					  new_packet);
+}
+
+bool VideoEncoder::SubmitInputBuffer(long long timestampStart,
+				     long long timestampEnd)
+{
+	if (context->encoder == nullptr)
+		return false;
+
+	return context->SubmitInputBuffer(timestampStart, timestampEnd);
+}
+
+void VideoEncoder::DiscardInputBuffer()
+{
+	if (context->encoder != nullptr)
+		context->DiscardInputBuffer();
+}
+
+void VideoEncoder::CountDroppedInput()
+{
+	context->CountDroppedInput();
+}
+
+bool VideoEncoder::GetStats(EncoderStats &stats) const
+{
+	if (context->encoder == nullptr)
+		return false;
+
+	context->GetStats(stats);
+	return true;
+}
+
 static bool EnumVideoEncoder(vector<DeviceId> &encoders, IBaseFilter *encoder,
 			     const wchar_t *deviceName,
 			     const wchar_t *devicePath)
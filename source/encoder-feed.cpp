@@ -0,0 +1,95 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "encoder-feed.hpp"
+#include "video-convert.hpp"
+
+namespace DShow {
+
+const wchar_t *EncoderFeedResultName(EncoderFeedResult result)
+{
+	switch (result) {
+	case EncoderFeedResult::Sent:
+		return L"sent";
+	case EncoderFeedResult::UnsupportedFormat:
+		return L"format can't be converted to YV12";
+	case EncoderFeedResult::ShortFrame:
+		return L"frame is smaller than its format requires";
+	case EncoderFeedResult::NoInputBuffer:
+		return L"no encoder input buffer";
+	case EncoderFeedResult::SizeMismatch:
+		return L"frame size doesn't match the encoder's";
+	case EncoderFeedResult::ConvertFailed:
+		return L"conversion failed";
+	case EncoderFeedResult::SubmitFailed:
+		return L"encoder didn't take the frame";
+	}
+
+	return L"unknown";
+}
+
+static EncoderFeedResult Feed(EncoderInput &encoder,
+			      const EncoderFeedFrame &frame)
+{
+	EncoderInputBuffer buffer;
+	const uint8_t *planes[DSHOW_MAX_PLANES];
+
+	if (!VFormatConvertsToYV12(frame.format, frame.cx, frame.cy))
+		return EncoderFeedResult::UnsupportedFormat;
+	if (!frame.frameSize || frame.frameSize > frame.size)
+		return EncoderFeedResult::ShortFrame;
+
+	if (!encoder.GetInputBuffer(buffer))
+		return EncoderFeedResult::NoInputBuffer;
+
+	/* the capture format can change under a running encoder */
+	if (buffer.format != VideoFormat::YV12 || buffer.cx != frame.cx ||
+	    buffer.cy != frame.cy) {
+		encoder.DiscardInputBuffer();
+		return EncoderFeedResult::SizeMismatch;
+	}
+
+	for (size_t i = 0; i < DSHOW_MAX_PLANES; i++)
+		planes[i] = frame.data + frame.offsets[i];
+
+	if (!ConvertToYV12(frame.format, planes, frame.linesize, buffer.cx,
+			   buffer.cy, buffer.data, buffer.linesize,
+			   frame.bottomUp)) {
+		encoder.DiscardInputBuffer();
+		return EncoderFeedResult::ConvertFailed;
+	}
+
+	if (!encoder.SubmitInputBuffer(frame.startTime, frame.stopTime)) {
+		encoder.DiscardInputBuffer();
+		return EncoderFeedResult::SubmitFailed;
+	}
+
+	return EncoderFeedResult::Sent;
+}
+
+EncoderFeedResult FeedEncoder(EncoderInput &encoder,
+			      const EncoderFeedFrame &frame)
+{
+	EncoderFeedResult result = Feed(encoder, frame);
+	if (result != EncoderFeedResult::Sent)
+		encoder.CountDroppedInput();
+	return result;
+}
+
+}; /* namespace DShow */
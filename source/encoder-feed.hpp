@@ -0,0 +1,83 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace DShow {
+
+/*
+ * The zero-copy input side of a video encoder, as VideoEncoder's
+ * GetInputBuffer/SubmitInputBuffer/DiscardInputBuffer, so captured frames
+ * can also be fed to a stand-in encoder.
+ */
+class EncoderInput {
+public:
+	virtual ~EncoderInput() {}
+
+	virtual bool GetInputBuffer(EncoderInputBuffer &buffer) = 0;
+	virtual bool SubmitInputBuffer(long long startTime,
+				       long long stopTime) = 0;
+	virtual void DiscardInputBuffer() = 0;
+
+	/* a frame never reached the encoder */
+	virtual void CountDroppedInput() = 0;
+};
+
+/* a captured frame; offsets/linesize/frameSize are from VFormatPlaneLayout */
+struct EncoderFeedFrame {
+	VideoFormat format;
+	int cx;
+	int cy;
+	bool bottomUp;
+
+	const uint8_t *data;
+	size_t size;
+
+	size_t frameSize;
+	size_t offsets[DSHOW_MAX_PLANES];
+	size_t linesize[DSHOW_MAX_PLANES];
+
+	long long startTime;
+	long long stopTime;
+};
+
+enum class EncoderFeedResult {
+	Sent,
+	UnsupportedFormat,
+	ShortFrame,
+	NoInputBuffer,
+	SizeMismatch,
+	ConvertFailed,
+	SubmitFailed,
+};
+
+const wchar_t *EncoderFeedResultName(EncoderFeedResult result);
+
+/* converts the frame straight into the encoder's input sample and submits
+ * it; anything other than Sent has released the sample and counted a
+ * dropped frame */
+EncoderFeedResult FeedEncoder(EncoderInput &encoder,
+			      const EncoderFeedFrame &frame);
+
+}; /* namespace DShow */
@@ -0,0 +1,184 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "encoder-packets.hpp"
+
+#include <string.h>
+#include <algorithm>
+
+namespace DShow {
+
+EncoderPacketQueue::EncoderPacketQueue()
+{
+	inputTimes.reserve(ENCODER_MAX_INPUT_TIMES);
+}
+
+void EncoderPacketQueue::SetFormat(VideoFormat format_)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	format = format_;
+}
+
+void EncoderPacketQueue::QueueInputTime(long long timestamp)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	/* frames the encoder swallowed would otherwise pile up forever */
+	if (inputTimes.size() >= ENCODER_MAX_INPUT_TIMES)
+		inputTimes.erase(inputTimes.begin());
+
+	inputTimes.push_back(timestamp);
+}
+
+/* encoders normally carry the input timestamp through to the output, so
+ * match on that, and fall back on submission order if they don't */
+long long EncoderPacketQueue::MatchInputTime(bool hasTime, long long timestamp)
+{
+	if (hasTime) {
+		auto it = std::find(inputTimes.begin(), inputTimes.end(),
+				    timestamp);
+		if (it != inputTimes.end()) {
+			inputTimes.erase(it);
+			return timestamp;
+		}
+	}
+
+	stats.unmatched++;
+
+	if (inputTimes.empty())
+		return timestamp;
+
+	long long pts = inputTimes.front();
+	inputTimes.erase(inputTimes.begin());
+	return pts;
+}
+
+void EncoderPacketQueue::Push(const unsigned char *data, size_t size,
+			      bool hasTime, long long timestamp)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	/* nobody is reading packets; drop the oldest rather than grow.  it
+	 * still takes its input time with it */
+	if (count == ENCODER_MAX_PACKETS) {
+		EncodedPacket &oldest = slots[head];
+		MatchInputTime(oldest.hasTime, oldest.timestamp);
+		head = (head + 1) % ENCODER_MAX_PACKETS;
+		count--;
+		stats.dropped++;
+	}
+
+	if (size > highWater)
+		highWater = size;
+
+	EncodedPacket &packet = slots[(head + count) % ENCODER_MAX_PACKETS];
+
+	/* grow straight to the high-water mark so that buffers settle */
+	if (packet.data.size() < size)
+		packet.data.resize(highWater);
+
+	packet.hasTime = hasTime;
+	packet.timestamp = hasTime ? timestamp : 0;
+	packet.size = size;
+	memcpy(packet.data.data(), data, size);
+	count++;
+
+	stats.packets++;
+	if ((long)count > stats.maxQueued)
+		stats.maxQueued = (long)count;
+}
+
+bool EncoderPacketQueue::Pop(EncoderPacket &packet)
+{
+	VideoFormat packetFormat;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (!count)
+			return false;
+
+		/* the previous packet's buffer goes back into the slot */
+		std::swap(current, slots[head]);
+		head = (head + 1) % ENCODER_MAX_PACKETS;
+		count--;
+
+		packet.pts = MatchInputTime(current.hasTime, current.timestamp);
+		packetFormat = format;
+	}
+
+	/* current is only replaced by the next Pop, from this thread */
+	BitstreamInfo info;
+	ParseBitstream(packetFormat, current.data.data(), current.size, info);
+
+	packet.data = current.data.data();
+	packet.size = current.size;
+	packet.dts = packet.pts;
+	packet.hasDts = false;
+	packet.keyframe = info.keyframe;
+	return true;
+}
+
+void EncoderPacketQueue::MakePacket(unsigned char *data, size_t size,
+				    bool hasTime, long long timestamp,
+				    EncoderPacket &packet)
+{
+	VideoFormat packetFormat;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		stats.packets++;
+		packet.pts = MatchInputTime(hasTime, hasTime ? timestamp : 0);
+		packetFormat = format;
+	}
+
+	BitstreamInfo info;
+	ParseBitstream(packetFormat, data, size, info);
+
+	packet.data = data;
+	packet.size = size;
+	packet.dts = 0;
+	packet.hasDts = false;
+	packet.keyframe = info.keyframe;
+}
+
+void EncoderPacketQueue::CountDroppedInput()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	stats.inputDropped++;
+}
+
+void EncoderPacketQueue::GetStats(EncoderStats &stats_) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	stats_ = stats;
+	stats_.queued = (long)count;
+	stats_.pooledBuffers = 0;
+	stats_.bufferSize = highWater;
+
+	/* free slots that hold on to a buffer for the next packets */
+	for (size_t i = count; i < ENCODER_MAX_PACKETS; i++) {
+		if (!slots[(head + i) % ENCODER_MAX_PACKETS].data.empty())
+			stats_.pooledBuffers++;
+	}
+}
+
+}; /* namespace DShow */
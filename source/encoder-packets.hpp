@@ -0,0 +1,92 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+
+#include <stddef.h>
+#include <mutex>
+#include <vector>
+
+#define ENCODER_MAX_PACKETS 32
+#define ENCODER_MAX_INPUT_TIMES (ENCODER_MAX_PACKETS * 2)
+
+namespace DShow {
+
+/* buffers are recycled, so data can be larger than the packet itself */
+struct EncodedPacket {
+	std::vector<unsigned char> data;
+	size_t size = 0;
+	long long timestamp = 0;
+	bool hasTime = false;
+};
+
+/*
+ * Packets coming back from a video encoder, and the timestamps of the frames
+ * sent to it.  Queued packets live in a fixed ring of slots that keep their
+ * buffers, which grow straight to the largest packet seen, so once that size
+ * has settled neither pushing nor popping allocates.  All calls lock
+ * internally: the encoder's thread pushes, the caller's thread pops.
+ */
+class EncoderPacketQueue {
+	mutable std::mutex mutex;
+
+	EncodedPacket slots[ENCODER_MAX_PACKETS];
+	size_t head = 0;
+	size_t count = 0;
+
+	/* handed out by the last Pop; its data is valid until the next */
+	EncodedPacket current;
+	size_t highWater = 0;
+
+	/* frames sent to the encoder but not yet returned, oldest first */
+	std::vector<long long> inputTimes;
+
+	EncoderStats stats;
+	VideoFormat format = VideoFormat::H264;
+
+	long long MatchInputTime(bool hasTime, long long timestamp);
+
+public:
+	EncoderPacketQueue();
+
+	/* the encoder's output format, for finding keyframes */
+	void SetFormat(VideoFormat format);
+
+	/* a frame with this start time was sent to the encoder */
+	void QueueInputTime(long long timestamp);
+
+	/* copies a packet in; when full, the oldest one is dropped */
+	void Push(const unsigned char *data, size_t size, bool hasTime,
+		  long long timestamp);
+
+	/* the oldest packet, with the input time it matched as pts */
+	bool Pop(EncoderPacket &packet);
+
+	/* describes a packet that isn't queued, for packetCallback; data
+	 * isn't copied, and dts is left unset */
+	void MakePacket(unsigned char *data, size_t size, bool hasTime,
+			long long timestamp, EncoderPacket &packet);
+
+	void CountDroppedInput();
+	void GetStats(EncoderStats &stats) const;
+};
+
+}; /* namespace DShow */
@@ -18,6 +18,8 @@
  */
 
 #include "encoder.hpp"
+#include "dshow-formats.hpp"
+#include "video-convert.hpp"
 #include "log.hpp"
 #include "avermedia-encode.h"
 
@@ -146,7 +148,8 @@ bool HVideoEncoder::SetupCrossbar()
 		Warning(L"Failed to get Analog Video In pin medium");
 		return false;
 	}
-	if (!GetFilterByMedium(AM_KSCATEGORY_CROSSBAR, medium, &crossbar)) {
+	if (!GetFilterByMedium(AM_KSCATEGORY_CROSSBAR, medium, &crossbar,
+			       &monikers)) {
 		Warning(L"Failed to get crossbar filter");
 		return false;
 	}
@@ -186,7 +189,7 @@ bool HVideoEncoder::SetupEncoder(IBaseFilter *filter)
 	inputPin.Release();
 
 	if (!GetFilterByMedium(CLSID_VideoInputDeviceCategory, medium,
-			       &deviceFilter)) {
+			       &deviceFilter, &monikers)) {
 		Warning(L"Could not get device filter from medium");
 		return false;
 	}
@@ -202,6 +205,17 @@ bool HVideoEncoder::SetupEncoder(IBaseFilter *filter)
 		Warning(L"Could not get encoder output pin media type");
 		return false;
 	}
+	if (!VFormatConvertsToYV12(config.inputFormat, config.cx, config.cy)) {
+		Warning(L"Cannot convert %dx%d input of format %d to YV12",
+			config.cx, config.cy, (int)config.inputFormat);
+		return false;
+	}
+
+	/* the AVerMedia encoders this is used with only produce H.264 */
+	VideoFormat outputFormat;
+	if (!GetMediaTypeVFormat(*mtEncoded, outputFormat))
+		outputFormat = VideoFormat::H264;
+	packets.SetFormat(outputFormat);
 
 	PinCaptureInfo captureInfo;
 	captureInfo.callback = [this](IMediaSample *s) { Receive(s); };
@@ -317,8 +331,17 @@ bool HVideoEncoder::SetConfig(VideoEncoderConfig &config)
 		return false;
 	}
 
+	if (!VFormatConvertsToYV12(config.inputFormat)) {
+		Warning(L"Unsupported video encoder input format %d",
+			(int)config.inputFormat);
+		return false;
+	}
+
+	monikers.Clear();
+
 	bool success = GetDeviceFilter(KSCATEGORY_ENCODER, config.name.c_str(),
-				       config.path.c_str(), &filter);
+				       config.path.c_str(), &filter,
+				       &monikers);
 	if (!success) {
 		Warning(L"Video encoder '%s': %s not found",
 			config.name.c_str(), config.path.c_str());
@@ -349,6 +372,8 @@ bool HVideoEncoder::SetConfig(VideoEncoderConfig &config)
 		return false;
 	}
 
+	monikers.Clear();
+
 	LogFilters(graph);
 
 	HRESULT hr = control->Run();
@@ -373,9 +398,27 @@ void HVideoEncoder::Receive(IMediaSample *s)
 	if (!size)
 		return;
 
-	packetMutex.lock();
-	packets.emplace_back(data, size);
-	packetMutex.unlock();
+	if (config.packetCallback) {
+		PushPacket(s, data, size);
+		return;
+	}
+
+	REFERENCE_TIME start = 0, stop = 0;
+	bool hasTime = SUCCEEDED(s->GetTime(&start, &stop));
+	packets.Push(data, size, hasTime, start);
+}
+
+/* hands the sample's data straight to the callback, without a copy */
+void HVideoEncoder::PushPacket(IMediaSample *s, unsigned char *data,
+			       size_t size)
+{
+	REFERENCE_TIME start = 0, stop = 0;
+	EncoderPacket packet;
+
+	bool hasTime = SUCCEEDED(s->GetTime(&start, &stop));
+	packets.MakePacket(data, size, hasTime, start, packet);
+
+	config.packetCallback(packet);
 }
 
 bool HVideoEncoder::Encode(unsigned char *data[DSHOW_MAX_PLANES],
@@ -385,27 +428,114 @@ bool HVideoEncoder::Encode(unsigned char *data[DSHOW_MAX_PLANES],
 {
 	new_packet = false;
 
-	if (!active)
+	if (!active || inputLocked)
 		return false;
 
+	if (config.inputFormat != VideoFormat::YV12)
+		return EncodeConverted(data, linesize, timestampStart,
+				       timestampEnd, packet, new_packet);
+
+	packets.QueueInputTime(timestampStart);
 	output->Send(data, linesize, timestampStart, timestampEnd);
-	ptsVals.push_back(timestampStart);
-
-	packetMutex.lock();
-	if (packets.size() > 0) {
-		curPacket = move(packets.front());
-		long long ptsOut = ptsVals[0];
-		packets.pop_front();
-		ptsVals.pop_front();
-
-		packet.data = curPacket.data.data();
-		packet.size = curPacket.data.size();
-		packet.pts = ptsOut;
-		packet.dts = ptsOut;
-		new_packet = true;
+
+	GetPacket(packet, new_packet);
+	return true;
+}
+
+/* converts into the locked sample, rather than through a temporary */
+bool HVideoEncoder::EncodeConverted(unsigned char *data[DSHOW_MAX_PLANES],
+				    size_t linesize[DSHOW_MAX_PLANES],
+				    long long timestampStart,
+				    long long timestampEnd,
+				    EncoderPacket &packet, bool &new_packet)
+{
+	EncoderInputBuffer buffer;
+
+	if (!GetInputBuffer(buffer))
+		return false;
+
+	if (!ConvertToYV12(config.inputFormat, data, linesize, buffer.cx,
+			   buffer.cy, buffer.data, buffer.linesize)) {
+		DiscardInputBuffer();
+		return false;
 	}
-	packetMutex.unlock();
+
+	return SubmitInputBuffer(timestampStart, timestampEnd, packet,
+				 new_packet);
+}
+
+bool HVideoEncoder::GetInputBuffer(EncoderInputBuffer &buffer)
+{
+	size_t offsets[DSHOW_MAX_PLANES];
+	unsigned char *ptr;
+
+	if (!active || inputLocked)
+		return false;
+	if (!output->LockSampleData(&ptr))
+		return false;
+
+	buffer.format = output->GetVideoFormat();
+	buffer.cx = output->GetCX();
+	buffer.cy = output->GetCY();
+	buffer.size = VFormatPlaneLayout(buffer.format, buffer.cx, buffer.cy,
+					 offsets, buffer.linesize);
+
+	for (size_t i = 0; i < DSHOW_MAX_PLANES; i++)
+		buffer.data[i] = buffer.linesize[i] ? ptr + offsets[i]
+						    : nullptr;
+
+	inputLocked = true;
 	return true;
 }
 
+bool HVideoEncoder::SubmitInputBuffer(long long timestampStart,
+				      long long timestampEnd)
+{
+	if (!active || !inputLocked)
+		return false;
+
+	inputLocked = false;
+	packets.QueueInputTime(timestampStart);
+	output->UnlockSampleData(timestampStart, timestampEnd);
+	return true;
+}
+
+bool HVideoEncoder::SubmitInputBuffer(long long timestampStart,
+				      long long timestampEnd,
+				      EncoderPacket &packet, bool &new_packet)
+{
+	new_packet = false;
+
+	if (!SubmitInputBuffer(timestampStart, timestampEnd))
+		return false;
+
+	GetPacket(packet, new_packet);
+	return true;
+}
+
+void HVideoEncoder::DiscardInputBuffer()
+{
+	if (!inputLocked)
+		return;
+
+	inputLocked = false;
+	output->DiscardSampleData();
+}
+
+void HVideoEncoder::CountDroppedInput()
+{
+	packets.CountDroppedInput();
+}
+
+void HVideoEncoder::GetPacket(EncoderPacket &packet, bool &new_packet)
+{
+	if (packets.Pop(packet))
+		new_packet = true;
+}
+
+void HVideoEncoder::GetStats(EncoderStats &stats)
+{
+	packets.GetStats(stats);
+}
+
 };
@@ -22,25 +22,12 @@
 #include "../dshowcapture.hpp"
 #include "output-filter.hpp"
 #include "capture-filter.hpp"
+#include "encoder-packets.hpp"
 
 #include <string>
 #include <vector>
-#include <deque>
-#include <mutex>
 using namespace std;
 
-struct EncodedData {
-	vector<unsigned char> data;
-
-	inline EncodedData() = default;
-
-	inline EncodedData(unsigned char *data_, size_t size)
-	{
-		data.resize(size);
-		memcpy(data.data(), data_, size);
-	}
-};
-
 namespace DShow {
 
 struct HVideoEncoder {
@@ -55,14 +42,14 @@ struct HVideoEncoder {
 
 	VideoEncoderConfig config;
 
-	mutex packetMutex;
-	deque<EncodedData> packets;
-	EncodedData curPacket;
+	/* device monikers, shared by the lookups while setting up */
+	MonikerIndex monikers;
 
-	deque<long long> ptsVals;
+	EncoderPacketQueue packets;
 
 	bool initialized = false;
 	bool active = false;
+	bool inputLocked = false;
 
 	HVideoEncoder();
 	~HVideoEncoder();
@@ -81,6 +68,25 @@ struct HVideoEncoder {
 		    size_t linesize[DSHOW_MAX_PLANES], long long timestampStart,
 		    long long timestampEnd, EncoderPacket &packet,
 		    bool &new_packet);
+
+	bool EncodeConverted(unsigned char *frame[DSHOW_MAX_PLANES],
+			     size_t linesize[DSHOW_MAX_PLANES],
+			     long long timestampStart, long long timestampEnd,
+			     EncoderPacket &packet, bool &new_packet);
+
+	bool GetInputBuffer(EncoderInputBuffer &buffer);
+	bool SubmitInputBuffer(long long timestampStart,
+			       long long timestampEnd, EncoderPacket &packet,
+			       bool &new_packet);
+	bool SubmitInputBuffer(long long timestampStart,
+			       long long timestampEnd);
+	void DiscardInputBuffer();
+	void CountDroppedInput();
+	void GetPacket(EncoderPacket &packet, bool &new_packet);
+
+	void GetStats(EncoderStats &stats);
+
+	void PushPacket(IMediaSample *s, unsigned char *data, size_t size);
 };
 
 };
@@ -19,6 +19,7 @@
 
 #include "output-filter.hpp"
 #include "dshow-formats.hpp"
+#include "video-convert.hpp"
 #include "log.hpp"
 
 #include <strsafe.h>
@@ -548,10 +549,10 @@ bool OutputPin::LockSampleData(unsigned char **ptr)
 	if (FAILED(sample->GetPointer(ptr)))
 		return false;
 
-	if (setSampleMediaType) {
+	/* cleared once the sample is delivered, so that a discarded sample
+	 * doesn't take the format change with it */
+	if (setSampleMediaType)
 		sample->SetMediaType(mt);
-		setSampleMediaType = false;
-	}
 
 	return true;
 }
@@ -560,17 +561,57 @@ void OutputPin::Send(unsigned char *data[DSHOW_MAX_PLANES],
 		     size_t linesize[DSHOW_MAX_PLANES],
 		     long long timestampStart, long long timestampEnd)
 {
+	size_t offsets[DSHOW_MAX_PLANES];
+	size_t rowBytes[DSHOW_MAX_PLANES];
+	size_t total = VFormatPlaneLayout(curVFormat, curCX, abs(curCY),
+					  offsets, rowBytes);
 	BYTE *ptr;
+
+	/* a known layout that doesn't fit the negotiated buffer means the
+	 * caller's frame doesn't match the format, so it isn't sent */
+	if (total > bufSize)
+		return;
+
 	if (!LockSampleData(&ptr))
 		return;
 
-	size_t total = 0;
+	/* formats without a known layout are just concatenated, as long as
+	 * the planes fit */
+	if (!total) {
+		for (size_t i = 0; i < DSHOW_MAX_PLANES; i++) {
+			if (!linesize[i])
+				break;
+
+			if (linesize[i] > bufSize - total) {
+				DiscardSampleData();
+				return;
+			}
+
+			memcpy(ptr + total, data[i], linesize[i]);
+			total += linesize[i];
+		}
+
+		UnlockSampleData(timestampStart, timestampEnd);
+		return;
+	}
+
 	for (size_t i = 0; i < DSHOW_MAX_PLANES; i++) {
-		if (!linesize[i])
+		if (!linesize[i] || !rowBytes[i])
 			break;
 
-		memcpy(ptr + total, data[i], linesize[i]);
-		total += linesize[i];
+		size_t end = (i + 1 < DSHOW_MAX_PLANES && rowBytes[i + 1])
+				     ? offsets[i + 1]
+				     : total;
+		size_t rows = (end - offsets[i]) / rowBytes[i];
+
+		/* linesize used to be the size of the whole plane, which is
+		 * still accepted from callers that pass packed planes */
+		size_t stride = linesize[i];
+		if (stride == rowBytes[i] * rows)
+			stride = rowBytes[i];
+
+		CopyPlane(ptr + offsets[i], rowBytes[i], data[i], stride,
+			  rowBytes[i], rows);
 	}
 
 	UnlockSampleData(timestampStart, timestampEnd);
@@ -590,10 +631,16 @@ void OutputPin::UnlockSampleData(long long timestampStart,
 	sample->SetTime(&startTime, &endTime);
 
 	memInput->Receive(sample);
+	setSampleMediaType = false;
 
 	sample.Clear();
 }
 
+void OutputPin::DiscardSampleData()
+{
+	sample.Clear();
+}
+
 void OutputPin::Stop()
 {
 	if (!!connectedPin) {
@@ -125,6 +125,7 @@ public:
 
 	bool LockSampleData(unsigned char **ptr);
 	void UnlockSampleData(long long timestampStart, long long timestampEnd);
+	void DiscardSampleData();
 
 	void Stop();
 };
@@ -212,6 +213,8 @@ public:
 	{
 		pin->UnlockSampleData(timestampStart, timestampEnd);
 	}
+
+	inline void DiscardSampleData() { pin->DiscardSampleData(); }
 };
 
 class OutputEnumPins : public IEnumPins {
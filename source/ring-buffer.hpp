@@ -0,0 +1,119 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+namespace DShow {
+
+/*
+ * Single producer, single consumer ring buffer.  Push may only be called
+ * from one thread and Pop from one (other) thread; neither takes a lock.
+ */
+template<typename T> class RingBuffer {
+	std::vector<T> items;
+	size_t mask = 0;
+
+	std::atomic<size_t> head{0}; /* next write, owned by the producer */
+	std::atomic<size_t> tail{0}; /* next read, owned by the consumer */
+
+public:
+	explicit RingBuffer(size_t capacity)
+	{
+		size_t size = 1;
+		while (size < capacity)
+			size <<= 1;
+
+		items.resize(size);
+		mask = size - 1;
+	}
+
+	inline size_t Capacity() const { return items.size(); }
+
+	inline size_t Size() const
+	{
+		return head.load(std::memory_order_acquire) -
+		       tail.load(std::memory_order_acquire);
+	}
+
+	bool Push(T &&item)
+	{
+		size_t pos = head.load(std::memory_order_relaxed);
+		if (pos - tail.load(std::memory_order_acquire) == items.size())
+			return false;
+
+		items[pos & mask] = std::move(item);
+		head.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Pop(T &item)
+	{
+		size_t pos = tail.load(std::memory_order_relaxed);
+		if (pos == head.load(std::memory_order_acquire))
+			return false;
+
+		item = std::move(items[pos & mask]);
+		tail.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/* bulk versions, return the number of items actually written/read */
+	size_t Write(const T *data, size_t count)
+	{
+		size_t pos = head.load(std::memory_order_relaxed);
+		size_t space = items.size() -
+			       (pos - tail.load(std::memory_order_acquire));
+		if (count > space)
+			count = space;
+
+		size_t start = pos & mask;
+		size_t first = std::min(count, items.size() - start);
+		std::copy(data, data + first, items.begin() + start);
+		std::copy(data + first, data + count, items.begin());
+
+		head.store(pos + count, std::memory_order_release);
+		return count;
+	}
+
+	size_t Read(T *data, size_t count)
+	{
+		size_t pos = tail.load(std::memory_order_relaxed);
+		size_t avail = head.load(std::memory_order_acquire) - pos;
+		if (count > avail)
+			count = avail;
+
+		size_t start = pos & mask;
+		size_t first = std::min(count, items.size() - start);
+		std::copy(items.begin() + start, items.begin() + start + first,
+			  data);
+		std::copy(items.begin(), items.begin() + (count - first),
+			  data + first);
+
+		tail.store(pos + count, std::memory_order_release);
+		return count;
+	}
+};
+
+}; /* namespace DShow */
@@ -0,0 +1,314 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#include "sync-group.hpp"
+#include "log.hpp"
+
+#include <limits.h>
+
+namespace DShow {
+
+HSyncGroup::HSyncGroup(const SyncGroupConfig &config_) : config(config_)
+{
+	if (!config.queueSize)
+		config.queueSize = 1;
+
+	wakeEvent = CreateEvent(nullptr, false, false, nullptr);
+	thread = std::thread(&HSyncGroup::SyncThread, this);
+}
+
+HSyncGroup::~HSyncGroup()
+{
+	Shutdown();
+	CloseHandle(wakeEvent);
+}
+
+/* devices can outlive the group, so this is what destroying the group does;
+ * Push ignores frames from then on, and frames already queued are released
+ * so their samples go back to the devices.
+ *
+ * a Push that checked stopping just before it was set can still be about
+ * to write into its ring, so the drain waits for those to finish first.
+ * Push raises pushing before it reads stopping, and this sets stopping
+ * before it reads pushing (both sequentially consistent), so either Push
+ * sees stopping or this sees the Push */
+void HSyncGroup::Shutdown()
+{
+	stopping = true;
+	SetEvent(wakeEvent);
+
+	if (thread.joinable())
+		thread.join();
+
+	while (pushing.load() != 0)
+		std::this_thread::yield();
+
+	int count = streamCount.load(std::memory_order_acquire);
+	SyncEntry entry;
+
+	for (int i = 0; i < count; i++) {
+		while (streams[i]->incoming.Pop(entry))
+			entry.frame = VideoFrame();
+		streams[i]->pending.clear();
+	}
+
+	std::lock_guard<std::mutex> lock(setMutex);
+	sets.clear();
+}
+
+int HSyncGroup::AddStream()
+{
+	std::lock_guard<std::mutex> lock(addMutex);
+
+	int index = streamCount.load();
+	if (index == SYNC_GROUP_MAX_STREAMS) {
+		Warning(L"SyncGroup::AddStream: too many streams");
+		return -1;
+	}
+
+	streams[index].reset(new SyncStream(config.queueSize));
+	streamCount.store(index + 1, std::memory_order_release);
+	return index;
+}
+
+void HSyncGroup::Push(int stream, VideoFrame &&frame)
+{
+	PushScope scope(pushing);
+
+	if (stopping)
+		return;
+	if (stream < 0 || stream >= streamCount.load(std::memory_order_acquire))
+		return;
+
+	SyncEntry entry;
+	entry.time = frame.PresentationTime();
+	if (!entry.time)
+		entry.time = frame.HostTime();
+	entry.frame = std::move(frame);
+
+	if (!streams[stream]->incoming.Push(std::move(entry))) {
+		droppedFrames++;
+		return;
+	}
+
+	SetEvent(wakeEvent);
+}
+
+void HSyncGroup::Output(std::vector<VideoFrame> &frames)
+{
+	if (config.callback) {
+		config.callback(frames);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(setMutex);
+
+	if (sets.size() >= config.queueSize) {
+		sets.pop_front();
+		droppedSets++;
+	}
+
+	sets.push_back(std::move(frames));
+	setAvailable.notify_one();
+}
+
+/*
+ * Linear merge of the per-stream queues.  Each stream is in time order, so
+ * the only candidate set is the front of every queue: if the fronts are
+ * within tolerance they form a set, otherwise the oldest front can never
+ * be matched and is dropped.  Streams without frames hold the merge back
+ * until maxWait expires.
+ */
+void HSyncGroup::Merge(int count, long long now)
+{
+	for (;;) {
+		long long oldest = LLONG_MAX;
+		long long newest = LLONG_MIN;
+		int oldestStream = -1;
+		bool complete = true;
+
+		for (int i = 0; i < count; i++) {
+			std::deque<SyncEntry> &pending = streams[i]->pending;
+			if (pending.empty()) {
+				complete = false;
+				continue;
+			}
+
+			long long time = pending.front().time;
+			if (time < oldest) {
+				oldest = time;
+				oldestStream = i;
+			}
+			if (time > newest)
+				newest = time;
+		}
+
+		if (oldestStream == -1)
+			return;
+
+		if (complete && newest - oldest > config.tolerance) {
+			streams[oldestStream]->pending.pop_front();
+			droppedFrames++;
+			continue;
+		}
+
+		if (!complete && now - oldest < config.maxWait)
+			return;
+
+		std::vector<VideoFrame> frames(count);
+		long long taken = 0;
+
+		for (int i = 0; i < count; i++) {
+			std::deque<SyncEntry> &pending = streams[i]->pending;
+			if (pending.empty() ||
+			    pending.front().time - oldest > config.tolerance)
+				continue;
+
+			frames[i] = std::move(pending.front().frame);
+			pending.pop_front();
+			taken++;
+		}
+
+		if (complete) {
+			completeSets++;
+		} else if (config.deliverPartialSets) {
+			partialSets++;
+		} else {
+			droppedSets++;
+			droppedFrames += taken;
+			continue;
+		}
+
+		Output(frames);
+	}
+}
+
+void HSyncGroup::SyncThread()
+{
+	/* wake up regularly so incomplete sets time out */
+	DWORD interval = (DWORD)(config.maxWait / 40000);
+	if (interval < 1)
+		interval = 1;
+
+	while (!stopping) {
+		WaitForSingleObject(wakeEvent, interval);
+
+		int count = streamCount.load(std::memory_order_acquire);
+		SyncEntry entry;
+
+		for (int i = 0; i < count; i++) {
+			SyncStream *stream = streams[i].get();
+			while (stream->incoming.Pop(entry)) {
+				/* a stream running ahead of the others would
+				 * otherwise hold on to every frame until
+				 * maxWait lets the merge through */
+				if (stream->pending.size() >= config.queueSize) {
+					stream->pending.pop_front();
+					droppedFrames++;
+				}
+				stream->pending.push_back(std::move(entry));
+			}
+		}
+
+		if (count)
+			Merge(count, GetHostTime());
+	}
+}
+
+// ============================================================================
+
+SyncGroup::SyncGroup(const SyncGroupConfig &config)
+{
+	std::shared_ptr<HSyncGroup> group =
+		std::make_shared<HSyncGroup>(config);
+
+	context = group.get();
+	context->self = std::move(group);
+}
+
+SyncGroup::~SyncGroup()
+{
+	std::shared_ptr<HSyncGroup> group = std::move(context->self);
+	group->Shutdown();
+}
+
+int SyncGroup::AddDevice(VideoConfig &config)
+{
+	int stream = context->AddStream();
+	if (stream == -1)
+		return -1;
+
+	std::shared_ptr<HSyncGroup> group = context->self;
+	VideoFrameProc previous = config.frameCallback;
+
+	config.frameCallback = [group, stream, previous](
+				       const VideoConfig &deviceConfig,
+				       VideoFrame &&frame) {
+		/* frameCallback replaces callback, so keep calling
+		 * whichever one was in use */
+		if (previous)
+			previous(deviceConfig, VideoFrame(frame));
+		else if (deviceConfig.callback)
+			deviceConfig.callback(deviceConfig,
+					      (unsigned char *)frame.Data(),
+					      frame.Size(), frame.StartTime(),
+					      frame.StopTime(),
+					      frame.Rotation());
+
+		group->Push(stream, std::move(frame));
+	};
+
+	return stream;
+}
+
+int SyncGroup::AddStream()
+{
+	return context->AddStream();
+}
+
+void SyncGroup::Push(int stream, VideoFrame &&frame)
+{
+	context->Push(stream, std::move(frame));
+}
+
+bool SyncGroup::GetFrameSet(std::vector<VideoFrame> &frames,
+			    unsigned long timeoutMs)
+{
+	std::unique_lock<std::mutex> lock(context->setMutex);
+
+	if (!context->setAvailable.wait_for(
+		    lock, std::chrono::milliseconds(timeoutMs),
+		    [this]() { return !context->sets.empty(); }))
+		return false;
+
+	frames = std::move(context->sets.front());
+	context->sets.pop_front();
+	return true;
+}
+
+void SyncGroup::GetStats(SyncGroupStats &stats) const
+{
+	stats.completeSets = context->completeSets;
+	stats.partialSets = context->partialSets;
+	stats.droppedSets = context->droppedSets;
+	stats.droppedFrames = context->droppedFrames;
+}
+
+}; /* namespace DShow */
@@ -0,0 +1,105 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+#include "ring-buffer.hpp"
+
+#include <windows.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#define SYNC_GROUP_MAX_STREAMS 16
+
+namespace DShow {
+
+struct SyncEntry {
+	VideoFrame frame;
+	long long time = 0;
+};
+
+struct SyncStream {
+	/* filled by the capture thread, drained by the sync thread */
+	RingBuffer<SyncEntry> incoming;
+
+	/* only touched by the sync thread, at most queueSize entries */
+	std::deque<SyncEntry> pending;
+
+	inline SyncStream(size_t queueSize) : incoming(queueSize) {}
+};
+
+struct HSyncGroup {
+	SyncGroupConfig config;
+
+	/* the SyncGroup's reference; the callbacks hooked by AddDevice hold
+	 * their own, as devices may still call them after the group is
+	 * destroyed */
+	std::shared_ptr<HSyncGroup> self;
+
+	/* streams are only ever appended; the count is published after the
+	 * stream is created so Push never needs a lock */
+	std::unique_ptr<SyncStream> streams[SYNC_GROUP_MAX_STREAMS];
+	std::atomic<int> streamCount{0};
+	std::mutex addMutex;
+
+	HANDLE wakeEvent = nullptr;
+	std::thread thread;
+	std::atomic<bool> stopping{false};
+
+	/* number of Push calls in progress, see Shutdown */
+	std::atomic<int> pushing{0};
+
+	struct PushScope {
+		std::atomic<int> &count;
+		inline PushScope(std::atomic<int> &count_) : count(count_)
+		{
+			count++;
+		}
+		inline ~PushScope() { count--; }
+	};
+
+	mutable std::mutex setMutex;
+	std::condition_variable setAvailable;
+	std::deque<std::vector<VideoFrame>> sets;
+
+	std::atomic<long long> completeSets{0};
+	std::atomic<long long> partialSets{0};
+	std::atomic<long long> droppedSets{0};
+	std::atomic<long long> droppedFrames{0};
+
+	HSyncGroup(const SyncGroupConfig &config);
+	~HSyncGroup();
+
+	void Shutdown();
+	int AddStream();
+	void Push(int stream, VideoFrame &&frame);
+
+	void SyncThread();
+	void Merge(int count, long long now);
+	void Output(std::vector<VideoFrame> &frames);
+};
+
+}; /* namespace DShow */
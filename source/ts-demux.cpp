@@ -0,0 +1,359 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#include "ts-demux.hpp"
+
+#include <string.h>
+
+#define TS_SYNC_BYTE 0x47
+#define TS_TIMESTAMP_WRAP (1LL << 33)
+
+/* PES stream IDs that have no optional header */
+#define PES_PROGRAM_STREAM_MAP 0xBC
+#define PES_PADDING_STREAM 0xBE
+#define PES_PRIVATE_STREAM_2 0xBF
+#define PES_ECM_STREAM 0xF0
+#define PES_EMM_STREAM 0xF1
+#define PES_DIRECTORY_STREAM 0xFF
+
+namespace DShow {
+
+static inline long long ReadTimestamp(const unsigned char *p)
+{
+	return ((long long)(p[0] & 0x0E) << 29) | ((long long)p[1] << 22) |
+	       ((long long)(p[2] & 0xFE) << 14) | ((long long)p[3] << 7) |
+	       ((long long)p[4] >> 1);
+}
+
+static inline bool HasPESHeader(unsigned char streamId)
+{
+	return streamId != PES_PROGRAM_STREAM_MAP &&
+	       streamId != PES_PADDING_STREAM &&
+	       streamId != PES_PRIVATE_STREAM_2 &&
+	       streamId != PES_ECM_STREAM && streamId != PES_EMM_STREAM &&
+	       streamId != PES_DIRECTORY_STREAM;
+}
+
+bool TSDemuxer::AddStream(int pid)
+{
+	if (FindStream(pid))
+		return true;
+	if (streamCount == TS_MAX_STREAMS)
+		return false;
+
+	Stream &stream = streams[streamCount++];
+	stream = Stream();
+	stream.pid = pid;
+	return true;
+}
+
+void TSDemuxer::Clear()
+{
+	for (int i = 0; i < streamCount; i++)
+		streams[i] = Stream();
+	streamCount = 0;
+	Reset();
+}
+
+void TSDemuxer::Reset()
+{
+	for (int i = 0; i < streamCount; i++) {
+		Stream &stream = streams[i];
+		stream.continuity = -1;
+		stream.started = false;
+		stream.pes.clear();
+		stream.lastTimestamp = -1;
+		stream.wrapOffset = 0;
+	}
+
+	partialSize = 0;
+	locked = false;
+	stats = TSDemuxStats();
+}
+
+TSDemuxer::Stream *TSDemuxer::FindStream(int pid)
+{
+	for (int i = 0; i < streamCount; i++) {
+		if (streams[i].pid == pid)
+			return &streams[i];
+	}
+
+	return nullptr;
+}
+
+long long TSDemuxer::Unwrap(Stream &stream, long long timestamp)
+{
+	if (stream.lastTimestamp >= 0) {
+		long long delta = timestamp - stream.lastTimestamp;
+
+		if (delta < -TS_TIMESTAMP_WRAP / 2)
+			stream.wrapOffset += TS_TIMESTAMP_WRAP;
+		else if (delta > TS_TIMESTAMP_WRAP / 2)
+			stream.wrapOffset -= TS_TIMESTAMP_WRAP;
+	}
+
+	stream.lastTimestamp = timestamp;
+	return timestamp + stream.wrapOffset;
+}
+
+void TSDemuxer::Emit(Stream &stream)
+{
+	const unsigned char *pes = stream.pes.data();
+	size_t size = stream.pes.size();
+
+	stream.started = false;
+
+	if (size < 6 || pes[0] != 0 || pes[1] != 0 || pes[2] != 1)
+		return;
+
+	TSPacket packet = {};
+	packet.pid = stream.pid;
+	packet.randomAccess = stream.randomAccess;
+
+	size_t offset = 6;
+
+	if (HasPESHeader(pes[3])) {
+		if (size < 9)
+			return;
+
+		int flags = pes[7] >> 6;
+		size_t headerSize = pes[8];
+		if (9 + headerSize > size)
+			return;
+
+		long long pts = 0;
+
+		if ((flags & 2) && headerSize >= 5) {
+			pts = Unwrap(stream, ReadTimestamp(pes + 9));
+			packet.pts = pts * 1000 / 9;
+			packet.hasPts = true;
+		}
+		if (flags == 3 && headerSize >= 10) {
+			/* DTS trails the PTS, so it can still be on the other
+			 * side of a wrap the PTS has already gone through */
+			long long dts = ReadTimestamp(pes + 14) +
+					stream.wrapOffset;
+			if (dts - pts > TS_TIMESTAMP_WRAP / 2)
+				dts -= TS_TIMESTAMP_WRAP;
+			else if (pts - dts > TS_TIMESTAMP_WRAP / 2)
+				dts += TS_TIMESTAMP_WRAP;
+
+			packet.dts = dts * 1000 / 9;
+			packet.hasDts = true;
+		}
+
+		offset = 9 + headerSize;
+	}
+
+	/* bounded packets may have been padded out by the last TS packet */
+	size_t length = ((size_t)pes[4] << 8) | pes[5];
+	if (length && 6 + length < size)
+		size = 6 + length;
+
+	if (offset >= size)
+		return;
+
+	packet.data = pes + offset;
+	packet.size = size - offset;
+	stats.pesPackets++;
+
+	if (callback)
+		callback(packet);
+}
+
+void TSDemuxer::ParsePacket(const unsigned char *packet)
+{
+	stats.packets++;
+
+	/* transport error indicator */
+	if (packet[1] & 0x80)
+		return;
+
+	bool unitStart = (packet[1] & 0x40) != 0;
+	int pid = ((packet[1] & 0x1F) << 8) | packet[2];
+	int adaptation = (packet[3] >> 4) & 3;
+	int continuity = packet[3] & 0xF;
+
+	Stream *stream = FindStream(pid);
+	if (!stream)
+		return;
+
+	size_t offset = 4;
+	bool discontinuity = false;
+	bool randomAccess = false;
+
+	if (adaptation & 2) {
+		size_t length = packet[4];
+		if (length) {
+			discontinuity = (packet[5] & 0x80) != 0;
+			randomAccess = (packet[5] & 0x40) != 0;
+		}
+		offset += 1 + length;
+	}
+
+	/* continuity only advances on packets with payload */
+	if (!(adaptation & 1) || offset >= TS_PACKET_SIZE)
+		return;
+
+	if (stream->continuity >= 0 && !discontinuity) {
+		if (continuity == stream->continuity)
+			return; /* duplicate */
+
+		if (continuity != ((stream->continuity + 1) & 0xF)) {
+			stats.continuityErrors++;
+			stream->started = false;
+			stream->pes.clear();
+		}
+	}
+	stream->continuity = continuity;
+
+	if (unitStart) {
+		if (stream->started)
+			Emit(*stream);
+
+		stream->pes.clear();
+		stream->started = true;
+		stream->randomAccess = randomAccess;
+	}
+
+	if (!stream->started)
+		return;
+
+	stream->pes.insert(stream->pes.end(), packet + offset,
+			   packet + TS_PACKET_SIZE);
+
+	/* bounded packets can go out as soon as they're complete rather
+	 * than waiting for the next unit start */
+	if (stream->pes.size() >= 6) {
+		size_t length = ((size_t)stream->pes[4] << 8) |
+				stream->pes[5];
+		if (length && stream->pes.size() >= 6 + length)
+			Emit(*stream);
+	}
+}
+
+void TSDemuxer::ParsePackets(const unsigned char *&data, size_t &size)
+{
+	while (size >= TS_PACKET_SIZE) {
+		/* while locked on, a sync byte where the next packet should
+		 * start is enough.  locking on again also needs the one after
+		 * it, so a stray sync byte in junk isn't taken for a packet.
+		 * if that isn't here yet, wait for the next write */
+		bool found = data[0] == TS_SYNC_BYTE;
+		if (found && !locked) {
+			if (size == TS_PACKET_SIZE)
+				return;
+			found = data[TS_PACKET_SIZE] == TS_SYNC_BYTE;
+		}
+
+		if (!found) {
+			const unsigned char *sync = (const unsigned char *)memchr(
+				data + 1, TS_SYNC_BYTE, size - 1);
+
+			if (locked)
+				stats.syncLosses++;
+			locked = false;
+
+			if (!sync) {
+				data += size;
+				size = 0;
+				return;
+			}
+
+			size -= sync - data;
+			data = sync;
+			continue;
+		}
+
+		locked = true;
+		ParsePacket(data);
+		data += TS_PACKET_SIZE;
+		size -= TS_PACKET_SIZE;
+	}
+
+	/* whatever's left has to start a packet to be worth keeping */
+	if (size && data[0] != TS_SYNC_BYTE) {
+		const unsigned char *sync = (const unsigned char *)memchr(
+			data + 1, TS_SYNC_BYTE, size - 1);
+
+		if (locked)
+			stats.syncLosses++;
+		locked = false;
+
+		if (!sync)
+			sync = data + size;
+
+		size -= sync - data;
+		data = sync;
+	}
+}
+
+void TSDemuxer::Write(const unsigned char *data, size_t size)
+{
+	stats.bytes += size;
+
+	/* a packet split across writes is joined up with the start of this
+	 * one, so the sync check can see across the split too */
+	if (partialSize) {
+		unsigned char join[TS_PACKET_SIZE * 2];
+		size_t copy = sizeof(join) - partialSize;
+		if (copy > size)
+			copy = size;
+
+		memcpy(join, partial, partialSize);
+		memcpy(join + partialSize, data, copy);
+
+		const unsigned char *joinData = join;
+		size_t joinSize = partialSize + copy;
+		ParsePackets(joinData, joinSize);
+
+		size_t used = joinData - join;
+		if (used < partialSize) {
+			/* the join took all of this write, keep what's left */
+			memmove(partial, joinData, joinSize);
+			partialSize = joinSize;
+			return;
+		}
+
+		data += used - partialSize;
+		size -= used - partialSize;
+		partialSize = 0;
+	}
+
+	ParsePackets(data, size);
+
+	if (size) {
+		memcpy(partial, data, size);
+		partialSize = size;
+	}
+}
+
+void TSDemuxer::Flush()
+{
+	for (int i = 0; i < streamCount; i++) {
+		if (streams[i].started)
+			Emit(streams[i]);
+		streams[i].pes.clear();
+	}
+
+	partialSize = 0;
+}
+
+}; /* namespace DShow */
@@ -0,0 +1,101 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#pragma once
+
+#include <stddef.h>
+#include <functional>
+#include <vector>
+
+#define TS_PACKET_SIZE 188
+#define TS_MAX_STREAMS 8
+
+namespace DShow {
+
+/* 33-bit 90khz timestamps, unwrapped and converted to 100ns units */
+struct TSPacket {
+	int pid;
+	const unsigned char *data;
+	size_t size;
+	long long pts;
+	long long dts;
+	bool hasPts;
+	bool hasDts;
+	bool randomAccess;
+};
+
+typedef std::function<void(const TSPacket &packet)> TSPacketProc;
+
+struct TSDemuxStats {
+	long long bytes = 0;
+	long long packets = 0;
+	long long pesPackets = 0;
+	long long syncLosses = 0;
+	long long continuityErrors = 0;
+};
+
+/*
+ * Minimal MPEG-2 transport stream demuxer.  Filters the elementary
+ * streams registered with AddStream and reassembles their PES packets,
+ * which are passed to the callback with their timestamps.  Input can be
+ * split at any byte.  After junk in the input, sync is regained once two
+ * packets line up again.
+ */
+class TSDemuxer {
+	struct Stream {
+		int pid = -1;
+		int continuity = -1;
+		bool started = false;
+		bool randomAccess = false;
+		std::vector<unsigned char> pes;
+
+		long long lastTimestamp = -1;
+		long long wrapOffset = 0;
+	};
+
+	Stream streams[TS_MAX_STREAMS];
+	int streamCount = 0;
+
+	unsigned char partial[TS_PACKET_SIZE];
+	size_t partialSize = 0;
+	bool locked = false;
+
+	TSDemuxStats stats;
+
+	Stream *FindStream(int pid);
+	void ParsePacket(const unsigned char *packet);
+	void ParsePackets(const unsigned char *&data, size_t &size);
+	void Emit(Stream &stream);
+	long long Unwrap(Stream &stream, long long timestamp);
+
+public:
+	TSPacketProc callback;
+
+	bool AddStream(int pid);
+	void Clear();
+	void Reset();
+
+	void Write(const unsigned char *data, size_t size);
+	void Flush();
+
+	inline const TSDemuxStats &GetStats() const { return stats; }
+};
+
+}; /* namespace DShow */
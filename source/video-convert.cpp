@@ -0,0 +1,429 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#include "video-convert.hpp"
+
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define VIDEO_SSE2 1
+#endif
+
+namespace DShow {
+
+static inline void CopyRow(uint8_t *dst, const uint8_t *src, size_t size)
+{
+	size_t i = 0;
+
+#ifdef VIDEO_SSE2
+	for (; i + 64 <= size; i += 64) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src + i + 16));
+		__m128i c = _mm_loadu_si128((const __m128i *)(src + i + 32));
+		__m128i d = _mm_loadu_si128((const __m128i *)(src + i + 48));
+		_mm_storeu_si128((__m128i *)(dst + i), a);
+		_mm_storeu_si128((__m128i *)(dst + i + 16), b);
+		_mm_storeu_si128((__m128i *)(dst + i + 32), c);
+		_mm_storeu_si128((__m128i *)(dst + i + 48), d);
+	}
+	for (; i + 16 <= size; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dst + i), a);
+	}
+#endif
+
+	if (i < size)
+		memcpy(dst + i, src + i, size - i);
+}
+
+void CopyPlane(uint8_t *dst, size_t dstLinesize, const uint8_t *src,
+	       size_t srcLinesize, size_t rowBytes, size_t rows)
+{
+	/* contiguous on both sides, one copy does it */
+	if (dstLinesize == rowBytes && srcLinesize == rowBytes) {
+		memcpy(dst, src, rowBytes * rows);
+		return;
+	}
+
+	for (size_t y = 0; y < rows; y++) {
+		CopyRow(dst, src, rowBytes);
+		dst += dstLinesize;
+		src += srcLinesize;
+	}
+}
+
+bool VFormatConvertsToYV12(VideoFormat format)
+{
+	switch (format) {
+	case VideoFormat::YV12:
+	case VideoFormat::I420:
+	case VideoFormat::NV12:
+	case VideoFormat::XRGB:
+	case VideoFormat::ARGB:
+	case VideoFormat::YUY2:
+	case VideoFormat::UYVY:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool VFormatConvertsToYV12(VideoFormat format, int cx, int cy)
+{
+	if (cx <= 0 || cy <= 0 || !VFormatConvertsToYV12(format))
+		return false;
+
+	/* packed 4:2:2 shares each chroma sample between two pixels */
+	if (format == VideoFormat::YUY2 || format == VideoFormat::UYVY)
+		return (cx & 1) == 0;
+
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void DeinterleaveUV(uint8_t *u, uint8_t *v, const uint8_t *uv,
+			   size_t count)
+{
+	size_t i = 0;
+
+#ifdef VIDEO_SSE2
+	const __m128i lowMask = _mm_set1_epi16(0x00FF);
+	for (; i + 16 <= count; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(uv + i * 2));
+		__m128i b = _mm_loadu_si128((const __m128i *)(uv + i * 2 + 16));
+
+		__m128i uVec = _mm_packus_epi16(_mm_and_si128(a, lowMask),
+						_mm_and_si128(b, lowMask));
+		__m128i vVec = _mm_packus_epi16(_mm_srli_epi16(a, 8),
+						_mm_srli_epi16(b, 8));
+
+		_mm_storeu_si128((__m128i *)(u + i), uVec);
+		_mm_storeu_si128((__m128i *)(v + i), vVec);
+	}
+#endif
+
+	for (; i < count; i++) {
+		u[i] = uv[i * 2];
+		v[i] = uv[i * 2 + 1];
+	}
+}
+
+/* packed 4:2:2 to 4:2:0, chroma averaged over the two rows */
+static void Packed422ToYV12Rows(const uint8_t *row0, const uint8_t *row1,
+				uint8_t *y0, uint8_t *y1, uint8_t *u,
+				uint8_t *v, int cx, bool yFirst)
+{
+	int yOff = yFirst ? 0 : 1;
+	int cOff = 1 - yOff;
+	int x = 0;
+
+#ifdef VIDEO_SSE2
+	const __m128i lowMask = _mm_set1_epi16(0x00FF);
+
+	for (; x + 16 <= cx; x += 16) {
+		__m128i a0 = _mm_loadu_si128((const __m128i *)(row0 + x * 2));
+		__m128i a1 = _mm_loadu_si128(
+			(const __m128i *)(row0 + x * 2 + 16));
+		__m128i b0 = _mm_loadu_si128((const __m128i *)(row1 + x * 2));
+		__m128i b1 = _mm_loadu_si128(
+			(const __m128i *)(row1 + x * 2 + 16));
+		__m128i c0 = _mm_avg_epu8(a0, b0);
+		__m128i c1 = _mm_avg_epu8(a1, b1);
+
+		if (yFirst) {
+			a0 = _mm_and_si128(a0, lowMask);
+			a1 = _mm_and_si128(a1, lowMask);
+			b0 = _mm_and_si128(b0, lowMask);
+			b1 = _mm_and_si128(b1, lowMask);
+			c0 = _mm_srli_epi16(c0, 8);
+			c1 = _mm_srli_epi16(c1, 8);
+		} else {
+			a0 = _mm_srli_epi16(a0, 8);
+			a1 = _mm_srli_epi16(a1, 8);
+			b0 = _mm_srli_epi16(b0, 8);
+			b1 = _mm_srli_epi16(b1, 8);
+			c0 = _mm_and_si128(c0, lowMask);
+			c1 = _mm_and_si128(c1, lowMask);
+		}
+
+		_mm_storeu_si128((__m128i *)(y0 + x), _mm_packus_epi16(a0, a1));
+		_mm_storeu_si128((__m128i *)(y1 + x), _mm_packus_epi16(b0, b1));
+
+		/* chroma is now U V U V ..., split it like NV12 */
+		__m128i uv = _mm_packus_epi16(c0, c1);
+		__m128i uv2 = _mm_packus_epi16(_mm_and_si128(uv, lowMask),
+					       _mm_srli_epi16(uv, 8));
+		_mm_storel_epi64((__m128i *)(u + x / 2), uv2);
+		_mm_storel_epi64((__m128i *)(v + x / 2),
+				 _mm_srli_si128(uv2, 8));
+	}
+#endif
+
+	for (; x + 1 < cx; x += 2) {
+		const uint8_t *p0 = row0 + x * 2;
+		const uint8_t *p1 = row1 + x * 2;
+
+		y0[x] = p0[yOff];
+		y0[x + 1] = p0[yOff + 2];
+		y1[x] = p1[yOff];
+		y1[x + 1] = p1[yOff + 2];
+		u[x / 2] = (uint8_t)((p0[cOff] + p1[cOff] + 1) >> 1);
+		v[x / 2] = (uint8_t)((p0[cOff + 2] + p1[cOff + 2] + 1) >> 1);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* BT.601 limited range, 8-bit fixed point */
+#define Y_R 66
+#define Y_G 129
+#define Y_B 25
+#define U_R -38
+#define U_G -74
+#define U_B 112
+#define V_R 112
+#define V_G -94
+#define V_B -18
+
+static inline uint8_t RGBToY(const uint8_t *p)
+{
+	return (uint8_t)(((Y_R * p[2] + Y_G * p[1] + Y_B * p[0] + 128) >> 8) +
+			 16);
+}
+
+/* chroma from the sums of two or four pixels' components */
+static inline void RGBToUV(int b, int g, int r, int count, uint8_t *u,
+			   uint8_t *v)
+{
+	int shift = count == 4 ? 10 : 9;
+	int round = 1 << (shift - 1);
+
+	*u = (uint8_t)(((U_R * r + U_G * g + U_B * b + round) >> shift) + 128);
+	*v = (uint8_t)(((V_R * r + V_G * g + V_B * b + round) >> shift) + 128);
+}
+
+#ifdef VIDEO_SSE2
+/* adds the even and odd 32-bit lanes of two madd results, giving one sum
+ * per pixel (or block) */
+static inline __m128i SumPairs(__m128i a, __m128i b)
+{
+	__m128 fa = _mm_castsi128_ps(a);
+	__m128 fb = _mm_castsi128_ps(b);
+	__m128 even = _mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0));
+	__m128 odd = _mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1));
+	return _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+}
+
+/* eight BGRA pixels as four registers of two 16-bit pixels each */
+static inline void LoadBGRA(const uint8_t *src, __m128i px[4])
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i lo = _mm_loadu_si128((const __m128i *)src);
+	__m128i hi = _mm_loadu_si128((const __m128i *)(src + 16));
+
+	px[0] = _mm_unpacklo_epi8(lo, zero);
+	px[1] = _mm_unpackhi_epi8(lo, zero);
+	px[2] = _mm_unpacklo_epi8(hi, zero);
+	px[3] = _mm_unpackhi_epi8(hi, zero);
+}
+
+static inline __m128i BGRAToY8(const __m128i px[4])
+{
+	const __m128i coef = _mm_setr_epi16(Y_B, Y_G, Y_R, 0, Y_B, Y_G, Y_R,
+					    0);
+	const __m128i round = _mm_set1_epi32(128);
+	const __m128i offset = _mm_set1_epi16(16);
+
+	__m128i y0 = SumPairs(_mm_madd_epi16(px[0], coef),
+			      _mm_madd_epi16(px[1], coef));
+	__m128i y1 = SumPairs(_mm_madd_epi16(px[2], coef),
+			      _mm_madd_epi16(px[3], coef));
+	y0 = _mm_srai_epi32(_mm_add_epi32(y0, round), 8);
+	y1 = _mm_srai_epi32(_mm_add_epi32(y1, round), 8);
+
+	__m128i y = _mm_add_epi16(_mm_packs_epi32(y0, y1), offset);
+	return _mm_packus_epi16(y, y);
+}
+
+/* four 2x2 blocks summed per component, as 32-bit chroma values */
+static inline __m128i BlocksToChroma(__m128i blocks01, __m128i blocks23,
+				     __m128i coef)
+{
+	const __m128i round = _mm_set1_epi32(512);
+	const __m128i offset = _mm_set1_epi32(128);
+
+	__m128i c = SumPairs(_mm_madd_epi16(blocks01, coef),
+			     _mm_madd_epi16(blocks23, coef));
+	c = _mm_srai_epi32(_mm_add_epi32(c, round), 10);
+	return _mm_add_epi32(c, offset);
+}
+#endif
+
+static void BGRAToYV12Rows(const uint8_t *row0, const uint8_t *row1,
+			   uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+			   int cx)
+{
+	int x = 0;
+
+#ifdef VIDEO_SSE2
+	const __m128i coefU = _mm_setr_epi16(U_B, U_G, U_R, 0, U_B, U_G, U_R,
+					     0);
+	const __m128i coefV = _mm_setr_epi16(V_B, V_G, V_R, 0, V_B, V_G, V_R,
+					     0);
+
+	for (; x + 8 <= cx; x += 8) {
+		__m128i a[4], b[4], blocks[2];
+
+		LoadBGRA(row0 + x * 4, a);
+		LoadBGRA(row1 + x * 4, b);
+
+		_mm_storel_epi64((__m128i *)(y0 + x), BGRAToY8(a));
+		_mm_storel_epi64((__m128i *)(y1 + x), BGRAToY8(b));
+
+		/* sum each 2x2 block: vertical, then the pixel pairs */
+		for (int i = 0; i < 2; i++) {
+			__m128i s0 = _mm_add_epi16(a[i * 2], b[i * 2]);
+			__m128i s1 = _mm_add_epi16(a[i * 2 + 1],
+						   b[i * 2 + 1]);
+			s0 = _mm_add_epi16(s0, _mm_srli_si128(s0, 8));
+			s1 = _mm_add_epi16(s1, _mm_srli_si128(s1, 8));
+			blocks[i] = _mm_unpacklo_epi64(s0, s1);
+		}
+
+		__m128i uVec = BlocksToChroma(blocks[0], blocks[1], coefU);
+		__m128i vVec = BlocksToChroma(blocks[0], blocks[1], coefV);
+		__m128i uv = _mm_packs_epi32(uVec, vVec);
+		uv = _mm_packus_epi16(uv, uv);
+
+		int packed = _mm_cvtsi128_si32(uv);
+		memcpy(u + x / 2, &packed, 4);
+		packed = _mm_cvtsi128_si32(_mm_srli_si128(uv, 4));
+		memcpy(v + x / 2, &packed, 4);
+	}
+#endif
+
+	for (; x < cx; x += 2) {
+		const uint8_t *p[4] = {row0 + x * 4, row1 + x * 4, nullptr,
+				       nullptr};
+		int count = 2;
+
+		y0[x] = RGBToY(p[0]);
+		y1[x] = RGBToY(p[1]);
+
+		if (x + 1 < cx) {
+			p[2] = p[0] + 4;
+			p[3] = p[1] + 4;
+			y0[x + 1] = RGBToY(p[2]);
+			y1[x + 1] = RGBToY(p[3]);
+			count = 4;
+		}
+
+		int b = 0, g = 0, r = 0;
+		for (int i = 0; i < count; i++) {
+			b += p[i][0];
+			g += p[i][1];
+			r += p[i][2];
+		}
+
+		RGBToUV(b, g, r, count, u + x / 2, v + x / 2);
+	}
+}
+
+bool ConvertToYV12(VideoFormat format, const uint8_t *const src[],
+		   const size_t srcLinesize[], int cx, int cy,
+		   uint8_t *const dst[3], const size_t dstLinesize[3],
+		   bool bottomUp)
+{
+	size_t width = (size_t)cx;
+	size_t height = (size_t)cy;
+	size_t chromaCX = (width + 1) / 2;
+	size_t chromaCY = (height + 1) / 2;
+
+	if (cx <= 0 || cy <= 0)
+		return false;
+
+	switch (format) {
+	case VideoFormat::YV12:
+	case VideoFormat::I420: {
+		/* I420 is YV12 with the chroma planes swapped */
+		int vPlane = format == VideoFormat::YV12 ? 1 : 2;
+		int uPlane = 3 - vPlane;
+
+		CopyPlane(dst[0], dstLinesize[0], src[0], srcLinesize[0], width,
+			  height);
+		CopyPlane(dst[1], dstLinesize[1], src[vPlane],
+			  srcLinesize[vPlane], chromaCX, chromaCY);
+		CopyPlane(dst[2], dstLinesize[2], src[uPlane],
+			  srcLinesize[uPlane], chromaCX, chromaCY);
+		return true;
+	}
+
+	case VideoFormat::NV12:
+		CopyPlane(dst[0], dstLinesize[0], src[0], srcLinesize[0], width,
+			  height);
+		for (size_t y = 0; y < chromaCY; y++)
+			DeinterleaveUV(dst[2] + y * dstLinesize[2],
+				       dst[1] + y * dstLinesize[1],
+				       src[1] + y * srcLinesize[1], chromaCX);
+		return true;
+
+	case VideoFormat::XRGB:
+	case VideoFormat::ARGB:
+		for (size_t y = 0; y < height; y += 2) {
+			/* an odd last row pairs with itself */
+			size_t y1 = y + 1 < height ? y + 1 : y;
+			size_t s0 = bottomUp ? height - 1 - y : y;
+			size_t s1 = bottomUp ? height - 1 - y1 : y1;
+
+			BGRAToYV12Rows(src[0] + s0 * srcLinesize[0],
+				       src[0] + s1 * srcLinesize[0],
+				       dst[0] + y * dstLinesize[0],
+				       dst[0] + y1 * dstLinesize[0],
+				       dst[2] + (y / 2) * dstLinesize[2],
+				       dst[1] + (y / 2) * dstLinesize[1], cx);
+		}
+		return true;
+
+	case VideoFormat::YUY2:
+	case VideoFormat::UYVY:
+		if (cx & 1)
+			return false;
+
+		for (size_t y = 0; y < height; y += 2) {
+			size_t y1 = y + 1 < height ? y + 1 : y;
+
+			Packed422ToYV12Rows(src[0] + y * srcLinesize[0],
+					    src[0] + y1 * srcLinesize[0],
+					    dst[0] + y * dstLinesize[0],
+					    dst[0] + y1 * dstLinesize[0],
+					    dst[2] + (y / 2) * dstLinesize[2],
+					    dst[1] + (y / 2) * dstLinesize[1],
+					    cx, format == VideoFormat::YUY2);
+		}
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+}; /* namespace DShow */
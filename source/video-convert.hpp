@@ -0,0 +1,48 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace DShow {
+
+/* copies rows of rowBytes between buffers with different strides */
+void CopyPlane(uint8_t *dst, size_t dstLinesize, const uint8_t *src,
+	       size_t srcLinesize, size_t rowBytes, size_t rows);
+
+/* whether ConvertToYV12 takes the format, and frames of that size */
+bool VFormatConvertsToYV12(VideoFormat format);
+bool VFormatConvertsToYV12(VideoFormat format, int cx, int cy);
+
+/*
+ * Converts an I420, NV12, YV12, YUY2, UYVY or BGRA (XRGB/ARGB) frame to
+ * YV12 in a single pass per plane; RGB uses BT.601 limited range and may
+ * be stored bottom-up.  dst holds the Y, V and U planes, in memory order.
+ */
+bool ConvertToYV12(VideoFormat format, const uint8_t *const src[],
+		   const size_t srcLinesize[], int cx, int cy,
+		   uint8_t *const dst[3], const size_t dstLinesize[3],
+		   bool bottomUp = false);
+
+}; /* namespace DShow */
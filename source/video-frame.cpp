@@ -0,0 +1,226 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#include "video-frame.hpp"
+#include "dshow-formats.hpp"
+
+namespace DShow {
+
+HVideoFrame::~HVideoFrame()
+{
+	if (sample && retained)
+		InterlockedDecrement(&retained->frames);
+}
+
+HVideoFrame *CreateVideoFrame(const VideoConfig &config, IMediaSample *sample,
+			      unsigned char *data, size_t size,
+			      long long startTime, long long stopTime,
+			      long rotation, bool syntheticTime,
+			      const std::shared_ptr<FrameRetainCount> &retained)
+{
+	HVideoFrame *frame = new HVideoFrame;
+	unsigned char *base = data;
+
+	/* only hold on to the sample if we're under the retain limit,
+	 * otherwise upstream could run out of buffers to deliver into */
+	if (sample && retained) {
+		long frames = InterlockedIncrement(&retained->frames);
+		if (frames <= (long)config.maxRetainedFrames) {
+			frame->sample = sample;
+			frame->retained = retained;
+		} else {
+			InterlockedDecrement(&retained->frames);
+		}
+	}
+
+	if (!frame->sample) {
+		frame->copy.assign(data, data + size);
+		base = frame->copy.data();
+	}
+
+	frame->size = size;
+	frame->format = config.format;
+	frame->cx = config.cx;
+	frame->cy = config.cy_abs;
+	frame->flip = config.cy_flip;
+	frame->startTime = startTime;
+	frame->stopTime = stopTime;
+	frame->rotation = rotation;
+	frame->syntheticTime = syntheticTime;
+
+	size_t offsets[DSHOW_MAX_PLANES] = {};
+	size_t frameSize = VFormatPlaneLayout(frame->format, frame->cx,
+					      frame->cy, offsets,
+					      frame->linesize);
+
+	if (frameSize && frameSize <= size) {
+		for (size_t i = 0; i < DSHOW_MAX_PLANES; i++) {
+			if (!frame->linesize[i])
+				break;
+			frame->data[i] = base + offsets[i];
+		}
+	} else {
+		/* encoded or unknown layout: expose the whole buffer */
+		memset(frame->linesize, 0, sizeof(frame->linesize));
+		frame->data[0] = base;
+		frame->linesize[0] = size;
+	}
+
+	return frame;
+}
+
+// ============================================================================
+
+VideoFrame::VideoFrame(HVideoFrame *context_) : context(context_) {}
+
+VideoFrame::VideoFrame(const VideoFrame &frame) : context(frame.context)
+{
+	if (context)
+		InterlockedIncrement(&context->refs);
+}
+
+VideoFrame::VideoFrame(VideoFrame &&frame) noexcept : context(frame.context)
+{
+	frame.context = nullptr;
+}
+
+VideoFrame::~VideoFrame()
+{
+	Reset();
+}
+
+VideoFrame &VideoFrame::operator=(const VideoFrame &frame)
+{
+	if (context != frame.context) {
+		if (frame.context)
+			InterlockedIncrement(&frame.context->refs);
+		Reset();
+		context = frame.context;
+	}
+
+	return *this;
+}
+
+VideoFrame &VideoFrame::operator=(VideoFrame &&frame) noexcept
+{
+	if (this != &frame) {
+		Reset();
+		context = frame.context;
+		frame.context = nullptr;
+	}
+
+	return *this;
+}
+
+bool VideoFrame::Valid() const
+{
+	return context != nullptr;
+}
+
+void VideoFrame::Reset()
+{
+	if (context && !InterlockedDecrement(&context->refs))
+		delete context;
+
+	context = nullptr;
+}
+
+bool VideoFrame::Retained() const
+{
+	return context ? !!context->sample : false;
+}
+
+VideoFormat VideoFrame::Format() const
+{
+	return context ? context->format : VideoFormat::Unknown;
+}
+
+int VideoFrame::Width() const
+{
+	return context ? context->cx : 0;
+}
+
+int VideoFrame::Height() const
+{
+	return context ? context->cy : 0;
+}
+
+bool VideoFrame::Flipped() const
+{
+	return context ? context->flip : false;
+}
+
+const unsigned char *VideoFrame::Data(int plane) const
+{
+	if (!context || plane < 0 || plane >= DSHOW_MAX_PLANES)
+		return nullptr;
+
+	return context->data[plane];
+}
+
+size_t VideoFrame::Linesize(int plane) const
+{
+	if (!context || plane < 0 || plane >= DSHOW_MAX_PLANES)
+		return 0;
+
+	return context->linesize[plane];
+}
+
+size_t VideoFrame::Size() const
+{
+	return context ? context->size : 0;
+}
+
+long long VideoFrame::StartTime() const
+{
+	return context ? context->startTime : 0;
+}
+
+long long VideoFrame::StopTime() const
+{
+	return context ? context->stopTime : 0;
+}
+
+long VideoFrame::Rotation() const
+{
+	return context ? context->rotation : 0;
+}
+
+bool VideoFrame::SyntheticTime() const
+{
+	return context ? context->syntheticTime : false;
+}
+
+bool VideoFrame::Keyframe() const
+{
+	return context ? context->keyframe : false;
+}
+
+long long VideoFrame::HostTime() const
+{
+	return context ? context->hostTime : 0;
+}
+
+long long VideoFrame::PresentationTime() const
+{
+	return context ? context->presentationTime : 0;
+}
+
+}; /* namespace DShow */
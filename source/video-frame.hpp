@@ -0,0 +1,69 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+
+#pragma once
+
+#include "../dshowcapture.hpp"
+#include "dshow-base.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace DShow {
+
+struct FrameRetainCount {
+	volatile long frames = 0;
+};
+
+struct HVideoFrame {
+	volatile long refs = 1;
+
+	/* either the capture sample is retained, or the data is copied */
+	ComPtr<IMediaSample> sample;
+	std::shared_ptr<FrameRetainCount> retained;
+	std::vector<unsigned char> copy;
+
+	unsigned char *data[DSHOW_MAX_PLANES] = {};
+	size_t linesize[DSHOW_MAX_PLANES] = {};
+	size_t size = 0;
+
+	VideoFormat format = VideoFormat::Unknown;
+	int cx = 0;
+	int cy = 0;
+	bool flip = false;
+
+	long long startTime = 0;
+	long long stopTime = 0;
+	long rotation = 0;
+	bool syntheticTime = false;
+	bool keyframe = false;
+	long long hostTime = 0;
+	long long presentationTime = 0;
+
+	~HVideoFrame();
+};
+
+HVideoFrame *CreateVideoFrame(const VideoConfig &config, IMediaSample *sample,
+			      unsigned char *data, size_t size,
+			      long long startTime, long long stopTime,
+			      long rotation, bool syntheticTime,
+			      const std::shared_ptr<FrameRetainCount> &retained);
+
+}; /* namespace DShow */
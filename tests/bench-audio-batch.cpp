@@ -0,0 +1,113 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "bench.hpp"
+#include "audio-buffering.hpp"
+#include "av-sync.hpp"
+
+#include <vector>
+
+using namespace DShow;
+
+/*
+ * Bookkeeping HDevice does for each buffer of a ReceiveMultiple batch,
+ * synthetic so it runs without a device: host time read, clock mapping,
+ * glitch monitoring and A/V sync.  Compares doing all of it per buffer
+ * (as the batch path used to) against once per batch, with only the A/V
+ * sample count kept per buffer.  The IMediaSample calls themselves aren't
+ * included.
+ */
+
+#define RATE 48000
+#define BUFFER_FRAMES 48
+#define FRAME_BYTES 4 /* 16-bit stereo */
+#define BUFFER_BYTES (BUFFER_FRAMES * FRAME_BYTES)
+#define BATCH 16
+
+struct Bookkeeping {
+	ClockMapper audioClock;
+	ClockMapper videoClock;
+	AudioBufferMonitor monitor;
+	AVSync avSync;
+	long long deviceTime = 0;
+
+	Bookkeeping()
+	{
+		for (int i = 0; i < 100; i++)
+			videoClock.Update(i * 333333LL, i * 333333LL);
+	}
+};
+
+static void PerBuffer(Bookkeeping &b)
+{
+	for (int i = 0; i < BATCH; i++) {
+		long long start = b.deviceTime;
+		long long stop = start + BUFFER_FRAMES * 10000000LL / RATE;
+		long long receiveTime = GetHostTime();
+
+		b.audioClock.Update(start, receiveTime);
+		b.monitor.Update(receiveTime, start, stop, false);
+		b.avSync.AddAudio(start, BUFFER_FRAMES, RATE, receiveTime,
+				  b.videoClock);
+		b.deviceTime = stop;
+	}
+}
+
+static void PerBatch(Bookkeeping &b)
+{
+	long long receiveTime = GetHostTime();
+	long long batchStart = b.deviceTime;
+	long long lastStart = 0;
+
+	for (int i = 0; i < BATCH; i++) {
+		long long start = b.deviceTime;
+		long long stop = start + BUFFER_FRAMES * 10000000LL / RATE;
+
+		b.avSync.AddAudio(start, BUFFER_FRAMES, RATE,
+				  i == BATCH - 1 ? receiveTime : 0,
+				  b.videoClock);
+		lastStart = start;
+		b.deviceTime = stop;
+	}
+
+	b.audioClock.Update(lastStart, receiveTime);
+	b.monitor.Update(receiveTime, batchStart, b.deviceTime, false);
+}
+
+static double NsPerFrame(double mbps)
+{
+	return 1000000000.0 * FRAME_BYTES / (mbps * 1024.0 * 1024.0);
+}
+
+int main()
+{
+	Bookkeeping perBuffer;
+	Bookkeeping perBatch;
+
+	printf("%d buffers of %d frames per batch\n", BATCH, BUFFER_FRAMES);
+
+	double a = Bench("bookkeeping per buffer", BATCH * BUFFER_BYTES,
+			 [&]() { PerBuffer(perBuffer); });
+	double b = Bench("bookkeeping per batch", BATCH * BUFFER_BYTES,
+			 [&]() { PerBatch(perBatch); });
+
+	printf("per-sample overhead: %.2f ns -> %.2f ns\n", NsPerFrame(a),
+	       NsPerFrame(b));
+	return 0;
+}
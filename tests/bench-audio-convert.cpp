@@ -0,0 +1,81 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "bench.hpp"
+#include "audio-convert.hpp"
+
+#include <stdint.h>
+#include <vector>
+
+using namespace DShow;
+
+/* one second of 48 kHz 7.1 */
+#define BENCH_FRAMES 48000
+#define BENCH_CHANNELS 8
+
+static void BenchToFloat(const char *name, AudioFormat format)
+{
+	size_t samples = BENCH_FRAMES * BENCH_CHANNELS;
+	size_t bytes = samples * AFormatSampleBytes(format);
+	std::vector<uint8_t> in(bytes);
+	std::vector<float> out(samples);
+
+	for (size_t i = 0; i < bytes; i++)
+		in[i] = (uint8_t)(i * 31 + 7);
+
+	Bench(name, bytes,
+	      [&]() { AudioToFloat(format, in.data(), samples, out.data()); });
+}
+
+static void BenchDeinterleaveMix()
+{
+	size_t samples = BENCH_FRAMES * BENCH_CHANNELS;
+	std::vector<float> in(samples);
+	std::vector<float> planes(samples);
+	std::vector<float> mixed(BENCH_FRAMES * 2);
+	float *inPlanes[BENCH_CHANNELS];
+	float *outPlanes[2] = {mixed.data(), mixed.data() + BENCH_FRAMES};
+
+	for (size_t i = 0; i < samples; i++)
+		in[i] = (float)(i % 2000) / 1000.0f - 1.0f;
+	for (int c = 0; c < BENCH_CHANNELS; c++)
+		inPlanes[c] = planes.data() + c * BENCH_FRAMES;
+
+	std::vector<float> matrix;
+	AudioMixMatrix(BENCH_CHANNELS, 2, std::vector<int>(), matrix);
+
+	Bench("deinterleave 7.1", samples * sizeof(float), [&]() {
+		AudioDeinterleave(in.data(), BENCH_FRAMES, BENCH_CHANNELS,
+				  inPlanes);
+	});
+	Bench("downmix 7.1 -> stereo", samples * sizeof(float), [&]() {
+		AudioMixPlanar(inPlanes, BENCH_CHANNELS, outPlanes, 2,
+			       BENCH_FRAMES, matrix.data());
+	});
+}
+
+int main()
+{
+	BenchToFloat("s16 -> float", AudioFormat::Wave16bit);
+	BenchToFloat("s24 -> float", AudioFormat::Wave24bit);
+	BenchToFloat("s32 -> float", AudioFormat::Wave32bit);
+	BenchToFloat("f32 -> float", AudioFormat::WaveFloat);
+	BenchDeinterleaveMix();
+	return 0;
+}
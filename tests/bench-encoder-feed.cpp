@@ -0,0 +1,78 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "bench.hpp"
+#include "stand-in-encoder.hpp"
+#include "video-convert.hpp"
+
+using namespace DShow;
+
+#define BENCH_CX 1920
+#define BENCH_CY 1080
+
+/* SendToEncoder's path, converting straight into the locked sample, next
+ * to converting into a frame of its own first and then copying that into
+ * the sample, as going through Encode would */
+static void BenchFormat(const char *name, VideoFormat format)
+{
+	StandInEncoder encoder(BENCH_CX, BENCH_CY);
+	StandInEncoder staging(BENCH_CX, BENCH_CY);
+	std::vector<uint8_t> data;
+	EncoderFeedFrame frame =
+		MakeFeedFrame(format, BENCH_CX, BENCH_CY, data);
+	char label[64];
+
+	snprintf(label, sizeof(label), "%s direct", name);
+	Bench(label, frame.frameSize, [&]() {
+		if (FeedEncoder(encoder, frame) != EncoderFeedResult::Sent)
+			fprintf(stderr, "frame dropped\n");
+	});
+
+	snprintf(label, sizeof(label), "%s via temporary frame", name);
+	Bench(label, frame.frameSize, [&]() {
+		const uint8_t *planes[DSHOW_MAX_PLANES];
+		uint8_t *dst[3];
+
+		for (size_t i = 0; i < DSHOW_MAX_PLANES; i++)
+			planes[i] = data.data() + frame.offsets[i];
+		for (size_t i = 0; i < 3; i++)
+			dst[i] = staging.sample.data() + staging.offsets[i];
+
+		ConvertToYV12(format, planes, frame.linesize, BENCH_CX,
+			      BENCH_CY, dst, staging.linesize);
+
+		EncoderInputBuffer buffer;
+		if (!encoder.GetInputBuffer(buffer)) {
+			fprintf(stderr, "frame dropped\n");
+			return;
+		}
+		memcpy(buffer.data[0], staging.sample.data(),
+		       staging.sample.size());
+		encoder.SubmitInputBuffer(0, 0);
+	});
+}
+
+int main()
+{
+	BenchFormat("I420 1080p", VideoFormat::I420);
+	BenchFormat("NV12 1080p", VideoFormat::NV12);
+	BenchFormat("YUY2 1080p", VideoFormat::YUY2);
+	BenchFormat("XRGB 1080p", VideoFormat::XRGB);
+	return 0;
+}
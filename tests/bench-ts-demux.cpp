@@ -0,0 +1,80 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "bench.hpp"
+#include "ts-mux.hpp"
+#include "ts-demux.hpp"
+
+using namespace DShow;
+
+/* about 16MB: 10 seconds of 12Mbps 30fps video with 48khz AAC-sized
+ * audio units */
+#define UNITS 300
+#define VIDEO_SIZE 50000
+#define AUDIO_SIZE 768
+
+static void BenchChunks(const char *name, const std::vector<uint8_t> &data,
+			size_t chunk)
+{
+	TSDemuxer demuxer;
+	long long payload = 0;
+
+	demuxer.AddStream(0x1011);
+	demuxer.AddStream(0x1100);
+	demuxer.callback = [&payload](const TSPacket &packet) {
+		payload += (long long)packet.size;
+	};
+
+	Bench(name, data.size(), [&]() {
+		demuxer.Reset();
+		for (size_t pos = 0; pos < data.size(); pos += chunk) {
+			size_t size = data.size() - pos < chunk
+					      ? data.size() - pos
+					      : chunk;
+			demuxer.Write(data.data() + pos, size);
+		}
+		demuxer.Flush();
+	});
+}
+
+int main()
+{
+	TSMuxer mux;
+
+	for (int i = 0; i < UNITS; i++) {
+		long long pts = (long long)i * 3000;
+
+		mux.Write({0x1011, 0xE0,
+			   std::vector<uint8_t>(VIDEO_SIZE, (uint8_t)i),
+			   pts + 3000, pts, false, i % 30 == 0});
+		for (int j = 0; j < 2; j++)
+			mux.Write({0x1100, 0xC0,
+				   std::vector<uint8_t>(AUDIO_SIZE, (uint8_t)j),
+				   pts + j * 1920, TS_MUX_NO_TIMESTAMP, true,
+				   false});
+	}
+
+	printf("%.1f MB multiplex\n", mux.out.size() / (1024.0 * 1024.0));
+
+	BenchChunks("demux whole buffer", mux.out, mux.out.size());
+	BenchChunks("demux 64KB writes", mux.out, 65536);
+	BenchChunks("demux 7 packet writes", mux.out, 188 * 7);
+	BenchChunks("demux 1000 byte writes", mux.out, 1000);
+	return 0;
+}
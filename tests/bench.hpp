@@ -0,0 +1,53 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <chrono>
+
+/* runs func repeatedly for at least BENCH_MIN_SECONDS and prints how much
+ * data it got through per second.  bytes is the input consumed per call */
+
+#define BENCH_MIN_SECONDS 0.5
+
+template<typename F> static double Bench(const char *name, size_t bytes, F func)
+{
+	typedef std::chrono::steady_clock clock;
+
+	func(); /* warm up */
+
+	clock::time_point start = clock::now();
+	double elapsed = 0.0;
+	long long calls = 0;
+
+	do {
+		func();
+		calls++;
+		elapsed = std::chrono::duration<double>(clock::now() - start)
+				  .count();
+	} while (elapsed < BENCH_MIN_SECONDS);
+
+	double perCall = elapsed / (double)calls;
+	double mbps = (double)bytes / perCall / (1024.0 * 1024.0);
+
+	printf("%-40s %10.1f MB/s %12.3f us/call\n", name, mbps,
+	       perCall * 1000000.0);
+	return mbps;
+}
@@ -0,0 +1,323 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+/*
+ * Fuzz harness for CapsCache::Load, the parser for the on-disk caps cache.
+ * Any input must either be rejected, or load into a cache that saves and
+ * loads back to exactly the same bytes.  Under ASan/UBSan this also
+ * catches reads outside the buffer.
+ *
+ * Built with -DDSHOW_LIBFUZZER (see tests/CMakeLists.txt) it's a libFuzzer
+ * target.  Otherwise it's a standalone runner:
+ *
+ *   fuzz-caps-cache [--runs N] [--seed N] [--write-seeds DIR] [FILE...]
+ *
+ * which runs the given files (a saved corpus or crash reproducers), or
+ * with no files, N random mutations of a few valid caches.
+ */
+
+#include "caps-cache.hpp"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace DShow;
+
+static void Fail(const char *what)
+{
+	fprintf(stderr, "fuzz-caps-cache: %s\n", what);
+	abort();
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	CapsCache cache;
+	std::vector<uint8_t> saved;
+	std::vector<uint8_t> resaved;
+
+	if (!cache.Load(data, size))
+		return 0;
+
+	cache.Save(saved);
+
+	CapsCache reloaded;
+	if (!reloaded.Load(saved.data(), saved.size()))
+		Fail("saved cache doesn't load");
+
+	reloaded.Save(resaved);
+	if (saved != resaved)
+		Fail("cache changed on a save/load round trip");
+
+	return 0;
+}
+
+#ifndef DSHOW_LIBFUZZER
+
+#define DEFAULT_RUNS 50000
+
+static uint32_t randState = 12345;
+
+static uint32_t Rand()
+{
+	randState = randState * 1664525 + 1013904223;
+	return randState >> 8;
+}
+
+static VideoInfo MakeVideoCaps(int cx, int cy, VideoFormat format)
+{
+	VideoInfo caps;
+	caps.minCX = caps.maxCX = cx;
+	caps.minCY = caps.maxCY = cy;
+	caps.granularityCX = caps.granularityCY = 1;
+	caps.minInterval = 166666;
+	caps.maxInterval = 333333;
+	caps.format = format;
+	return caps;
+}
+
+static void MakeSeeds(std::vector<std::vector<uint8_t>> &seeds)
+{
+	CapsCache cache;
+	std::vector<uint8_t> data;
+
+	cache.Save(data);
+	seeds.push_back(data);
+
+	CapsCacheEntry video;
+	video.fingerprint = 0x1234567890ABCDEFULL;
+	video.audioAttached = true;
+	video.videoCaps.push_back(MakeVideoCaps(1920, 1080, VideoFormat::NV12));
+	video.videoCaps.push_back(MakeVideoCaps(1280, 720, VideoFormat::MJPEG));
+	video.videoCaps.push_back(MakeVideoCaps(640, 480, VideoFormat::YUY2));
+	cache.SetVideo(L"\\\\?\\usb#vid_046d&pid_085c#1", video);
+	cache.Save(data);
+	seeds.push_back(data);
+
+	CapsCacheEntry audio;
+	AudioInfo audioCaps;
+	audio.fingerprint = 42;
+	audioCaps.minChannels = 1;
+	audioCaps.maxChannels = 2;
+	audioCaps.channelsGranularity = 1;
+	audioCaps.minSampleRate = 44100;
+	audioCaps.maxSampleRate = 48000;
+	audioCaps.sampleRateGranularity = 3900;
+	audioCaps.format = AudioFormat::Wave16bit;
+	audio.audioCaps.push_back(audioCaps);
+	cache.SetAudio(L"\\\\?\\swd#mmdevapi#{0.0.1.00000000}", audio);
+
+	KnownConfigEntry config;
+	config.fingerprint = 0x1234567890ABCDEFULL;
+	config.cx = 1920;
+	config.cy_abs = 1080;
+	config.cy_flip = true;
+	config.frameInterval = 166666;
+	config.internalFormat = VideoFormat::MJPEG;
+	config.format = VideoFormat::NV12;
+	cache.SetConfig(L"\\\\?\\usb#vid_046d&pid_085c#1", L"1080p60",
+			config);
+	cache.Save(data);
+	seeds.push_back(data);
+
+	/* odd-length strings exercise the padding */
+	CapsCacheEntry empty;
+	cache.SetVideo(L"abc", empty);
+	cache.SetConfig(L"abc", L"", config);
+	cache.Save(data);
+	seeds.push_back(data);
+}
+
+/* byte-level mutations, plus some aimed at the 32-bit size/count fields
+ * the parser has to check */
+static void Mutate(std::vector<uint8_t> &data,
+		   const std::vector<std::vector<uint8_t>> &seeds)
+{
+	int count = 1 + (int)(Rand() % 4);
+
+	for (int i = 0; i < count; i++) {
+		size_t size = data.size();
+		size_t pos = size ? Rand() % size : 0;
+
+		switch (Rand() % 8) {
+		case 0:
+			if (size)
+				data[pos] ^= (uint8_t)(1 << (Rand() % 8));
+			break;
+		case 1:
+			if (size)
+				data[pos] = (uint8_t)Rand();
+			break;
+		case 2:
+			data.resize(pos);
+			break;
+		case 3:
+			data.insert(data.begin() + pos, (uint8_t)Rand());
+			break;
+		case 4:
+			if (size)
+				data.erase(data.begin() + pos);
+			break;
+		case 5:
+			/* a 32-bit field set to something interesting */
+			if (size >= 4) {
+				static const uint32_t values[] = {
+					0,          1,          2,
+					3,          4096,       4097,
+					0x7FFFFFFF, 0x80000000, 0xFFFFFFFF};
+				uint32_t value =
+					values[Rand() % (sizeof(values) /
+							 sizeof(values[0]))];
+				pos &= ~(size_t)3;
+				if (pos + 4 > size)
+					pos = size - 4;
+				memcpy(&data[pos], &value, 4);
+			}
+			break;
+		case 6:
+			/* a 32-bit field nudged up or down */
+			if (size >= 4) {
+				uint32_t value;
+				pos &= ~(size_t)3;
+				if (pos + 4 > size)
+					pos = size - 4;
+				memcpy(&value, &data[pos], 4);
+				value += (Rand() & 1) ? 1 : (uint32_t)-1;
+				memcpy(&data[pos], &value, 4);
+			}
+			break;
+		default: {
+			/* splice in part of another seed */
+			const std::vector<uint8_t> &other =
+				seeds[Rand() % seeds.size()];
+			if (other.empty())
+				break;
+			size_t start = Rand() % other.size();
+			size_t length = Rand() % (other.size() - start + 1);
+			data.insert(data.begin() + pos, other.begin() + start,
+				    other.begin() + start + length);
+			break;
+		}
+		}
+	}
+}
+
+static bool ReadFile(const char *path, std::vector<uint8_t> &data)
+{
+	FILE *file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	uint8_t buf[4096];
+	size_t got;
+
+	data.clear();
+	while ((got = fread(buf, 1, sizeof(buf), file)) > 0)
+		data.insert(data.end(), buf, buf + got);
+
+	fclose(file);
+	return true;
+}
+
+static bool WriteSeeds(const char *dir,
+		       const std::vector<std::vector<uint8_t>> &seeds)
+{
+	for (size_t i = 0; i < seeds.size(); i++) {
+		std::string path =
+			std::string(dir) + "/seed-" + std::to_string(i);
+		FILE *file = fopen(path.c_str(), "wb");
+		if (!file)
+			return false;
+		fwrite(seeds[i].data(), 1, seeds[i].size(), file);
+		fclose(file);
+	}
+
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::vector<uint8_t>> seeds;
+	std::vector<const char *> files;
+	long runs = DEFAULT_RUNS;
+
+	MakeSeeds(seeds);
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+			runs = atol(argv[++i]);
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			randState = (uint32_t)strtoul(argv[++i], nullptr, 0);
+		} else if (strcmp(argv[i], "--write-seeds") == 0 &&
+			   i + 1 < argc) {
+			if (!WriteSeeds(argv[++i], seeds)) {
+				fprintf(stderr, "Could not write seeds\n");
+				return 1;
+			}
+			return 0;
+		} else {
+			files.push_back(argv[i]);
+		}
+	}
+
+	if (!files.empty()) {
+		std::vector<uint8_t> data;
+
+		for (const char *path : files) {
+			if (!ReadFile(path, data)) {
+				fprintf(stderr, "Could not read %s\n", path);
+				return 1;
+			}
+			LLVMFuzzerTestOneInput(data.data(), data.size());
+		}
+
+		printf("fuzz-caps-cache: %zu file(s) passed\n", files.size());
+		return 0;
+	}
+
+	/* the seeds themselves must load */
+	for (const std::vector<uint8_t> &seed : seeds) {
+		CapsCache cache;
+		if (!cache.Load(seed.data(), seed.size()))
+			Fail("seed doesn't load");
+		LLVMFuzzerTestOneInput(seed.data(), seed.size());
+	}
+
+	long accepted = 0;
+
+	for (long i = 0; i < runs; i++) {
+		std::vector<uint8_t> data = seeds[Rand() % seeds.size()];
+		Mutate(data, seeds);
+
+		CapsCache cache;
+		if (cache.Load(data.data(), data.size()))
+			accepted++;
+
+		LLVMFuzzerTestOneInput(data.data(), data.size());
+	}
+
+	printf("fuzz-caps-cache: %ld runs passed, %ld inputs loaded\n", runs,
+	       accepted);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,166 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include "encoder-feed.hpp"
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+/*
+ * Stands in for a VideoEncoder's YV12 input sample, for the encoder feed
+ * tests and benchmark.  Frames are "encoded" by counting them, and any
+ * step can be made to fail.
+ */
+class StandInEncoder : public DShow::EncoderInput {
+public:
+	int cx;
+	int cy;
+	std::vector<uint8_t> sample;
+	size_t linesize[3];
+	size_t offsets[3];
+
+	bool failLock = false;
+	bool failSubmit = false;
+	bool locked = false;
+
+	long long locks = 0;
+	long long submitted = 0;
+	long long discarded = 0;
+	long long dropped = 0;
+	long long lastStartTime = 0;
+	long long lastStopTime = 0;
+
+	StandInEncoder(int cx_, int cy_) : cx(cx_), cy(cy_)
+	{
+		size_t chromaCX = ((size_t)cx + 1) / 2;
+		size_t chromaCY = ((size_t)cy + 1) / 2;
+
+		linesize[0] = (size_t)cx;
+		linesize[1] = chromaCX;
+		linesize[2] = chromaCX;
+		offsets[0] = 0;
+		offsets[1] = (size_t)cx * (size_t)cy;
+		offsets[2] = offsets[1] + chromaCX * chromaCY;
+		sample.resize(offsets[2] + chromaCX * chromaCY);
+	}
+
+	bool GetInputBuffer(DShow::EncoderInputBuffer &buffer) override
+	{
+		locks++;
+		if (failLock || locked)
+			return false;
+
+		memset(&buffer, 0, sizeof(buffer));
+		for (size_t i = 0; i < 3; i++) {
+			buffer.data[i] = sample.data() + offsets[i];
+			buffer.linesize[i] = linesize[i];
+		}
+		buffer.size = sample.size();
+		buffer.format = DShow::VideoFormat::YV12;
+		buffer.cx = cx;
+		buffer.cy = cy;
+
+		locked = true;
+		return true;
+	}
+
+	bool SubmitInputBuffer(long long startTime, long long stopTime) override
+	{
+		if (!locked || failSubmit)
+			return false;
+
+		locked = false;
+		submitted++;
+		lastStartTime = startTime;
+		lastStopTime = stopTime;
+		return true;
+	}
+
+	void DiscardInputBuffer() override
+	{
+		if (!locked)
+			return;
+
+		locked = false;
+		discarded++;
+	}
+
+	void CountDroppedInput() override { dropped++; }
+};
+
+/* a tightly packed frame, laid out as VFormatPlaneLayout would */
+static inline DShow::EncoderFeedFrame MakeFeedFrame(DShow::VideoFormat format,
+						    int cx, int cy,
+						    std::vector<uint8_t> &data)
+{
+	using DShow::VideoFormat;
+
+	size_t width = (size_t)cx;
+	size_t height = (size_t)cy;
+	size_t chromaCX = (width + 1) / 2;
+	size_t chromaCY = (height + 1) / 2;
+	DShow::EncoderFeedFrame frame;
+
+	memset(&frame, 0, sizeof(frame));
+	frame.format = format;
+	frame.cx = cx;
+	frame.cy = cy;
+
+	switch (format) {
+	case VideoFormat::I420:
+	case VideoFormat::YV12:
+		frame.linesize[0] = width;
+		frame.linesize[1] = chromaCX;
+		frame.linesize[2] = chromaCX;
+		frame.offsets[1] = width * height;
+		frame.offsets[2] = frame.offsets[1] + chromaCX * chromaCY;
+		frame.frameSize = frame.offsets[2] + chromaCX * chromaCY;
+		break;
+	case VideoFormat::NV12:
+		frame.linesize[0] = width;
+		frame.linesize[1] = chromaCX * 2;
+		frame.offsets[1] = width * height;
+		frame.frameSize = frame.offsets[1] + chromaCX * 2 * chromaCY;
+		break;
+	case VideoFormat::XRGB:
+	case VideoFormat::ARGB:
+		frame.linesize[0] = width * 4;
+		frame.frameSize = width * 4 * height;
+		break;
+	case VideoFormat::YUY2:
+	case VideoFormat::UYVY:
+		frame.linesize[0] = width * 2;
+		frame.frameSize = width * 2 * height;
+		break;
+	default:
+		/* no known layout, as VFormatPlaneLayout returns for MJPEG */
+		break;
+	}
+
+	data.resize(frame.frameSize ? frame.frameSize : width * height);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = (uint8_t)((i * 7 + (i >> 8) * 13) & 0xFF);
+
+	frame.data = data.data();
+	frame.size = data.size();
+	return frame;
+}
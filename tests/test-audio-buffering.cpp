@@ -0,0 +1,196 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "test.hpp"
+#include "audio-buffering.hpp"
+
+using namespace DShow;
+
+/* 10ms buffers */
+#define DURATION 100000LL
+
+struct Feed {
+	AudioBufferMonitor monitor;
+	long long receive = 1000000000LL;
+	long long start = 0;
+
+	/* returns true if the monitor asked for more buffering */
+	bool Next(long long lateBy = 0, long long gap = 0,
+		  bool discontinuity = false)
+	{
+		start += gap;
+		receive += DURATION + lateBy;
+
+		bool raise = monitor.Update(receive, start, start + DURATION,
+					    discontinuity);
+		start += DURATION;
+		return raise;
+	}
+
+	long long Glitches() const
+	{
+		AudioBufferingStats stats;
+		monitor.GetStats(stats);
+		return stats.glitches;
+	}
+};
+
+static void TestSteady()
+{
+	Feed feed;
+	AudioBufferingStats stats;
+
+	for (int i = 0; i < 1000; i++)
+		CHECK(!feed.Next((i % 2) * 10000));
+
+	feed.monitor.GetStats(stats);
+	CHECK(stats.buffers == 1000);
+	CHECK(stats.glitches == 0);
+	CHECK_NEAR(stats.meanInterval, DURATION + 5000, 1000);
+	CHECK(stats.maxInterval == DURATION + 10000);
+	CHECK_NEAR(stats.jitter, 5000, 1000);
+}
+
+static void TestGlitches()
+{
+	Feed feed;
+
+	feed.Next();
+	feed.Next();
+
+	/* late: more than 4 buffers and 20ms since the last one */
+	feed.Next(4 * DURATION + 1);
+	CHECK(feed.Glitches() == 1);
+
+	/* late by less than 20ms is not a glitch for short buffers */
+	Feed shortBuffers;
+	shortBuffers.Next();
+	shortBuffers.monitor.Update(shortBuffers.receive + 150000,
+				    shortBuffers.start,
+				    shortBuffers.start + 10000, false);
+	CHECK(shortBuffers.Glitches() == 0);
+
+	/* a gap in the timestamps is lost audio, rounding is not */
+	feed.Next(0, 10000);
+	CHECK(feed.Glitches() == 1);
+	feed.Next(0, 10001);
+	CHECK(feed.Glitches() == 2);
+
+	feed.Next(0, 0, true);
+	CHECK(feed.Glitches() == 3);
+}
+
+static void TestFirstBuffer()
+{
+	Feed feed;
+
+	/* nothing to compare the first buffer against */
+	CHECK(!feed.Next(0, 50000000LL, true));
+	CHECK(feed.Glitches() == 0);
+}
+
+static void TestRaise()
+{
+	Feed feed;
+
+	feed.Next();
+	CHECK(!feed.Next(0, 0, true));
+	CHECK(!feed.Next(0, 0, true));
+	CHECK(feed.Next(0, 0, true));
+
+	/* the window starts over after asking */
+	CHECK(!feed.Next(0, 0, true));
+	CHECK(!feed.Next(0, 0, true));
+	CHECK(feed.Next(0, 0, true));
+	CHECK(feed.Glitches() == 6);
+}
+
+static void TestWindow()
+{
+	Feed feed;
+
+	/* glitches spread further apart than the window never add up */
+	for (int i = 0; i < 2000; i++)
+		CHECK(!feed.Next(0, 0, i % 200 == 199));
+
+	CHECK(feed.Glitches() == 10);
+}
+
+static void TestReset()
+{
+	Feed feed;
+	AudioBufferingStats stats;
+
+	feed.Next();
+	feed.Next(0, 0, true);
+	feed.monitor.Reset();
+
+	feed.monitor.GetStats(stats);
+	CHECK(stats.buffers == 0);
+	CHECK(stats.glitches == 0);
+	CHECK(stats.meanInterval == 0);
+	CHECK(stats.maxInterval == 0);
+}
+
+static void TestAdaptive()
+{
+	const std::wstring path = L"\\\\?\\test#device-a";
+	const std::wstring other = L"\\\\?\\test#device-b";
+	long long backoffs = -1;
+
+	CHECK(GetAdaptiveAudioBuffering(path, &backoffs) ==
+	      AUDIO_BUFFERING_MIN_MS);
+	CHECK(backoffs == 0);
+
+	int ms = AUDIO_BUFFERING_MIN_MS;
+	int expected = AUDIO_BUFFERING_MIN_MS;
+	for (int i = 0; i < 10; i++) {
+		ms = RaiseAdaptiveAudioBuffering(path, ms);
+		expected *= 2;
+		if (expected > AUDIO_BUFFERING_MAX_MS)
+			expected = AUDIO_BUFFERING_MAX_MS;
+		CHECK(ms == expected);
+	}
+
+	CHECK(GetAdaptiveAudioBuffering(path, &backoffs) ==
+	      AUDIO_BUFFERING_MAX_MS);
+	CHECK(backoffs == 6);
+
+	/* a connection still on an old value gets the raised one instead
+	 * of raising it again */
+	CHECK(RaiseAdaptiveAudioBuffering(path, 4) == AUDIO_BUFFERING_MAX_MS);
+	GetAdaptiveAudioBuffering(path, &backoffs);
+	CHECK(backoffs == 6);
+
+	/* devices are independent */
+	CHECK(GetAdaptiveAudioBuffering(other) == AUDIO_BUFFERING_MIN_MS);
+}
+
+int main()
+{
+	TestSteady();
+	TestGlitches();
+	TestFirstBuffer();
+	TestRaise();
+	TestWindow();
+	TestReset();
+	TestAdaptive();
+
+	return TestResult("test-audio-buffering");
+}
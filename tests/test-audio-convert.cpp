@@ -0,0 +1,317 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "test.hpp"
+#include "audio-convert.hpp"
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+using namespace DShow;
+
+/* odd lengths so both the SSE2 blocks and the scalar tails get exercised */
+#define TEST_SAMPLES 1037
+
+#define MIX_EPSILON 0.000001
+
+static uint32_t randState = 12345;
+
+static uint32_t Rand()
+{
+	randState = randState * 1664525 + 1013904223;
+	return randState;
+}
+
+static void TestSampleBytes()
+{
+	CHECK(AFormatSampleBytes(AudioFormat::Wave16bit) == 2);
+	CHECK(AFormatSampleBytes(AudioFormat::Wave24bit) == 3);
+	CHECK(AFormatSampleBytes(AudioFormat::Wave32bit) == 4);
+	CHECK(AFormatSampleBytes(AudioFormat::WaveFloat) == 4);
+	CHECK(AFormatSampleBytes(AudioFormat::AAC) == 0);
+	CHECK(AFormatSampleBytes(AudioFormat::Any) == 0);
+}
+
+static void TestS16()
+{
+	std::vector<int16_t> in(TEST_SAMPLES);
+	std::vector<float> out(TEST_SAMPLES);
+
+	for (size_t i = 0; i < in.size(); i++)
+		in[i] = (int16_t)Rand();
+	in[0] = -32768;
+	in[1] = 32767;
+	in[2] = 0;
+	in[3] = -1;
+
+	AudioToFloat(AudioFormat::Wave16bit, (const uint8_t *)in.data(),
+		     in.size(), out.data());
+
+	for (size_t i = 0; i < in.size(); i++)
+		CHECK(out[i] == (float)((double)in[i] / 32768.0));
+
+	CHECK(out[0] == -1.0f);
+	CHECK(out[2] == 0.0f);
+}
+
+static void TestS24()
+{
+	std::vector<uint8_t> in(TEST_SAMPLES * 3);
+	std::vector<int32_t> ref(TEST_SAMPLES);
+	std::vector<float> out(TEST_SAMPLES);
+
+	for (size_t i = 0; i < ref.size(); i++) {
+		int32_t val = (int32_t)(Rand() & 0xFFFFFF);
+		if (val & 0x800000)
+			val -= 0x1000000;
+		if (i == 0)
+			val = -8388608;
+		else if (i == 1)
+			val = 8388607;
+
+		ref[i] = val;
+		in[i * 3 + 0] = (uint8_t)(val & 0xFF);
+		in[i * 3 + 1] = (uint8_t)((val >> 8) & 0xFF);
+		in[i * 3 + 2] = (uint8_t)((val >> 16) & 0xFF);
+	}
+
+	AudioToFloat(AudioFormat::Wave24bit, in.data(), ref.size(),
+		     out.data());
+
+	for (size_t i = 0; i < ref.size(); i++)
+		CHECK(out[i] == (float)((double)ref[i] / 8388608.0));
+
+	CHECK(out[0] == -1.0f);
+}
+
+static void TestS32()
+{
+	std::vector<int32_t> in(TEST_SAMPLES);
+	std::vector<float> out(TEST_SAMPLES);
+
+	for (size_t i = 0; i < in.size(); i++)
+		in[i] = (int32_t)Rand();
+	in[0] = INT32_MIN;
+	in[1] = INT32_MAX;
+
+	AudioToFloat(AudioFormat::Wave32bit, (const uint8_t *)in.data(),
+		     in.size(), out.data());
+
+	/* int32 doesn't fit a float mantissa, so allow for the rounding of
+	 * the conversion itself */
+	for (size_t i = 0; i < in.size(); i++)
+		CHECK_NEAR(out[i], (double)in[i] / 2147483648.0, 0.0000001);
+
+	CHECK(out[0] == -1.0f);
+}
+
+static void TestFloat()
+{
+	std::vector<float> in(TEST_SAMPLES);
+	std::vector<float> out(TEST_SAMPLES);
+
+	for (size_t i = 0; i < in.size(); i++)
+		in[i] = (float)(int32_t)Rand() / 2147483648.0f;
+
+	AudioToFloat(AudioFormat::WaveFloat, (const uint8_t *)in.data(),
+		     in.size(), out.data());
+
+	CHECK(memcmp(in.data(), out.data(), in.size() * sizeof(float)) == 0);
+}
+
+static void TestUnknownFormat()
+{
+	uint8_t in[16] = {0xFF};
+	float out[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+
+	AudioToFloat(AudioFormat::AAC, in, 4, out);
+	for (int i = 0; i < 4; i++)
+		CHECK(out[i] == 0.0f);
+}
+
+static void TestDeinterleave()
+{
+	for (int channels = 1; channels <= 8; channels++) {
+		size_t frames = TEST_SAMPLES / channels;
+		std::vector<float> in(frames * channels);
+		std::vector<std::vector<float>> planes(channels);
+		std::vector<float *> out(channels);
+
+		for (size_t i = 0; i < in.size(); i++)
+			in[i] = (float)i;
+		for (int c = 0; c < channels; c++) {
+			planes[c].resize(frames);
+			out[c] = planes[c].data();
+		}
+
+		AudioDeinterleave(in.data(), frames, channels, out.data());
+
+		for (int c = 0; c < channels; c++)
+			for (size_t i = 0; i < frames; i++)
+				CHECK(planes[c][i] == in[i * channels + c]);
+	}
+}
+
+static void CheckMatrix(int inChannels, int outChannels,
+			const std::vector<int> &channelMap,
+			const std::vector<float> &expected)
+{
+	std::vector<float> matrix;
+	AudioMixMatrix(inChannels, outChannels, channelMap, matrix);
+
+	CHECK(matrix.size() == expected.size());
+	if (matrix.size() != expected.size())
+		return;
+
+	for (size_t i = 0; i < matrix.size(); i++)
+		CHECK_NEAR(matrix[i], expected[i], MIX_EPSILON);
+}
+
+static void TestMixMatrices()
+{
+	const std::vector<int> noMap;
+
+	/* mono <-> stereo */
+	CheckMatrix(1, 2, noMap, {1.0f, 1.0f});
+	CheckMatrix(2, 1, noMap, {0.5f, 0.5f});
+
+	/* 2.1 drops the LFE */
+	CheckMatrix(3, 2, noMap, {1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f});
+
+	/* quad: 1 / (1 + 0.7071) and 0.7071 / (1 + 0.7071) */
+	CheckMatrix(4, 2, noMap,
+		    {0.58578644f, 0.0f, 0.41421356f, 0.0f,
+		     0.0f, 0.58578644f, 0.0f, 0.41421356f});
+
+	/* 5.1: 1 / (1 + 2 * 0.7071) and 0.7071 / (1 + 2 * 0.7071) */
+	CheckMatrix(6, 2, noMap,
+		    {0.41421356f, 0.0f, 0.29289322f, 0.0f, 0.29289322f,
+		     0.0f,
+		     0.0f, 0.41421356f, 0.29289322f, 0.0f, 0.0f,
+		     0.29289322f});
+
+	/* 5.1 to mono halves the stereo gains and sums both sides */
+	CheckMatrix(6, 1, noMap,
+		    {0.20710678f, 0.20710678f, 0.29289322f, 0.0f,
+		     0.14644661f, 0.14644661f});
+
+	/* 7.1: 1 / (1 + 3 * 0.7071) and 0.7071 / (1 + 3 * 0.7071) */
+	CheckMatrix(8, 2, noMap,
+		    {0.32037724f, 0.0f, 0.22654092f, 0.0f, 0.22654092f, 0.0f,
+		     0.22654092f, 0.0f,
+		     0.0f, 0.32037724f, 0.22654092f, 0.0f, 0.0f, 0.22654092f,
+		     0.0f, 0.22654092f});
+
+	/* upmixing only passes through the channels that exist */
+	CheckMatrix(2, 4, noMap,
+		    {1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f});
+
+	/* anything else is passed through */
+	CheckMatrix(6, 6, noMap, {1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0,
+				  0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0,
+				  0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1});
+}
+
+static void TestChannelMap()
+{
+	/* swap, silence and a missing entry */
+	CheckMatrix(2, 3, {1, 0}, {0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f});
+	CheckMatrix(2, 3, {1, 0, -1}, {0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f});
+
+	/* source indices past the input are silent rather than invalid */
+	CheckMatrix(2, 2, {5, 1}, {0.0f, 0.0f, 0.0f, 1.0f});
+
+	/* pick the center channel of 5.1 as mono */
+	CheckMatrix(6, 1, {2}, {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f});
+
+	/* a map overrides the downmix even when channel counts match */
+	std::vector<float> matrix;
+	AudioMixMatrix(2, 2, {1, 0}, matrix);
+	CHECK(!AudioMixIsIdentity(2, 2, matrix));
+
+	AudioMixMatrix(2, 2, {0, 1}, matrix);
+	CHECK(AudioMixIsIdentity(2, 2, matrix));
+}
+
+static void TestIdentity()
+{
+	std::vector<float> matrix;
+
+	AudioMixMatrix(6, 6, std::vector<int>(), matrix);
+	CHECK(AudioMixIsIdentity(6, 6, matrix));
+
+	AudioMixMatrix(6, 2, std::vector<int>(), matrix);
+	CHECK(!AudioMixIsIdentity(6, 2, matrix));
+}
+
+static void TestMixPlanar()
+{
+	const int inChannels = 6;
+	const int outChannels = 2;
+	const size_t frames = TEST_SAMPLES;
+
+	std::vector<std::vector<float>> inPlanes(inChannels);
+	std::vector<std::vector<float>> outPlanes(outChannels);
+	std::vector<const float *> in(inChannels);
+	std::vector<float *> out(outChannels);
+
+	for (int c = 0; c < inChannels; c++) {
+		inPlanes[c].resize(frames);
+		for (size_t i = 0; i < frames; i++)
+			inPlanes[c][i] = (float)(int32_t)Rand() / 2147483648.0f;
+		in[c] = inPlanes[c].data();
+	}
+	for (int c = 0; c < outChannels; c++) {
+		outPlanes[c].assign(frames, 123.0f);
+		out[c] = outPlanes[c].data();
+	}
+
+	std::vector<float> matrix;
+	AudioMixMatrix(inChannels, outChannels, std::vector<int>(), matrix);
+	AudioMixPlanar(in.data(), inChannels, out.data(), outChannels, frames,
+		       matrix.data());
+
+	for (int o = 0; o < outChannels; o++) {
+		for (size_t i = 0; i < frames; i++) {
+			double ref = 0.0;
+			for (int c = 0; c < inChannels; c++)
+				ref += (double)inPlanes[c][i] *
+				       matrix[o * inChannels + c];
+			CHECK_NEAR(outPlanes[o][i], ref, MIX_EPSILON);
+		}
+	}
+}
+
+int main()
+{
+	TestSampleBytes();
+	TestS16();
+	TestS24();
+	TestS32();
+	TestFloat();
+	TestUnknownFormat();
+	TestDeinterleave();
+	TestMixMatrices();
+	TestChannelMap();
+	TestIdentity();
+	TestMixPlanar();
+
+	return TestResult("test-audio-convert");
+}
@@ -0,0 +1,239 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "test.hpp"
+#include "audio-resampler.hpp"
+
+#include <math.h>
+#include <vector>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+using namespace DShow;
+
+/* output frames at the start that still see the silence ahead of the
+ * first input frame */
+#define SETTLE_FRAMES 64
+
+struct Planes {
+	std::vector<std::vector<float>> data;
+	std::vector<float *> ptrs;
+
+	Planes(int channels, size_t frames)
+		: data(channels, std::vector<float>(frames)), ptrs(channels)
+	{
+		for (int c = 0; c < channels; c++)
+			ptrs[c] = data[c].data();
+	}
+};
+
+static void Sine(Planes &planes, double freq, int rate, size_t offset = 0)
+{
+	for (size_t c = 0; c < planes.data.size(); c++) {
+		std::vector<float> &plane = planes.data[c];
+		for (size_t i = 0; i < plane.size(); i++)
+			plane[i] = (float)(0.5 * sin(2.0 * M_PI * freq *
+						     (double)(i + offset) /
+						     rate +
+						     (double)c));
+	}
+}
+
+/* feeds the whole input in chunks of the given size, returns plane 0 */
+static std::vector<float> Run(AudioResampler &rs, Planes &in, size_t chunk)
+{
+	int channels = (int)in.data.size();
+	size_t frames = in.data[0].size();
+	std::vector<std::vector<float>> result(channels);
+
+	for (size_t pos = 0; pos < frames; pos += chunk) {
+		size_t count = frames - pos < chunk ? frames - pos : chunk;
+		size_t maxOut = rs.MaxOutputFrames(count);
+		Planes out(channels, maxOut);
+		std::vector<const float *> inPtrs(channels);
+
+		for (int c = 0; c < channels; c++)
+			inPtrs[c] = in.ptrs[c] + pos;
+
+		size_t produced =
+			rs.Process(inPtrs.data(), count, out.ptrs.data(), maxOut);
+		CHECK(produced <= maxOut);
+
+		for (int c = 0; c < channels; c++)
+			result[c].insert(result[c].end(), out.data[c].begin(),
+					 out.data[c].begin() + produced);
+	}
+
+	for (int c = 1; c < channels; c++)
+		CHECK(result[c].size() == result[0].size());
+	return result[0];
+}
+
+static void TestSineAccuracy(int inRate, int outRate)
+{
+	AudioResampler rs;
+	rs.Reset(inRate, outRate, 2);
+
+	Planes in(2, (size_t)inRate);
+	Sine(in, 1000.0, inRate);
+
+	std::vector<float> out = Run(rs, in, 480);
+	double step = (double)inRate / (double)outRate;
+	double maxError = 0.0;
+
+	/* output frame k sits at input frame k * step */
+	size_t end = (size_t)((in.data[0].size() - 32) / step);
+	for (size_t k = SETTLE_FRAMES; k < end && k < out.size(); k++) {
+		double t = (double)k * step / inRate;
+		double ref = 0.5 * sin(2.0 * M_PI * 1000.0 * t);
+		double error = fabs(out[k] - ref);
+		if (error > maxError)
+			maxError = error;
+	}
+
+	CHECK(maxError < 0.001);
+
+	/* about one second of output, less the filter latency of half the
+	 * filter's input frames */
+	size_t latency = (size_t)ceil(17.0 / step);
+	CHECK(out.size() <= (size_t)outRate);
+	CHECK(out.size() + latency >= (size_t)outRate);
+}
+
+static void TestDCGain()
+{
+	AudioResampler rs;
+	rs.Reset(44100, 48000, 1);
+
+	Planes in(1, 4410);
+	for (float &val : in.data[0])
+		val = 0.5f;
+
+	std::vector<float> out = Run(rs, in, 441);
+	for (size_t k = SETTLE_FRAMES; k + SETTLE_FRAMES < out.size(); k++)
+		CHECK_NEAR(out[k], 0.5, 0.0001);
+}
+
+static void TestChunking()
+{
+	AudioResampler whole, chunked;
+	whole.Reset(48000, 44100, 2);
+	chunked.Reset(48000, 44100, 2);
+
+	Planes in(2, 48000);
+	Sine(in, 440.0, 48000);
+
+	/* history carried across calls makes the chunk size irrelevant */
+	std::vector<float> a = Run(whole, in, 48000);
+	std::vector<float> b = Run(chunked, in, 37);
+
+	CHECK(a.size() == b.size());
+	for (size_t i = 0; i < a.size() && i < b.size(); i++)
+		CHECK_NEAR(a[i], b[i], 0.000001);
+}
+
+static void TestAntiAliasing()
+{
+	AudioResampler rs;
+	rs.Reset(48000, 44100, 1);
+
+	/* above the output's Nyquist frequency, so it has to be filtered
+	 * out rather than fold back down */
+	Planes in(1, 48000);
+	Sine(in, 23000.0, 48000);
+
+	std::vector<float> out = Run(rs, in, 480);
+	double sum = 0.0;
+	size_t count = 0;
+	for (size_t k = SETTLE_FRAMES; k + SETTLE_FRAMES < out.size(); k++) {
+		sum += (double)out[k] * out[k];
+		count++;
+	}
+
+	/* input RMS is 0.35 */
+	CHECK(sqrt(sum / count) < 0.02);
+}
+
+static void TestRatioAdjust()
+{
+	AudioResampler rs;
+	rs.Reset(48000, 48000, 1);
+
+	rs.SetRatioAdjust(2.0);
+	CHECK_NEAR(rs.GetRatioAdjust(), 1.05, 0.0000001);
+	rs.SetRatioAdjust(0.5);
+	CHECK_NEAR(rs.GetRatioAdjust(), 0.95, 0.0000001);
+
+	/* 1000ppm more output over ten seconds */
+	rs.SetRatioAdjust(1.001);
+	Planes in(1, 480000);
+	Sine(in, 1000.0, 48000);
+
+	std::vector<float> out = Run(rs, in, 480);
+	CHECK_NEAR((double)out.size(), 480480.0, 32.0);
+}
+
+static void TestOutputOffset()
+{
+	AudioResampler rs;
+	CHECK(rs.NextOutputOffset() == 0.0);
+
+	rs.Reset(44100, 48000, 1);
+
+	/* the first output frame lines up with the first input frame */
+	CHECK(rs.NextOutputOffset() == 0.0);
+
+	Planes in(1, 441);
+	Sine(in, 1000.0, 44100);
+	Run(rs, in, 441);
+
+	/* pending output frames lie inside the buffer just fed in, which
+	 * the next buffer's offset is relative to */
+	double offset = rs.NextOutputOffset();
+	CHECK(offset < 0.0);
+	CHECK(offset > -32.0);
+}
+
+static void TestUnconfigured()
+{
+	AudioResampler rs;
+	float sample = 0.0f;
+	const float *in = &sample;
+	float *out = &sample;
+
+	CHECK(rs.Process(&in, 1, &out, 1) == 0);
+}
+
+int main()
+{
+	TestSineAccuracy(44100, 48000);
+	TestSineAccuracy(48000, 44100);
+	TestSineAccuracy(48000, 48000);
+	TestSineAccuracy(32000, 96000);
+	TestDCGain();
+	TestChunking();
+	TestAntiAliasing();
+	TestRatioAdjust();
+	TestOutputOffset();
+	TestUnconfigured();
+
+	return TestResult("test-audio-resampler");
+}
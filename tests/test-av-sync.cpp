@@ -0,0 +1,133 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "test.hpp"
+#include "av-sync.hpp"
+
+using namespace DShow;
+
+#define RATE 48000
+#define BUFFER_FRAMES 480
+#define HOST_ORIGIN 50000000000LL
+#define VIDEO_ORIGIN 20000000000LL
+#define AUDIO_ORIGIN 70000000000LL
+#define FRAME_INTERVAL 333333LL
+
+/* audio device actually runs 200ppm fast against the host clock */
+#define AUDIO_DRIFT 0.0002
+
+/* one 10ms buffer is what the old mapping was off by */
+#define MAX_ERROR 5000
+
+/* video timestamps are exactly host time minus VIDEO_ORIGIN */
+static void FeedVideo(ClockMapper &videoClock, long long until)
+{
+	for (long long t = 0; t <= until; t += FRAME_INTERVAL)
+		videoClock.Update(t, t + VIDEO_ORIGIN);
+}
+
+/* host time at which the given sample was captured */
+static long long CaptureTime(long long frame)
+{
+	return HOST_ORIGIN +
+	       (long long)((double)frame * 10000000.0 /
+			   ((double)RATE * (1.0 + AUDIO_DRIFT)));
+}
+
+static void TestBufferStartMapping(int batch)
+{
+	ClockMapper videoClock;
+	AVSync sync;
+	AVSyncStats stats;
+	int checked = 0;
+
+	FeedVideo(videoClock, HOST_ORIGIN - VIDEO_ORIGIN + 200000000LL);
+
+	for (int i = 0; i < 1000; i++) {
+		long long start = (long long)i * BUFFER_FRAMES;
+		long long end = start + BUFFER_FRAMES;
+		long long deviceTime = AUDIO_ORIGIN + start * 10000000LL / RATE;
+
+		/* buffers arrive when their last sample is captured, plus a
+		 * little delivery jitter.  in a batch only the last buffer
+		 * has its own arrival time */
+		long long hostTime = CaptureTime(end) + (i % 5) * 2000 - 4000;
+		if ((i + 1) % batch)
+			hostTime = 0;
+
+		long long corrected = sync.AddAudio(deviceTime, BUFFER_FRAMES,
+						    RATE, hostTime, videoClock);
+		if (i < 100 || !corrected)
+			continue;
+
+		/* the corrected time is when the first sample of the buffer
+		 * was captured, on the video timeline */
+		long long expected = CaptureTime(start) - VIDEO_ORIGIN;
+		CHECK_NEAR(corrected, expected, MAX_ERROR);
+		checked++;
+	}
+
+	CHECK(checked == 900);
+
+	sync.GetStats(stats, videoClock);
+	CHECK(stats.buffers > 0);
+	CHECK_NEAR(stats.audioDriftPPM, -200.0, 20.0);
+	CHECK_NEAR(stats.driftPPM, -200.0, 20.0);
+}
+
+static void TestNoVideoClock()
+{
+	ClockMapper videoClock;
+	AVSync sync;
+
+	/* nothing to map onto yet, so timestamps pass through */
+	CHECK(sync.AddAudio(1234, BUFFER_FRAMES, RATE, HOST_ORIGIN,
+			    videoClock) == 1234);
+	CHECK(sync.AddAudio(5678, BUFFER_FRAMES, 0, HOST_ORIGIN,
+			    videoClock) == 5678);
+}
+
+static void TestRateChange()
+{
+	ClockMapper videoClock;
+	AVSync sync;
+
+	FeedVideo(videoClock, HOST_ORIGIN - VIDEO_ORIGIN + 200000000LL);
+
+	for (int i = 0; i < 50; i++)
+		sync.AddAudio(0, BUFFER_FRAMES, RATE,
+			      CaptureTime((i + 1) * BUFFER_FRAMES), videoClock);
+
+	/* a new rate starts counting samples again from this buffer, and
+	 * the first buffer's start is its arrival minus its duration */
+	long long hostTime = HOST_ORIGIN + 100000000LL;
+	long long corrected =
+		sync.AddAudio(0, 441, 44100, hostTime, videoClock);
+	CHECK_NEAR(corrected, hostTime - 100000 - VIDEO_ORIGIN, 1);
+}
+
+int main()
+{
+	TestBufferStartMapping(1);
+	TestBufferStartMapping(4);
+	TestNoVideoClock();
+	TestRateChange();
+
+	return TestResult("test-av-sync");
+}
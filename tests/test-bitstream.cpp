@@ -0,0 +1,833 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "test.hpp"
+#include "bitstream.hpp"
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+using namespace DShow;
+
+/* ------------------------------------------------------------------------- */
+
+class BitWriter {
+	std::vector<uint8_t> bytes;
+	int bit = 0;
+
+public:
+	void Bit(unsigned val)
+	{
+		if (!(bit & 7))
+			bytes.push_back(0);
+		if (val)
+			bytes.back() |= (uint8_t)(0x80 >> (bit & 7));
+		bit++;
+	}
+
+	void Bits(unsigned val, int count)
+	{
+		while (count--)
+			Bit((val >> count) & 1);
+	}
+
+	void UE(unsigned val)
+	{
+		int length = 0;
+		while ((val + 1) >> (length + 1))
+			length++;
+
+		Bits(0, length);
+		Bits(val + 1, length + 1);
+	}
+
+	void SE(int val) { UE(val > 0 ? val * 2 - 1 : -val * 2); }
+
+	/* adds the RBSP trailing bits and emulation prevention, and puts
+	 * the NAL header in front */
+	std::vector<uint8_t> Nal(const std::vector<uint8_t> &header)
+	{
+		Bit(1);
+		while (bit & 7)
+			Bit(0);
+
+		std::vector<uint8_t> nal = header;
+		int zeros = 0;
+
+		for (uint8_t byte : bytes) {
+			if (zeros >= 2 && byte <= 3) {
+				nal.push_back(3);
+				zeros = 0;
+			}
+
+			zeros = byte ? 0 : zeros + 1;
+			nal.push_back(byte);
+		}
+
+		return nal;
+	}
+};
+
+static std::vector<uint8_t> AnnexB(const std::vector<std::vector<uint8_t>> &nals)
+{
+	std::vector<uint8_t> packet;
+
+	for (const std::vector<uint8_t> &nal : nals) {
+		static const uint8_t startCode[] = {0, 0, 0, 1};
+		packet.insert(packet.end(), startCode, startCode + 4);
+		packet.insert(packet.end(), nal.begin(), nal.end());
+	}
+
+	return packet;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static const uint8_t *ReferenceStartCode(const uint8_t *p, const uint8_t *end)
+{
+	for (; end - p >= 3; p++) {
+		if (!p[0] && !p[1] && p[2] == 1)
+			return p;
+	}
+
+	return end;
+}
+
+static void TestStartCodePositions()
+{
+	uint8_t data[80];
+
+	/* a start code at every position relative to the 16 byte blocks,
+	 * with every buffer length that could contain it */
+	for (size_t pos = 0; pos + 3 <= sizeof(data); pos++) {
+		memset(data, 0xFF, sizeof(data));
+		data[pos] = 0;
+		data[pos + 1] = 0;
+		data[pos + 2] = 1;
+
+		for (size_t size = 0; size <= sizeof(data); size++) {
+			const uint8_t *expected = pos + 3 <= size ? data + pos
+								  : data + size;
+			CHECK(FindStartCode(data, data + size) == expected);
+		}
+	}
+}
+
+static void TestStartCodeStraddle()
+{
+	uint8_t data[64];
+
+	/* the zero pair and the 01 split over two 16 byte blocks, both
+	 * ways, and a zero pair at the end of a block with no 01 after it */
+	for (size_t pos = 12; pos < 18; pos++) {
+		memset(data, 0xFF, sizeof(data));
+		data[pos] = 0;
+		data[pos + 1] = 0;
+		data[pos + 2] = 1;
+		CHECK(FindStartCode(data, data + sizeof(data)) == data + pos);
+	}
+
+	memset(data, 0xFF, sizeof(data));
+	data[14] = 0;
+	data[15] = 0;
+	data[16] = 0;
+	data[17] = 2;
+	data[40] = 0;
+	data[41] = 0;
+	data[42] = 1;
+	CHECK(FindStartCode(data, data + sizeof(data)) == data + 40);
+
+	/* a four byte start code gives the position of its last three */
+	memset(data, 0xFF, sizeof(data));
+	data[14] = 0;
+	data[15] = 0;
+	data[16] = 0;
+	data[17] = 1;
+	CHECK(FindStartCode(data, data + sizeof(data)) == data + 15);
+
+	/* runs of zeros */
+	memset(data, 0, sizeof(data));
+	data[50] = 1;
+	CHECK(FindStartCode(data, data + sizeof(data)) == data + 48);
+	CHECK(FindStartCode(data, data + 50) == data + 50);
+}
+
+static void TestStartCodeRandom()
+{
+	uint32_t state = 1;
+	std::vector<uint8_t> data(4096);
+
+	/* mostly zeros and ones, so there are lots of near misses */
+	for (uint8_t &byte : data) {
+		state = state * 1664525 + 1013904223;
+		unsigned r = state >> 24;
+		byte = r < 150 ? 0 : (r < 200 ? 1 : (uint8_t)r);
+	}
+
+	for (size_t start = 0; start < 48; start++) {
+		const uint8_t *p = data.data() + start;
+		const uint8_t *end = data.data() + data.size() - start % 7;
+
+		while (p != end) {
+			const uint8_t *expected = ReferenceStartCode(p, end);
+			const uint8_t *found = FindStartCode(p, end);
+			CHECK(found == expected);
+			if (found != expected || found == end)
+				break;
+			p = found + 1;
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct H264Params {
+	int profile = 66;
+	int level = 40;
+	int widthMbs = 120;
+	int heightMapUnits = 68;
+	bool frameMbsOnly = true;
+	unsigned chroma = 1;
+	bool scalingLists = false;
+	unsigned pocType = 0;
+	unsigned crop[4] = {}; /* left, right, top, bottom */
+	bool vui = false;
+	bool aspectRatio = false;
+	bool signalType = false;
+	unsigned numUnitsInTick = 0;
+	unsigned timeScale = 0;
+};
+
+static std::vector<uint8_t> H264SPS(const H264Params &p)
+{
+	BitWriter bw;
+
+	bw.Bits(p.profile, 8);
+	bw.Bits(0, 8);
+	bw.Bits(p.level, 8);
+	bw.UE(0);
+
+	if (p.profile >= 100) {
+		bw.UE(p.chroma);
+		if (p.chroma == 3)
+			bw.Bit(0);
+		bw.UE(2); /* 10-bit */
+		bw.UE(2);
+		bw.Bit(0);
+		bw.Bit(p.scalingLists);
+
+		if (p.scalingLists) {
+			int lists = p.chroma != 3 ? 8 : 12;
+			for (int i = 0; i < lists; i++) {
+				bool present = i != 2;
+				bw.Bit(present);
+				if (!present)
+					continue;
+
+				/* some deltas, and one list that ends with
+				 * next == 0 (use the default matrix) */
+				int count = i < 6 ? 16 : 64;
+				for (int j = 0; j < count; j++) {
+					if (i == 1) {
+						bw.SE(-8);
+						break;
+					}
+					bw.SE(j % 5 - 2);
+				}
+			}
+		}
+	}
+
+	bw.UE(4);
+	bw.UE(p.pocType);
+	if (p.pocType == 0) {
+		bw.UE(4);
+	} else if (p.pocType == 1) {
+		bw.Bit(0);
+		bw.SE(-3);
+		bw.SE(2);
+		bw.UE(3);
+		bw.SE(1);
+		bw.SE(-1);
+		bw.SE(5);
+	}
+
+	bw.UE(4);
+	bw.Bit(0);
+	bw.UE(p.widthMbs - 1);
+	bw.UE(p.heightMapUnits - 1);
+	bw.Bit(p.frameMbsOnly);
+	if (!p.frameMbsOnly)
+		bw.Bit(1);
+	bw.Bit(1);
+
+	bool crop = p.crop[0] || p.crop[1] || p.crop[2] || p.crop[3];
+	bw.Bit(crop);
+	if (crop) {
+		for (unsigned val : p.crop)
+			bw.UE(val);
+	}
+
+	bw.Bit(p.vui);
+	if (p.vui) {
+		bw.Bit(p.aspectRatio);
+		if (p.aspectRatio) {
+			bw.Bits(255, 8);
+			bw.Bits(4, 16);
+			bw.Bits(3, 16);
+		}
+		bw.Bit(1);
+		bw.Bit(0);
+		bw.Bit(p.signalType);
+		if (p.signalType) {
+			bw.Bits(5, 3);
+			bw.Bit(1);
+			bw.Bit(1);
+			bw.Bits(0x010101, 24);
+		}
+		bw.Bit(1);
+		bw.UE(0);
+		bw.UE(0);
+
+		bool timing = p.numUnitsInTick && p.timeScale;
+		bw.Bit(timing);
+		if (timing) {
+			bw.Bits(p.numUnitsInTick, 32);
+			bw.Bits(p.timeScale, 32);
+			bw.Bit(1);
+		}
+		bw.Bits(0, 5); /* hrd, pic_struct, bitstream_restriction */
+	}
+
+	return bw.Nal({0x67});
+}
+
+static void TestH264Baseline()
+{
+	H264Params p;
+	p.widthMbs = 80;
+	p.heightMapUnits = 45;
+
+	BitstreamInfo info;
+	std::vector<uint8_t> sps = H264SPS(p);
+	CHECK(ParseH264SPS(sps.data(), sps.size(), info));
+	CHECK(info.profile == 66);
+	CHECK(info.level == 40);
+	CHECK(info.width == 1280);
+	CHECK(info.height == 720);
+	CHECK(info.frameInterval == 0);
+}
+
+static void TestH264Cropping()
+{
+	H264Params p;
+	p.crop[3] = 4; /* 1088 -> 1080 in 4:2:0 */
+
+	BitstreamInfo info;
+	std::vector<uint8_t> sps = H264SPS(p);
+	CHECK(ParseH264SPS(sps.data(), sps.size(), info));
+	CHECK(info.width == 1920);
+	CHECK(info.height == 1080);
+
+	/* odd crop on every side */
+	p.widthMbs = 45;
+	p.heightMapUnits = 36;
+	p.crop[0] = 1;
+	p.crop[1] = 2;
+	p.crop[2] = 3;
+	p.crop[3] = 1;
+	sps = H264SPS(p);
+	CHECK(ParseH264SPS(sps.data(), sps.size(), info));
+	CHECK(info.width == 720 - 2 * 3);
+	CHECK(info.height == 576 - 2 * 4);
+
+	/* interlaced: map units are field macroblock pairs and the
+	 * vertical crop unit doubles */
+	p = H264Params();
+	p.frameMbsOnly = false;
+	p.heightMapUnits = 34;
+	p.crop[3] = 2;
+	sps = H264SPS(p);
+	CHECK(ParseH264SPS(sps.data(), sps.size(), info));
+	CHECK(info.width == 1920);
+	CHECK(info.height == 1080);
+
+	/* 4:4:4 crops in single pixels */
+	p = H264Params();
+	p.profile = 244;
+	p.chroma = 3;
+	p.crop[1] = 3;
+	p.crop[3] = 8;
+	sps = H264SPS(p);
+	CHECK(ParseH264SPS(sps.data(), sps.size(), info));
+	CHECK(info.width == 1917);
+	CHECK(info.height == 1080);
+}
+
+static void TestH264HighProfile()
+{
+	H264Params p;
+	p.profile = 100;
+	p.level = 51;
+	p.scalingLists = true;
+	p.pocType = 1;
+	p.crop[3] = 4;
+	p.vui = true;
+	p.aspectRatio = true;
+	p.signalType = true;
+	p.numUnitsInTick = 1001;
+	p.timeScale = 60000;
+
+	BitstreamInfo info;
+	std::vector<uint8_t> sps = H264SPS(p);
+	CHECK(ParseH264SPS(sps.data(), sps.size(), info));
+	CHECK(info.profile == 100);
+	CHECK(info.level == 51);
+	CHECK(info.width == 1920);
+	CHECK(info.height == 1080);
+
+	/* two ticks per frame: 2 * 1001 / 60000 seconds */
+	CHECK(info.frameInterval == 333666);
+
+	/* 4:4:4 has 12 scaling lists */
+	p.profile = 244;
+	p.chroma = 3;
+	p.crop[3] = 8;
+	p.numUnitsInTick = 1;
+	p.timeScale = 120;
+	sps = H264SPS(p);
+	CHECK(ParseH264SPS(sps.data(), sps.size(), info));
+	CHECK(info.height == 1080);
+	CHECK(info.frameInterval == 166666);
+}
+
+static void TestH264Truncated()
+{
+	H264Params p;
+	p.crop[3] = 4;
+
+	BitstreamInfo info;
+	std::vector<uint8_t> sps = H264SPS(p);
+	CHECK(!ParseH264SPS(sps.data(), 6, info));
+	CHECK(!ParseH264SPS(sps.data(), 1, info));
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct HEVCParams {
+	int profile = 1;
+	int level = 120;
+	unsigned subLayers = 0; /* sps_max_sub_layers_minus1 */
+	unsigned chroma = 1;
+	unsigned width = 1920;
+	unsigned height = 1080;
+	unsigned conf[4] = {}; /* left, right, top, bottom */
+	bool orderingInfo = true;
+	bool scalingLists = false;
+	bool pcm = false;
+	bool interRefSet = false;
+	bool longTermRefs = false;
+	bool vui = false;
+	unsigned numUnitsInTick = 0;
+	unsigned timeScale = 0;
+};
+
+static void HEVCProfileTierLevel(BitWriter &bw, const HEVCParams &p)
+{
+	bw.Bits(0, 2);
+	bw.Bit(0);
+	bw.Bits(p.profile, 5);
+	bw.Bits(0x60000000, 32); /* compatibility flags */
+	bw.Bits(0xB, 4);
+	bw.Bits(0, 32);
+	bw.Bits(0, 11);
+	bw.Bit(0);
+	bw.Bits(p.level, 8);
+
+	/* alternate which sub-layers carry profile and level info */
+	for (unsigned i = 0; i < p.subLayers; i++) {
+		bw.Bit(i % 2 == 0);
+		bw.Bit(1);
+	}
+	if (p.subLayers) {
+		for (unsigned i = p.subLayers; i < 8; i++)
+			bw.Bits(0, 2);
+	}
+	for (unsigned i = 0; i < p.subLayers; i++) {
+		if (i % 2 == 0) {
+			bw.Bits(0x41, 8);
+			bw.Bits(0x60000000, 32);
+			bw.Bits(0, 32);
+			bw.Bits(0, 16);
+		}
+		bw.Bits(90, 8);
+	}
+}
+
+static void HEVCScalingLists(BitWriter &bw)
+{
+	for (int sizeId = 0; sizeId < 4; sizeId++) {
+		for (int m = 0; m < 6; m += sizeId == 3 ? 3 : 1) {
+			bool explicitList = (sizeId + m) % 2 == 0;
+			bw.Bit(explicitList);
+			if (!explicitList) {
+				bw.UE(m ? 1 : 0);
+				continue;
+			}
+
+			if (sizeId > 1)
+				bw.SE(8);
+			for (int i = 0; i < (sizeId ? 64 : 16); i++)
+				bw.SE(i % 3 - 1);
+		}
+	}
+}
+
+static std::vector<uint8_t> HEVCSPS(const HEVCParams &p)
+{
+	BitWriter bw;
+
+	bw.Bits(0, 4);
+	bw.Bits(p.subLayers, 3);
+	bw.Bit(1);
+	HEVCProfileTierLevel(bw, p);
+
+	bw.UE(0);
+	bw.UE(p.chroma);
+	if (p.chroma == 3)
+		bw.Bit(0);
+	bw.UE(p.width);
+	bw.UE(p.height);
+
+	bool conf = p.conf[0] || p.conf[1] || p.conf[2] || p.conf[3];
+	bw.Bit(conf);
+	if (conf) {
+		for (unsigned val : p.conf)
+			bw.UE(val);
+	}
+
+	bw.UE(2);
+	bw.UE(2);
+	bw.UE(4); /* log2_max_pic_order_cnt_lsb_minus4 */
+
+	bw.Bit(p.orderingInfo);
+	for (unsigned i = p.orderingInfo ? 0 : p.subLayers; i <= p.subLayers;
+	     i++) {
+		bw.UE(4 + i);
+		bw.UE(2);
+		bw.UE(0);
+	}
+
+	bw.UE(0);
+	bw.UE(3);
+	bw.UE(0);
+	bw.UE(3);
+	bw.UE(1);
+	bw.UE(1);
+
+	bw.Bit(p.scalingLists);
+	if (p.scalingLists) {
+		bw.Bit(1);
+		HEVCScalingLists(bw);
+	}
+
+	bw.Bit(1);
+	bw.Bit(1);
+	bw.Bit(p.pcm);
+	if (p.pcm) {
+		bw.Bits(7, 4);
+		bw.Bits(7, 4);
+		bw.UE(0);
+		bw.UE(1);
+		bw.Bit(1);
+	}
+
+	/* two explicit sets, and a third predicted from the second */
+	bw.UE(p.interRefSet ? 3 : 2);
+
+	bw.UE(2);
+	bw.UE(0);
+	bw.UE(0);
+	bw.Bit(1);
+	bw.UE(1);
+	bw.Bit(1);
+
+	bw.Bit(0);
+	bw.UE(1);
+	bw.UE(1);
+	bw.UE(0);
+	bw.Bit(1);
+	bw.UE(3);
+	bw.Bit(0);
+
+	if (p.interRefSet) {
+		bw.Bit(1);
+		bw.Bit(0);
+		bw.UE(0);
+
+		/* second set has 2 delta POCs, so 3 entries */
+		bw.Bit(1);
+		bw.Bit(0);
+		bw.Bit(1);
+		bw.Bit(0);
+		bw.Bit(0);
+	}
+
+	bw.Bit(p.longTermRefs);
+	if (p.longTermRefs) {
+		bw.UE(2);
+		bw.Bits(5, 8);
+		bw.Bit(1);
+		bw.Bits(200, 8);
+		bw.Bit(0);
+	}
+
+	bw.Bit(1);
+	bw.Bit(1);
+
+	bw.Bit(p.vui);
+	if (p.vui) {
+		bw.Bit(1);
+		bw.Bits(255, 8);
+		bw.Bits(1, 16);
+		bw.Bits(1, 16);
+		bw.Bit(0);
+		bw.Bit(1);
+		bw.Bits(5, 3);
+		bw.Bit(0);
+		bw.Bit(1);
+		bw.Bits(0x090909, 24);
+		bw.Bit(1);
+		bw.UE(2);
+		bw.UE(2);
+		bw.Bit(0);
+		bw.Bit(0);
+		bw.Bit(0);
+		bw.Bit(1);
+		bw.UE(0);
+		bw.UE(0);
+		bw.UE(0);
+		bw.UE(0);
+
+		bool timing = p.numUnitsInTick && p.timeScale;
+		bw.Bit(timing);
+		if (timing) {
+			bw.Bits(p.numUnitsInTick, 32);
+			bw.Bits(p.timeScale, 32);
+			bw.Bit(0);
+			bw.Bit(0);
+		}
+		bw.Bit(0);
+	}
+
+	bw.Bit(0);
+	return bw.Nal({0x42, 0x01});
+}
+
+static void TestHEVCBasic()
+{
+	HEVCParams p;
+
+	BitstreamInfo info;
+	std::vector<uint8_t> sps = HEVCSPS(p);
+	CHECK(ParseHEVCSPS(sps.data(), sps.size(), info));
+	CHECK(info.profile == 1);
+	CHECK(info.level == 120);
+	CHECK(info.width == 1920);
+	CHECK(info.height == 1080);
+	CHECK(info.frameInterval == 0);
+}
+
+static void TestHEVCConformanceWindow()
+{
+	HEVCParams p;
+	p.height = 1088;
+	p.conf[3] = 4; /* in chroma units, so 8 luma rows */
+
+	BitstreamInfo info;
+	std::vector<uint8_t> sps = HEVCSPS(p);
+	CHECK(ParseHEVCSPS(sps.data(), sps.size(), info));
+	CHECK(info.width == 1920);
+	CHECK(info.height == 1080);
+
+	/* 4:2:2 only halves horizontally */
+	p.chroma = 2;
+	p.width = 1928;
+	p.conf[0] = 1;
+	p.conf[1] = 3;
+	p.conf[2] = 4;
+	p.conf[3] = 4;
+	sps = HEVCSPS(p);
+	CHECK(ParseHEVCSPS(sps.data(), sps.size(), info));
+	CHECK(info.width == 1920);
+	CHECK(info.height == 1080);
+
+	/* 4:4:4 in single pixels */
+	p.chroma = 3;
+	p.width = 1924;
+	p.conf[0] = 2;
+	p.conf[1] = 2;
+	p.conf[2] = 0;
+	p.conf[3] = 8;
+	sps = HEVCSPS(p);
+	CHECK(ParseHEVCSPS(sps.data(), sps.size(), info));
+	CHECK(info.width == 1920);
+	CHECK(info.height == 1080);
+}
+
+static void TestHEVCSubLayers()
+{
+	for (unsigned layers = 0; layers < 7; layers++) {
+		HEVCParams p;
+		p.subLayers = layers;
+		p.orderingInfo = layers % 2 == 0;
+		p.width = 3840;
+		p.height = 2160;
+		p.level = 153;
+		p.vui = true;
+		p.numUnitsInTick = 1;
+		p.timeScale = 50;
+
+		BitstreamInfo info;
+		std::vector<uint8_t> sps = HEVCSPS(p);
+		CHECK(ParseHEVCSPS(sps.data(), sps.size(), info));
+		CHECK(info.level == 153);
+		CHECK(info.width == 3840);
+		CHECK(info.height == 2160);
+		CHECK(info.frameInterval == 200000);
+	}
+}
+
+static void TestHEVCTiming()
+{
+	HEVCParams p;
+	p.profile = 2;
+	p.height = 1088;
+	p.conf[3] = 4;
+	p.subLayers = 2;
+	p.scalingLists = true;
+	p.pcm = true;
+	p.interRefSet = true;
+	p.longTermRefs = true;
+	p.vui = true;
+	p.numUnitsInTick = 1001;
+	p.timeScale = 30000;
+
+	/* everything between the conformance window and the VUI has to be
+	 * skipped correctly for the timing to come out right */
+	BitstreamInfo info;
+	std::vector<uint8_t> sps = HEVCSPS(p);
+	CHECK(ParseHEVCSPS(sps.data(), sps.size(), info));
+	CHECK(info.profile == 2);
+	CHECK(info.height == 1080);
+	CHECK(info.frameInterval == 333666);
+
+	/* without timing info, or without a VUI at all */
+	p.numUnitsInTick = 0;
+	sps = HEVCSPS(p);
+	info = BitstreamInfo();
+	CHECK(ParseHEVCSPS(sps.data(), sps.size(), info));
+	CHECK(info.frameInterval == 0);
+
+	p.vui = false;
+	sps = HEVCSPS(p);
+	info = BitstreamInfo();
+	CHECK(ParseHEVCSPS(sps.data(), sps.size(), info));
+	CHECK(info.frameInterval == 0);
+
+	/* cut short inside the VUI: the size is still good */
+	p.vui = true;
+	p.numUnitsInTick = 1001;
+	sps = HEVCSPS(p);
+	info = BitstreamInfo();
+	CHECK(ParseHEVCSPS(sps.data(), sps.size() - 6, info));
+	CHECK(info.height == 1080);
+	CHECK(info.frameInterval == 0);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void TestParseBitstream()
+{
+	H264Params p;
+	p.profile = 100;
+	p.crop[3] = 4;
+	p.vui = true;
+	p.numUnitsInTick = 1001;
+	p.timeScale = 60000;
+
+	std::vector<uint8_t> packet = AnnexB({H264SPS(p),
+					      {0x68, 0xEE, 0x3C, 0x80},
+					      {0x65, 0x88, 0x84, 0x00}});
+
+	BitstreamInfo info;
+	CHECK(ParseBitstream(VideoFormat::H264, packet.data(), packet.size(),
+			     info));
+	CHECK(info.keyframe);
+	CHECK(info.nalTypes == ((1ULL << 7) | (1ULL << 8) | (1ULL << 5)));
+	CHECK(info.width == 1920);
+	CHECK(info.height == 1080);
+	CHECK(info.frameInterval == 333666);
+
+	HEVCParams hp;
+	hp.vui = true;
+	hp.numUnitsInTick = 1;
+	hp.timeScale = 60;
+	packet = AnnexB({{0x40, 0x01, 0x0C}, HEVCSPS(hp), {0x44, 0x01, 0xC1},
+			 {0x26, 0x01, 0xAF}});
+
+	CHECK(ParseBitstream(VideoFormat::HEVC, packet.data(), packet.size(),
+			     info));
+	CHECK(info.keyframe);
+	CHECK(info.nalTypes ==
+	      ((1ULL << 32) | (1ULL << 33) | (1ULL << 34) | (1ULL << 19)));
+	CHECK(info.width == 1920);
+	CHECK(info.frameInterval == 166666);
+
+	/* non-IDR slice only */
+	packet = AnnexB({{0x41, 0x9A, 0x00}});
+	CHECK(ParseBitstream(VideoFormat::H264, packet.data(), packet.size(),
+			     info));
+	CHECK(!info.keyframe);
+	CHECK(info.width == 0);
+
+	uint8_t junk[] = {1, 2, 3, 4, 5};
+	CHECK(!ParseBitstream(VideoFormat::H264, junk, sizeof(junk), info));
+	CHECK(!ParseBitstream(VideoFormat::MJPEG, packet.data(), packet.size(),
+			      info));
+}
+
+int main()
+{
+	TestStartCodePositions();
+	TestStartCodeStraddle();
+	TestStartCodeRandom();
+	TestH264Baseline();
+	TestH264Cropping();
+	TestH264HighProfile();
+	TestH264Truncated();
+	TestHEVCBasic();
+	TestHEVCConformanceWindow();
+	TestHEVCSubLayers();
+	TestHEVCTiming();
+	TestParseBitstream();
+
+	return TestResult("test-bitstream");
+}
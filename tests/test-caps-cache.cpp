@@ -0,0 +1,181 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "test.hpp"
+#include "caps-cache.hpp"
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+using namespace DShow;
+
+#define PATH L"\\\\?\\usb#vid_046d&pid_085c#1"
+#define FINGERPRINT 0x1234567890ABCDEFULL
+
+static KnownConfigEntry MakeConfig()
+{
+	KnownConfigEntry config;
+	config.fingerprint = FINGERPRINT;
+	config.cx = 1920;
+	config.cy_abs = 1080;
+	config.cy_flip = true;
+	config.frameInterval = 166667;
+	config.internalFormat = VideoFormat::MJPEG;
+	config.format = VideoFormat::NV12;
+	config.useDefaultConfig = false;
+	return config;
+}
+
+static bool SameConfig(const KnownConfigEntry &a, const KnownConfigEntry &b)
+{
+	return a.fingerprint == b.fingerprint && a.cx == b.cx &&
+	       a.cy_abs == b.cy_abs && a.cy_flip == b.cy_flip &&
+	       a.frameInterval == b.frameInterval &&
+	       a.internalFormat == b.internalFormat && a.format == b.format &&
+	       a.useDefaultConfig == b.useDefaultConfig;
+}
+
+static void TestConfigs()
+{
+	CapsCache cache;
+	KnownConfigEntry config = MakeConfig();
+
+	CHECK(!cache.FindConfig(PATH, L"1080p60", FINGERPRINT));
+
+	CHECK(cache.SetConfig(PATH, L"1080p60", config));
+	CHECK(!cache.SetConfig(PATH, L"1080p60", config));
+
+	const KnownConfigEntry *found =
+		cache.FindConfig(PATH, L"1080p60", FINGERPRINT);
+	CHECK(found && SameConfig(*found, config));
+
+	/* keyed by mode as well as path, and by the driver fingerprint */
+	CHECK(!cache.FindConfig(PATH, L"720p30", FINGERPRINT));
+	CHECK(!cache.FindConfig(L"other", L"1080p60", FINGERPRINT));
+	CHECK(!cache.FindConfig(PATH, L"1080p60", FINGERPRINT + 1));
+
+	/* a changed config replaces the old one */
+	config.useDefaultConfig = true;
+	CHECK(cache.SetConfig(PATH, L"1080p60", config));
+	found = cache.FindConfig(PATH, L"1080p60", FINGERPRINT);
+	CHECK(found && found->useDefaultConfig);
+
+	CHECK(cache.RemoveConfig(PATH, L"1080p60"));
+	CHECK(!cache.RemoveConfig(PATH, L"1080p60"));
+	CHECK(!cache.FindConfig(PATH, L"1080p60", FINGERPRINT));
+}
+
+static void TestRoundTrip()
+{
+	CapsCache cache;
+	std::vector<uint8_t> data;
+
+	CapsCacheEntry video;
+	VideoInfo caps = {};
+	video.fingerprint = FINGERPRINT;
+	video.audioAttached = true;
+	caps.minCX = caps.maxCX = 1280;
+	caps.minCY = caps.maxCY = 720;
+	caps.granularityCX = caps.granularityCY = 1;
+	caps.minInterval = 166667;
+	caps.maxInterval = 333333;
+	caps.format = VideoFormat::YUY2;
+	video.videoCaps.push_back(caps);
+	cache.SetVideo(PATH, video);
+
+	KnownConfigEntry config = MakeConfig();
+	KnownConfigEntry other = MakeConfig();
+	other.cy_flip = false;
+	other.useDefaultConfig = true;
+	other.format = VideoFormat::Any;
+
+	cache.SetConfig(PATH, L"1080p60", config);
+	cache.SetConfig(PATH, L"default", other);
+	/* odd-length path and an empty mode, to exercise the padding */
+	cache.SetConfig(L"abc", L"", config);
+
+	cache.Save(data);
+	CHECK(data.size() % 4 == 0);
+
+	CapsCache loaded;
+	CHECK(loaded.Load(data.data(), data.size()));
+
+	const KnownConfigEntry *found =
+		loaded.FindConfig(PATH, L"1080p60", FINGERPRINT);
+	CHECK(found && SameConfig(*found, config));
+	found = loaded.FindConfig(PATH, L"default", FINGERPRINT);
+	CHECK(found && SameConfig(*found, other));
+	found = loaded.FindConfig(L"abc", L"", FINGERPRINT);
+	CHECK(found && SameConfig(*found, config));
+
+	const CapsCacheEntry *entry = loaded.FindVideo(PATH, FINGERPRINT);
+	CHECK(entry && entry->audioAttached && entry->videoCaps.size() == 1);
+	CHECK(entry && entry->videoCaps[0].format == VideoFormat::YUY2);
+
+	/* configs and caps with the same path don't collide */
+	CHECK(!loaded.FindAudio(PATH, FINGERPRINT));
+
+	std::vector<uint8_t> resaved;
+	loaded.Save(resaved);
+	CHECK(resaved == data);
+}
+
+static void TestRejected()
+{
+	CapsCache cache;
+	std::vector<uint8_t> data;
+
+	cache.SetConfig(PATH, L"1080p60", MakeConfig());
+	cache.Save(data);
+
+	/* version 1 files (before configs) are discarded and rebuilt */
+	std::vector<uint8_t> old = data;
+	uint32_t version = 1;
+	memcpy(&old[4], &version, 4);
+
+	CapsCache loaded;
+	CHECK(!loaded.Load(old.data(), old.size()));
+	CHECK(!loaded.FindConfig(PATH, L"1080p60", FINGERPRINT));
+
+	/* a config entry must hold exactly one record; the record count
+	 * follows size, kind, fingerprint, flags and path length */
+	std::vector<uint8_t> bad = data;
+	uint32_t records = 2;
+	memcpy(&bad[16 + 24], &records, 4);
+	CHECK(!loaded.Load(bad.data(), bad.size()));
+
+	/* truncated anywhere */
+	for (size_t size = 0; size < data.size(); size++)
+		CHECK(!loaded.Load(data.data(), size));
+
+	/* and a failed load leaves nothing behind */
+	CHECK(loaded.Load(data.data(), data.size()));
+	CHECK(!loaded.Load(data.data(), data.size() - 1));
+	CHECK(!loaded.FindConfig(PATH, L"1080p60", FINGERPRINT));
+}
+
+int main()
+{
+	TestConfigs();
+	TestRoundTrip();
+	TestRejected();
+
+	return TestResult("test-caps-cache");
+}
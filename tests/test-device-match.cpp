@@ -0,0 +1,304 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "test.hpp"
+#include "device-match.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace DShow;
+
+/* laid out like REGPINMEDIUM, as mediums are compared bytewise */
+struct FakeMedium {
+	unsigned char clsMedium[16];
+	unsigned long dw1;
+	unsigned long dw2;
+};
+
+static FakeMedium Medium(unsigned long id)
+{
+	FakeMedium medium = {};
+	medium.clsMedium[0] = 0x42;
+	medium.dw1 = id;
+	return medium;
+}
+
+/* stands in for MonikerIndex::Entry and the filter its moniker binds */
+struct FakeEntry {
+	std::wstring name;
+	std::wstring path;
+	bool hasPath = false;
+
+	bool mediumsRead = false;
+	std::vector<FakeMedium> mediums;
+
+	std::vector<FakeMedium> pins;
+	bool bindFails = false;
+	int binds = 0;
+	int reads = 0;
+};
+
+static FakeEntry Entry(const wchar_t *name, const wchar_t *path = nullptr)
+{
+	FakeEntry entry;
+	entry.name = name;
+	entry.hasPath = !!path;
+	if (path)
+		entry.path = path;
+	return entry;
+}
+
+static FakeEntry *Match(std::vector<FakeEntry> &entries, const wchar_t *name,
+			const wchar_t *path, bool &exact,
+			bool skipDecklink = false)
+{
+	return MatchDeviceEntry(entries, name, path, skipDecklink, exact);
+}
+
+static void TestLastNameWins()
+{
+	std::vector<FakeEntry> entries = {Entry(L"Cam", L"\\\\?\\usb#1"),
+					  Entry(L"Cam", L"\\\\?\\usb#2"),
+					  Entry(L"Other", L"\\\\?\\usb#3"),
+					  Entry(L"Cam")};
+	bool exact;
+
+	/* without a path (or with one nothing has) the last with the name */
+	CHECK(Match(entries, L"Cam", nullptr, exact) == &entries[3]);
+	CHECK(!exact);
+	CHECK(Match(entries, L"Cam", L"\\\\?\\usb#9", exact) == &entries[3]);
+	CHECK(!exact);
+
+	/* the path picks an earlier one, and stops there */
+	CHECK(Match(entries, L"Cam", L"\\\\?\\usb#1", exact) == &entries[0]);
+	CHECK(exact);
+	CHECK(Match(entries, L"Cam", L"\\\\?\\usb#2", exact) == &entries[1]);
+	CHECK(exact);
+
+	/* but only together with the name */
+	CHECK(Match(entries, L"Cam", L"\\\\?\\usb#3", exact) == &entries[3]);
+	CHECK(!exact);
+
+	/* no name matches any device */
+	CHECK(Match(entries, nullptr, nullptr, exact) == &entries[3]);
+	CHECK(Match(entries, L"", L"\\\\?\\usb#3", exact) == &entries[2]);
+	CHECK(exact);
+
+	CHECK(Match(entries, L"Missing", nullptr, exact) == nullptr);
+	CHECK(!exact);
+}
+
+static void TestDecklinkSkip()
+{
+	std::vector<FakeEntry> video = {Entry(L"USB Camera")};
+	std::vector<FakeEntry> audio = {Entry(L"Microphone"),
+					Entry(L"Decklink Audio Capture")};
+	bool exact;
+
+	CHECK(!HasDecklinkEntry(video));
+	video.push_back(Entry(L"Decklink Video Capture"));
+	CHECK(HasDecklinkEntry(video));
+
+	/* decklink audio without its video is skipped, even by name */
+	CHECK(Match(audio, nullptr, nullptr, exact, true) == &audio[0]);
+	CHECK(Match(audio, L"Decklink Audio Capture", nullptr, exact, true) ==
+	      nullptr);
+
+	CHECK(Match(audio, nullptr, nullptr, exact, false) == &audio[1]);
+}
+
+static void TestException()
+{
+	std::vector<FakeEntry> entries = {Entry(L"Game Capture", L"path#1"),
+					  Entry(L"Game Capture", L"path#2")};
+	FakeEntry *bound = nullptr;
+	int exceptions = 0;
+	bool available = true;
+
+	auto createException = [&]() {
+		exceptions++;
+		return available;
+	};
+	auto bind = [&](FakeEntry &entry) {
+		bound = &entry;
+		return !entry.bindFails;
+	};
+
+	/* anything short of an exact match uses the exception filter */
+	CHECK(SelectDeviceEntry(entries, L"Game Capture", nullptr, false,
+				createException, bind));
+	CHECK(exceptions == 1);
+	CHECK(!bound);
+
+	CHECK(SelectDeviceEntry(entries, L"Game Capture", L"path#9", false,
+				createException, bind));
+	CHECK(exceptions == 2);
+	CHECK(!bound);
+
+	CHECK(SelectDeviceEntry(entries, L"Missing", nullptr, false,
+				createException, bind));
+	CHECK(exceptions == 3);
+
+	/* an exact match binds the moniker without trying it */
+	CHECK(SelectDeviceEntry(entries, L"Game Capture", L"path#1", false,
+				createException, bind));
+	CHECK(exceptions == 3);
+	CHECK(bound == &entries[0]);
+
+	/* without the exception filter, the name match is bound */
+	available = false;
+	bound = nullptr;
+	CHECK(SelectDeviceEntry(entries, L"Game Capture", nullptr, false,
+				createException, bind));
+	CHECK(bound == &entries[1]);
+
+	CHECK(!SelectDeviceEntry(entries, L"Missing", nullptr, false,
+				 createException, bind));
+
+	entries[1].bindFails = true;
+	CHECK(!SelectDeviceEntry(entries, L"Game Capture", nullptr, false,
+				 createException, bind));
+}
+
+static bool FindMedium(std::vector<FakeEntry> &entries,
+		       const FakeMedium &medium, FakeEntry *&found)
+{
+	found = nullptr;
+
+	return FindMediumEntry<FakeEntry *>(
+		entries, medium,
+		[](FakeEntry &entry, FakeEntry *&filter) {
+			entry.binds++;
+			if (entry.bindFails)
+				return false;
+			filter = &entry;
+			return true;
+		},
+		[](FakeEntry *filter, std::vector<FakeMedium> &mediums) {
+			filter->reads++;
+			mediums = filter->pins;
+		},
+		[&found](FakeEntry *filter) { found = filter; });
+}
+
+static void TestMediumCache()
+{
+	std::vector<FakeEntry> entries(4);
+	FakeEntry *found;
+
+	entries[0].pins = {Medium(1)};
+	entries[1].bindFails = true;
+	entries[2].pins = {Medium(2), Medium(3)};
+	entries[3].pins = {Medium(4)};
+
+	/* the first search binds everything up to the match */
+	CHECK(FindMedium(entries, Medium(3), found));
+	CHECK(found == &entries[2]);
+	CHECK(entries[0].binds == 1 && entries[0].reads == 1);
+	CHECK(entries[1].binds == 1 && entries[1].reads == 0);
+	CHECK(entries[2].binds == 1 && entries[2].reads == 1);
+	CHECK(entries[3].binds == 0);
+
+	/* a failed bind counts as read, so it isn't bound again */
+	CHECK(entries[1].mediumsRead);
+	CHECK(entries[1].mediums.empty());
+
+	/* after that only the entry with the medium is bound */
+	CHECK(FindMedium(entries, Medium(2), found));
+	CHECK(found == &entries[2]);
+	CHECK(entries[0].binds == 1);
+	CHECK(entries[1].binds == 1);
+	CHECK(entries[2].binds == 2 && entries[2].reads == 1);
+
+	CHECK(FindMedium(entries, Medium(4), found));
+	CHECK(found == &entries[3]);
+	CHECK(entries[3].binds == 1 && entries[3].reads == 1);
+
+	/* nothing has it: every entry has been read, nothing is bound */
+	CHECK(!FindMedium(entries, Medium(5), found));
+	CHECK(!found);
+	CHECK(entries[0].binds == 1);
+	CHECK(entries[1].binds == 1);
+	CHECK(entries[2].binds == 2);
+	CHECK(entries[3].binds == 1);
+}
+
+static void TestAudioEntry()
+{
+	const std::wstring videoPath = L"\\\\?\\usb#vid";
+	std::vector<FakeEntry> entries = {
+		Entry(L"Capture Video", videoPath.c_str()),
+		Entry(L"Other Mic", L"\\\\?\\usb#other"),
+		Entry(L"Capture Audio", L"\\\\?\\usb#aud1"),
+		Entry(L"Capture Audio 2", L"\\\\?\\usb#aud2"),
+		Entry(L"Capture Audio 3")};
+	FakeEntry *bound = nullptr;
+	bool matchNames = false;
+
+	/* everything but the other mic is the same device, including the
+	 * video device's own entry */
+	auto sameDevice = [&](FakeEntry &entry) {
+		return &entry != &entries[1];
+	};
+	auto nameMatches = [&](FakeEntry &entry) {
+		return !matchNames || entry.name == L"Capture Audio 3";
+	};
+	auto bind = [&](FakeEntry &entry) {
+		entry.binds++;
+		if (entry.bindFails)
+			return false;
+		bound = &entry;
+		return true;
+	};
+
+	/* the first of the device's other entries */
+	CHECK(FindAudioEntry(entries, videoPath, sameDevice, nameMatches,
+			     bind));
+	CHECK(bound == &entries[2]);
+	CHECK(entries[0].binds == 0);
+	CHECK(entries[1].binds == 0);
+
+	/* one that doesn't bind is passed over */
+	entries[2].bindFails = true;
+	CHECK(FindAudioEntry(entries, videoPath, sameDevice, nameMatches,
+			     bind));
+	CHECK(bound == &entries[3]);
+
+	/* names are only checked when asked to */
+	matchNames = true;
+	CHECK(FindAudioEntry(entries, videoPath, sameDevice, nameMatches,
+			     bind));
+	CHECK(bound == &entries[4]);
+
+	entries[4].bindFails = true;
+	CHECK(!FindAudioEntry(entries, videoPath, sameDevice, nameMatches,
+			      bind));
+}
+
+int main()
+{
+	TestLastNameWins();
+	TestDecklinkSkip();
+	TestException();
+	TestMediumCache();
+	TestAudioEntry();
+
+	return TestResult("test-device-match");
+}
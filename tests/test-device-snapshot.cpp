@@ -0,0 +1,388 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "test.hpp"
+#include "device-snapshot.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+using namespace DShow;
+
+/* stands in for the system's device notifications */
+class SimulatedNotifier : public DeviceNotifier {
+public:
+	std::function<void()> changed;
+	bool available = true;
+	int starts = 0;
+
+	bool Start(std::function<void()> changed_) override
+	{
+		starts++;
+		if (available)
+			changed = changed_;
+		return available;
+	}
+
+	/* a device arriving or being removed */
+	void Fire()
+	{
+		if (changed)
+			changed();
+	}
+};
+
+/* a device enumeration that counts how often it runs */
+struct FakeEnum {
+	std::vector<std::wstring> present;
+	int calls = 0;
+	bool fail = false;
+	std::function<void()> during;
+
+	bool operator()(std::vector<std::wstring> &list)
+	{
+		calls++;
+		if (during)
+			during();
+		if (fail)
+			return false;
+
+		list = present;
+		return true;
+	}
+};
+
+static bool Get(CachedDeviceList<std::wstring> &cache,
+		DeviceGeneration &generation, FakeEnum &enumDevices,
+		std::vector<std::wstring> &devices, long long maxAge = 0)
+{
+	return cache.Get(devices, maxAge, generation,
+			 [&enumDevices](std::vector<std::wstring> &list) {
+				 return enumDevices(list);
+			 });
+}
+
+static void TestSnapshot()
+{
+	DeviceSnapshot snapshot;
+
+	CHECK(!snapshot.Valid(0, 0, 0));
+
+	snapshot.Filled(3, 1000);
+	CHECK(snapshot.Valid(3, 1000, 0));
+	CHECK(snapshot.Valid(3, 100000000, 0));
+	CHECK(!snapshot.Valid(4, 1000, 0));
+
+	/* maximum age */
+	CHECK(snapshot.Valid(3, 1999, 1000));
+	CHECK(!snapshot.Valid(3, 2000, 1000));
+
+	snapshot.Clear();
+	CHECK(!snapshot.Valid(3, 1000, 0));
+}
+
+static void TestArrivalAndRemoval()
+{
+	SimulatedNotifier *notifier = new SimulatedNotifier;
+	DeviceGeneration generation(notifier);
+	CachedDeviceList<std::wstring> cache;
+	std::vector<std::wstring> devices;
+	FakeEnum enumDevices;
+
+	enumDevices.present = {L"Camera A"};
+
+	/* the notifier is only started when the cache is first used */
+	CHECK(notifier->starts == 0);
+
+	CHECK(Get(cache, generation, enumDevices, devices));
+	CHECK(notifier->starts == 1);
+	CHECK(enumDevices.calls == 1);
+	CHECK(devices.size() == 1);
+
+	/* nothing changed, served from the cache */
+	CHECK(Get(cache, generation, enumDevices, devices));
+	CHECK(Get(cache, generation, enumDevices, devices));
+	CHECK(enumDevices.calls == 1);
+	CHECK(notifier->starts == 1);
+
+	/* arrival: the next lookup enumerates and sees the new device */
+	enumDevices.present.push_back(L"Camera B");
+	notifier->Fire();
+	CHECK(Get(cache, generation, enumDevices, devices));
+	CHECK(enumDevices.calls == 2);
+	CHECK(devices.size() == 2 && devices[1] == L"Camera B");
+
+	CHECK(Get(cache, generation, enumDevices, devices));
+	CHECK(enumDevices.calls == 2);
+
+	/* removal, with a burst of notifications: one enumeration */
+	enumDevices.present.erase(enumDevices.present.begin());
+	notifier->Fire();
+	notifier->Fire();
+	notifier->Fire();
+	CHECK(Get(cache, generation, enumDevices, devices));
+	CHECK(enumDevices.calls == 3);
+	CHECK(devices.size() == 1 && devices[0] == L"Camera B");
+
+	CHECK(Get(cache, generation, enumDevices, devices));
+	CHECK(enumDevices.calls == 3);
+}
+
+static void TestSharedGeneration()
+{
+	/* video and audio lists share a generation, one notification
+	 * invalidates both */
+	SimulatedNotifier *notifier = new SimulatedNotifier;
+	DeviceGeneration generation(notifier);
+	CachedDeviceList<std::wstring> video;
+	CachedDeviceList<std::wstring> audio;
+	std::vector<std::wstring> devices;
+	FakeEnum enumVideo;
+	FakeEnum enumAudio;
+
+	CHECK(Get(video, generation, enumVideo, devices));
+	CHECK(Get(audio, generation, enumAudio, devices));
+	CHECK(notifier->starts == 1);
+
+	notifier->Fire();
+	CHECK(Get(video, generation, enumVideo, devices));
+	CHECK(Get(audio, generation, enumAudio, devices));
+	CHECK(enumVideo.calls == 2);
+	CHECK(enumAudio.calls == 2);
+
+	/* and Invalidate does the same, as InvalidateDeviceCache */
+	generation.Invalidate();
+	CHECK(Get(video, generation, enumVideo, devices));
+	CHECK(Get(audio, generation, enumAudio, devices));
+	CHECK(enumVideo.calls == 3);
+	CHECK(enumAudio.calls == 3);
+}
+
+static void TestChangeDuringEnumeration()
+{
+	SimulatedNotifier *notifier = new SimulatedNotifier;
+	DeviceGeneration generation(notifier);
+	CachedDeviceList<std::wstring> cache;
+	std::vector<std::wstring> devices;
+	FakeEnum enumDevices;
+
+	CHECK(Get(cache, generation, enumDevices, devices));
+
+	/* a device arrives while the list is being read, after the driver
+	 * was asked: the result may already be stale, so isn't trusted */
+	notifier->Fire();
+	enumDevices.during = [notifier]() { notifier->Fire(); };
+	CHECK(Get(cache, generation, enumDevices, devices));
+	CHECK(enumDevices.calls == 2);
+
+	enumDevices.during = nullptr;
+	CHECK(Get(cache, generation, enumDevices, devices));
+	CHECK(enumDevices.calls == 3);
+	CHECK(Get(cache, generation, enumDevices, devices));
+	CHECK(enumDevices.calls == 3);
+}
+
+static void TestFailure()
+{
+	DeviceGeneration generation(new SimulatedNotifier);
+	CachedDeviceList<std::wstring> cache;
+	std::vector<std::wstring> devices;
+	FakeEnum enumDevices;
+
+	enumDevices.fail = true;
+	CHECK(!Get(cache, generation, enumDevices, devices));
+	CHECK(!Get(cache, generation, enumDevices, devices));
+	CHECK(enumDevices.calls == 2);
+
+	/* a failed enumeration is never cached */
+	enumDevices.fail = false;
+	CHECK(Get(cache, generation, enumDevices, devices));
+	CHECK(Get(cache, generation, enumDevices, devices));
+	CHECK(enumDevices.calls == 3);
+}
+
+static void TestWithoutNotifications()
+{
+	/* without notifications only the maximum age expires the list */
+	SimulatedNotifier *notifier = new SimulatedNotifier;
+	DeviceGeneration generation(notifier);
+	CachedDeviceList<std::wstring> cache;
+	std::vector<std::wstring> devices;
+	FakeEnum enumDevices;
+
+	notifier->available = false;
+
+	/* 10ms */
+	long long maxAge = 100000;
+
+	CHECK(Get(cache, generation, enumDevices, devices, maxAge));
+	CHECK(Get(cache, generation, enumDevices, devices, maxAge));
+	CHECK(enumDevices.calls == 1);
+	CHECK(notifier->starts == 1);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	CHECK(Get(cache, generation, enumDevices, devices, maxAge));
+	CHECK(enumDevices.calls == 2);
+
+	/* and without a notifier at all */
+	DeviceGeneration noNotifier(nullptr);
+	CachedDeviceList<std::wstring> other;
+	CHECK(Get(other, noNotifier, enumDevices, devices));
+	CHECK(Get(other, noNotifier, enumDevices, devices));
+	CHECK(enumDevices.calls == 3);
+}
+
+static void TestConcurrentCallers()
+{
+	/* callers that find the list stale wait for one enumeration rather
+	 * than each running their own */
+	DeviceGeneration generation(new SimulatedNotifier);
+	CachedDeviceList<std::wstring> cache;
+	FakeEnum enumDevices;
+	std::vector<std::thread> threads;
+
+	enumDevices.present = {L"Camera A"};
+	enumDevices.during = []() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	};
+
+	for (int i = 0; i < 8; i++) {
+		threads.emplace_back([&]() {
+			std::vector<std::wstring> devices;
+			Get(cache, generation, enumDevices, devices);
+		});
+	}
+	for (std::thread &thread : threads)
+		thread.join();
+
+	CHECK(enumDevices.calls == 1);
+}
+
+/* a device entry whose copies take a while and record how many overlap */
+struct SlowCopy {
+	static std::atomic<int> copying;
+	static std::atomic<int> maxCopying;
+
+	SlowCopy() {}
+	SlowCopy(const SlowCopy &) { Copy(); }
+	SlowCopy &operator=(const SlowCopy &)
+	{
+		Copy();
+		return *this;
+	}
+
+	static void Copy()
+	{
+		int now = ++copying;
+		int max = maxCopying;
+		while (now > max && !maxCopying.compare_exchange_weak(max, now))
+			;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		copying--;
+	}
+};
+
+std::atomic<int> SlowCopy::copying{0};
+std::atomic<int> SlowCopy::maxCopying{0};
+
+static void TestSharedReads()
+{
+	/* callers of a fresh list copy it out at the same time */
+	DeviceGeneration generation(new SimulatedNotifier);
+	CachedDeviceList<SlowCopy> cache;
+	std::vector<std::thread> threads;
+	int enumerations = 0;
+
+	auto enumDevices = [&enumerations](std::vector<SlowCopy> &list) {
+		enumerations++;
+		list.resize(1);
+		return true;
+	};
+
+	std::vector<SlowCopy> devices;
+	CHECK(cache.Get(devices, 0, generation, enumDevices));
+	SlowCopy::maxCopying = 0;
+
+	for (int i = 0; i < 4; i++) {
+		threads.emplace_back([&]() {
+			std::vector<SlowCopy> copy;
+			cache.Get(copy, 0, generation, enumDevices);
+		});
+	}
+	for (std::thread &thread : threads)
+		thread.join();
+
+	CHECK(enumerations == 1);
+	CHECK(SlowCopy::maxCopying > 1);
+}
+
+static void TestSharedMutex()
+{
+	/* a writer waits for readers, and readers for the writer */
+	SharedMutex mutex;
+	std::atomic<bool> written{false};
+
+	mutex.lock_shared();
+	mutex.lock_shared();
+
+	std::thread writer([&]() {
+		std::lock_guard<SharedMutex> lock(mutex);
+		written = true;
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	CHECK(!written);
+	mutex.unlock_shared();
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	CHECK(!written);
+	mutex.unlock_shared();
+	writer.join();
+	CHECK(written);
+
+	mutex.lock();
+	std::atomic<bool> read{false};
+	std::thread reader([&]() {
+		SharedLockGuard lock(mutex);
+		read = true;
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	CHECK(!read);
+	mutex.unlock();
+	reader.join();
+	CHECK(read);
+}
+
+int main()
+{
+	TestSnapshot();
+	TestArrivalAndRemoval();
+	TestSharedGeneration();
+	TestChangeDuringEnumeration();
+	TestFailure();
+	TestWithoutNotifications();
+	TestConcurrentCallers();
+	TestSharedReads();
+	TestSharedMutex();
+
+	return TestResult("test-device-snapshot");
+}
@@ -0,0 +1,161 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "test.hpp"
+#include "dshow-clock.hpp"
+
+using namespace DShow;
+
+#define FRAME_INTERVAL 333333LL
+#define HOST_OFFSET 50000000000LL
+
+/* 100ppm fast device clock with a little delivery jitter */
+static long long HostTimeOf(long long deviceTime, int i)
+{
+	return HOST_OFFSET + deviceTime + deviceTime / 10000 +
+	       (i % 3) * 20000 - 20000;
+}
+
+static void TestDrift()
+{
+	ClockMapper clock;
+	ClockStats stats;
+	long long deviceTime = 0;
+
+	for (int i = 0; i < 600; i++) {
+		clock.Update(deviceTime, HostTimeOf(deviceTime, i));
+		deviceTime += FRAME_INTERVAL;
+	}
+
+	clock.GetStats(stats);
+	CHECK(stats.samples == 600);
+	CHECK_NEAR(stats.driftPPM, 100.0, 5.0);
+	CHECK(stats.jitter < 30000);
+
+	/* maps onto the middle of the jitter and back again */
+	long long mapped = clock.Map(deviceTime);
+	CHECK_NEAR(mapped, HOST_OFFSET + deviceTime + deviceTime / 10000,
+		   20000);
+	CHECK_NEAR(clock.Unmap(mapped), deviceTime, 2);
+}
+
+static void TestReorderedTimestamps()
+{
+	ClockMapper clock;
+	ClockStats stats;
+
+	/* IPBB: presentation order 0 3 1 2, delivered in decode order */
+	static const int order[] = {0, 3, 1, 2};
+	int updates = 0;
+
+	for (int gop = 0; gop < 50; gop++) {
+		for (int j = 0; j < 4; j++) {
+			int frame = gop * 4 + order[j];
+			long long pts = frame * FRAME_INTERVAL;
+			long long host = HOST_OFFSET +
+					 (gop * 4 + j) * FRAME_INTERVAL;
+			clock.Update(pts, host);
+			updates++;
+		}
+	}
+
+	/* the B-frames went back in time but are not a discontinuity, so
+	 * they're skipped instead of starting the mapping over */
+	clock.GetStats(stats);
+	CHECK(stats.samples == updates / 2);
+	CHECK_NEAR(stats.driftPPM, 0.0, 1000.0);
+}
+
+static void TestDiscontinuity()
+{
+	ClockMapper clock;
+	ClockStats stats;
+	long long deviceTime = 100 * FRAME_INTERVAL;
+	long long host = HOST_OFFSET;
+
+	for (int i = 0; i < 100; i++) {
+		clock.Update(deviceTime, host);
+		deviceTime += FRAME_INTERVAL;
+		host += FRAME_INTERVAL;
+	}
+
+	/* device restarted its clock: far off the mapping, so resync */
+	clock.Update(0, host);
+	clock.GetStats(stats);
+	CHECK(stats.samples == 1);
+	CHECK(clock.Map(0) == host);
+
+	/* and a forward jump of more than a second does the same */
+	clock.Update(FRAME_INTERVAL, host + FRAME_INTERVAL);
+	clock.Update(100000000LL, host + 2 * FRAME_INTERVAL);
+	clock.GetStats(stats);
+	CHECK(stats.samples == 1);
+}
+
+static void TestUnmapped()
+{
+	ClockMapper clock;
+
+	CHECK(clock.Map(12345) == 0);
+	CHECK(clock.Unmap(12345) == 0);
+	CHECK(clock.Slope() == 1.0);
+}
+
+static void TestSynthesizer()
+{
+	TimestampSynthesizer synth;
+	long long start, stop;
+
+	synth.Reset();
+
+	/* called much faster than the frame rate, so every frame resyncs to
+	 * the host clock rather than following the frame grid */
+	for (int i = 0; i < 10; i++) {
+		synth.Next(FRAME_INTERVAL, start, stop);
+
+		CHECK(start >= 0);
+		CHECK(start < 10000000LL);
+		CHECK(stop - start == FRAME_INTERVAL);
+	}
+
+	/* no frame interval still gives a valid (1 unit) duration */
+	synth.Next(0, start, stop);
+	CHECK(stop - start == 1);
+}
+
+static void TestHostTime()
+{
+	long long a = GetHostTime();
+	long long b = GetHostTime();
+
+	CHECK(a > 0);
+	CHECK(b >= a);
+}
+
+int main()
+{
+	TestDrift();
+	TestReorderedTimestamps();
+	TestDiscontinuity();
+	TestUnmapped();
+	TestSynthesizer();
+	TestHostTime();
+
+	return TestResult("test-dshow-clock");
+}
@@ -0,0 +1,220 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "test.hpp"
+#include "stand-in-encoder.hpp"
+#include "video-convert.hpp"
+
+#include <wchar.h>
+
+using namespace DShow;
+
+static void CheckSent(VideoFormat format, int cx, int cy, bool bottomUp)
+{
+	StandInEncoder encoder(cx, cy);
+	std::vector<uint8_t> data;
+	EncoderFeedFrame frame = MakeFeedFrame(format, cx, cy, data);
+
+	frame.bottomUp = bottomUp;
+	frame.startTime = 333333;
+	frame.stopTime = 666666;
+
+	CHECK(FeedEncoder(encoder, frame) == EncoderFeedResult::Sent);
+	CHECK(encoder.submitted == 1);
+	CHECK(encoder.discarded == 0);
+	CHECK(encoder.dropped == 0);
+	CHECK(!encoder.locked);
+	CHECK(encoder.lastStartTime == 333333);
+	CHECK(encoder.lastStopTime == 666666);
+
+	/* the sample holds exactly what a direct conversion gives */
+	StandInEncoder ref(cx, cy);
+	const uint8_t *planes[DSHOW_MAX_PLANES];
+	uint8_t *dst[3];
+
+	for (size_t i = 0; i < DSHOW_MAX_PLANES; i++)
+		planes[i] = data.data() + frame.offsets[i];
+	for (size_t i = 0; i < 3; i++)
+		dst[i] = ref.sample.data() + ref.offsets[i];
+
+	CHECK(ConvertToYV12(format, planes, frame.linesize, cx, cy, dst,
+			    ref.linesize, bottomUp));
+	CHECK(encoder.sample == ref.sample);
+}
+
+static void TestSent()
+{
+	CheckSent(VideoFormat::I420, 640, 360, false);
+	CheckSent(VideoFormat::YV12, 320, 240, false);
+	CheckSent(VideoFormat::NV12, 1280, 720, false);
+	CheckSent(VideoFormat::XRGB, 642, 362, true);
+	CheckSent(VideoFormat::ARGB, 321, 241, false);
+	CheckSent(VideoFormat::YUY2, 1920, 1080, false);
+	CheckSent(VideoFormat::UYVY, 720, 481, false);
+}
+
+static void CheckDropped(StandInEncoder &encoder, const EncoderFeedFrame &frame,
+			 EncoderFeedResult expected)
+{
+	long long dropped = encoder.dropped;
+	long long submitted = encoder.submitted;
+
+	CHECK(FeedEncoder(encoder, frame) == expected);
+	CHECK(encoder.dropped == dropped + 1);
+	CHECK(encoder.submitted == submitted);
+
+	/* a dropped frame never leaves the sample locked */
+	CHECK(!encoder.locked);
+}
+
+static void TestUnsupported()
+{
+	StandInEncoder encoder(640, 480);
+	std::vector<uint8_t> data;
+
+	/* e.g. a device that picked MJPEG for VideoFormat::Any */
+	EncoderFeedFrame frame =
+		MakeFeedFrame(VideoFormat::MJPEG, 640, 480, data);
+	CheckDropped(encoder, frame, EncoderFeedResult::UnsupportedFormat);
+
+	StandInEncoder oddEncoder(639, 480);
+	frame = MakeFeedFrame(VideoFormat::YUY2, 639, 480, data);
+	CheckDropped(oddEncoder, frame, EncoderFeedResult::UnsupportedFormat);
+
+	/* rejected before the encoder is touched */
+	CHECK(encoder.locks == 0);
+	CHECK(oddEncoder.locks == 0);
+}
+
+static void TestShortFrame()
+{
+	StandInEncoder encoder(640, 480);
+	std::vector<uint8_t> data;
+	EncoderFeedFrame frame =
+		MakeFeedFrame(VideoFormat::NV12, 640, 480, data);
+
+	frame.size = frame.frameSize - 1;
+	CheckDropped(encoder, frame, EncoderFeedResult::ShortFrame);
+
+	frame.size = 0;
+	CheckDropped(encoder, frame, EncoderFeedResult::ShortFrame);
+
+	/* a layout VFormatPlaneLayout didn't know */
+	frame = MakeFeedFrame(VideoFormat::NV12, 640, 480, data);
+	frame.frameSize = 0;
+	CheckDropped(encoder, frame, EncoderFeedResult::ShortFrame);
+
+	CHECK(encoder.locks == 0);
+
+	/* larger than needed is fine, drivers pad their buffers */
+	frame = MakeFeedFrame(VideoFormat::NV12, 640, 480, data);
+	frame.size += 4096;
+	CHECK(FeedEncoder(encoder, frame) == EncoderFeedResult::Sent);
+}
+
+static void TestNoInputBuffer()
+{
+	StandInEncoder encoder(640, 480);
+	std::vector<uint8_t> data;
+	EncoderFeedFrame frame =
+		MakeFeedFrame(VideoFormat::I420, 640, 480, data);
+
+	encoder.failLock = true;
+	CheckDropped(encoder, frame, EncoderFeedResult::NoInputBuffer);
+	CHECK(encoder.discarded == 0);
+}
+
+static void TestSizeMismatch()
+{
+	StandInEncoder encoder(1280, 720);
+	std::vector<uint8_t> data;
+	EncoderFeedFrame frame =
+		MakeFeedFrame(VideoFormat::YUY2, 1920, 1080, data);
+
+	CheckDropped(encoder, frame, EncoderFeedResult::SizeMismatch);
+	CHECK(encoder.discarded == 1);
+
+	frame = MakeFeedFrame(VideoFormat::YUY2, 1280, 722, data);
+	CheckDropped(encoder, frame, EncoderFeedResult::SizeMismatch);
+	CHECK(encoder.discarded == 2);
+}
+
+static void TestSubmitFailed()
+{
+	StandInEncoder encoder(640, 480);
+	std::vector<uint8_t> data;
+	EncoderFeedFrame frame =
+		MakeFeedFrame(VideoFormat::XRGB, 640, 480, data);
+
+	encoder.failSubmit = true;
+	CheckDropped(encoder, frame, EncoderFeedResult::SubmitFailed);
+	CHECK(encoder.discarded == 1);
+}
+
+static void TestRecovery()
+{
+	/* drops of every kind in a row, then frames go through again */
+	StandInEncoder encoder(640, 480);
+	std::vector<uint8_t> data;
+	EncoderFeedFrame good =
+		MakeFeedFrame(VideoFormat::NV12, 640, 480, data);
+	EncoderFeedFrame bad = good;
+
+	bad.size = 100;
+	CheckDropped(encoder, bad, EncoderFeedResult::ShortFrame);
+
+	encoder.failLock = true;
+	CheckDropped(encoder, good, EncoderFeedResult::NoInputBuffer);
+	encoder.failLock = false;
+
+	encoder.failSubmit = true;
+	CheckDropped(encoder, good, EncoderFeedResult::SubmitFailed);
+	encoder.failSubmit = false;
+
+	for (int i = 0; i < 3; i++)
+		CHECK(FeedEncoder(encoder, good) == EncoderFeedResult::Sent);
+
+	CHECK(encoder.dropped == 3);
+	CHECK(encoder.submitted == 3);
+	CHECK(!encoder.locked);
+}
+
+static void TestResultNames()
+{
+	CHECK(wcscmp(EncoderFeedResultName(EncoderFeedResult::Sent),
+		     L"sent") == 0);
+	CHECK(wcslen(EncoderFeedResultName(
+		      EncoderFeedResult::UnsupportedFormat)) > 0);
+	CHECK(wcslen(EncoderFeedResultName(EncoderFeedResult::SubmitFailed)) >
+	      0);
+}
+
+int main()
+{
+	TestSent();
+	TestUnsupported();
+	TestShortFrame();
+	TestNoInputBuffer();
+	TestSizeMismatch();
+	TestSubmitFailed();
+	TestRecovery();
+	TestResultNames();
+
+	return TestResult("test-encoder-feed");
+}
@@ -0,0 +1,299 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "test.hpp"
+#include "encoder-packets.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+#include <vector>
+
+using namespace DShow;
+
+/* every allocation in the program goes through here, so a section of code
+ * can be checked for allocating */
+static std::atomic<long long> allocations{0};
+
+void *operator new(size_t size)
+{
+	allocations++;
+	void *ptr = malloc(size ? size : 1);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	operator delete(ptr);
+}
+
+/* packet payloads carry their index, so they can be told apart */
+static void PushIndexed(EncoderPacketQueue &queue, std::vector<uint8_t> &buf,
+			int index, size_t size, long long timestamp)
+{
+	memset(buf.data(), 0, size);
+	memcpy(buf.data(), &index, sizeof(index));
+	queue.Push(buf.data(), size, true, timestamp);
+}
+
+static int PacketIndex(const EncoderPacket &packet)
+{
+	int index;
+	memcpy(&index, packet.data, sizeof(index));
+	return index;
+}
+
+static void TestSteadyStateAllocations()
+{
+	EncoderPacketQueue queue;
+	std::vector<uint8_t> buf(65536);
+	EncoderPacket packet;
+	EncoderStats stats;
+	long long time = 0;
+
+	/* warm up: largest packet first, then a full queue that overflows,
+	 * so every slot has been handed a buffer */
+	queue.QueueInputTime(time);
+	PushIndexed(queue, buf, 0, 65536, time);
+	CHECK(queue.Pop(packet));
+
+	for (int i = 0; i < ENCODER_MAX_PACKETS + 4; i++) {
+		time += 333333;
+		queue.QueueInputTime(time);
+		PushIndexed(queue, buf, i, 1000 + i * 100, time);
+	}
+	while (queue.Pop(packet))
+		;
+
+	long long before = allocations;
+
+	for (int round = 0; round < 200; round++) {
+		/* varying depth, including queue overflow every few rounds */
+		int depth = (round % 5 == 0) ? ENCODER_MAX_PACKETS + 3
+					     : 1 + round % 7;
+
+		for (int i = 0; i < depth; i++) {
+			time += 333333;
+			queue.QueueInputTime(time);
+			size_t size = 200 + (round * 37 + i) % 60000;
+			PushIndexed(queue, buf, i, size, time);
+		}
+		while (queue.Pop(packet))
+			;
+		queue.GetStats(stats);
+	}
+
+	CHECK(allocations == before);
+	CHECK(stats.bufferSize == 65536);
+	CHECK(stats.queued == 0);
+}
+
+static void TestOverflow()
+{
+	EncoderPacketQueue queue;
+	std::vector<uint8_t> buf(256);
+	EncoderPacket packet;
+	EncoderStats stats;
+	const int total = ENCODER_MAX_PACKETS + 8;
+
+	for (int i = 0; i < total; i++) {
+		queue.QueueInputTime(i * 1000LL);
+		PushIndexed(queue, buf, i, 256, i * 1000LL);
+	}
+
+	queue.GetStats(stats);
+	CHECK(stats.packets == total);
+	CHECK(stats.dropped == 8);
+	CHECK(stats.queued == ENCODER_MAX_PACKETS);
+	CHECK(stats.maxQueued == ENCODER_MAX_PACKETS);
+
+	/* the oldest were dropped, and took their input times with them, so
+	 * the rest still match exactly */
+	for (int i = 8; i < total; i++) {
+		CHECK(queue.Pop(packet));
+		CHECK(PacketIndex(packet) == i);
+		CHECK(packet.pts == i * 1000LL);
+		CHECK(packet.size == 256);
+	}
+	CHECK(!queue.Pop(packet));
+
+	queue.GetStats(stats);
+	CHECK(stats.unmatched == 0);
+	CHECK(stats.queued == 0);
+	CHECK(stats.pooledBuffers == ENCODER_MAX_PACKETS - 1);
+}
+
+static void TestMatchByTimestamp()
+{
+	EncoderPacketQueue queue;
+	std::vector<uint8_t> buf(64);
+	EncoderPacket packet;
+	EncoderStats stats;
+
+	/* reordered output (I P B) keeps each packet's own input time */
+	queue.QueueInputTime(0);
+	queue.QueueInputTime(1000);
+	queue.QueueInputTime(2000);
+	PushIndexed(queue, buf, 0, 64, 0);
+	PushIndexed(queue, buf, 1, 64, 2000);
+	PushIndexed(queue, buf, 2, 64, 1000);
+
+	CHECK(queue.Pop(packet) && packet.pts == 0);
+	CHECK(queue.Pop(packet) && packet.pts == 2000);
+	CHECK(queue.Pop(packet) && packet.pts == 1000);
+
+	queue.GetStats(stats);
+	CHECK(stats.unmatched == 0);
+
+	/* no time, or a time nothing was sent with: oldest input time */
+	queue.QueueInputTime(3000);
+	queue.QueueInputTime(4000);
+	queue.QueueInputTime(5000);
+	queue.Push(buf.data(), 64, false, 0);
+	PushIndexed(queue, buf, 4, 64, 9999);
+
+	CHECK(queue.Pop(packet) && packet.pts == 3000);
+	CHECK(queue.Pop(packet) && packet.pts == 4000);
+
+	/* the unmatched ones didn't eat the last input time */
+	PushIndexed(queue, buf, 5, 64, 5000);
+	CHECK(queue.Pop(packet) && packet.pts == 5000);
+
+	queue.GetStats(stats);
+	CHECK(stats.unmatched == 2);
+
+	/* nothing left to match against keeps the packet's own time */
+	PushIndexed(queue, buf, 6, 64, 7777);
+	CHECK(queue.Pop(packet) && packet.pts == 7777);
+}
+
+static void TestInputTimeLimit()
+{
+	EncoderPacketQueue queue;
+	std::vector<uint8_t> buf(64);
+	EncoderPacket packet;
+
+	/* an encoder that swallowed frames: only the newest are kept */
+	for (int i = 0; i < 100; i++)
+		queue.QueueInputTime(i);
+
+	queue.Push(buf.data(), 64, false, 0);
+	CHECK(queue.Pop(packet));
+	CHECK(packet.pts == 100 - ENCODER_MAX_INPUT_TIMES);
+
+	queue.Push(buf.data(), 64, true, 99);
+	CHECK(queue.Pop(packet) && packet.pts == 99);
+	queue.Push(buf.data(), 64, true, 10);
+	CHECK(queue.Pop(packet) && packet.pts == 101 - ENCODER_MAX_INPUT_TIMES);
+}
+
+/* what packetCallback gets from MakePacket */
+static void TestCallbackPacket()
+{
+	EncoderPacketQueue queue;
+	EncoderPacket packet;
+	EncoderStats stats;
+
+	unsigned char h264Idr[] = {0, 0, 0, 1, 0x65, 0x88, 0x84, 0x00};
+	unsigned char hevcIdr[] = {0, 0, 0, 1, 0x26, 0x01, 0xAF, 0x00};
+
+	queue.QueueInputTime(1000);
+	queue.QueueInputTime(2000);
+	queue.QueueInputTime(3000);
+
+	/* the sample memory itself, matched by input time, dts unset */
+	queue.MakePacket(h264Idr, sizeof(h264Idr), true, 2000, packet);
+	CHECK(packet.data == h264Idr);
+	CHECK(packet.size == sizeof(h264Idr));
+	CHECK(packet.pts == 2000);
+	CHECK(!packet.hasDts);
+	CHECK(packet.dts == 0);
+	CHECK(packet.keyframe);
+
+	/* keyframes come from the configured format's NAL types; an HEVC
+	 * IDR read as H.264 would be an SEI */
+	queue.MakePacket(hevcIdr, sizeof(hevcIdr), true, 1000, packet);
+	CHECK(packet.pts == 1000);
+	CHECK(!packet.keyframe);
+
+	queue.SetFormat(VideoFormat::HEVC);
+	queue.MakePacket(hevcIdr, sizeof(hevcIdr), false, 0, packet);
+	CHECK(packet.pts == 3000);
+	CHECK(packet.keyframe);
+
+	queue.MakePacket(h264Idr, sizeof(h264Idr), false, 12345, packet);
+	CHECK(packet.pts == 0);
+	CHECK(!packet.keyframe);
+
+	/* counted, but never queued */
+	queue.CountDroppedInput();
+
+	queue.GetStats(stats);
+	CHECK(stats.packets == 4);
+	CHECK(stats.unmatched == 2);
+	CHECK(stats.inputDropped == 1);
+	CHECK(stats.queued == 0);
+	CHECK(!queue.Pop(packet));
+}
+
+static void TestPoppedPacket()
+{
+	EncoderPacketQueue queue;
+	EncoderPacket packet;
+
+	unsigned char hevcIdr[] = {0, 0, 0, 1, 0x26, 0x01, 0xAF, 0x00};
+
+	queue.SetFormat(VideoFormat::HEVC);
+	queue.QueueInputTime(5000);
+	queue.Push(hevcIdr, sizeof(hevcIdr), true, 5000);
+
+	/* a copy, with pts in dts as Encode always gave */
+	CHECK(queue.Pop(packet));
+	CHECK(packet.data != hevcIdr);
+	CHECK(memcmp(packet.data, hevcIdr, sizeof(hevcIdr)) == 0);
+	CHECK(packet.pts == 5000);
+	CHECK(packet.dts == 5000);
+	CHECK(!packet.hasDts);
+	CHECK(packet.keyframe);
+}
+
+int main()
+{
+	TestSteadyStateAllocations();
+	TestOverflow();
+	TestMatchByTimestamp();
+	TestInputTimeLimit();
+	TestCallbackPacket();
+	TestPoppedPacket();
+
+	return TestResult("test-encoder-packets");
+}
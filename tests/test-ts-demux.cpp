@@ -0,0 +1,361 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "test.hpp"
+#include "ts-mux.hpp"
+#include "ts-demux.hpp"
+
+#include <vector>
+
+using namespace DShow;
+
+#define VIDEO_PID 0x1011
+#define AUDIO_PID 0x1100
+#define VIDEO_STREAM 0xE0
+#define AUDIO_STREAM 0xC0
+
+#define UNITS 24
+#define FRAME_TICKS 3003 /* 29.97fps at 90khz */
+#define WRAP (1LL << 33)
+
+/* starts 5 frames before the 33-bit timestamps wrap */
+#define FIRST_PTS (WRAP - 5 * FRAME_TICKS)
+
+struct Received {
+	int pid;
+	std::vector<uint8_t> payload;
+	long long pts;
+	long long dts;
+	bool hasPts;
+	bool hasDts;
+	bool randomAccess;
+};
+
+/* sizes cover single packets, exact packet multiples and long units */
+static size_t VideoSize(int i)
+{
+	static const size_t sizes[] = {100, 2000, 170, 184 * 3 - 14, 7000, 1};
+	return sizes[i % 6];
+}
+
+static std::vector<uint8_t> Payload(int i, size_t size)
+{
+	std::vector<uint8_t> payload(size);
+	for (size_t j = 0; j < size; j++)
+		payload[j] = (uint8_t)(i * 7 + j);
+	return payload;
+}
+
+/*
+ * Video: unbounded PES with PTS and DTS, keyframe every 8 units.
+ * Audio: bounded PES with PTS only, 10 ticks after its video frame.
+ * Every 5th audio unit has no PTS and belongs to the previous one.
+ */
+static TSMuxer Multiplex()
+{
+	TSMuxer mux;
+
+	for (int i = 0; i < UNITS; i++) {
+		long long pts = FIRST_PTS + (long long)i * FRAME_TICKS;
+
+		mux.Write({VIDEO_PID, VIDEO_STREAM, Payload(i, VideoSize(i)),
+			   pts + FRAME_TICKS, pts, false, i % 8 == 0});
+		mux.Write({AUDIO_PID, AUDIO_STREAM, Payload(i + 100, 300 + i),
+			   i % 5 == 4 ? TS_MUX_NO_TIMESTAMP : pts + 10,
+			   TS_MUX_NO_TIMESTAMP, true, false});
+	}
+
+	return mux;
+}
+
+static TSDemuxer *NewDemuxer(std::vector<Received> &received)
+{
+	TSDemuxer *demuxer = new TSDemuxer;
+	demuxer->AddStream(VIDEO_PID);
+	demuxer->AddStream(AUDIO_PID);
+	demuxer->callback = [&received](const TSPacket &packet) {
+		received.push_back({packet.pid,
+				    std::vector<uint8_t>(packet.data,
+							 packet.data +
+								 packet.size),
+				    packet.pts, packet.dts, packet.hasPts,
+				    packet.hasDts, packet.randomAccess});
+	};
+	return demuxer;
+}
+
+static std::vector<Received> OfPid(const std::vector<Received> &received,
+				   int pid)
+{
+	std::vector<Received> result;
+	for (const Received &packet : received)
+		if (packet.pid == pid)
+			result.push_back(packet);
+	return result;
+}
+
+/* 90khz ticks since the first PTS, unwrapped, in 100ns units */
+static long long Time(long long ticks)
+{
+	return (FIRST_PTS + ticks) * 1000 / 9;
+}
+
+static void CheckFixture(const std::vector<Received> &received)
+{
+	std::vector<Received> video = OfPid(received, VIDEO_PID);
+	std::vector<Received> audio = OfPid(received, AUDIO_PID);
+
+	CHECK(video.size() == UNITS);
+	CHECK(audio.size() == UNITS);
+	if (video.size() != UNITS || audio.size() != UNITS)
+		return;
+
+	for (int i = 0; i < UNITS; i++) {
+		long long ticks = (long long)i * FRAME_TICKS;
+
+		CHECK(video[i].payload == Payload(i, VideoSize(i)));
+		CHECK(video[i].hasPts && video[i].hasDts);
+		CHECK(video[i].pts == Time(ticks + FRAME_TICKS));
+		CHECK(video[i].dts == Time(ticks));
+		CHECK(video[i].randomAccess == (i % 8 == 0));
+
+		CHECK(audio[i].payload == Payload(i + 100, 300 + i));
+		CHECK(audio[i].hasPts == (i % 5 != 4));
+		CHECK(!audio[i].hasDts);
+		CHECK(!audio[i].randomAccess);
+		if (audio[i].hasPts)
+			CHECK(audio[i].pts == Time(ticks + 10));
+	}
+
+	/* video unit 4 is where the raw PTS wraps to 0 while its DTS hasn't
+	 * yet, the unwrapped ones keep counting up past 2^33 */
+	CHECK(video[0].pts == 954435842222LL);
+	CHECK(video[4].pts == 954437176888LL);
+	CHECK(video[4].dts == 954436843222LL);
+	CHECK(video[5].pts == 954437510555LL);
+	CHECK(audio[5].pts == 954437178000LL);
+}
+
+static void TestFixture()
+{
+	TSMuxer mux = Multiplex();
+	std::vector<Received> received;
+	TSDemuxer *demuxer = NewDemuxer(received);
+
+	demuxer->Write(mux.out.data(), mux.out.size());
+	demuxer->Flush();
+	CheckFixture(received);
+
+	const TSDemuxStats &stats = demuxer->GetStats();
+	CHECK(stats.bytes == (long long)mux.out.size());
+	CHECK(stats.packets == (long long)mux.out.size() / TS_PACKET_SIZE);
+	CHECK(stats.pesPackets == UNITS * 2);
+	CHECK(stats.syncLosses == 0);
+	CHECK(stats.continuityErrors == 0);
+
+	delete demuxer;
+}
+
+static void TestSplitWrites()
+{
+	TSMuxer mux = Multiplex();
+	const std::vector<uint8_t> &data = mux.out;
+	size_t splits[] = {1, 4, 187, 188, 189, 376, 1000, data.size() / 2,
+			   data.size() - 188, data.size() - 1};
+
+	/* one split at an arbitrary byte */
+	for (size_t split : splits) {
+		std::vector<Received> received;
+		TSDemuxer *demuxer = NewDemuxer(received);
+
+		demuxer->Write(data.data(), split);
+		demuxer->Write(data.data() + split, data.size() - split);
+		demuxer->Flush();
+		CheckFixture(received);
+		CHECK(demuxer->GetStats().syncLosses == 0);
+
+		delete demuxer;
+	}
+
+	/* and every byte on its own */
+	std::vector<Received> received;
+	TSDemuxer *demuxer = NewDemuxer(received);
+
+	for (size_t i = 0; i < data.size(); i++)
+		demuxer->Write(data.data() + i, 1);
+	demuxer->Flush();
+	CheckFixture(received);
+	CHECK(demuxer->GetStats().syncLosses == 0);
+
+	delete demuxer;
+}
+
+/* the first multi-packet video unit */
+#define GAP_UNIT 1
+
+static void TestContinuityGap()
+{
+	TSMuxer mux = Multiplex();
+	std::vector<uint8_t> data = mux.out;
+
+	/* video unit 1 is the second unit written (video, audio, video) */
+	const std::vector<size_t> &packets = mux.unitPackets[GAP_UNIT * 2];
+	CHECK(packets.size() > 2);
+
+	/* lose the middle TS packet of it */
+	data.erase(data.begin() + packets[1],
+		   data.begin() + packets[1] + TS_PACKET_SIZE);
+
+	std::vector<Received> received;
+	TSDemuxer *demuxer = NewDemuxer(received);
+	demuxer->Write(data.data(), data.size());
+	demuxer->Flush();
+
+	/* the damaged unit is dropped rather than passed on with a hole
+	 * in it, everything around it is intact */
+	std::vector<Received> video = OfPid(received, VIDEO_PID);
+	CHECK(video.size() == UNITS - 1);
+	CHECK(OfPid(received, AUDIO_PID).size() == UNITS);
+	CHECK(demuxer->GetStats().continuityErrors == 1);
+
+	for (size_t i = 0; i < video.size(); i++) {
+		int unit = (int)i < GAP_UNIT ? (int)i : (int)i + 1;
+		CHECK(video[i].payload == Payload(unit, VideoSize(unit)));
+	}
+
+	delete demuxer;
+}
+
+static void TestDuplicatePacket()
+{
+	TSMuxer mux = Multiplex();
+	std::vector<uint8_t> data = mux.out;
+
+	/* repeat a TS packet, which is allowed once and must be skipped */
+	size_t offset = mux.unitPackets[GAP_UNIT * 2][1];
+	std::vector<uint8_t> packet(data.begin() + offset,
+				    data.begin() + offset + TS_PACKET_SIZE);
+	data.insert(data.begin() + offset + TS_PACKET_SIZE, packet.begin(),
+		    packet.end());
+
+	std::vector<Received> received;
+	TSDemuxer *demuxer = NewDemuxer(received);
+	demuxer->Write(data.data(), data.size());
+	demuxer->Flush();
+
+	CheckFixture(received);
+	CHECK(demuxer->GetStats().continuityErrors == 0);
+
+	delete demuxer;
+}
+
+static void TestSyncLoss()
+{
+	TSMuxer mux = Multiplex();
+	std::vector<uint8_t> data = mux.out;
+
+	/* junk between two units, long enough to hide a packet boundary */
+	size_t offset = mux.unitPackets[6][0];
+	std::vector<uint8_t> junk(300, 0x11);
+	junk[100] = 0x47; /* a stray sync byte that isn't a packet */
+	data.insert(data.begin() + offset, junk.begin(), junk.end());
+
+	for (size_t chunk : {data.size(), (size_t)100, (size_t)1}) {
+		std::vector<Received> received;
+		TSDemuxer *demuxer = NewDemuxer(received);
+
+		for (size_t pos = 0; pos < data.size(); pos += chunk) {
+			size_t size = data.size() - pos < chunk
+					      ? data.size() - pos
+					      : chunk;
+			demuxer->Write(data.data() + pos, size);
+		}
+		demuxer->Flush();
+
+		/* the demuxer resyncs on the next real packet and every unit
+		 * still makes it through */
+		CHECK(demuxer->GetStats().syncLosses > 0);
+		CHECK(demuxer->GetStats().continuityErrors == 0);
+		CheckFixture(received);
+
+		delete demuxer;
+	}
+}
+
+static void TestTransportError()
+{
+	TSMuxer mux = Multiplex();
+	std::vector<uint8_t> data = mux.out;
+
+	/* flag the first packet of an audio unit as corrupt */
+	data[mux.unitPackets[3][0] + 1] |= 0x80;
+
+	std::vector<Received> received;
+	TSDemuxer *demuxer = NewDemuxer(received);
+	demuxer->Write(data.data(), data.size());
+	demuxer->Flush();
+
+	CHECK(OfPid(received, VIDEO_PID).size() == UNITS);
+	CHECK(OfPid(received, AUDIO_PID).size() == UNITS - 1);
+
+	delete demuxer;
+}
+
+static void TestStreams()
+{
+	TSDemuxer demuxer;
+	TSMuxer mux = Multiplex();
+	int count = 0;
+
+	/* unregistered PIDs are skipped */
+	demuxer.AddStream(AUDIO_PID);
+	demuxer.callback = [&count](const TSPacket &packet) {
+		CHECK(packet.pid == AUDIO_PID);
+		count++;
+	};
+	demuxer.Write(mux.out.data(), mux.out.size());
+	demuxer.Flush();
+	CHECK(count == UNITS);
+
+	/* adding a PID twice doesn't use up a slot */
+	demuxer.Clear();
+	for (int i = 0; i < TS_MAX_STREAMS; i++) {
+		CHECK(demuxer.AddStream(0x100 + i));
+		CHECK(demuxer.AddStream(0x100 + i));
+	}
+	CHECK(!demuxer.AddStream(0x200));
+
+	/* Reset keeps the streams but forgets the stream state */
+	demuxer.Reset();
+	CHECK(demuxer.AddStream(0x100));
+	CHECK(demuxer.GetStats().packets == 0);
+}
+
+int main()
+{
+	TestFixture();
+	TestSplitWrites();
+	TestContinuityGap();
+	TestDuplicatePacket();
+	TestSyncLoss();
+	TestTransportError();
+	TestStreams();
+
+	return TestResult("test-ts-demux");
+}
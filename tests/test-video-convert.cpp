@@ -0,0 +1,515 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#include "test.hpp"
+#include "video-convert.hpp"
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+using namespace DShow;
+
+/* written into destination padding to catch writes past the row */
+#define GUARD_BYTE 0xA5
+
+static uint32_t randState = 12345;
+
+static uint32_t Rand()
+{
+	randState = randState * 1664525 + 1013904223;
+	return randState;
+}
+
+static void FillRandom(std::vector<uint8_t> &buf)
+{
+	for (size_t i = 0; i < buf.size(); i++)
+		buf[i] = (uint8_t)(Rand() >> 24);
+}
+
+static inline size_t Align64(size_t size)
+{
+	return (size + 63) & ~(size_t)63;
+}
+
+/* counts bytes that differ from the reference rows, or that were written
+ * in the padding after them */
+static size_t ComparePlane(const uint8_t *plane, size_t linesize,
+			   const uint8_t *ref, size_t rowBytes, size_t rows)
+{
+	size_t errors = 0;
+
+	for (size_t y = 0; y < rows; y++) {
+		const uint8_t *row = plane + y * linesize;
+
+		if (memcmp(row, ref + y * rowBytes, rowBytes) != 0)
+			errors++;
+		for (size_t x = rowBytes; x < linesize; x++)
+			if (row[x] != GUARD_BYTE)
+				errors++;
+	}
+
+	return errors;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void CheckCopyPlane(size_t rowBytes, size_t rows, size_t srcLinesize,
+			   size_t dstLinesize)
+{
+	std::vector<uint8_t> src(srcLinesize * rows);
+	std::vector<uint8_t> ref(rowBytes * rows);
+	/* one extra row of guard to catch a copy running past the plane */
+	std::vector<uint8_t> dst(dstLinesize * (rows + 1), GUARD_BYTE);
+
+	FillRandom(src);
+	for (size_t y = 0; y < rows; y++)
+		memcpy(&ref[y * rowBytes], &src[y * srcLinesize], rowBytes);
+
+	CopyPlane(dst.data(), dstLinesize, src.data(), srcLinesize, rowBytes,
+		  rows);
+
+	size_t errors = ComparePlane(dst.data(), dstLinesize, ref.data(),
+				     rowBytes, rows);
+	for (size_t i = dstLinesize * rows; i < dst.size(); i++)
+		if (dst[i] != GUARD_BYTE)
+			errors++;
+
+	if (errors)
+		fprintf(stderr,
+			"CopyPlane %zux%zu (src %zu, dst %zu): %zu errors\n",
+			rowBytes, rows, srcLinesize, dstLinesize, errors);
+	CHECK(errors == 0);
+}
+
+static void TestCopyPlaneContiguous()
+{
+	/* both strides equal the row size, so this is the single copy */
+	CheckCopyPlane(1920, 1080, 1920, 1920);
+	CheckCopyPlane(1, 1, 1, 1);
+	CheckCopyPlane(37, 3, 37, 37);
+}
+
+static void TestCopyPlanePadded()
+{
+	/* 64-byte aligned source strides, as capture drivers tend to use */
+	CheckCopyPlane(1920, 8, 1920, 1920 + 64);
+	CheckCopyPlane(1280, 8, Align64(1280 + 1), 1280);
+	CheckCopyPlane(720, 8, Align64(720), 768);
+	CheckCopyPlane(360, 8, Align64(360), 360);
+	CheckCopyPlane(100, 8, 128, 112);
+
+	/* a destination wider than the source on one side only */
+	CheckCopyPlane(640, 4, 640, 704);
+}
+
+static void TestCopyPlaneOddWidths()
+{
+	/* every width through a few 64-byte blocks, so each combination of
+	 * 64-byte blocks, 16-byte blocks and a byte tail gets copied */
+	for (size_t width = 1; width <= 200; width++) {
+		CheckCopyPlane(width, 3, Align64(width), width + 3);
+		CheckCopyPlane(width, 3, width + 1, Align64(width));
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct Image {
+	std::vector<uint8_t> planes[3];
+	size_t linesize[3] = {};
+	const uint8_t *data[3] = {};
+};
+
+/* tightly packed Y, U and V planes */
+struct Reference {
+	std::vector<uint8_t> y, u, v;
+};
+
+static void AllocPlane(Image &image, int plane, size_t rowBytes, size_t rows,
+		       bool padded)
+{
+	image.linesize[plane] = padded ? Align64(rowBytes + 1) : rowBytes;
+	image.planes[plane].resize(image.linesize[plane] * rows);
+	FillRandom(image.planes[plane]);
+	image.data[plane] = image.planes[plane].data();
+}
+
+static Image MakeSource(VideoFormat format, size_t cx, size_t cy, bool padded)
+{
+	size_t chromaCX = (cx + 1) / 2;
+	size_t chromaCY = (cy + 1) / 2;
+	Image image;
+
+	switch (format) {
+	case VideoFormat::I420:
+	case VideoFormat::YV12:
+		AllocPlane(image, 0, cx, cy, padded);
+		AllocPlane(image, 1, chromaCX, chromaCY, padded);
+		AllocPlane(image, 2, chromaCX, chromaCY, padded);
+		break;
+	case VideoFormat::NV12:
+		AllocPlane(image, 0, cx, cy, padded);
+		AllocPlane(image, 1, chromaCX * 2, chromaCY, padded);
+		break;
+	case VideoFormat::XRGB:
+	case VideoFormat::ARGB:
+		AllocPlane(image, 0, cx * 4, cy, padded);
+		break;
+	case VideoFormat::YUY2:
+	case VideoFormat::UYVY:
+		AllocPlane(image, 0, cx * 2, cy, padded);
+		break;
+	default:
+		break;
+	}
+
+	return image;
+}
+
+static inline const uint8_t *Pixel(const Image &image, int plane, size_t x,
+				   size_t y, size_t bytes)
+{
+	return image.data[plane] + y * image.linesize[plane] + x * bytes;
+}
+
+/* straightforward per-pixel conversions to compare the library against */
+static Reference ConvertReference(VideoFormat format, const Image &src,
+				  size_t cx, size_t cy, bool bottomUp)
+{
+	size_t chromaCX = (cx + 1) / 2;
+	size_t chromaCY = (cy + 1) / 2;
+	Reference ref;
+
+	ref.y.resize(cx * cy);
+	ref.u.resize(chromaCX * chromaCY);
+	ref.v.resize(chromaCX * chromaCY);
+
+	switch (format) {
+	case VideoFormat::I420:
+	case VideoFormat::YV12: {
+		int uPlane = format == VideoFormat::I420 ? 1 : 2;
+		int vPlane = 3 - uPlane;
+
+		for (size_t y = 0; y < cy; y++)
+			for (size_t x = 0; x < cx; x++)
+				ref.y[y * cx + x] = *Pixel(src, 0, x, y, 1);
+		for (size_t y = 0; y < chromaCY; y++) {
+			for (size_t x = 0; x < chromaCX; x++) {
+				size_t i = y * chromaCX + x;
+				ref.u[i] = *Pixel(src, uPlane, x, y, 1);
+				ref.v[i] = *Pixel(src, vPlane, x, y, 1);
+			}
+		}
+		break;
+	}
+
+	case VideoFormat::NV12:
+		for (size_t y = 0; y < cy; y++)
+			for (size_t x = 0; x < cx; x++)
+				ref.y[y * cx + x] = *Pixel(src, 0, x, y, 1);
+		for (size_t y = 0; y < chromaCY; y++) {
+			for (size_t x = 0; x < chromaCX; x++) {
+				const uint8_t *uv = Pixel(src, 1, x, y, 2);
+				ref.u[y * chromaCX + x] = uv[0];
+				ref.v[y * chromaCX + x] = uv[1];
+			}
+		}
+		break;
+
+	case VideoFormat::XRGB:
+	case VideoFormat::ARGB:
+		/* BT.601 limited range */
+		for (size_t y = 0; y < cy; y++) {
+			size_t row = bottomUp ? cy - 1 - y : y;
+			for (size_t x = 0; x < cx; x++) {
+				const uint8_t *p = Pixel(src, 0, x, row, 4);
+				int r = p[2], g = p[1], b = p[0];
+				ref.y[y * cx + x] = (uint8_t)(
+					((66 * r + 129 * g + 25 * b + 128) >>
+					 8) +
+					16);
+			}
+		}
+		for (size_t y = 0; y < chromaCY; y++) {
+			for (size_t x = 0; x < chromaCX; x++) {
+				/* an odd last row is counted twice, an odd
+				 * last column once */
+				size_t rows[2] = {y * 2, y * 2 + 1 < cy
+								 ? y * 2 + 1
+								 : y * 2};
+				size_t cols = x * 2 + 1 < cx ? 2 : 1;
+				int r = 0, g = 0, b = 0;
+
+				for (int i = 0; i < 2; i++) {
+					size_t row = bottomUp
+							     ? cy - 1 - rows[i]
+							     : rows[i];
+					for (size_t c = 0; c < cols; c++) {
+						const uint8_t *p = Pixel(
+							src, 0, x * 2 + c, row,
+							4);
+						b += p[0];
+						g += p[1];
+						r += p[2];
+					}
+				}
+
+				int shift = cols == 2 ? 10 : 9;
+				int round = 1 << (shift - 1);
+				size_t i = y * chromaCX + x;
+				ref.u[i] = (uint8_t)(((-38 * r - 74 * g +
+						       112 * b + round) >>
+						      shift) +
+						     128);
+				ref.v[i] = (uint8_t)(((112 * r - 94 * g -
+						       18 * b + round) >>
+						      shift) +
+						     128);
+			}
+		}
+		break;
+
+	case VideoFormat::YUY2:
+	case VideoFormat::UYVY: {
+		size_t yOff = format == VideoFormat::YUY2 ? 0 : 1;
+		size_t cOff = 1 - yOff;
+
+		for (size_t y = 0; y < cy; y++)
+			for (size_t x = 0; x < cx; x++)
+				ref.y[y * cx + x] =
+					Pixel(src, 0, x, y, 2)[yOff];
+		for (size_t y = 0; y < chromaCY; y++) {
+			size_t y1 = y * 2 + 1 < cy ? y * 2 + 1 : y * 2;
+			for (size_t x = 0; x < chromaCX; x++) {
+				const uint8_t *p0 =
+					Pixel(src, 0, x * 2, y * 2, 2);
+				const uint8_t *p1 = Pixel(src, 0, x * 2, y1, 2);
+				size_t i = y * chromaCX + x;
+				ref.u[i] = (uint8_t)((p0[cOff] + p1[cOff] + 1) >>
+						     1);
+				ref.v[i] = (uint8_t)((p0[cOff + 2] +
+						      p1[cOff + 2] + 1) >>
+						     1);
+			}
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+
+	return ref;
+}
+
+static const char *FormatName(VideoFormat format)
+{
+	switch (format) {
+	case VideoFormat::I420:
+		return "I420";
+	case VideoFormat::YV12:
+		return "YV12";
+	case VideoFormat::NV12:
+		return "NV12";
+	case VideoFormat::XRGB:
+		return "XRGB";
+	case VideoFormat::ARGB:
+		return "ARGB";
+	case VideoFormat::YUY2:
+		return "YUY2";
+	case VideoFormat::UYVY:
+		return "UYVY";
+	default:
+		return "?";
+	}
+}
+
+static void CheckConvert(VideoFormat format, int cx, int cy, bool padded,
+			 bool bottomUp = false)
+{
+	size_t width = (size_t)cx;
+	size_t height = (size_t)cy;
+	size_t chromaCX = (width + 1) / 2;
+	size_t chromaCY = (height + 1) / 2;
+
+	Image src = MakeSource(format, width, height, padded);
+	Reference ref = ConvertReference(format, src, width, height, bottomUp);
+
+	/* padded destinations too, to check nothing is written past a row */
+	size_t dstLinesize[3] = {Align64(width) + 64, Align64(chromaCX) + 64,
+				 Align64(chromaCX) + 64};
+	std::vector<uint8_t> y(dstLinesize[0] * height, GUARD_BYTE);
+	std::vector<uint8_t> v(dstLinesize[1] * chromaCY, GUARD_BYTE);
+	std::vector<uint8_t> u(dstLinesize[2] * chromaCY, GUARD_BYTE);
+	uint8_t *const dst[3] = {y.data(), v.data(), u.data()};
+
+	bool success = ConvertToYV12(format, src.data, src.linesize, cx, cy,
+				     dst, dstLinesize, bottomUp);
+	CHECK(success);
+	if (!success)
+		return;
+
+	size_t errors = ComparePlane(dst[0], dstLinesize[0], ref.y.data(),
+				     width, height);
+	errors += ComparePlane(dst[1], dstLinesize[1], ref.v.data(), chromaCX,
+			       chromaCY);
+	errors += ComparePlane(dst[2], dstLinesize[2], ref.u.data(), chromaCX,
+			       chromaCY);
+
+	if (errors)
+		fprintf(stderr, "ConvertToYV12 %s %dx%d%s%s: %zu errors\n",
+			FormatName(format), cx, cy, padded ? " padded" : "",
+			bottomUp ? " bottom-up" : "", errors);
+	CHECK(errors == 0);
+}
+
+/* widths either side of the 16 and 64 pixel SIMD blocks, odd ones included
+ * where the format allows them */
+static const int testWidths[] = {2,  4,  14,  16,  18,  30,  32,   34,
+				 62, 64, 66, 126, 130, 640, 1282, 1920};
+static const int oddWidths[] = {1, 3, 15, 17, 33, 63, 65, 129, 1281};
+static const int testHeights[] = {1, 2, 3, 4, 7, 16};
+
+static void CheckFormat(VideoFormat format, bool allowOddWidth,
+			bool bottomUp = false)
+{
+	for (int cx : testWidths)
+		for (int cy : testHeights)
+			for (int padded = 0; padded < 2; padded++)
+				CheckConvert(format, cx, cy, !!padded,
+					     bottomUp);
+
+	if (allowOddWidth)
+		for (int cx : oddWidths)
+			for (int cy : testHeights)
+				CheckConvert(format, cx, cy, true, bottomUp);
+}
+
+static void TestPlanar()
+{
+	CheckFormat(VideoFormat::I420, true);
+	CheckFormat(VideoFormat::YV12, true);
+	CheckFormat(VideoFormat::NV12, true);
+}
+
+static void TestRGB()
+{
+	CheckFormat(VideoFormat::XRGB, true);
+	CheckFormat(VideoFormat::ARGB, true);
+	CheckFormat(VideoFormat::XRGB, true, true);
+}
+
+static void TestPacked422()
+{
+	CheckFormat(VideoFormat::YUY2, false);
+	CheckFormat(VideoFormat::UYVY, false);
+}
+
+static void ConvertSolid(uint8_t b, uint8_t g, uint8_t r, uint8_t &y,
+			 uint8_t &u, uint8_t &v)
+{
+	uint8_t src[16 * 2 * 4];
+	for (size_t i = 0; i < sizeof(src); i += 4) {
+		src[i] = b;
+		src[i + 1] = g;
+		src[i + 2] = r;
+		src[i + 3] = 0xFF;
+	}
+
+	uint8_t yPlane[16 * 2], uPlane[8], vPlane[8];
+	const uint8_t *const srcPlanes[1] = {src};
+	const size_t srcLinesize[1] = {16 * 4};
+	uint8_t *const dst[3] = {yPlane, vPlane, uPlane};
+	const size_t dstLinesize[3] = {16, 8, 8};
+
+	CHECK(ConvertToYV12(VideoFormat::ARGB, srcPlanes, srcLinesize, 16, 2,
+			    dst, dstLinesize));
+	y = yPlane[0];
+	u = uPlane[0];
+	v = vPlane[0];
+}
+
+static void TestRGBRange()
+{
+	/* pins the reference to the expected BT.601 limited range values */
+	uint8_t y, u, v;
+
+	ConvertSolid(0, 0, 0, y, u, v);
+	CHECK(y == 16 && u == 128 && v == 128);
+	ConvertSolid(255, 255, 255, y, u, v);
+	CHECK(y == 235 && u == 128 && v == 128);
+	ConvertSolid(0, 0, 255, y, u, v);
+	CHECK(y == 82 && u == 90 && v == 240);
+	ConvertSolid(0, 255, 0, y, u, v);
+	CHECK(y == 144 && u == 54 && v == 34);
+	ConvertSolid(255, 0, 0, y, u, v);
+	CHECK(y == 41 && u == 240 && v == 110);
+}
+
+static void TestRejected()
+{
+	uint8_t buf[64 * 4 * 4] = {};
+	uint8_t out[64 * 4];
+	const uint8_t *const src[3] = {buf, buf, buf};
+	const size_t srcLinesize[3] = {64 * 4, 64, 64};
+	uint8_t *const dst[3] = {out, out, out};
+	const size_t dstLinesize[3] = {64, 32, 32};
+
+	CHECK(!ConvertToYV12(VideoFormat::I420, src, srcLinesize, 0, 4, dst,
+			     dstLinesize));
+	CHECK(!ConvertToYV12(VideoFormat::I420, src, srcLinesize, 4, -1, dst,
+			     dstLinesize));
+	CHECK(!ConvertToYV12(VideoFormat::YUY2, src, srcLinesize, 15, 2, dst,
+			     dstLinesize));
+	CHECK(!ConvertToYV12(VideoFormat::UYVY, src, srcLinesize, 15, 2, dst,
+			     dstLinesize));
+	CHECK(!ConvertToYV12(VideoFormat::MJPEG, src, srcLinesize, 16, 2, dst,
+			     dstLinesize));
+	CHECK(!ConvertToYV12(VideoFormat::H264, src, srcLinesize, 16, 2, dst,
+			     dstLinesize));
+
+	CHECK(VFormatConvertsToYV12(VideoFormat::NV12));
+	CHECK(VFormatConvertsToYV12(VideoFormat::YUY2));
+	CHECK(!VFormatConvertsToYV12(VideoFormat::MJPEG));
+	CHECK(!VFormatConvertsToYV12(VideoFormat::Any));
+
+	CHECK(VFormatConvertsToYV12(VideoFormat::YUY2, 1920, 1080));
+	CHECK(!VFormatConvertsToYV12(VideoFormat::YUY2, 1919, 1080));
+	CHECK(!VFormatConvertsToYV12(VideoFormat::UYVY, 721, 480));
+	CHECK(VFormatConvertsToYV12(VideoFormat::UYVY, 720, 481));
+	CHECK(VFormatConvertsToYV12(VideoFormat::I420, 1919, 1079));
+	CHECK(VFormatConvertsToYV12(VideoFormat::XRGB, 1, 1));
+	CHECK(!VFormatConvertsToYV12(VideoFormat::NV12, 0, 1080));
+	CHECK(!VFormatConvertsToYV12(VideoFormat::MJPEG, 1920, 1080));
+}
+
+int main()
+{
+	TestCopyPlaneContiguous();
+	TestCopyPlanePadded();
+	TestCopyPlaneOddWidths();
+	TestPlanar();
+	TestRGB();
+	TestRGBRange();
+	TestPacked422();
+	TestRejected();
+
+	return TestResult("test-video-convert");
+}
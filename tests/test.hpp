@@ -0,0 +1,61 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdio.h>
+
+/* minimal checking for the test programs: a failed check prints where it
+ * failed and carries on, and TestResult() gives the exit code for ctest */
+
+static int testFailures = 0;
+
+#define CHECK(expr)                                                     \
+	do {                                                            \
+		if (!(expr)) {                                          \
+			fprintf(stderr, "%s:%d: check failed: %s\n",    \
+				__FILE__, __LINE__, #expr);             \
+			testFailures++;                                 \
+		}                                                       \
+	} while (false)
+
+#define CHECK_NEAR(a, b, eps)                                             \
+	do {                                                              \
+		double check_a = (double)(a);                             \
+		double check_b = (double)(b);                             \
+		if (!(fabs(check_a - check_b) <= (double)(eps))) {        \
+			fprintf(stderr,                                   \
+				"%s:%d: check failed: %s == %s "          \
+				"(%.9g vs %.9g)\n",                       \
+				__FILE__, __LINE__, #a, #b, check_a,      \
+				check_b);                                 \
+			testFailures++;                                   \
+		}                                                         \
+	} while (false)
+
+static inline int TestResult(const char *name)
+{
+	if (testFailures)
+		fprintf(stderr, "%s: %d check(s) failed\n", name,
+			testFailures);
+	else
+		printf("%s: passed\n", name);
+	return testFailures ? 1 : 0;
+}
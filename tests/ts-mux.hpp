@@ -0,0 +1,135 @@
+/*
+ *  Copyright (C) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+/*
+ * Builds synthetic MPEG-2 transport streams for the demuxer tests and
+ * benchmark.  Each PES packet is split over as many TS packets as it
+ * needs, with the last one padded out by its adaptation field.
+ */
+
+#define TS_MUX_NO_TIMESTAMP -1LL
+
+struct TSMuxUnit {
+	int pid;
+	uint8_t streamId;
+	std::vector<uint8_t> payload;
+	long long pts; /* 90khz, TS_MUX_NO_TIMESTAMP for none */
+	long long dts;
+	bool bounded; /* PES_packet_length set rather than 0 */
+	bool randomAccess;
+};
+
+class TSMuxer {
+	uint8_t continuity[0x2000] = {};
+
+	static void PutTimestamp(uint8_t *p, int prefix, long long ts)
+	{
+		ts &= (1LL << 33) - 1;
+		p[0] = (uint8_t)((prefix << 4) | (((ts >> 30) & 7) << 1) | 1);
+		p[1] = (uint8_t)(ts >> 22);
+		p[2] = (uint8_t)((((ts >> 15) & 0x7F) << 1) | 1);
+		p[3] = (uint8_t)(ts >> 7);
+		p[4] = (uint8_t)(((ts & 0x7F) << 1) | 1);
+	}
+
+public:
+	std::vector<uint8_t> out;
+
+	/* offsets in out of the TS packets written for each unit */
+	std::vector<std::vector<size_t>> unitPackets;
+
+	void Write(const TSMuxUnit &unit)
+	{
+		bool hasPts = unit.pts != TS_MUX_NO_TIMESTAMP;
+		bool hasDts = hasPts && unit.dts != TS_MUX_NO_TIMESTAMP;
+		uint8_t headerSize = hasDts ? 10 : (hasPts ? 5 : 0);
+
+		std::vector<uint8_t> pes = {0, 0, 1, unit.streamId, 0, 0, 0x80,
+					    0, headerSize};
+		pes[7] = hasDts ? 0xC0 : (hasPts ? 0x80 : 0);
+		pes.resize(9 + headerSize);
+
+		if (hasPts)
+			PutTimestamp(&pes[9], hasDts ? 3 : 2, unit.pts);
+		if (hasDts)
+			PutTimestamp(&pes[14], 1, unit.dts);
+
+		pes.insert(pes.end(), unit.payload.begin(), unit.payload.end());
+
+		if (unit.bounded) {
+			size_t length = pes.size() - 6;
+			pes[4] = (uint8_t)(length >> 8);
+			pes[5] = (uint8_t)length;
+		}
+
+		std::vector<size_t> packets;
+		size_t offset = 0;
+		bool first = true;
+
+		while (offset < pes.size()) {
+			uint8_t packet[188];
+			size_t remaining = pes.size() - offset;
+			bool flags = first && unit.randomAccess;
+			size_t header = flags ? 6 : 4;
+			size_t size = 188 - header;
+
+			packet[0] = 0x47;
+			packet[1] = (uint8_t)((first ? 0x40 : 0) |
+					      (unit.pid >> 8));
+			packet[2] = (uint8_t)unit.pid;
+
+			if (remaining < size || flags) {
+				size_t stuffing =
+					remaining < size ? size - remaining : 0;
+				/* a zero length field is a single byte of
+				 * stuffing with no flags */
+				size_t length = header + stuffing - 5;
+
+				packet[3] = (uint8_t)(0x30 |
+						      continuity[unit.pid]);
+				packet[4] = (uint8_t)length;
+				if (length) {
+					packet[5] = flags ? 0x40 : 0;
+					memset(packet + 6, 0xFF, length - 1);
+				}
+
+				size = 188 - 5 - length;
+			} else {
+				packet[3] = (uint8_t)(0x10 |
+						      continuity[unit.pid]);
+			}
+
+			memcpy(packet + 188 - size, &pes[offset], size);
+			offset += size;
+
+			continuity[unit.pid] = (continuity[unit.pid] + 1) & 0xF;
+			packets.push_back(out.size());
+			out.insert(out.end(), packet, packet + 188);
+			first = false;
+		}
+
+		unitPackets.push_back(packets);
+	}
+};